@@ -58,6 +58,7 @@ void DMA1_Ch4_7_DMA2_Ch1_5_DMAMUX1_OVR_IRQHandler(void);
 void TIM14_IRQHandler(void);
 void TIM16_FDCAN_IT0_IRQHandler(void);
 void TIM17_FDCAN_IT1_IRQHandler(void);
+void I2C2_3_IRQHandler(void);
 void SPI1_IRQHandler(void);
 void USART1_IRQHandler(void);
 /* USER CODE BEGIN EFP */
@@ -57,6 +57,8 @@
 /* External variables --------------------------------------------------------*/
 extern PCD_HandleTypeDef hpcd_USB_DRD_FS;
 extern FDCAN_HandleTypeDef hfdcan1;
+extern DMA_HandleTypeDef hdma_i2c3_tx;
+extern I2C_HandleTypeDef hi2c3;
 extern DMA_HandleTypeDef hdma_spi1_rx;
 extern DMA_HandleTypeDef hdma_spi1_tx;
 extern SPI_HandleTypeDef hspi1;
@@ -200,6 +202,7 @@ void DMA1_Ch4_7_DMA2_Ch1_5_DMAMUX1_OVR_IRQHandler(void)
 
   /* USER CODE END DMA1_Ch4_7_DMA2_Ch1_5_DMAMUX1_OVR_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart1_rx);
+  HAL_DMA_IRQHandler(&hdma_i2c3_tx);
   /* USER CODE BEGIN DMA1_Ch4_7_DMA2_Ch1_5_DMAMUX1_OVR_IRQn 1 */
 
   /* USER CODE END DMA1_Ch4_7_DMA2_Ch1_5_DMAMUX1_OVR_IRQn 1 */
@@ -247,6 +250,24 @@ void TIM17_FDCAN_IT1_IRQHandler(void)
   /* USER CODE END TIM17_FDCAN_IT1_IRQn 1 */
 }
 
+/**
+  * @brief This function handles I2C2 and I2C3 Interrupts.
+  */
+void I2C2_3_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C2_3_IRQn 0 */
+
+  /* USER CODE END I2C2_3_IRQn 0 */
+  if (hi2c3.Instance->ISR & (I2C_FLAG_BERR | I2C_FLAG_ARLO | I2C_FLAG_OVR)) {
+    HAL_I2C_ER_IRQHandler(&hi2c3);
+  } else {
+    HAL_I2C_EV_IRQHandler(&hi2c3);
+  }
+  /* USER CODE BEGIN I2C2_3_IRQn 1 */
+
+  /* USER CODE END I2C2_3_IRQn 1 */
+}
+
 /**
   * @brief This function handles SPI1/I2S1 Interrupt.
   */
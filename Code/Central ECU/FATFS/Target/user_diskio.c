@@ -1,220 +1,254 @@
-/* USER CODE BEGIN Header */
-/**
- ******************************************************************************
-  * @file    user_diskio.c
-  * @brief   This file includes a diskio driver skeleton to be completed by the user.
-  ******************************************************************************
-  * @attention
-  *
-  * Copyright (c) 2025 STMicroelectronics.
-  * All rights reserved.
-  *
-  * This software is licensed under terms that can be found in the LICENSE file
-  * in the root directory of this software component.
-  * If no LICENSE file comes with this software, it is provided AS-IS.
-  *
-  ******************************************************************************
-  */
- /* USER CODE END Header */
-
-#ifdef USE_OBSOLETE_USER_CODE_SECTION_0
-/*
- * Warning: the user section 0 is no more in use (starting from CubeMx version 4.16.0)
- * To be suppressed in the future.
- * Kept to ensure backward compatibility with previous CubeMx versions when
- * migrating projects.
- * User code previously added there should be copied in the new user sections before
- * the section contents can be deleted.
- */
-/* USER CODE BEGIN 0 */
-/* USER CODE END 0 */
-#endif
-
-/* USER CODE BEGIN DECL */
-
-/* Includes ------------------------------------------------------------------*/
-#include <string.h>
-#include "ff_gen_drv.h"
-#include "sdcard.h"
-
-/* Private typedef -----------------------------------------------------------*/
-/* Private define ------------------------------------------------------------*/
-
-/* Private variables ---------------------------------------------------------*/
-/* Disk status */
-static volatile DSTATUS Stat = STA_NOINIT;
-
-/* USER CODE END DECL */
-
-/* Private function prototypes -----------------------------------------------*/
-DSTATUS USER_initialize (BYTE pdrv);
-DSTATUS USER_status (BYTE pdrv);
-DRESULT USER_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
-#if _USE_WRITE == 1
-  DRESULT USER_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
-#endif /* _USE_WRITE == 1 */
-#if _USE_IOCTL == 1
-  DRESULT USER_ioctl (BYTE pdrv, BYTE cmd, void *buff);
-#endif /* _USE_IOCTL == 1 */
-
-Diskio_drvTypeDef  USER_Driver =
-{
-  USER_initialize,
-  USER_status,
-  USER_read,
-#if  _USE_WRITE
-  USER_write,
-#endif  /* _USE_WRITE == 1 */
-#if  _USE_IOCTL == 1
-  USER_ioctl,
-#endif /* _USE_IOCTL == 1 */
-};
-
-/* Private functions ---------------------------------------------------------*/
-
-/**
-  * @brief  Initializes a Drive
-  * @param  pdrv: Physical drive number (0..)
-  * @retval DSTATUS: Operation status
-  */
-DSTATUS USER_initialize (
-	BYTE pdrv           /* Physical drive nmuber to identify the drive */
-)
-{
-  /* USER CODE BEGIN INIT */
-    if (pdrv) return STA_NOINIT;  // Only support drive 0
-    
-    if (SDCARD_Init() != 0) {
-        Stat = STA_NOINIT;
-        return Stat;
-    }
-    
-    Stat = RES_OK;
-    return Stat;
-  /* USER CODE END INIT */
-}
-
-/**
-  * @brief  Gets Disk Status
-  * @param  pdrv: Physical drive number (0..)
-  * @retval DSTATUS: Operation status
-  */
-DSTATUS USER_status (
-	BYTE pdrv       /* Physical drive number to identify the drive */
-)
-{
-  /* USER CODE BEGIN STATUS */
-    if (pdrv) return STA_NOINIT;  // Only support drive 0
-    return Stat;
-  /* USER CODE END STATUS */
-}
-
-/**
-  * @brief  Reads Sector(s)
-  * @param  pdrv: Physical drive number (0..)
-  * @param  *buff: Data buffer to store read data
-  * @param  sector: Sector address (LBA)
-  * @param  count: Number of sectors to read (1..128)
-  * @retval DRESULT: Operation result
-  */
-DRESULT USER_read (
-	BYTE pdrv,      /* Physical drive nmuber to identify the drive */
-	BYTE *buff,     /* Data buffer to store read data */
-	DWORD sector,   /* Sector address in LBA */
-	UINT count      /* Number of sectors to read */
-)
-{
-  /* USER CODE BEGIN READ */
-    if (pdrv) return RES_PARERR;  // Only support drive 0
-    
-    for (UINT i = 0; i < count; i++) {
-        if (SDCARD_ReadSingleBlock(sector + i, buff + (i * 512)) != 0) {
-            return RES_ERROR;
-        }
-    }
-    
-    return RES_OK;
-  /* USER CODE END READ */
-}
-
-/**
-  * @brief  Writes Sector(s)
-  * @param  pdrv: Physical drive number (0..)
-  * @param  *buff: Data to be written
-  * @param  sector: Sector address (LBA)
-  * @param  count: Number of sectors to write (1..128)
-  * @retval DRESULT: Operation result
-  */
-#if _USE_WRITE == 1
-DRESULT USER_write (
-	BYTE pdrv,          /* Physical drive nmuber to identify the drive */
-	const BYTE *buff,   /* Data to be written */
-	DWORD sector,       /* Sector address in LBA */
-	UINT count          /* Number of sectors to write */
-)
-{
-  /* USER CODE BEGIN WRITE */
-  if (pdrv) return RES_PARERR;  // Only support drive 0
-
-  if (SDCARD_WriteBegin(sector) != 0) {
-    return RES_ERROR;
-  }
-
-  for (UINT i = 0; i < count; i++) {
-    if (SDCARD_WriteData(buff + (i * 512)) != 0) {
-      SDCARD_WriteEnd();  // Clean up even on error
-      return RES_ERROR;
-    }
-  }
-
-  if (SDCARD_WriteEnd() != 0) {
-    return RES_ERROR;
-  }
-
-  return RES_OK;
-  /* USER CODE END WRITE */
-}
-#endif /* _USE_WRITE == 1 */
-
-/**
-  * @brief  I/O control operation
-  * @param  pdrv: Physical drive number (0..)
-  * @param  cmd: Control code
-  * @param  *buff: Buffer to send/receive control data
-  * @retval DRESULT: Operation result
-  */
-#if _USE_IOCTL == 1
-DRESULT USER_ioctl (
-	BYTE pdrv,      /* Physical drive nmuber (0..) */
-	BYTE cmd,       /* Control code */
-	void *buff      /* Buffer to send/receive control data */
-)
-{
-  /* USER CODE BEGIN IOCTL */
-    if (pdrv) return RES_PARERR;  // Only support drive 0
-    
-    switch (cmd) {
-        case CTRL_SYNC:
-            return RES_OK;
-            
-        case GET_SECTOR_COUNT:
-            if (SDCARD_GetBlocksNumber((uint32_t*)buff) != 0) {
-                return RES_ERROR;
-            }
-            return RES_OK;
-            
-        case GET_SECTOR_SIZE:
-            *(WORD*)buff = 512;
-            return RES_OK;
-            
-        case GET_BLOCK_SIZE:
-            *(DWORD*)buff = 1;
-            return RES_OK;
-            
-        default:
-            return RES_PARERR;
-    }
-  /* USER CODE END IOCTL */
-}
-#endif /* _USE_IOCTL == 1 */
-
+/* USER CODE BEGIN Header */
+/**
+ ******************************************************************************
+  * @file    user_diskio.c
+  * @brief   This file includes a diskio driver skeleton to be completed by the user.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2025 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+ /* USER CODE END Header */
+
+#ifdef USE_OBSOLETE_USER_CODE_SECTION_0
+/*
+ * Warning: the user section 0 is no more in use (starting from CubeMx version 4.16.0)
+ * To be suppressed in the future.
+ * Kept to ensure backward compatibility with previous CubeMx versions when
+ * migrating projects.
+ * User code previously added there should be copied in the new user sections before
+ * the section contents can be deleted.
+ */
+/* USER CODE BEGIN 0 */
+/* USER CODE END 0 */
+#endif
+
+/* USER CODE BEGIN DECL */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "ff_gen_drv.h"
+#include "sdcard.h"
+#include "config.h"
+#ifdef SD_FAULT_INJECT
+#include "sd_fault.h"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+/* Disk status */
+static volatile DSTATUS Stat = STA_NOINIT;
+
+/* Volume window, only moved away from the whole card while formatting */
+static DWORD vol_base = 0;
+static DWORD vol_size = 0;  /* 0 = up to the end of the card */
+static DWORD vol_block = 0; /* 0 = the card's AU */
+
+void USER_set_volume_window(DWORD base, DWORD size, DWORD block)
+{
+    vol_base = base;
+    vol_size = size;
+    vol_block = block;
+}
+
+/* USER CODE END DECL */
+
+/* Private function prototypes -----------------------------------------------*/
+DSTATUS USER_initialize (BYTE pdrv);
+DSTATUS USER_status (BYTE pdrv);
+DRESULT USER_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+  DRESULT USER_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+  DRESULT USER_ioctl (BYTE pdrv, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+
+Diskio_drvTypeDef  USER_Driver =
+{
+  USER_initialize,
+  USER_status,
+  USER_read,
+#if  _USE_WRITE
+  USER_write,
+#endif  /* _USE_WRITE == 1 */
+#if  _USE_IOCTL == 1
+  USER_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Initializes a Drive
+  * @param  pdrv: Physical drive number (0..)
+  * @retval DSTATUS: Operation status
+  */
+DSTATUS USER_initialize (
+	BYTE pdrv           /* Physical drive nmuber to identify the drive */
+)
+{
+  /* USER CODE BEGIN INIT */
+    if (pdrv) return STA_NOINIT;  // Only support drive 0
+    
+    if (SDCARD_Init() != 0) {
+        Stat = STA_NOINIT;
+        return Stat;
+    }
+    
+    Stat = RES_OK;
+    return Stat;
+  /* USER CODE END INIT */
+}
+
+/**
+  * @brief  Gets Disk Status
+  * @param  pdrv: Physical drive number (0..)
+  * @retval DSTATUS: Operation status
+  */
+DSTATUS USER_status (
+	BYTE pdrv       /* Physical drive number to identify the drive */
+)
+{
+  /* USER CODE BEGIN STATUS */
+    if (pdrv) return STA_NOINIT;  // Only support drive 0
+    return Stat;
+  /* USER CODE END STATUS */
+}
+
+/**
+  * @brief  Reads Sector(s)
+  * @param  pdrv: Physical drive number (0..)
+  * @param  *buff: Data buffer to store read data
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to read (1..128)
+  * @retval DRESULT: Operation result
+  */
+DRESULT USER_read (
+	BYTE pdrv,      /* Physical drive nmuber to identify the drive */
+	BYTE *buff,     /* Data buffer to store read data */
+	DWORD sector,   /* Sector address in LBA */
+	UINT count      /* Number of sectors to read */
+)
+{
+  /* USER CODE BEGIN READ */
+    if (pdrv) return RES_PARERR;  // Only support drive 0
+
+#ifdef SD_FAULT_INJECT
+    if (!sd_fault_on_read()) return RES_ERROR;
+#endif
+    
+    for (UINT i = 0; i < count; i++) {
+        if (SDCARD_ReadSingleBlock(vol_base + sector + i, buff + (i * 512)) != 0) {
+            return RES_ERROR;
+        }
+    }
+    
+    return RES_OK;
+  /* USER CODE END READ */
+}
+
+/**
+  * @brief  Writes Sector(s)
+  * @param  pdrv: Physical drive number (0..)
+  * @param  *buff: Data to be written
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to write (1..128)
+  * @retval DRESULT: Operation result
+  */
+#if _USE_WRITE == 1
+DRESULT USER_write (
+	BYTE pdrv,          /* Physical drive nmuber to identify the drive */
+	const BYTE *buff,   /* Data to be written */
+	DWORD sector,       /* Sector address in LBA */
+	UINT count          /* Number of sectors to write */
+)
+{
+  /* USER CODE BEGIN WRITE */
+  if (pdrv) return RES_PARERR;  // Only support drive 0
+
+#ifdef SD_FAULT_INJECT
+  if (!sd_fault_on_write(sector, count)) return RES_ERROR;
+#endif
+
+  if (SDCARD_WriteBegin(vol_base + sector) != 0) {
+    return RES_ERROR;
+  }
+
+  for (UINT i = 0; i < count; i++) {
+    if (SDCARD_WriteData(buff + (i * 512)) != 0) {
+      SDCARD_WriteEnd();  // Clean up even on error
+      return RES_ERROR;
+    }
+  }
+
+  if (SDCARD_WriteEnd() != 0) {
+    return RES_ERROR;
+  }
+
+  return RES_OK;
+  /* USER CODE END WRITE */
+}
+#endif /* _USE_WRITE == 1 */
+
+/**
+  * @brief  I/O control operation
+  * @param  pdrv: Physical drive number (0..)
+  * @param  cmd: Control code
+  * @param  *buff: Buffer to send/receive control data
+  * @retval DRESULT: Operation result
+  */
+#if _USE_IOCTL == 1
+DRESULT USER_ioctl (
+	BYTE pdrv,      /* Physical drive nmuber (0..) */
+	BYTE cmd,       /* Control code */
+	void *buff      /* Buffer to send/receive control data */
+)
+{
+  /* USER CODE BEGIN IOCTL */
+    if (pdrv) return RES_PARERR;  // Only support drive 0
+    
+    switch (cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+            
+        case GET_SECTOR_COUNT:
+            if (SDCARD_GetBlocksNumber((uint32_t*)buff) != 0) {
+                return RES_ERROR;
+            }
+            if (vol_size) {
+                *(DWORD*)buff = vol_size;
+            } else {
+                *(DWORD*)buff -= vol_base;
+            }
+            return RES_OK;
+            
+        case GET_SECTOR_SIZE:
+            *(WORD*)buff = 512;
+            return RES_OK;
+            
+        case GET_BLOCK_SIZE:
+            /* Erase block (AU) size so f_mkfs aligns the data area; 1 if unknown */
+            if (vol_block) {
+                *(DWORD*)buff = vol_block;
+            } else if (SDCARD_GetAllocationUnit((uint32_t*)buff) != 0) {
+                *(DWORD*)buff = 1;
+            }
+            return RES_OK;
+            
+        default:
+            return RES_PARERR;
+    }
+  /* USER CODE END IOCTL */
+}
+#endif /* _USE_IOCTL == 1 */
+
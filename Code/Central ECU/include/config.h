@@ -9,8 +9,13 @@
 #define BOARD_TYPE_CENTRAL
 extern uint8_t BOARD_ID;
 
+#ifndef HOTFIRE_CONFIG // Defined by builds that check the hot-fire configuration (tools/host fsm_sim_hotfire)
 #define COLDFLOW_MODE //TODO: Remove before hot-fire
 #define TEST_MODE //TODO: Remove before hot-fire
+#endif
+// #define SD_FAULT_INJECT // Bench only: SD fault injection and load commands on the debug interface
+// #define RS422_STRESS // Bench only: emulated RIU traffic into the RS422 receiver (RSSTRESS command)
+// #define FSM_FUZZ // Bench only: randomised countdowns from an emulated RIU (FSMFUZZ command, needs RS422_STRESS)
 
 #define BOARD_ID_RIU 0
 #define BOARD_ID_ECU 1
@@ -13,6 +13,22 @@
 #include "crc.h"
 #include "test_servo.h"
 #include "main_FSM.h"
+#include "sensor_summary.h"
+#include "sensor_seq.h"
+#include "calibration.h"
+#include "sd_replay.h"
+#include "sequencer.h"
+#include "fsm_monitor.h"
+#include "heartbeat.h"
+#ifdef SD_FAULT_INJECT
+#include "sd_fault.h"
+#endif
+#ifdef RS422_STRESS
+#include "rs422_stress.h"
+#endif
+#ifdef FSM_FUZZ
+#include "fsm_fuzz.h"
+#endif
 
 uint8_t BOARD_ID = 0;
 
@@ -50,6 +66,7 @@ void app_init(void) {
     }
 
     HAL_ADCEx_Calibration_Start(&hadc1);
+    calibration_init(); // Calibration from flash and the sensor tables built from it, before anything converts
     ssd1306_Init();
     batt_check();
     HAL_Delay(100); // Wait for battery check to stabilize
@@ -76,6 +93,8 @@ void app_init(void) {
         dbg_printf("INIT: Failed to start ADC\n");
         setup_panic(6);
     }
+    sequencer_init(); // Start the sequencer step timer
+    heartbeat_init(); // Start heartbeat supervision
     test_servo_init();
 }
 
@@ -111,14 +130,30 @@ void app_run(void) {
     // Define tasks
     Task tasks[] = {
         {0, 20,  task_poll_can_handlers},     // Poll CAN handlers every 20 ms
-        {0, 100, task_poll_rs422},            // Poll RS422 every 100 ms
+        {0, 10, task_poll_rs422},             // Poll RS422 every 10 ms so commands are ACKed promptly
         {0, 1000, task_poll_battery},         // Poll battery every 1000 ms
         {0, 500, test_servo_poll},            // Poll test servo interface
         {0, 500, task_flush_sd_card},         // Flush SD card every 500 ms
-        {0, 100, fsm_tick},
+        {0, 100, fsm_tick},                   // Periodic FSM work, everything else is handled as posted
+        {0, 1, fsm_dispatch},                 // FSM events posted from interrupts, interlock edges
+        {0, 1, fsm_monitor_poll},             // FSM safety invariants against the output pins
         {0, 3, can_service_tx_queue},         // Service CAN TX queue every 3 ms
+        {0, 1, rs422_service_tx},             // Restart RS422 TX lanes waiting on their rate limit
         {0, 400, task_send_heartbeat},        // Send heartbeat every 400 ms
-        {0, 200, spicy_send_status_update}    // Send spicy status update over RS422 every 200 ms
+        {0, 200, spicy_send_status_update},   // Send spicy status update over RS422 every 200 ms
+        {0, 5, sensor_summary_poll},          // Sensor summaries to the RIU at the display rate
+        {0, 100, sensor_seq_poll},            // Sensor frames dropped before the SD card
+        {0, 5, sd_replay_poll},               // SD replay to the RIU in the link's spare capacity
+        {0, 1000, calibration_poll},          // Board calibration info, logged once per session
+#ifdef SD_FAULT_INJECT
+        {0, 10, sd_fault_load_poll},          // Synthetic SD sensor load (bench only)
+#endif
+#ifdef RS422_STRESS
+        {0, 1, rs422_stress_poll},            // Emulated RIU traffic (bench only)
+#endif
+#ifdef FSM_FUZZ
+        {0, 1, fsm_fuzz_poll},                // Randomised countdowns (bench only)
+#endif
     };
 
     while (1) {
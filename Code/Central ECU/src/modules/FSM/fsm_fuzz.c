@@ -0,0 +1,323 @@
+#include "fsm_fuzz.h"
+#include <string.h>
+#include "debug_io.h"
+#include "fsm_monitor.h"
+#include "main_FSM.h"
+#include "rs422.h"
+#include "rs422_stress.h"
+#include "sequencer.h"
+#include "servo.h"
+
+#ifdef FSM_FUZZ
+
+#ifndef RS422_STRESS
+#error "FSM_FUZZ injects RIU frames through RS422_STRESS, define both"
+#endif
+
+#define SW_POWER    (1U << 15)
+#define SW_VALVE    (1U << 14)
+#define SW_PYRO     (1U << 13)
+#define SW_OVERRIDE (1U << 12)
+
+#define FUZZ_QUEUE_LEN  8U
+
+typedef enum {
+    DIST_NONE = 0,
+    DIST_ABORT,             // Abort command
+    DIST_DISARM,            // Arm switches off
+    DIST_OVERRIDE,          // Sequencer override switch on
+    DIST_ESTOP,             // Emulated ESTOP press
+    DIST_RIU_SILENT,        // Heartbeats stop
+    DIST_DOUBLE_FIRE,       // A second fire command
+    DIST_COUNT
+} fuzz_disturbance_t;
+
+typedef enum {
+    FUZZ_IDLE,
+    FUZZ_SETTLE,            // Switches off and ESTOP until READY
+    FUZZ_CLOSE_VALVES,      // Rig back to the prefire valve state
+    FUZZ_ARM,               // Switches on until the sequencer is READY
+    FUZZ_RUN
+} fuzz_phase_t;
+
+typedef struct {
+    bool used;
+    uint32_t due;
+    RS422_FrameType_t type;
+    uint8_t size;
+    uint8_t data[3];
+} fuzz_pending_t;
+
+static const char *dist_names[DIST_COUNT] = {
+    "none", "abort", "disarm", "override", "estop", "riu silent", "double fire"
+};
+
+static const char *state_names[] = {
+    [STATE_INIT] = "INIT", [STATE_READY] = "READY", [STATE_SEQUENCER] = "SEQUENCER",
+    [STATE_POST_FIRE] = "POST_FIRE", [STATE_MANUAL_MODE] = "MANUAL", [STATE_ABORT] = "ABORT"
+};
+
+static fuzz_phase_t phase = FUZZ_IDLE;
+static uint32_t rng = 1;
+static uint32_t runs_left = 0;
+static uint32_t phase_start = 0;
+static uint32_t last_heartbeat = 0;
+static bool estop = false;
+static bool silent = false;
+static uint8_t emu_seq = 0;
+static uint8_t emu_cmd_seq = 0;
+static fuzz_pending_t pending[FUZZ_QUEUE_LEN];
+
+static struct {
+    uint32_t seed;
+    fuzz_disturbance_t dist;
+    uint32_t dist_at;           // ms after fire
+    bool dist_sent;
+    main_states_t dist_state;   // FSM state when it was sent
+    uint32_t violations;        // Monitor count at the start
+} run;
+
+static struct {
+    uint32_t runs;
+    uint32_t failed_starts;
+    uint32_t unexpected;
+    uint32_t violations;
+    uint32_t outcomes[DIST_COUNT][2];   // [disturbance][0 post fire, 1 abort/ready]
+} totals;
+
+static uint32_t rand_next(void)
+{
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void inject(RS422_FrameType_t type, const uint8_t *data, uint8_t size)
+{
+    uint8_t buf[RS422_TX_MESSAGE_SIZE];
+    uint16_t len = rs422_encode_frame(emu_seq++, type, data, size, buf);
+    rs422_stress_inject(buf, len);
+}
+
+// Queue a command for delivery after a random delay, sometimes twice as if retransmitted
+static void send_command(RS422_FrameType_t type, const uint8_t *args, uint8_t size)
+{
+    uint8_t copies = (rand_next() % 1000U < FSM_FUZZ_DUP_PER_MILLE) ? 2 : 1;
+    uint8_t cmd_seq = emu_cmd_seq++;
+    for (uint8_t c = 0; c < copies; c++) {
+        for (uint8_t i = 0; i < FUZZ_QUEUE_LEN; i++) {
+            fuzz_pending_t *p = &pending[i];
+            if (p->used) continue;
+            p->used = true;
+            p->due = HAL_GetTick() + rand_next() % (FSM_FUZZ_JITTER_MS + 1U);
+            p->type = type;
+            p->data[0] = cmd_seq;
+            memcpy(&p->data[1], args, size);
+            p->size = size + 1;
+            break;
+        }
+    }
+}
+
+static void send_switches(uint16_t switches)
+{
+    uint8_t args[2] = {(uint8_t)(switches >> 8), (uint8_t)switches};
+    send_command(RS422_FRAME_SWITCH_CHANGE, args, sizeof(args));
+}
+
+static void send_fire(void)
+{
+    uint8_t args[1] = {0xC0 | (1 + rand_next() % 6)};
+    send_command(RS422_FRAME_FIRE, args, sizeof(args));
+}
+
+static void deliver(uint32_t now)
+{
+    for (uint8_t i = 0; i < FUZZ_QUEUE_LEN; i++) {
+        fuzz_pending_t *p = &pending[i];
+        if (p->used && (int32_t)(now - p->due) >= 0) {
+            inject(p->type, p->data, p->size);
+            p->used = false;
+        }
+    }
+    if (!silent && now - last_heartbeat >= FSM_FUZZ_HEARTBEAT_MS) {
+        uint8_t hb[2] = {0, 0};
+        inject(RS422_FRAME_HEARTBEAT, hb, sizeof(hb));
+        last_heartbeat = now;
+    }
+}
+
+static void set_phase(fuzz_phase_t next)
+{
+    phase = next;
+    phase_start = HAL_GetTick();
+}
+
+static void disturb(void)
+{
+    run.dist_sent = true;
+    run.dist_state = fsm_get_state();
+    switch (run.dist) {
+        case DIST_ABORT: {
+            uint8_t code = 0;
+            send_command(RS422_FRAME_ABORT, &code, 1);
+            break;
+        }
+        case DIST_DISARM:       send_switches(SW_POWER); break;
+        case DIST_OVERRIDE:     send_switches(SW_POWER | SW_VALVE | SW_PYRO | SW_OVERRIDE); break;
+        case DIST_ESTOP:        estop = true; break;
+        case DIST_RIU_SILENT:   silent = true; break;
+        case DIST_DOUBLE_FIRE:  send_fire(); break;
+        default:                break;
+    }
+}
+
+static void start_run(void)
+{
+    run.seed = rng;
+    run.dist = (fuzz_disturbance_t)(rand_next() % DIST_COUNT);
+    run.dist_at = rand_next() % FSM_FUZZ_WINDOW_MS;
+    run.dist_sent = false;
+    run.violations = fsm_monitor_violations();
+    send_fire();
+    set_phase(FUZZ_RUN);
+}
+
+static void end_run(main_states_t outcome)
+{
+    // Anything sent while the sequence was live has to end it early, except a second fire,
+    // and heartbeat loss which is ignored once firing
+    bool aborted = (outcome != STATE_POST_FIRE);
+    bool live = run.dist_sent && run.dist_state == STATE_SEQUENCER;
+    bool ok;
+    if (!live || run.dist == DIST_NONE || run.dist == DIST_DOUBLE_FIRE) {
+        ok = !aborted;
+    } else if (run.dist == DIST_RIU_SILENT) {
+        ok = true;
+    } else {
+        ok = aborted;
+    }
+    uint32_t violations = fsm_monitor_violations() - run.violations;
+
+    totals.runs++;
+    totals.outcomes[run.dist][aborted ? 1 : 0]++;
+    totals.violations += violations;
+    if (!ok) totals.unexpected++;
+    dbg_printf("FSM FUZZ: run %lu seed %08lX, %s at %lu ms%s -> %s, %lu violations%s\r\n",
+               totals.runs, run.seed, dist_names[run.dist], run.dist_at, live ? "" : " (not live)",
+               state_names[outcome], violations, ok ? "" : ", UNEXPECTED");
+
+    silent = false;
+    if (runs_left > 0) runs_left--;
+    if (runs_left == 0) {
+        fsm_fuzz_stop();
+    } else {
+        set_phase(FUZZ_SETTLE);
+        estop = true;
+        send_switches(0);
+    }
+}
+
+void fsm_fuzz_start(uint32_t runs, uint32_t seed)
+{
+    if (phase != FUZZ_IDLE) fsm_fuzz_stop();
+    if (rs422_stress_running()) rs422_stress_stop();
+
+    memset(&totals, 0, sizeof(totals));
+    memset(pending, 0, sizeof(pending));
+    rng = seed ? seed : 1;
+    runs_left = runs ? runs : 1;
+    silent = false;
+    estop = true;
+    last_heartbeat = HAL_GetTick();
+    rs422_stress_attach(true);
+    send_switches(0);
+    set_phase(FUZZ_SETTLE);
+    dbg_printf("FSM FUZZ: %lu runs, seed %08lX\r\n", runs_left, rng);
+}
+
+void fsm_fuzz_stop(void)
+{
+    if (phase == FUZZ_IDLE) return;
+    phase = FUZZ_IDLE;
+    estop = false;
+    rs422_stress_attach(false);
+
+    dbg_printf("FSM FUZZ: %lu runs, %lu failed starts, %lu unexpected outcomes, %lu invariant violations\r\n",
+               totals.runs, totals.failed_starts, totals.unexpected, totals.violations);
+    for (uint8_t d = 0; d < DIST_COUNT; d++) {
+        dbg_printf("  %-12s %lu post fire, %lu aborted\r\n", dist_names[d], totals.outcomes[d][0], totals.outcomes[d][1]);
+    }
+    fsm_monitor_print_stats();
+}
+
+bool fsm_fuzz_running(void)
+{
+    return phase != FUZZ_IDLE;
+}
+
+bool fsm_fuzz_interlock(void)
+{
+    return !estop;
+}
+
+void fsm_fuzz_poll(void)
+{
+    if (phase == FUZZ_IDLE) return;
+
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - phase_start;
+    main_states_t state = fsm_get_state();
+    deliver(now);
+
+    switch (phase) {
+        case FUZZ_SETTLE:
+            if (state == STATE_READY) {
+                servo_arm_all();
+                for (uint8_t v = 0; v < 4; v++) servo_set_position(v, SERVO_POSITION_CLOSE);
+                set_phase(FUZZ_CLOSE_VALVES);
+            } else if (elapsed > FSM_FUZZ_SETTLE_MS) {
+                dbg_printf("FSM FUZZ: stuck in %s, stopping\r\n", state_names[state]);
+                fsm_fuzz_stop();
+            } else if (elapsed % 500U == 0) {
+                send_switches(0); // ABORT only leaves on a switch change
+            }
+            break;
+        case FUZZ_CLOSE_VALVES:
+            if (servo_helper_check_all_closed() || elapsed > FSM_FUZZ_SETTLE_MS) {
+                servo_disarm_all();
+                estop = false;
+                send_switches(SW_POWER | SW_VALVE | SW_PYRO);
+                set_phase(FUZZ_ARM);
+            }
+            break;
+        case FUZZ_ARM:
+            if (state == STATE_SEQUENCER && sequencer_get_state() == SEQUENCER_READY) {
+                start_run();
+            } else if (elapsed > FSM_FUZZ_SETTLE_MS) {
+                totals.failed_starts++;
+                dbg_printf("FSM FUZZ: failed start (%s, seq %d)\r\n", state_names[state], sequencer_get_state());
+                estop = true;
+                send_switches(0);
+                set_phase(FUZZ_SETTLE);
+            }
+            break;
+        case FUZZ_RUN:
+            if (!run.dist_sent && elapsed >= run.dist_at) {
+                disturb();
+            }
+            if (state != STATE_SEQUENCER) {
+                end_run(state);
+            } else if (elapsed > FSM_FUZZ_RUN_TIMEOUT_MS) {
+                dbg_printf("FSM FUZZ: run timed out in the sequencer\r\n");
+                end_run(state);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+#endif // FSM_FUZZ
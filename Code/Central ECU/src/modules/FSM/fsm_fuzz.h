@@ -0,0 +1,38 @@
+#ifndef FSM_FUZZ_H
+#define FSM_FUZZ_H
+
+#include "stm32g0xx_hal.h"
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Randomised countdowns on the bench, to find FSM and sequencer timing bugs before the pad.
+// Only built when FSM_FUZZ (and RS422_STRESS, for the RX injection) are defined in
+// config.h. Needs the servo board connected and nothing on the igniter or solenoid outputs.
+//
+// Each run the emulated RIU arms the switches, sends a fire command and at a random time
+// one disturbance: abort command, disarm, override, ESTOP, heartbeat silence, a second fire
+// command, or nothing. Every command goes through the real RS422 parser, command layer and
+// handler, with random delivery jitter (so commands can overtake each other) and random
+// duplicates. The outcome is checked against what the disturbance should cause, and
+// fsm_monitor checks its invariants throughout. Runs are real time, the sequence timings are
+// what is under test. ESTOP is emulated on top of the real interlock input.
+
+#define FSM_FUZZ_HEARTBEAT_MS       100U
+#define FSM_FUZZ_JITTER_MS          40U     // Command delivery delay, 0 to this
+#define FSM_FUZZ_DUP_PER_MILLE      100U    // Commands delivered twice
+#define FSM_FUZZ_WINDOW_MS          50000U  // Disturbance time after fire, 0 to this
+#define FSM_FUZZ_RUN_TIMEOUT_MS     90000U
+#define FSM_FUZZ_SETTLE_MS          3000U   // Time allowed to get back to READY between runs
+
+void fsm_fuzz_start(uint32_t runs, uint32_t seed);
+void fsm_fuzz_stop(void);
+bool fsm_fuzz_running(void);
+
+// Call every ms
+void fsm_fuzz_poll(void);
+
+// False while the emulated ESTOP is pressed
+bool fsm_fuzz_interlock(void);
+
+#endif // FSM_FUZZ_H
@@ -0,0 +1,141 @@
+#include "fsm_monitor.h"
+#include <string.h>
+#include "debug_io.h"
+#include "error_def.h"
+#include "sd_log.h"
+#include "sequencer.h"
+#include "servo.h"
+#include "spicy.h"
+
+static const char *inv_names[FSM_INV_COUNT] = {
+    [FSM_INV_IGNITER_PREFIRE] = "igniter without prefire",
+    [FSM_INV_SOLENOID_STATE] = "solenoid open outside sequencer/manual",
+    [FSM_INV_SEQ_STATE] = "sequencer running outside STATE_SEQUENCER",
+    [FSM_INV_ABORT_OUTPUTS] = "outputs live in abort",
+    [FSM_INV_ABORT_VALVES] = "valves not disarmed after abort"
+};
+
+static fsm_monitor_stats_t stats;
+static bool prefire_passed = false;
+static bool checks_passed = false;
+static uint8_t failing = 0;                 // Bit per invariant, logged once per excursion
+static main_states_t last_state = STATE_INIT;
+static uint32_t abort_entry = 0;
+static bool abort_valves_pending = false;
+
+void fsm_monitor_note_prefire(bool ok)
+{
+    prefire_passed = ok;
+    checks_passed = false;
+}
+
+void fsm_monitor_note_checks(bool ok)
+{
+    checks_passed = ok;
+}
+
+static bool servos_disarmed(void)
+{
+    servo_feedback_t servos[4];
+    servo_get_states(servos);
+    for (uint8_t i = 0; i < 4; i++) {
+        if (servos[i].state != SERVO_DISARMED) return false;
+    }
+    return true;
+}
+
+// Returns true on the first failing check of an excursion
+static bool check(fsm_invariant_t inv, bool holds)
+{
+    uint8_t bit = 1U << inv;
+    if (holds) {
+        failing &= ~bit;
+        return false;
+    }
+    if (failing & bit) {
+        return false;
+    }
+    failing |= bit;
+    stats.violations[inv]++;
+    dbg_printf("FSM MONITOR: %s (state %d, seq %d)\n", inv_names[inv], fsm_get_state(), sequencer_get_state());
+    sd_log_write(SD_LOG_ERROR, "FSM invariant: %s", inv_names[inv]);
+    return true;
+}
+
+void fsm_monitor_poll(void)
+{
+    uint32_t now = HAL_GetTick();
+    main_states_t state = fsm_get_state();
+    sequencer_states_t seq = sequencer_get_state();
+    bool igniter = spicy_get_ematch1();
+    bool solenoid = spicy_get_solenoid();
+    bool armed = spicy_get_arm();
+    bool violated = false;
+
+    stats.checks++;
+    if (state != last_state) {
+        last_state = state;
+        if (state == STATE_ABORT) {
+            stats.aborts++;
+            abort_entry = now;
+            abort_valves_pending = true;
+        }
+    }
+
+    violated |= check(FSM_INV_IGNITER_PREFIRE,
+                      !igniter || (state == STATE_SEQUENCER && prefire_passed && checks_passed && armed));
+    violated |= check(FSM_INV_SOLENOID_STATE,
+                      !solenoid || state == STATE_SEQUENCER || state == STATE_MANUAL_MODE);
+    violated |= check(FSM_INV_SEQ_STATE,
+                      (seq != SEQUENCER_COUNTDOWN && seq != SEQUENCER_FIRE) || state == STATE_SEQUENCER);
+
+    if (state == STATE_ABORT) {
+        if (check(FSM_INV_ABORT_OUTPUTS, !igniter && !solenoid && !armed)) {
+            outputs_safe();
+        }
+        if (abort_valves_pending) {
+            uint32_t elapsed = now - abort_entry;
+            if (servos_disarmed()) {
+                abort_valves_pending = false;
+                if (elapsed > stats.abort_valves_max_ms) stats.abort_valves_max_ms = elapsed;
+            } else if (elapsed > FSM_MONITOR_ABORT_VALVES_MS) {
+                abort_valves_pending = false;
+                (void)check(FSM_INV_ABORT_VALVES, false);
+            }
+        }
+    } else {
+        failing &= ~((1U << FSM_INV_ABORT_OUTPUTS) | (1U << FSM_INV_ABORT_VALVES));
+        abort_valves_pending = false;
+        if (violated) {
+            fsm_set_abort(ECU_ERROR_INVARIANT);
+        }
+    }
+}
+
+uint32_t fsm_monitor_violations(void)
+{
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < FSM_INV_COUNT; i++) {
+        total += stats.violations[i];
+    }
+    return total;
+}
+
+void fsm_monitor_get_stats(fsm_monitor_stats_t *out)
+{
+    *out = stats;
+}
+
+void fsm_monitor_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void fsm_monitor_print_stats(void)
+{
+    dbg_printf("FSM MONITOR: %lu checks, %lu aborts, slowest abort to valves disarmed %lu ms\n",
+               stats.checks, stats.aborts, stats.abort_valves_max_ms);
+    for (uint8_t i = 0; i < FSM_INV_COUNT; i++) {
+        dbg_printf("  %-42s %lu\n", inv_names[i], stats.violations[i]);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FSM_MONITOR_H
+#define FSM_MONITOR_H
+
+#include "stm32g0xx_hal.h"
+#include "main_FSM.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Safety invariants of the main FSM and sequencer, checked against the actual output pins
+// every ms in every build, so timing bugs (an abort racing a step, a fire command arriving
+// mid transition) show up as counted violations instead of only on the pad.
+//
+// Output invariants broken outside ABORT abort with ECU_ERROR_INVARIANT; broken inside
+// ABORT they make the outputs safe again. The valve invariant is only reported.
+
+#define FSM_MONITOR_ABORT_VALVES_MS 500U    // Abort to all servos reporting disarmed
+
+typedef enum {
+    FSM_INV_IGNITER_PREFIRE = 0,    // Igniter on only in the sequencer, after prefire_ok and
+                                    // the pre-ignition checks step passed, with spicy armed
+    FSM_INV_SOLENOID_STATE,         // Solenoid open only in the sequencer or manual mode
+    FSM_INV_SEQ_STATE,              // Sequencer counting down or firing only in STATE_SEQUENCER
+    FSM_INV_ABORT_OUTPUTS,          // In abort: igniter off, solenoid closed, spicy disarmed
+    FSM_INV_ABORT_VALVES,           // Every servo disarmed within FSM_MONITOR_ABORT_VALVES_MS
+    FSM_INV_COUNT
+} fsm_invariant_t;
+
+typedef struct {
+    uint32_t checks;
+    uint32_t violations[FSM_INV_COUNT];
+    uint32_t aborts;
+    uint32_t abort_valves_max_ms;   // Slowest abort to valves disarmed
+} fsm_monitor_stats_t;
+
+// Results the invariants depend on, from the FSM and sequencer
+void fsm_monitor_note_prefire(bool ok);     // On every entry to STATE_SEQUENCER
+void fsm_monitor_note_checks(bool ok);      // Pre-ignition checks step
+
+// Check every invariant. Call every ms.
+void fsm_monitor_poll(void);
+
+uint32_t fsm_monitor_violations(void);
+void fsm_monitor_get_stats(fsm_monitor_stats_t *out);
+void fsm_monitor_reset_stats(void);
+void fsm_monitor_print_stats(void);
+
+#endif // FSM_MONITOR_H
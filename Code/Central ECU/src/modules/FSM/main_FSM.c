@@ -1,4 +1,5 @@
 #include "main_FSM.h"
+#include <string.h>
 #include "debug_io.h"
 #include "spicy.h"
 #include "can.h"
@@ -10,6 +11,9 @@
 #include "rs422.h"
 #include "error_def.h"
 #include "sensors.h"
+#include "sensor_history.h"
+#include "fsm_monitor.h"
+#include "seq_timer.h"
 
 //==============================
 // Internal state variables
@@ -18,37 +22,54 @@ static volatile main_states_t current_state = STATE_INIT;
 static switch_state_t switch_snapshot = {0};
 static uint8_t error_code = 0; // Last error code
 
+// Event queue, interrupts post into it too
+static fsm_event_t ev_queue[FSM_EVENT_QUEUE_LEN];
+static volatile uint8_t ev_head = 0;
+static volatile uint8_t ev_tail = 0;
+static volatile bool abort_pending = false;     // fsm_set_abort() from an interrupt, ahead of the queue
+static volatile uint8_t abort_pending_code = 0;
+static volatile uint32_t abort_pending_us = 0;
+static bool dispatching = false;
+static bool last_interlock = false;
+static fsm_event_stats_t ev_stats;
+
+static const char *ev_names[FSM_EV_COUNT] = {
+    [FSM_EV_TICK] = "tick", [FSM_EV_SWITCHES] = "switches", [FSM_EV_INTERLOCK] = "interlock",
+    [FSM_EV_SEQ_STEP] = "seq step", [FSM_EV_SEQ_DONE] = "seq done", [FSM_EV_ERROR] = "error",
+    [FSM_EV_ABORT] = "abort"
+};
+
 typedef void (*st_on_enter_fn)(main_states_t prev_state);
 typedef void (*st_on_exit_fn)(void);
-typedef void (*st_on_tick_fn)(void);
+typedef void (*st_on_event_fn)(const fsm_event_t *ev);
 
 typedef struct {
     st_on_enter_fn on_enter;
     st_on_exit_fn  on_exit;
-    st_on_tick_fn  on_tick;
+    st_on_event_fn on_event;
     const char    *name;
 } state_parameters_t;
 
 // Forward declarations of handlers
-static void s_init_enter(main_states_t prev_state);      static void s_init_exit(void);   static void s_init_tick(void);
-static void s_ready_enter(main_states_t prev_state);     static void s_ready_exit(void);  static void s_ready_tick(void);
-static void s_seq_enter(main_states_t prev_state);       static void s_seq_exit(void);    static void s_seq_tick(void);
-static void s_post_enter(main_states_t prev_state);      static void s_post_exit(void);   static void s_post_tick(void);
-static void s_manual_enter(main_states_t prev_state);    static void s_manual_exit(void); static void s_manual_tick(void);
-static void s_abort_enter(main_states_t prev_state);     static void s_abort_exit(void);  static void s_abort_tick(void);
-static void s_generic_noop(void) {}
+static void s_init_enter(main_states_t prev_state);      static void s_init_exit(void);   static void s_init_event(const fsm_event_t *ev);
+static void s_ready_enter(main_states_t prev_state);     static void s_ready_exit(void);  static void s_ready_event(const fsm_event_t *ev);
+static void s_seq_enter(main_states_t prev_state);       static void s_seq_exit(void);    static void s_seq_event(const fsm_event_t *ev);
+static void s_post_enter(main_states_t prev_state);      static void s_post_exit(void);   static void s_post_event(const fsm_event_t *ev);
+static void s_manual_enter(main_states_t prev_state);    static void s_manual_exit(void); static void s_manual_event(const fsm_event_t *ev);
+static void s_abort_enter(main_states_t prev_state);     static void s_abort_exit(void);  static void s_abort_event(const fsm_event_t *ev);
+static void handle_error(uint8_t raise_code);
 
 // State table
 static const state_parameters_t st_table[] = {
-    [STATE_INIT]        = { s_init_enter,   s_init_exit,    s_init_tick,   "INIT" },
-    [STATE_READY]       = { s_ready_enter,  s_ready_exit,   s_ready_tick,  "READY" },
-    [STATE_SEQUENCER]   = { s_seq_enter,    s_seq_exit,     s_seq_tick,    "SEQUENCER" },
-    [STATE_POST_FIRE]   = { s_post_enter,   s_post_exit,    s_post_tick,   "POST_FIRE" },
-    [STATE_MANUAL_MODE] = { s_manual_enter, s_manual_exit,  s_manual_tick, "MANUAL" },
-    [STATE_ABORT]       = { s_abort_enter,  s_abort_exit,   s_abort_tick,  "ABORT" }
+    [STATE_INIT]        = { s_init_enter,   s_init_exit,    s_init_event,   "INIT" },
+    [STATE_READY]       = { s_ready_enter,  s_ready_exit,   s_ready_event,  "READY" },
+    [STATE_SEQUENCER]   = { s_seq_enter,    s_seq_exit,     s_seq_event,    "SEQUENCER" },
+    [STATE_POST_FIRE]   = { s_post_enter,   s_post_exit,    s_post_event,   "POST_FIRE" },
+    [STATE_MANUAL_MODE] = { s_manual_enter, s_manual_exit,  s_manual_event, "MANUAL" },
+    [STATE_ABORT]       = { s_abort_enter,  s_abort_exit,   s_abort_event,  "ABORT" }
 };
 
-void fsm_set_state(main_states_t new_state)
+static void fsm_set_state(main_states_t new_state)
 {
     // If there is no state change, do nothing
     if (new_state == current_state) {
@@ -74,9 +95,143 @@ void fsm_set_state(main_states_t new_state)
     }
 }
 
+//==============================
+// EVENTS
+//==============================
+
+static bool in_interrupt(void)
+{
+    return __get_IPSR() != 0;
+}
+
+static bool ev_pop(fsm_event_t *ev)
+{
+    bool got = false;
+    __disable_irq();
+    if (abort_pending) {
+        abort_pending = false;
+        ev->type = FSM_EV_ABORT;
+        ev->arg = abort_pending_code;
+        ev->posted_us = abort_pending_us;
+        got = true;
+    } else if (ev_head != ev_tail) {
+        *ev = ev_queue[ev_tail];
+        ev_tail = (ev_tail + 1) & (FSM_EVENT_QUEUE_LEN - 1);
+        got = true;
+    }
+    __enable_irq();
+    return got;
+}
+
+static void ev_handle(const fsm_event_t *ev)
+{
+    main_states_t before = current_state;
+    uint32_t latency = seq_timer_now_us() - ev->posted_us;
+    ev_stats.last_latency_us = latency;
+    if (latency > ev_stats.max_latency_us) ev_stats.max_latency_us = latency;
+
+    switch (ev->type) {
+        case FSM_EV_ABORT:
+            error_code = ev->arg;
+            fsm_set_state(STATE_ABORT);
+            break;
+        case FSM_EV_ERROR:
+            handle_error(ev->arg);
+            break;
+        default:
+            st_table[current_state].on_event(ev);
+            break;
+    }
+    ev_stats.handled++;
+
+    if (current_state != before) {
+        uint32_t transition = seq_timer_now_us() - ev->posted_us;
+        ev_stats.transitions++;
+        ev_stats.last_transition_us = transition;
+        if (transition > ev_stats.max_transition_us) {
+            ev_stats.max_transition_us = transition;
+            ev_stats.max_transition_type = ev->type;
+        }
+    }
+}
+
+// Run to completion: events posted by a handler wait until it returns
+static void ev_run(void)
+{
+    if (dispatching) {
+        return;
+    }
+    dispatching = true;
+    fsm_event_t ev;
+    while (ev_pop(&ev)) {
+        ev_handle(&ev);
+    }
+    dispatching = false;
+}
+
+void fsm_post(fsm_event_type_t type, uint8_t arg)
+{
+    uint32_t now = seq_timer_now_us();
+    __disable_irq();
+    uint8_t next = (ev_head + 1) & (FSM_EVENT_QUEUE_LEN - 1);
+    if (next == ev_tail) {
+        ev_stats.dropped++;
+        __enable_irq();
+        return;
+    }
+    ev_queue[ev_head].type = type;
+    ev_queue[ev_head].arg = arg;
+    ev_queue[ev_head].posted_us = now;
+    ev_head = next;
+    uint8_t depth = (ev_head - ev_tail) & (FSM_EVENT_QUEUE_LEN - 1);
+    if (depth > ev_stats.max_depth) ev_stats.max_depth = depth;
+    ev_stats.posted++;
+    __enable_irq();
+
+    if (!in_interrupt()) {
+        ev_run();
+    }
+}
+
+void fsm_dispatch(void)
+{
+    // The interlock has no interrupt, its edges become events here
+    bool interlock = comp_get_interlock();
+    if (interlock != last_interlock) {
+        last_interlock = interlock;
+        fsm_post(FSM_EV_INTERLOCK, interlock);
+    }
+    ev_run();
+}
+
 void fsm_tick(void)
 {
-    st_table[current_state].on_tick();
+    fsm_post(FSM_EV_TICK, 0);
+}
+
+void fsm_get_event_stats(fsm_event_stats_t *out)
+{
+    __disable_irq();
+    *out = ev_stats;
+    __enable_irq();
+}
+
+void fsm_reset_event_stats(void)
+{
+    __disable_irq();
+    memset(&ev_stats, 0, sizeof(ev_stats));
+    __enable_irq();
+}
+
+void fsm_print_event_stats(void)
+{
+    fsm_event_stats_t s;
+    fsm_get_event_stats(&s);
+    dbg_printf("MAINFSM: %lu events posted, %lu handled, %lu dropped, queue max %u/%u\n",
+               s.posted, s.handled, s.dropped, s.max_depth, FSM_EVENT_QUEUE_LEN - 1);
+    dbg_printf("MAINFSM: post to handler last %lu us max %lu us, %lu transitions, post to state change last %lu us max %lu us (%s)\n",
+               s.last_latency_us, s.max_latency_us, s.transitions, s.last_transition_us, s.max_transition_us,
+               s.transitions ? ev_names[s.max_transition_type] : "-");
 }
 
 //==============================
@@ -123,9 +278,10 @@ bool prefire_ok(void)
         checks_good = false;
         dbg_printf("MAINFSM SEQ: Failed as not all valves closed\n");
     }
-    // Check #5 - >30 bar on mainline
+    // Check #5 - >30 bar on mainline, every sample in the history window
     #ifndef TEST_MODE
-    if (sensors_get_data(SENSOR_PT_MAINLINE) < 300) { // 10*bar, so 300 = 30.0 bar
+    sensor_history_stats_t mainline;
+    if (!sensor_history_get_stats(SENSOR_PT_MAINLINE, &mainline) || mainline.min < 300) { // 10*bar, so 300 = 30.0 bar
         checks_good = false;
         dbg_printf("MAINFSM SEQ: Failed as mainline pressure < 30 bar\n");
     }
@@ -152,6 +308,7 @@ void fsm_set_switch_states(uint16_t switches)
 
     if (ns.changed) {
         switch_snapshot = ns;
+        fsm_post(FSM_EV_SWITCHES, 0);
     }
 }
 
@@ -162,6 +319,14 @@ main_states_t fsm_get_state(void)
 
 void fsm_set_abort(uint8_t code)
 {
+    if (in_interrupt()) {
+        // Handled ahead of anything queued on the next dispatch
+        abort_pending_us = seq_timer_now_us();
+        abort_pending_code = code;
+        abort_pending = true;
+        return;
+    }
+    // Not queued: callers rely on the sequence being stopped when this returns
     error_code = code;
     fsm_set_state(STATE_ABORT);
 }
@@ -171,18 +336,25 @@ uint8_t fsm_get_error_code(void)
     return error_code;
 }
 
+void fsm_raise_error(uint8_t raise_code)
+{
+    fsm_post(FSM_EV_ERROR, raise_code);
+}
+
 // Depending on state and error code, will change the outcome
 // TODO: Add all possible commands from CAN
-void fsm_raise_error(uint8_t raise_code)
+static void handle_error(uint8_t raise_code)
 {
     rs422_send_error_warning(CAN_ERROR_ACTION_ERROR << 6 | BOARD_ID_ECU, raise_code);
     switch (raise_code) {
         case ECU_ERROR_HEARTBEAT_LOST:
             uint8_t hb_status = get_heartbeat_status();
+            // A board back by now was still lost, the silence counts
+            uint8_t hb_lost = heartbeat_take_lost() | (uint8_t)~hb_status;
             dbg_printf("MAINFSM RAISE: Heartbeat lost, status 0x%02X\n", hb_status);
-            bool riu_lost = (hb_status & (1 << BOARD_ID_RIU)) == 0;
-            bool servo_lost = (hb_status & (1 << BOARD_ID_SERVO)) == 0;
-            bool adc_a_lost = (hb_status & (1 << BOARD_ID_ADC_A)) == 0;
+            bool riu_lost = (hb_lost & (1 << BOARD_ID_RIU)) != 0;
+            bool servo_lost = (hb_lost & (1 << BOARD_ID_SERVO)) != 0;
+            bool adc_a_lost = (hb_lost & (1 << BOARD_ID_ADC_A)) != 0;
 
             if (servo_lost) { // Always abort if servo lost
                 error_code = ECU_ERROR_HEARTBEAT_LOST;
@@ -246,8 +418,11 @@ static void s_init_exit(void)
     dbg_printf("STATE EXIT: Init\n");
 }
 
-static void s_init_tick(void)
+static void s_init_event(const fsm_event_t *ev)
 {
+    if (ev->type != FSM_EV_TICK) {
+        return;
+    }
     // VERIFY: Verify this
     if (heartbeat_all_started()) {
         dbg_printf("MAINFSM INIT: All heartbeats good, moving to ready state\n");
@@ -276,8 +451,9 @@ static void s_ready_exit(void)
     dbg_printf("STATE EXIT: Ready\n");
 }
 
-static void s_ready_tick(void)
+static void s_ready_event(const fsm_event_t *ev)
 {
+    (void)ev;
     // Check state of switches
     if (switch_snapshot.sequencer_override) { // Switch to manual mode if override active
         fsm_set_state(STATE_MANUAL_MODE);
@@ -299,6 +475,7 @@ static void s_seq_enter(main_states_t prev_state)
 {
     // Do conditional checks here, can either enter sequencer ready or sequencer failed start
     bool checks_good = prefire_ok();
+    fsm_monitor_note_prefire(checks_good);
 
     if (checks_good) {
         dbg_printf("STATE ENTER: Sequencer (READY)\n");
@@ -312,11 +489,11 @@ static void s_seq_enter(main_states_t prev_state)
 static void s_seq_exit(void) 
 {
     dbg_printf("STATE EXIT: Sequencer\n");
+    sequencer_set_state(SEQUENCER_UNINITIALISED); // Stops the step timer before outputs go safe
     outputs_safe();
-    sequencer_set_state(SEQUENCER_UNINITIALISED);
 }
 
-static void s_seq_tick(void)
+static void s_seq_event(const fsm_event_t *ev)
 {
     // Check that the switches are still correct
     if (!both_armed() || switch_snapshot.sequencer_override || !comp_get_interlock()) { // If not still armed or override active or estop pressed then exit sequencer
@@ -328,7 +505,19 @@ static void s_seq_tick(void)
         }
         return;
     }
-    sequencer_tick();
+    switch (ev->type) {
+        case FSM_EV_TICK:
+            sequencer_tick();
+            break;
+        case FSM_EV_SEQ_STEP:
+            sequencer_report();
+            break;
+        case FSM_EV_SEQ_DONE:
+            fsm_set_state(STATE_POST_FIRE);
+            break;
+        default:
+            break;
+    }
 }
 
 //==============================
@@ -344,8 +533,9 @@ static void s_post_exit(void)
     dbg_printf("STATE EXIT: Post Fire\n");
 }
 
-static void s_post_tick(void)
+static void s_post_event(const fsm_event_t *ev)
 { 
+    (void)ev;
     if(!both_armed() && !comp_get_interlock()) { // Transition when arm switches are changed and estop pressed
         fsm_set_state(STATE_READY);
         dbg_printf("MAINFSM SEQ: Post fire, both arm switches disabled - moving to ready state\n");
@@ -369,8 +559,9 @@ static void s_manual_exit(void)
     dbg_printf("STATE EXIT: Manual\n");
 }
 
-static void s_manual_tick(void)
+static void s_manual_event(const fsm_event_t *ev)
 {
+    (void)ev;
     // Check that the manual override is still active
     if (!switch_snapshot.sequencer_override) {// If not still overriding then return to ready
         fsm_set_state(STATE_READY);
@@ -403,8 +594,9 @@ static void s_abort_exit(void)
     dbg_printf("STATE EXIT: Abort\n");
 }
 
-static void s_abort_tick(void)
+static void s_abort_event(const fsm_event_t *ev)
 {
+    (void)ev;
     if (!switch_snapshot.master_pyro && !switch_snapshot.master_valve && !comp_get_interlock() && !switch_snapshot.sequencer_override && switch_snapshot.changed) { // Transition when both arm switches are off and estop pressed
         dbg_printf("MAINFSM ABORT: Moving to ready state\n");
         fsm_set_state(STATE_READY);
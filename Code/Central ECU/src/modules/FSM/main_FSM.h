@@ -27,10 +27,53 @@ typedef struct {
     bool changed;
 } switch_state_t;
 
+// The FSM runs on events. Producers post them and each one is handled to completion before
+// the next; posted from the main loop they are handled before fsm_post() returns, posted
+// from an interrupt they wait for fsm_dispatch() (every ms). Aborts from the main loop
+// take effect immediately, even from inside a handler.
+#define FSM_EVENT_QUEUE_LEN 16U     // Power of two
+
+typedef enum {
+    FSM_EV_TICK = 0,        // Periodic work, from fsm_tick()
+    FSM_EV_SWITCHES,        // RIU switch word changed
+    FSM_EV_INTERLOCK,       // ESTOP pressed or released, arg 1 if released
+    FSM_EV_SEQ_STEP,        // Sequencer timer ran a step, arg step index
+    FSM_EV_SEQ_DONE,        // Sequence finished
+    FSM_EV_ERROR,           // fsm_raise_error(), arg error code
+    FSM_EV_ABORT,           // fsm_set_abort() from an interrupt, arg error code
+    FSM_EV_COUNT
+} fsm_event_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t arg;
+    uint32_t posted_us;     // seq_timer_now_us() when posted
+} fsm_event_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t handled;
+    uint32_t dropped;               // Queue full
+    uint8_t max_depth;
+    uint32_t last_latency_us;       // Post to handler start
+    uint32_t max_latency_us;
+    uint32_t transitions;
+    uint32_t last_transition_us;    // Post to state change, for events that changed state
+    uint32_t max_transition_us;
+    uint8_t max_transition_type;    // Event type behind max_transition_us
+} fsm_event_stats_t;
+
+void fsm_post(fsm_event_type_t type, uint8_t arg);
+// Handle events posted from interrupts and watch the interlock input. Call every ms.
+void fsm_dispatch(void);
+// Post the periodic tick event
+void fsm_tick(void);
+void fsm_get_event_stats(fsm_event_stats_t *out);
+void fsm_reset_event_stats(void);
+void fsm_print_event_stats(void);
+
 void fsm_set_switch_states(uint16_t switches);
-void fsm_set_state(main_states_t new_state);
 main_states_t fsm_get_state(void);
-void fsm_tick(void);
 bool both_armed(void);
 bool prefire_ok(void);
 void outputs_safe(void);
@@ -3,6 +3,7 @@
 #include "ssd1306.h"
 #include "ssd1306_fonts.h"
 #include "rs422_handler.h"
+#include "calibration.h"
 
 ADC_ChannelConfTypeDef ADC_6S_Config = {
     .Channel = ADC_CHANNEL_0,
@@ -16,22 +17,6 @@ ADC_ChannelConfTypeDef ADC_2S_Config = {
     .SamplingTime = ADC_SAMPLETIME_3CYCLES_5
 };
 
-typedef struct {
-    float voltage; // per-cell voltage in V
-    uint8_t soc;   // corresponding SoC in percent
-} OCVPoint;
-
-// Also worth noting the cells we have are LiHV, so 4.35V max charge. This should be close enough though.
-static const OCVPoint ocv_table[] = {
-    {4.20, 100}, {4.14, 95}, {4.09, 90}, {4.05, 85}, {4.01, 80},
-    {3.98, 75},  {3.95, 70}, {3.92, 65}, {3.89, 60}, {3.87, 55},
-    {3.85, 50},  {3.83, 45}, {3.81, 40}, {3.79, 35}, {3.77, 30},
-    {3.75, 25},  {3.73, 20}, {3.71, 15}, {3.68, 10}, {3.64, 5},
-    {3.40,  0}
-};
-
-#define OCV_TABLE_SIZE (sizeof(ocv_table)/sizeof(ocv_table[0]))
-
 BatteryStatus batt_get_volt(void) {
     BatteryStatus status = {0};
 
@@ -51,22 +36,26 @@ BatteryStatus batt_get_volt(void) {
 uint8_t batt_volt_to_soc(uint16_t voltage_mV, uint8_t cell_count) {
     if (cell_count == 0) return 0; // prevent divide-by-zero
 
-    float per_cell_voltage = voltage_mV / (1000.0f * cell_count);
+    // Open circuit voltage table from the calibration store
+    const calibration_t *cal = calibration_get();
+    const uint16_t *ocv_mv = cal->ocv_mv;
+    const uint8_t *ocv_soc = cal->ocv_soc;
+    float per_cell_mv = (float)voltage_mV / cell_count;
 
     // Clamp above max
-    if (per_cell_voltage >= ocv_table[0].voltage) return 100;
+    if (per_cell_mv >= ocv_mv[0]) return ocv_soc[0];
     // Clamp below min
-    if (per_cell_voltage <= ocv_table[OCV_TABLE_SIZE - 1].voltage) return 0;
+    if (per_cell_mv <= ocv_mv[CALIBRATION_OCV_POINTS - 1]) return ocv_soc[CALIBRATION_OCV_POINTS - 1];
 
     // Find interval and interpolate
-    for (uint8_t i = 0; i < OCV_TABLE_SIZE - 1; i++) {
-        float v1 = ocv_table[i].voltage;
-        float v2 = ocv_table[i + 1].voltage;
-        uint8_t soc1 = ocv_table[i].soc;
-        uint8_t soc2 = ocv_table[i + 1].soc;
-
-        if (per_cell_voltage <= v1 && per_cell_voltage >= v2) {
-            float fraction = (per_cell_voltage - v2) / (v1 - v2);
+    for (uint8_t i = 0; i < CALIBRATION_OCV_POINTS - 1; i++) {
+        float v1 = ocv_mv[i];
+        float v2 = ocv_mv[i + 1];
+        uint8_t soc1 = ocv_soc[i];
+        uint8_t soc2 = ocv_soc[i + 1];
+
+        if (per_cell_mv <= v1 && per_cell_mv >= v2) {
+            float fraction = (per_cell_mv - v2) / (v1 - v2);
             return soc2 + (uint8_t)((soc1 - soc2) * fraction + 0.5f); // round to nearest
         }
     }
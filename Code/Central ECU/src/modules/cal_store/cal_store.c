@@ -0,0 +1,312 @@
+#include "cal_store.h"
+#include <string.h>
+#include "debug_io.h"
+
+#define CAL_STORE_MAGIC 0x314C4143UL    // "CAL1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;               // Over the payload that follows
+} cal_record_t;                 // Two double words, programmed first
+
+typedef struct {
+    const cal_record_t *best;   // Newest usable record
+    uint32_t max_seq;           // Over every record, usable or not
+    uint32_t free;              // Offset of the first erased byte
+} cal_page_scan_t;
+
+static const cal_store_config_t *config;
+static uint8_t staged[CAL_STORE_MAX_SIZE];
+static uint32_t active_seq = 0;
+static uint32_t active_crc = 0;
+static uint32_t last_seq = 0;
+static uint32_t page_in_use = CAL_STORE_PAGE_A;
+static uint32_t page_free = 0;
+
+uint32_t cal_store_crc32(const uint8_t *data, uint16_t length)
+{
+    // CRC-32/MPEG-2, the same checksum the link and the SD log use. Bitwise, since the
+    // ADC and servo boards have no crc module and this only runs on a commit or at boot.
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= (uint32_t)data[i] << 24;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x80000000UL) ? (crc << 1) ^ 0x04C11DB7UL : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t record_len(uint16_t size)
+{
+    return sizeof(cal_record_t) + ((size + 7UL) & ~7UL);
+}
+
+static bool erased(uint32_t addr, uint32_t len)
+{
+    const uint32_t *p = (const uint32_t *)addr;
+    for (uint32_t i = 0; i < len / 4U; i++) {
+        if (p[i] != 0xFFFFFFFFUL) return false;
+    }
+    return true;
+}
+
+static void scan_page(uint32_t page, cal_page_scan_t *scan)
+{
+    scan->best = NULL;
+    scan->max_seq = 0;
+    uint32_t off = 0;
+    while (off + sizeof(cal_record_t) <= CAL_STORE_PAGE_SIZE) {
+        const cal_record_t *r = (const cal_record_t *)(page + off);
+        if (erased(page + off, sizeof(cal_record_t))) break;
+        if (r->magic != CAL_STORE_MAGIC || r->size == 0 || r->size > CAL_STORE_MAX_SIZE) {
+            off = CAL_STORE_PAGE_SIZE; // Torn header, nothing after it can be trusted
+            break;
+        }
+        if (r->seq > scan->max_seq) scan->max_seq = r->seq;
+        // Records of another layout version are skipped, not used
+        if (r->version == config->version && r->size == config->size &&
+            cal_store_crc32((const uint8_t *)(r + 1), r->size) == r->crc &&
+            (scan->best == NULL || r->seq > scan->best->seq)) {
+            scan->best = r;
+        }
+        off += record_len(r->size);
+    }
+    scan->free = off < CAL_STORE_PAGE_SIZE ? off : CAL_STORE_PAGE_SIZE;
+}
+
+static bool erase_page(uint32_t page)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t offset = page - FLASH_BASE;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+#ifdef FLASH_DBANK_SUPPORT
+    erase.Banks = offset < FLASH_BANK_SIZE ? FLASH_BANK_1 : FLASH_BANK_2;
+    offset %= FLASH_BANK_SIZE;
+#else
+    erase.Banks = FLASH_BANK_1;
+#endif
+    erase.Page = offset / FLASH_PAGE_SIZE;
+    erase.NbPages = 1;
+
+    uint32_t page_error = 0;
+    HAL_FLASH_Unlock();
+    FLASH->SR = FLASH_SR_CLEAR; // Stale error flags make the HAL refuse to start
+    bool ok = HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK;
+    HAL_FLASH_Lock();
+    return ok && erased(page, CAL_STORE_PAGE_SIZE);
+}
+
+static bool program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    bool ok = true;
+    HAL_FLASH_Unlock();
+    FLASH->SR = FLASH_SR_CLEAR; // Stale error flags make the HAL refuse to start
+    for (uint32_t i = 0; i < len && ok; i += 8U) {
+        uint64_t dw;
+        memcpy(&dw, data + i, sizeof(dw));
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr + i, dw) == HAL_OK;
+    }
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+void cal_store_init(const cal_store_config_t *cfg)
+{
+    config = cfg;
+    cal_page_scan_t a, b;
+    scan_page(CAL_STORE_PAGE_A, &a);
+    scan_page(CAL_STORE_PAGE_B, &b);
+    last_seq = a.max_seq > b.max_seq ? a.max_seq : b.max_seq;
+
+    const cal_record_t *best = NULL;
+    if (a.best && (!b.best || a.best->seq > b.best->seq)) {
+        best = a.best;
+        page_in_use = CAL_STORE_PAGE_A;
+        page_free = a.free;
+    } else if (b.best) {
+        best = b.best;
+        page_in_use = CAL_STORE_PAGE_B;
+        page_free = b.free;
+    } else {
+        // Nothing usable, the first commit goes in whichever page has more room
+        page_in_use = a.free <= b.free ? CAL_STORE_PAGE_A : CAL_STORE_PAGE_B;
+        page_free = a.free <= b.free ? a.free : b.free;
+    }
+
+    if (best) {
+        memcpy(config->active, best + 1, config->size);
+        active_seq = best->seq;
+        dbg_printf("CAL: calibration seq %lu loaded\r\n", active_seq);
+    } else {
+        memcpy(config->active, config->defaults, config->size);
+        active_seq = 0;
+        dbg_printf("CAL: no stored calibration, using defaults\r\n");
+    }
+    active_crc = cal_store_crc32(config->active, config->size);
+    memcpy(staged, config->active, config->size);
+    if (config->apply) config->apply();
+}
+
+cal_status_t cal_store_read(uint8_t offset, uint8_t length, uint8_t *out)
+{
+    if (length > CAL_STORE_CHUNK || (uint16_t)offset + length > config->size) return CAL_ERR_RANGE;
+    memcpy(out, staged + offset, length);
+    return CAL_OK;
+}
+
+cal_status_t cal_store_write(uint8_t offset, uint8_t length, const uint8_t *data)
+{
+    if (length > CAL_STORE_CHUNK || (uint16_t)offset + length > config->size) return CAL_ERR_RANGE;
+    memcpy(staged + offset, data, length);
+    return CAL_OK;
+}
+
+cal_status_t cal_store_commit(uint32_t expected_crc)
+{
+    uint32_t crc = cal_store_crc32(staged, config->size);
+    if (crc != expected_crc) return CAL_ERR_CRC;
+    if (config->validate && !config->validate(staged)) return CAL_ERR_INVALID;
+
+    static uint8_t image[sizeof(cal_record_t) + CAL_STORE_MAX_SIZE + 8U];
+    uint32_t len = record_len(config->size);
+    cal_record_t hdr = {CAL_STORE_MAGIC, last_seq + 1U, config->version, config->size, crc};
+    memset(image, 0xFF, len);
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(image + sizeof(hdr), staged, config->size);
+
+    // Append to the page in use while it has room, else start over in the other one.
+    // The erase never touches the page holding the active record.
+    uint32_t page = page_in_use;
+    uint32_t off = page_free;
+    if (off + len > CAL_STORE_PAGE_SIZE || !erased(page + off, len)) {
+        page = page == CAL_STORE_PAGE_A ? CAL_STORE_PAGE_B : CAL_STORE_PAGE_A;
+        off = 0;
+        if (!erase_page(page)) {
+            dbg_printf("CAL: erase of %08lX failed\r\n", page);
+            return CAL_ERR_FLASH;
+        }
+    }
+    if (!program(page + off, image, len) || memcmp((const void *)(page + off), image, len) != 0) {
+        dbg_printf("CAL: program at %08lX failed\r\n", page + off);
+        if (page == page_in_use) {
+            page_free = CAL_STORE_PAGE_SIZE; // Whatever is there, the next commit moves page
+        }
+        return CAL_ERR_FLASH;
+    }
+
+    last_seq = hdr.seq;
+    active_seq = hdr.seq;
+    active_crc = crc;
+    page_in_use = page;
+    page_free = off + len;
+    __disable_irq();
+    memcpy(config->active, staged, config->size);
+    __enable_irq();
+    dbg_printf("CAL: committed seq %lu crc %08lX\r\n", active_seq, active_crc);
+    if (config->apply) config->apply();
+    return CAL_OK;
+}
+
+void cal_store_revert(void)
+{
+    memcpy(staged, config->active, config->size);
+}
+
+void cal_store_load_defaults(void)
+{
+    memcpy(staged, config->defaults, config->size);
+}
+
+void cal_store_get_info(cal_info_t *out)
+{
+    out->version = config->version;
+    out->size = config->size;
+    out->seq = active_seq;
+    out->hash = active_crc;
+    out->staged = memcmp(staged, config->active, config->size) != 0;
+    out->free = (uint16_t)(CAL_STORE_PAGE_SIZE - page_free);
+}
+
+uint8_t cal_store_pack_info(const cal_info_t *info, uint8_t *out)
+{
+    out[0] = info->version & 0xFF;
+    out[1] = info->version >> 8;
+    out[2] = info->size & 0xFF;
+    out[3] = info->size >> 8;
+    for (uint8_t i = 0; i < 4; i++) {
+        out[4 + i] = (info->seq >> (8 * i)) & 0xFF;
+        out[8 + i] = (info->hash >> (8 * i)) & 0xFF;
+    }
+    out[12] = info->staged;
+    out[13] = info->free & 0xFF;
+    out[14] = info->free >> 8;
+    return CAL_INFO_PACKED_SIZE;
+}
+
+bool cal_store_unpack_info(const uint8_t *data, uint8_t length, cal_info_t *out)
+{
+    if (length < CAL_INFO_PACKED_SIZE) return false;
+    out->version = data[0] | (data[1] << 8);
+    out->size = data[2] | (data[3] << 8);
+    out->seq = 0;
+    out->hash = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        out->seq |= (uint32_t)data[4 + i] << (8 * i);
+        out->hash |= (uint32_t)data[8 + i] << (8 * i);
+    }
+    out->staged = data[12] != 0;
+    out->free = data[13] | (data[14] << 8);
+    return true;
+}
+
+void cal_store_request(const cal_msg_t *req, cal_msg_t *reply)
+{
+    memset(reply, 0, sizeof(*reply));
+    reply->op = req->op;
+    reply->offset = req->offset;
+
+    cal_status_t status = CAL_OK;
+    bool with_info = true;
+    switch (req->op) {
+        case CAL_OP_INFO:
+            break;
+        case CAL_OP_READ:
+            status = cal_store_read(req->offset, req->length, reply->data);
+            if (status == CAL_OK) reply->length = req->length;
+            with_info = false;
+            break;
+        case CAL_OP_WRITE:
+            status = cal_store_write(req->offset, req->length, req->data);
+            reply->length = 0;
+            with_info = false;
+            break;
+        case CAL_OP_COMMIT:
+            if (req->length < 4) {
+                status = CAL_ERR_MALFORMED;
+                break;
+            }
+            status = cal_store_commit(req->data[0] | (req->data[1] << 8) | ((uint32_t)req->data[2] << 16) |
+                                      ((uint32_t)req->data[3] << 24));
+            break;
+        case CAL_OP_REVERT:
+            cal_store_revert();
+            break;
+        case CAL_OP_DEFAULTS:
+            cal_store_load_defaults();
+            break;
+        default:
+            status = CAL_ERR_MALFORMED;
+            with_info = false;
+            break;
+    }
+    reply->status = status;
+    if (with_info) {
+        cal_info_t info;
+        cal_store_get_info(&info);
+        reply->length = cal_store_pack_info(&info, reply->data);
+    }
+}
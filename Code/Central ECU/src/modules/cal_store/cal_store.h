@@ -0,0 +1,94 @@
+#ifndef CAL_STORE_H
+#define CAL_STORE_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Versioned calibration store in the last two flash pages (reserved in STM32G0B1XX_FLASH.ld).
+// The same file is used on every board, only the calibration struct behind it differs
+// (see calibration.h).
+//
+// Each commit appends a record to the page in use:
+//   [magic][seq][version][size][CRC-32/MPEG-2 of the payload][payload, padded to 8 bytes]
+// When the page is full the other page is erased and written instead, so a page is only
+// erased once per (page size / record size) commits and the previous calibration survives
+// a reset part way through. At start up the valid record with the highest seq wins; with
+// none (blank board, or the struct version changed) the built in defaults are used.
+//
+// Changes are staged in RAM by offset, then committed with the CRC of the whole staged
+// struct, so a lost or repeated chunk is caught before anything is written.
+
+#define CAL_STORE_PAGE_A        0x0803F000UL
+#define CAL_STORE_PAGE_B        0x0803F800UL
+#define CAL_STORE_PAGE_SIZE     0x800UL
+#define CAL_STORE_MAX_SIZE      240U    // Largest calibration struct, offsets are one byte
+#define CAL_STORE_CHUNK         48U     // Data bytes per read or write message
+
+typedef enum {
+    CAL_OP_INFO = 0,        // -> cal_info_t, packed by cal_store_pack_info()
+    CAL_OP_READ = 1,        // offset, length -> staged bytes
+    CAL_OP_WRITE = 2,       // offset, length, bytes into the staged copy
+    CAL_OP_COMMIT = 3,      // expected CRC (4 bytes LE) of the staged copy -> info
+    CAL_OP_REVERT = 4,      // Staged copy back to the active calibration -> info
+    CAL_OP_DEFAULTS = 5     // Staged copy to the built in defaults, needs a commit -> info
+} cal_op_t;
+
+typedef enum {
+    CAL_OK = 0,
+    CAL_ERR_MALFORMED = 1,  // Unknown op or short message
+    CAL_ERR_RANGE = 2,      // Offset and length outside the struct
+    CAL_ERR_CRC = 3,        // Commit CRC does not match the staged copy
+    CAL_ERR_INVALID = 4,    // Staged values rejected by the board
+    CAL_ERR_FLASH = 5,      // Erase, program or read back failed
+    CAL_ERR_STATE = 6       // Not allowed in the current state
+} cal_status_t;
+
+typedef struct {
+    void *active;                       // The struct the board's code reads
+    const void *defaults;
+    uint16_t size;
+    uint16_t version;                   // Bump when the struct layout changes
+    bool (*validate)(const void *cal);  // Check staged values before a commit, may be NULL
+    void (*apply)(void);                // Called after the active calibration changed, may be NULL
+} cal_store_config_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t seq;               // Commits so far, 0 while running on defaults
+    uint32_t hash;              // CRC of the active calibration
+    bool staged;                // Staged copy differs from the active one
+    uint16_t free;              // Bytes left in the page in use
+} cal_info_t;
+
+#define CAL_INFO_PACKED_SIZE    15U
+
+// One request or reply, the same on RS422 and CAN
+typedef struct {
+    uint8_t op;
+    uint8_t status;             // Replies only
+    uint8_t offset;
+    uint8_t length;
+    uint8_t data[CAL_STORE_CHUNK];
+} cal_msg_t;
+
+// Load the newest valid record into cfg->active, or the defaults. Calls cfg->apply.
+void cal_store_init(const cal_store_config_t *cfg);
+
+cal_status_t cal_store_read(uint8_t offset, uint8_t length, uint8_t *out);
+cal_status_t cal_store_write(uint8_t offset, uint8_t length, const uint8_t *data);
+cal_status_t cal_store_commit(uint32_t expected_crc);
+void cal_store_revert(void);
+void cal_store_load_defaults(void);
+void cal_store_get_info(cal_info_t *out);
+
+// Execute a request and fill in the reply (op echoed, status set)
+void cal_store_request(const cal_msg_t *req, cal_msg_t *reply);
+
+uint8_t cal_store_pack_info(const cal_info_t *info, uint8_t *out);
+bool cal_store_unpack_info(const uint8_t *data, uint8_t length, cal_info_t *out);
+
+uint32_t cal_store_crc32(const uint8_t *data, uint16_t length);
+
+#endif // CAL_STORE_H
@@ -0,0 +1,243 @@
+#include "calibration.h"
+#include <math.h>
+#include <string.h>
+#include "debug_io.h"
+#include "can.h"
+#include "heartbeat.h"
+#include "main_FSM.h"
+#include "sd_log.h"
+#include "sensors.h"
+
+#define CAL_BOARDS          (BOARD_ID_ADC_A + 1U)
+#define CAL_INFO_RETRY_MS   1000U
+
+_Static_assert(sizeof(calibration_t) == 108, "calibration_t layout changed, bump CALIBRATION_VERSION");
+_Static_assert(sizeof(calibration_t) <= CAL_STORE_MAX_SIZE, "calibration_t too big for the store");
+
+static const calibration_t defaults = {
+    // NumPy fit of the type K table over the ADS124 thermocouple range
+    .thermo_coeffs = {
+        -8.46349804e-27f,  7.10985650e-22f, -2.14114276e-17f,  2.48424392e-13f,
+        -1.63198889e-10f, -1.40441053e-05f,  1.52510733e+00f, -2.25001136e+00f,
+    },
+    .mipa_full_scale = 500,
+    .mipa_zero_permille = 100,
+    .mipa_span_permille = 900,
+    // PT values map 0->100 bar as -16000->16000
+    .pt_offset = 16000,
+    .pt_divisor = 32,
+    // LiHV cells charge to 4.35 V, this LiPo curve is close enough
+    .ocv_mv = {4200, 4140, 4090, 4050, 4010, 3980, 3950, 3920, 3890, 3870, 3850,
+               3830, 3810, 3790, 3770, 3750, 3730, 3710, 3680, 3640, 3400},
+    .ocv_soc = {100, 95, 90, 85, 80, 75, 70, 65, 60, 55, 50,
+                45, 40, 35, 30, 25, 20, 15, 10, 5, 0},
+};
+
+static calibration_t active;
+
+typedef struct {
+    bool known;
+    bool unlogged;              // Changed since it was last written to the SD log
+    cal_info_t info;
+    uint32_t last_request;
+} cal_board_t;
+
+static cal_board_t boards[CAL_BOARDS];
+static uint32_t logged_session = 0;
+
+static bool validate(const void *cal)
+{
+    const calibration_t *c = cal;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (!isfinite(c->thermo_coeffs[i])) return false;
+    }
+    if (c->mipa_zero_permille >= c->mipa_span_permille || c->mipa_span_permille > 1000) return false;
+    if (c->mipa_full_scale == 0 || c->mipa_full_scale >= 0x8000) return false; // sensor_conv_linear limit
+    if (c->pt_divisor == 0) return false;
+    for (uint8_t i = 0; i + 1U < CALIBRATION_OCV_POINTS; i++) {
+        if (c->ocv_mv[i] <= c->ocv_mv[i + 1] || c->ocv_soc[i] < c->ocv_soc[i + 1]) return false;
+    }
+    return true;
+}
+
+static void note_info(uint8_t board, const cal_info_t *info)
+{
+    cal_board_t *b = &boards[board];
+    if (!b->known || b->info.seq != info->seq || b->info.hash != info->hash) {
+        b->unlogged = true;
+    }
+    b->known = true;
+    b->info = *info;
+}
+
+static void refresh_local(void)
+{
+    cal_info_t info;
+    cal_store_get_info(&info);
+    note_info(BOARD_ID_ECU, &info);
+}
+
+static void apply(void)
+{
+    sensors_init(); // Rebuild the conversion tables
+    refresh_local();
+}
+
+static const cal_store_config_t store_config = {
+    .active = &active,
+    .defaults = &defaults,
+    .size = sizeof(calibration_t),
+    .version = CALIBRATION_VERSION,
+    .validate = validate,
+    .apply = apply,
+};
+
+void calibration_init(void)
+{
+    cal_store_init(&store_config);
+}
+
+const calibration_t *calibration_get(void)
+{
+    return &active;
+}
+
+static bool board_address(uint8_t board, CAN_NodeType *type, CAN_NodeAddr *addr)
+{
+    switch (board) {
+        case BOARD_ID_SERVO:
+            *type = CAN_NODE_TYPE_SERVO;
+            *addr = CAN_NODE_ADDR_SERVO;
+            return true;
+        case BOARD_ID_ADC_A:
+            *type = CAN_NODE_TYPE_ADC;
+            *addr = CAN_NODE_ADDR_ADC_1;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void send_reply(uint8_t board, const cal_msg_t *reply)
+{
+    uint8_t buf[5 + CAL_STORE_CHUNK];
+    uint8_t length = reply->length <= CAL_STORE_CHUNK ? reply->length : CAL_STORE_CHUNK;
+    buf[0] = board;
+    buf[1] = reply->op;
+    buf[2] = reply->status;
+    buf[3] = reply->offset;
+    buf[4] = length;
+    memcpy(&buf[5], reply->data, length);
+    rs422_send_data(buf, 5 + length, RS422_FRAME_CALIBRATION);
+}
+
+static bool commit_allowed(void)
+{
+    main_states_t state = fsm_get_state();
+    return state == STATE_INIT || state == STATE_READY;
+}
+
+rs422_cmd_status_t calibration_handle_rs422(const uint8_t *data, uint16_t size)
+{
+    if (size < 5) return RS422_CMD_NAK_MALFORMED;
+    uint8_t board = data[0];
+    cal_msg_t req = {0};
+    req.op = data[1];
+    req.offset = data[3];
+    req.length = data[4];
+    if (req.length > CAL_STORE_CHUNK) return RS422_CMD_NAK_MALFORMED;
+    if (req.op == CAL_OP_WRITE || req.op == CAL_OP_COMMIT) {
+        if (size < 5U + req.length) return RS422_CMD_NAK_MALFORMED;
+        memcpy(req.data, &data[5], req.length);
+    }
+    if (req.op == CAL_OP_COMMIT && !commit_allowed()) {
+        dbg_printf("CAL: commit for board %u refused in state %d\r\n", board, fsm_get_state());
+        return RS422_CMD_NAK_STATE;
+    }
+
+    if (board == BOARD_ID_ECU) {
+        cal_msg_t reply;
+        cal_store_request(&req, &reply);
+        refresh_local();
+        send_reply(board, &reply);
+        return RS422_CMD_OK;
+    }
+
+    CAN_NodeType type;
+    CAN_NodeAddr addr;
+    if (!board_address(board, &type, &addr)) return RS422_CMD_NAK_MALFORMED;
+    if (!can_send_calibration(type, addr, req.op, 0, req.offset, req.data, req.length)) {
+        return RS422_CMD_NAK_RATE; // CAN queue full, the RIU retries
+    }
+    return RS422_CMD_OK;
+}
+
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length)
+{
+    if (length < 4) return;
+    uint8_t board = frame->what & 0x07;
+    if (board >= CAL_BOARDS) return;
+
+    cal_msg_t reply = {0};
+    reply.op = frame->what >> 3;
+    reply.status = frame->status;
+    reply.offset = frame->offset;
+    reply.length = frame->length;
+    if (reply.length > CAL_STORE_CHUNK || reply.length > length - 4U) return;
+    memcpy(reply.data, frame->data, reply.length);
+    send_reply(board, &reply);
+
+    cal_info_t info;
+    if (reply.op != CAL_OP_READ && reply.op != CAL_OP_WRITE && reply.status == CAL_OK &&
+        cal_store_unpack_info(reply.data, reply.length, &info)) {
+        note_info(board, &info);
+    }
+}
+
+static void log_info(uint8_t board)
+{
+    const cal_info_t *info = &boards[board].info;
+    sd_log_write(SD_LOG_INFO, "CAL: board %u calibration v%u seq %lu hash %08lX%s", board,
+                 info->version, info->seq, info->hash, info->seq ? "" : " (defaults)");
+    boards[board].unlogged = false;
+}
+
+void calibration_poll(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t session = sd_log_get_session_number();
+    bool new_session = session != 0 && session != logged_session;
+    if (new_session) logged_session = session;
+
+    for (uint8_t board = 0; board < CAL_BOARDS; board++) {
+        cal_board_t *b = &boards[board];
+        CAN_NodeType type;
+        CAN_NodeAddr addr;
+        if (!b->known && board_address(board, &type, &addr) && now - b->last_request >= CAL_INFO_RETRY_MS) {
+            heartbeat_state_t hb = heartbeat_get_state(board);
+            if (hb == HEARTBEAT_OK || hb == HEARTBEAT_DEGRADED) {
+                b->last_request = now;
+                can_send_calibration(type, addr, CAL_OP_INFO, 0, 0, NULL, 0);
+            }
+        }
+        if (b->known && logged_session != 0 && (new_session || b->unlogged)) {
+            log_info(board);
+        }
+    }
+}
+
+void calibration_print(void)
+{
+    refresh_local();
+    for (uint8_t board = 0; board < CAL_BOARDS; board++) {
+        const cal_board_t *b = &boards[board];
+        if (!b->known) {
+            if (board != BOARD_ID_RIU) dbg_printf("CAL: board %u not heard from\r\n", board);
+            continue;
+        }
+        dbg_printf("CAL: board %u v%u %u bytes, seq %lu hash %08lX%s%s, %u bytes free in page\r\n",
+                   board, b->info.version, b->info.size, b->info.seq, b->info.hash,
+                   b->info.seq ? "" : " (defaults)", b->info.staged ? ", uncommitted changes" : "",
+                   b->info.free);
+    }
+}
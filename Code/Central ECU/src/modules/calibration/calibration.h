@@ -0,0 +1,58 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "stm32g0xx_hal.h"
+#include "cal_store.h"
+#include "frames.h"
+#include "rs422_cmd.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Calibration of this board, kept in the flash store (cal_store.h), and the RIU side of the
+// calibration protocol for every board.
+//
+// RS422_FRAME_CALIBRATION commands from the RIU:  [board][op][0][offset][length][data]
+// replies back to the RIU (not commands):         [board][op][status][offset][length][data]
+// i.e. a board ID followed by a cal_msg_t. Requests for this board are answered here, the
+// rest are forwarded as CAN_TYPE_CALIBRATION frames and the board's reply is relayed. The
+// command ACK only says the request was taken; the result is in the reply.
+//
+// Commits are refused for every board unless the FSM is in INIT or READY, so nothing is
+// rewritten under a running sequence.
+//
+// The ECU logs each board's calibration seq and hash to the SD card at the start of every
+// log session and whenever they change.
+
+#define CALIBRATION_VERSION     1U
+#define CALIBRATION_OCV_POINTS  21U
+
+// Field offsets are part of the protocol, only ever append and bump CALIBRATION_VERSION
+typedef struct {
+    float thermo_coeffs[8];         // Thermocouple counts to centi-C, highest order first
+    uint16_t mipa_full_scale;       // 10*bar at the top of the span (PTE7100: 50 bar)
+    uint16_t mipa_zero_permille;    // Zero output, permille of the supply reference
+    uint16_t mipa_span_permille;    // Full scale output, permille of the supply reference
+    int16_t pt_offset;              // Added to PT counts before scaling
+    uint16_t pt_divisor;            // PT counts per 0.1 bar
+    uint16_t ocv_mv[CALIBRATION_OCV_POINTS];    // Per cell open circuit voltage, descending
+    uint8_t ocv_soc[CALIBRATION_OCV_POINTS];    // Charge percent at each voltage
+    uint8_t reserved[3];
+} calibration_t;
+
+// Load this board's calibration, before anything that reads it
+void calibration_init(void);
+
+const calibration_t *calibration_get(void);
+
+// RS422_FRAME_CALIBRATION command payload, after the command sequence number
+rs422_cmd_status_t calibration_handle_rs422(const uint8_t *data, uint16_t size);
+
+// CAN_TYPE_CALIBRATION reply from another board
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length);
+
+// Ask boards for their calibration info until they answer, log it per session. 1 s task.
+void calibration_poll(void);
+
+void calibration_print(void);
+
+#endif // CALIBRATION_H
@@ -202,43 +202,56 @@ static bool can_tx_queue_push(const FDCAN_TxHeaderTypeDef *hdr, const uint8_t *d
     return true;
 }
 
-// Service routine to be called roughly every 1ms to flush queued frames to hardware.
-// Attempts to send all queued frames until HW FIFO is full or queue emptied.
-void can_service_tx_queue(void) {
-    // Loop while entries pending
+// Hand the head of the software queue to the FDCAN TX FIFO. Interrupts stay off from the
+// peek to the pop, so the main loop and the sequencer timer interrupt can both call it.
+static HAL_StatusTypeDef can_tx_queue_pop_to_fifo(bool *skipped) {
+    HAL_StatusTypeDef status = HAL_OK;
+    *skipped = false;
+    __disable_irq();
     if (can_tx_count > 0) {
-        // Peek at head
         CAN_TxQueueEntry *entry = &can_tx_queue[can_tx_head];
-        if (!entry->used) {
-            // Should not happen; recover by dropping entry
-            __disable_irq();
-            can_tx_head = (can_tx_head + 1) % CAN_TX_QUEUE_SIZE;
-            can_tx_count--;
-            __enable_irq();
-            dbg_printf("CAN: TX entry not used, skipping.\r\n");
-            return;
+        if (entry->used) {
+            status = HAL_FDCAN_AddMessageToTxFifoQ(&hfdcan1, &entry->header, entry->data);
+        } else {
+            *skipped = true; // Should not happen; recover by dropping entry
         }
-
-        HAL_StatusTypeDef status = HAL_FDCAN_AddMessageToTxFifoQ(&hfdcan1, &entry->header, entry->data);
         if (status == HAL_OK) {
-            // Successfully queued to hardware; remove from SW queue
-            __disable_irq();
+            // Queued to hardware (or dropped); remove from SW queue
             entry->used = 0;
             can_tx_head = (can_tx_head + 1) % CAN_TX_QUEUE_SIZE;
             can_tx_count--;
-            __enable_irq();
-        } else {
+        }
+    }
+    __enable_irq();
+    return status;
+}
+
+// Service routine to be called roughly every 1ms to flush queued frames to hardware.
+// Attempts to send all queued frames until HW FIFO is full or queue emptied.
+void can_service_tx_queue(void) {
+    // Loop while entries pending
+    if (can_tx_count > 0) {
+        bool skipped;
+        HAL_StatusTypeDef status = can_tx_queue_pop_to_fifo(&skipped);
+        if (skipped) {
+            dbg_printf("CAN: TX entry not used, skipping.\r\n");
+        } else if (status != HAL_OK) {
             static uint32_t last_error_notify = 0;
             uint32_t now = HAL_GetTick();
             if (now - last_error_notify > 2000) { // Notify at most once every 2 seconds, prevent flooding bus
                 last_error_notify = now;
                 handle_tx_error(status);
             }
-            return;
         }
     }
 }
 
+void can_kick_tx_queue(void) {
+    bool skipped;
+    while (can_tx_count > 0 && can_tx_queue_pop_to_fifo(&skipped) == HAL_OK) {
+    }
+}
+
 bool can_send_error_warning(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, CAN_ErrorAction action, uint8_t errorCode) {
     CAN_ID id = {
         .priority = CAN_PRIORITY_CRITICAL,
@@ -344,7 +357,7 @@ bool can_send_heartbeat(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr) {
     return can_send(id, (uint8_t*)&frame, sizeof(frame));
 }
 
-bool can_send_data(uint8_t sensorID, uint8_t *data, uint8_t length, uint32_t timestamp) {
+bool can_send_data(uint8_t sensorID, uint8_t *data, uint8_t length, uint32_t timestamp, uint8_t seq) {
     CAN_ID id = {
         .priority = CAN_PRIORITY_DATA,
         .nodeType = CAN_NODE_TYPE_CENTRAL, // Use the provided node type
@@ -352,15 +365,36 @@ bool can_send_data(uint8_t sensorID, uint8_t *data, uint8_t length, uint32_t tim
         .frameType = CAN_TYPE_ADC_DATA // Data is a data message
     };
 
+    if (length > sizeof(((CAN_ADCFrame *)0)->data) - 1) length = sizeof(((CAN_ADCFrame *)0)->data) - 1;
+    length &= ~1U; // Whole samples, the sequence number makes it odd
+
     CAN_ADCFrame frame = {
         .what = sensorID,
-        .length = length, // Set the length of the data
+        .length = length + 1, // Samples and the sequence number
         .timestamp = {
             (uint8_t)((timestamp >> 16) & 0xFF),
             (uint8_t)((timestamp >> 8) & 0xFF),
             (uint8_t)(timestamp & 0xFF)
         }
     };
-    memcpy(frame.data, data, length < sizeof(frame.data) ? length : sizeof(frame.data));
+    memcpy(frame.data, data, length);
+    frame.data[length] = seq;
     return can_send(id, (uint8_t*)&frame, sizeof(frame));
+}
+
+bool can_send_calibration(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, uint8_t op, uint8_t status, uint8_t offset, const uint8_t *data, uint8_t length) {
+    CAN_ID id = {
+        .priority = CAN_PRIORITY_COMMAND,
+        .nodeType = nodeType,
+        .nodeAddr = nodeAddr,
+        .frameType = CAN_TYPE_CALIBRATION
+    };
+    CAN_CalibrationFrame frame = {
+        .what = op<<3 | BOARD_ID,
+        .status = status,
+        .offset = offset,
+        .length = length < sizeof(frame.data) ? length : sizeof(frame.data)
+    };
+    if (frame.length) memcpy(frame.data, data, frame.length);
+    return can_send(id, (uint8_t*)&frame, 4 + frame.length);
 }
\ No newline at end of file
@@ -27,11 +27,16 @@ bool can_send_command(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, CommandType
 bool can_send_status(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, uint8_t status, uint8_t substatus);
 bool can_send_servo_position(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, uint8_t connected, uint8_t set_position[4], uint8_t current_position[4]);
 bool can_send_heartbeat(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr);
-bool can_send_data(uint8_t sensorID, uint8_t *data, uint8_t length, uint32_t timestamp);
+bool can_send_data(uint8_t sensorID, uint8_t *data, uint8_t length, uint32_t timestamp, uint8_t seq);
+bool can_send_calibration(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, uint8_t op, uint8_t status, uint8_t offset, const uint8_t *data, uint8_t length);
 
 // Service routine to flush software TX queue (call ~ every 1ms)
 void can_service_tx_queue(void);
 
+// Move queued frames into the hardware FIFO now instead of waiting for the service task.
+// No logging, safe from the sequencer timer interrupt.
+void can_kick_tx_queue(void);
+
 
 
 
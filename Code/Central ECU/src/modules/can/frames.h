@@ -15,7 +15,7 @@ typedef enum {
     CAN_TYPE_STATUS = 0b010,
     CAN_TYPE_SERVO_POS = 0b011,
     CAN_TYPE_HEARTBEAT = 0b100,
-    // 0b101
+    CAN_TYPE_CALIBRATION = 0b101,
     // 0b110
     CAN_TYPE_ADC_DATA = 0b111
 } CAN_MessageType;
@@ -97,6 +97,9 @@ typedef struct __attribute__((packed)) {
     uint8_t timestamp[3];
 } CAN_HeartbeatFrame;
 
+// Up to 29 int16 LE samples. An odd length means the byte after the samples is the
+// sender's frame sequence number for that sensor (wraps at 256), so the ECU can tell lost
+// frames from a quiet sensor (sensor_seq.h). Anything reading length / 2 samples skips it.
 typedef struct __attribute__((packed)) {
     uint8_t what;
     uint8_t length; // Length of the data
@@ -104,6 +107,15 @@ typedef struct __attribute__((packed)) {
     uint8_t data[59];     // 59 bytes of ADC data
 } CAN_ADCFrame;
 
+// Calibration store request or reply (see cal_store.h for the ops and status codes)
+typedef struct __attribute__((packed)) {
+    uint8_t what;           // Op << 3 | sender board ID
+    uint8_t status;         // Replies only
+    uint8_t offset;
+    uint8_t length;
+    uint8_t data[48];
+} CAN_CalibrationFrame;
+
 // Pack to 11-bit CAN ID
 static inline uint16_t pack_can_id(CAN_ID id) {
     return ((id.frameType  & 0x07) << CAN_ID_FRAME_TYPE_SHIFT) |
@@ -9,6 +9,12 @@
 #include "heartbeat.h"
 #include "error_def.h"
 #include "sensors.h"
+#include "sensor_summary.h"
+#include "sensor_history.h"
+#include "redline.h"
+#include "derived.h"
+#include "sensor_seq.h"
+#include "calibration.h"
 
 static void handle_cmd_set_servo_arm(CAN_CommandFrame* frame, CAN_ID id);
 static void handle_cmd_set_servo_pos(CAN_CommandFrame* frame, CAN_ID id);
@@ -59,6 +65,9 @@ void handle_tx_error(uint32_t error_code) {
 void enqueue_can_frame(CAN_Frame_t* frame) {
     if (can_rx_queue.count >= CAN_RX_QUEUE_LENGTH) {
         dbg_printf("CAN RX Queue is full, dropping frame\n");
+        if (frame->id.frameType == CAN_TYPE_ADC_DATA) {
+            sensor_seq_note_rx_drop((CAN_ADCFrame*)frame->data);
+        }
         return; // Queue is full, drop the frame
     }
     
@@ -94,6 +103,9 @@ void can_handler_poll(void) {
             case CAN_TYPE_STATUS:
                 handle_status((CAN_StatusFrame*)frame->data, frame->id);
                 break;
+            case CAN_TYPE_CALIBRATION:
+                handle_calibration((CAN_CalibrationFrame*)frame->data, frame->id, frame->length);
+                break;
             default:
                 dbg_printf("Unknown CAN frame type: %d\n", frame->id.frameType);
                 break;
@@ -241,30 +253,12 @@ static uint8_t can_dlc_to_bytes(uint8_t dlc_code) {
     }
 }
 
-void handle_adc_data(CAN_ADCFrame* frame, CAN_ID id, uint8_t dataLength) {
-    // Bits 3-7 for sensor ID. Bits 6-7 are sensor type and bits 3-5 for sub ID.
-    // Sensor types:
-    //  00 - Pressure
-    //  01 - Temperature
-    //  10 - Pressure + Temperature
-    //  11 - Load cell
+// History, RIU summaries and the SD log, for ADC frames and derived channels alike
+static bool publish_sensor_frame(CAN_ADCFrame* frame) {
     uint8_t sensorID = frame->what >> 3;
-    // Sample rate, 3 bits. (0-7) = 1, 10, 20, 50, 100, 200, 500, 1000Hz
-    uint8_t sampleRate = frame->what & 0x07;
 
-    
-    if (sensorID <= SENSOR_P_MANIFOLD) { // Pressure sensor
-        uint16_t first_sample = (frame->data[0]) | (frame->data[1] << 8);
-        uint16_t reference = (frame->data[56]) | (frame->data[57] << 8);
-        sensors_add_pressure(sensorID, first_sample, reference);
-    } else if ((sensorID >= SENSOR_THERMO_A) && (sensorID <= SENSOR_THERMO_C)) { // Thermocouples
-        int16_t first_sample = (frame->data[0]) | (frame->data[1] << 8);
-        sensors_add_temperature(sensorID, first_sample);
-    } else if ((sensorID >= SENSOR_PT_MAINLINE) && (sensorID <= SENSOR_PT_BRANCH_B)) { // PT sensors
-        int16_t first_sample = (frame->data[0]) | (frame->data[1] << 8);
-        sensors_add_pt(sensorID, first_sample);
-    }
-    
+    sensor_history_add_frame(frame); // Every sample, sensors_get_data() reads the newest
+    sensor_summary_add(frame); // Every sample goes into the RIU display summaries
 
     // Write chunk to per-sensor file with delimiter header
     bool status = sd_log_write_sensor_chunk(frame, frame->length + 5);
@@ -273,12 +267,37 @@ void handle_adc_data(CAN_ADCFrame* frame, CAN_ID id, uint8_t dataLength) {
         uint8_t action = CAN_ERROR_ACTION_ERROR << 6 | BOARD_ID_ECU;
         rs422_send_error_warning(action, ECU_ERROR_SD_DATA_WRITE_FAIL);
         fsm_raise_error(ECU_ERROR_SD_DATA_WRITE_FAIL);
-        return;
+        return false;
     }
 
+#if SENSOR_SUMMARY_FORWARD_RAW
     // Send to the RIU
     rs422_send_data((uint8_t*)frame, frame->length+5, RS422_FRAME_SENSOR);
+#endif
+    return true;
+}
 
+void handle_adc_data(CAN_ADCFrame* frame, CAN_ID id, uint8_t dataLength) {
+    // frame->what bits 3-7 are the sensor ID. Bits 6-7 are sensor type and bits 3-5 for sub ID.
+    // Sensor types:
+    //  00 - Pressure
+    //  01 - Temperature
+    //  10 - Pressure + Temperature
+    //  11 - Load cell
+    // Bits 0-2 are the sample rate, (0-7) = 1, 10, 20, 50, 100, 200, 500, 1000Hz
+
+    redline_check_frame(frame); // Before anything else, an abort should not wait on the card
+    sensor_seq_check(frame); // Gap record goes to the card ahead of the frame
+
+    bool stored = publish_sensor_frame(frame);
+
+    // Channels computed from this sensor, published the same way. Always evaluated so
+    // their integrals keep up when the card has failed.
+    static CAN_ADCFrame derived_frames[DERIVED_MAX_CHANNELS];
+    uint8_t derived_count = derived_add_frame(frame, derived_frames, DERIVED_MAX_CHANNELS);
+    for (uint8_t i = 0; i < derived_count && stored; i++) {
+        stored = publish_sensor_frame(&derived_frames[i]);
+    }
 }
 
 void handle_status(CAN_StatusFrame* frame, CAN_ID id) {
@@ -296,6 +315,11 @@ void handle_status(CAN_StatusFrame* frame, CAN_ID id) {
     }
 }
 
+void handle_calibration(CAN_CalibrationFrame* frame, CAN_ID id, uint8_t dataLength) {
+    // Calibration store reply from another board, relayed to the RIU
+    calibration_handle_can(frame, can_dlc_to_bytes(dataLength));
+}
+
 void handle_heartbeat(CAN_HeartbeatFrame* frame, CAN_ID id, uint32_t local_timestamp) {
     // Handle heartbeat messages
     // RxTimestamp not used at this stage as far more accurate than SysTick and rolls over often
@@ -3,8 +3,50 @@
 
 #include "stm32g0xx_hal.h"
 #include "peripherals.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// 16-bit checksum used on the RS422 link and in the SD log files: the low 16 bits of
+// CRC-32/MPEG-2 (poly 0x04C11DB7, init 0xFFFFFFFF, MSB first, no final xor), which is what
+// the CRC unit produces in its reset configuration. tools/sd_unpack.c has the host version.
+//
+// The running value lives in the context, not in the peripheral, so several checksums can
+// be in progress at once and a message can be fed in pieces from wherever its bytes are
+// (header on the stack, payload in the caller's buffer, both halves of a ring buffer wrap).
+//   crc16_ctx_t c;
+//   crc16_begin(&c);
+//   crc16_update(&c, ring + tail, RING_SIZE - tail);
+//   crc16_update(&c, ring, head);
+//   uint16_t crc = crc16_final(&c);
+//
+// Two backends give identical results: the CRC unit, and a 1 KiB table for when the unit is
+// not set up or the caller wants to compare. The HW backend is not reentrant: crc16_update()
+// and crc16_compute() are for the main loop only. Code that can also run from an interrupt
+// (rs422_encode_frame(), via the error callbacks) calls crc16_update_sw() directly.
+
+#ifndef CRC16_USE_HW
+#define CRC16_USE_HW    1       // crc16_update() backend, 0 = table (host builds)
+#endif
+
+typedef struct {
+    uint32_t crc;       // Full 32-bit register, truncated only in crc16_final
+} crc16_ctx_t;
 
 void crc16_init(void);
-uint16_t crc16_compute(uint8_t *data, uint32_t length);
 
-#endif // CRC_H
\ No newline at end of file
+void crc16_begin(crc16_ctx_t *ctx);
+void crc16_update(crc16_ctx_t *ctx, const uint8_t *data, uint32_t length);
+uint16_t crc16_final(const crc16_ctx_t *ctx);
+
+// Explicit backends, for the self test and benchmark
+void crc16_update_hw(crc16_ctx_t *ctx, const uint8_t *data, uint32_t length);
+void crc16_update_sw(crc16_ctx_t *ctx, const uint8_t *data, uint32_t length);
+
+// Checksum of one contiguous buffer
+uint16_t crc16_compute(const uint8_t *data, uint32_t length);
+
+// Check both backends against known vectors, fragmented and unaligned, and print
+// cycles/byte for each. Returns false on any mismatch.
+bool crc16_self_test(void);
+
+#endif // CRC_H
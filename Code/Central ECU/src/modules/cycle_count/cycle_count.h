@@ -0,0 +1,28 @@
+#ifndef CYCLE_COUNT_H
+#define CYCLE_COUNT_H
+
+#include "stm32g0xx_hal.h"
+#include <stdint.h>
+
+// Cycle counter for benchmarking. The M0+ has no DWT, but SysTick is free (the HAL tick
+// comes from TIM2) so it is run as a free running 24-bit down counter at HCLK.
+// A single measured interval must stay below 2^24 cycles (~262 ms at 64 MHz).
+
+static inline void cycle_count_init(void)
+{
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+static inline uint32_t cycle_count_now(void)
+{
+    return SysTick->VAL;
+}
+
+static inline uint32_t cycle_count_since(uint32_t start)
+{
+    return (start - SysTick->VAL) & SysTick_LOAD_RELOAD_Msk;
+}
+
+#endif // CYCLE_COUNT_H
@@ -1,13 +1,132 @@
 #include "heartbeat.h"
+#include <string.h>
 #include "debug_io.h"
 #include "main_FSM.h"
 #include "error_def.h"
 
-RemoteHeartbeat_t heartbeat[MAX_COUNT] = {0};
+#define WHEEL_MASK (HEARTBEAT_WHEEL_SLOTS - 1U)
 
-// VERIFY: All of this
+#if (HEARTBEAT_WHEEL_SLOTS & WHEEL_MASK) != 0
+#error "HEARTBEAT_WHEEL_SLOTS must be a power of two"
+#endif
 
-void heartbeat_reload(uint8_t BOARD_ID) 
+// Servo and ADC boards beat every 500 ms. The RIU rate is set on the RIU, so it keeps the
+// old 1.5 s loss timeout until the jitter figures say a tighter one is safe.
+static const heartbeat_config_t config[MAX_COUNT] = {
+    [BOARD_ID_RIU]   = { 500, 750, 1500 },
+    [BOARD_ID_ECU]   = { 0, 0, 0 },
+    [BOARD_ID_SERVO] = { 500, 750, 1200 },
+    [BOARD_ID_ADC_A] = { 500, 750, 1200 },
+};
+
+typedef struct hb_node {
+    struct hb_node *next;       // Wheel slot list
+    struct hb_node *prev;
+    bool queued;
+    uint8_t slot;
+    uint16_t rounds;            // Full turns of the wheel before the deadline is due
+    uint32_t last_beat;
+    uint8_t good_beats;         // In a row, towards HEARTBEAT_RECOVER_BEATS
+    heartbeat_stats_t stats;
+} hb_node_t;
+
+static hb_node_t nodes[MAX_COUNT];
+static hb_node_t *wheel[HEARTBEAT_WHEEL_SLOTS];
+static volatile uint8_t wheel_pos = 0;
+static volatile uint8_t lost_latch = 0;     // Bit per board gone LOST, see heartbeat_take_lost()
+
+static const uint16_t jitter_edges[HEARTBEAT_JITTER_BINS - 1] = {5, 10, 20, 50, 100, 200, 500};
+static const char *state_names[] = {"off", "ok", "degraded", "lost"};
+
+// Interrupts off for the wheel functions, TIM14 walks the same lists
+
+static void wheel_remove(hb_node_t *n)
+{
+    if (!n->queued) return;
+    if (n->prev) {
+        n->prev->next = n->next;
+    } else {
+        wheel[n->slot] = n->next;
+    }
+    if (n->next) n->next->prev = n->prev;
+    n->next = n->prev = NULL;
+    n->queued = false;
+}
+
+static void wheel_insert(hb_node_t *n, uint32_t now, uint32_t deadline)
+{
+    int32_t delay = (int32_t)(deadline - now);
+    uint32_t ticks = delay > 0 ? ((uint32_t)delay + HEARTBEAT_WHEEL_TICK_MS - 1U) / HEARTBEAT_WHEEL_TICK_MS : 1U;
+    if (ticks == 0) ticks = 1;
+    n->slot = (wheel_pos + ticks) & WHEEL_MASK;
+    n->rounds = (uint16_t)((ticks - 1U) / HEARTBEAT_WHEEL_SLOTS);
+    n->prev = NULL;
+    n->next = wheel[n->slot];
+    if (n->next) n->next->prev = n;
+    wheel[n->slot] = n;
+    n->queued = true;
+}
+
+static void set_state(hb_node_t *n, heartbeat_state_t state)
+{
+    n->stats.state = state;
+    if (state == HEARTBEAT_DEGRADED) n->stats.degraded++;
+    if (state == HEARTBEAT_LOST) n->stats.lost++;
+}
+
+// TIM14 interrupt: a board's deadline passed without a beat
+static void expire(uint8_t id, uint32_t now)
+{
+    hb_node_t *n = &nodes[id];
+    n->good_beats = 0;
+    if (now - n->last_beat >= config[id].lost_ms) {
+        set_state(n, HEARTBEAT_LOST);
+        lost_latch |= (uint8_t)(1U << id);
+        dbg_printf("HRT_BT: Heartbeat for board %d is inactive\n", id);
+
+        #ifndef TEST_MODE
+        fsm_raise_error(ECU_ERROR_HEARTBEAT_LOST);
+        #endif
+        return;
+    }
+    if (n->stats.state == HEARTBEAT_OK) {
+        set_state(n, HEARTBEAT_DEGRADED);
+    }
+    wheel_insert(n, now, n->last_beat + config[id].lost_ms);
+}
+
+static void record_gap(uint8_t id, uint32_t gap)
+{
+    heartbeat_stats_t *s = &nodes[id].stats;
+    uint16_t period = config[id].period_ms;
+    if (gap < s->gap_min_ms) s->gap_min_ms = gap;
+    if (gap > s->gap_max_ms) s->gap_max_ms = gap;
+
+    uint32_t dev = gap > period ? gap - period : period - gap;
+    uint8_t bin = 0;
+    while (bin < HEARTBEAT_JITTER_BINS - 1U && dev >= jitter_edges[bin]) bin++;
+    s->jitter[bin]++;
+
+    uint32_t expected = (gap + period / 2U) / period;
+    if (expected > 1U) s->missed += expected - 1U;
+}
+
+void heartbeat_init(void)
+{
+    memset(nodes, 0, sizeof(nodes));
+    memset(wheel, 0, sizeof(wheel));
+    for (uint8_t i = 0; i < MAX_COUNT; i++) {
+        nodes[i].stats.gap_min_ms = UINT32_MAX;
+    }
+    // TIM14 counts at 1 kHz (CubeMX prescaler), one update per wheel slot
+    __HAL_TIM_SET_AUTORELOAD(&htim14, HEARTBEAT_WHEEL_TICK_MS - 1U);
+    __HAL_TIM_SET_COUNTER(&htim14, 0);
+    if (HAL_TIM_Base_Start_IT(&htim14) != HAL_OK) {
+        dbg_printf("HRT_BT: Failed to start heartbeat timer\n");
+    }
+}
+
+void heartbeat_reload(uint8_t BOARD_ID)
 {
     // Check if BOARD_ID is valid
     if (BOARD_ID >= MAX_COUNT) {
@@ -15,50 +134,138 @@ void heartbeat_reload(uint8_t BOARD_ID)
         return;
     }
 
-    // Clear the heartbeat for the specified board
-    heartbeat[BOARD_ID].is_active = true;
-    heartbeat[BOARD_ID].cleared = true;
+    hb_node_t *n = &nodes[BOARD_ID];
+    const heartbeat_config_t *cfg = &config[BOARD_ID];
+    uint32_t now = HAL_GetTick();
+    bool recovered = false;
 
-    // Ensure TIM14 is started in interrupt mode
-    // After HAL_TIM_Base_Init, the state is READY. Start it if so.
-    if (HAL_TIM_Base_GetState(&htim14) == HAL_TIM_STATE_READY) {
-        if (HAL_TIM_Base_Start_IT(&htim14) != HAL_OK) {
-            dbg_printf("HRT_BT: Failed to start heartbeat timer for board %d\n", BOARD_ID);
-            return;
-        }
+    __disable_irq();
+    uint32_t gap = now - n->last_beat;
+    heartbeat_state_t state = n->stats.state;
+    n->stats.beats++;
+    n->last_beat = now;
+    if (cfg->period_ms == 0) { // Not supervised
+        n->stats.state = HEARTBEAT_OK;
+        __enable_irq();
+        return;
+    }
+    if (state != HEARTBEAT_OFF) {
+        record_gap(BOARD_ID, gap);
+    }
+
+    switch (state) {
+        case HEARTBEAT_OFF:
+            set_state(n, HEARTBEAT_OK);
+            break;
+        case HEARTBEAT_LOST:
+            set_state(n, HEARTBEAT_DEGRADED);
+            n->good_beats = 1;
+            break;
+        case HEARTBEAT_DEGRADED:
+            n->good_beats = gap <= cfg->degraded_ms ? n->good_beats + 1 : 0;
+            if (n->good_beats >= HEARTBEAT_RECOVER_BEATS) {
+                set_state(n, HEARTBEAT_OK);
+                n->stats.recovered++;
+                recovered = true;
+            }
+            break;
+        default:
+            break;
+    }
+    wheel_remove(n);
+    wheel_insert(n, now, now + cfg->degraded_ms);
+    __enable_irq();
+
+    if (state == HEARTBEAT_LOST) {
+        dbg_printf("HRT_BT: Heartbeat for board %d is back, degraded until %u good beats\n", BOARD_ID, HEARTBEAT_RECOVER_BEATS);
+    } else if (recovered) {
+        dbg_printf("HRT_BT: Heartbeat for board %d recovered\n", BOARD_ID);
     }
 }
 
+static bool is_active(uint8_t id)
+{
+    heartbeat_state_t state = nodes[id].stats.state;
+    return state == HEARTBEAT_OK || state == HEARTBEAT_DEGRADED;
+}
+
 bool heartbeat_all_started(void) {
-    return (heartbeat[BOARD_ID_RIU].is_active && heartbeat[BOARD_ID_SERVO].is_active && heartbeat[BOARD_ID_ADC_A].is_active);
+    return (is_active(BOARD_ID_RIU) && is_active(BOARD_ID_SERVO) && is_active(BOARD_ID_ADC_A));
 }
 
 uint8_t get_heartbeat_status(void) {
     uint8_t status = 0;
     for (uint8_t i = 0; i < MAX_COUNT; i++) {
-        if (heartbeat[i].is_active) {
+        if (is_active(i)) {
             status |= (1 << i);
         }
     }
     return status;
 }
 
+uint8_t heartbeat_take_lost(void)
+{
+    __disable_irq();
+    uint8_t lost = lost_latch;
+    lost_latch = 0;
+    __enable_irq();
+    return lost;
+}
+
+heartbeat_state_t heartbeat_get_state(uint8_t board_id)
+{
+    return board_id < MAX_COUNT ? nodes[board_id].stats.state : HEARTBEAT_OFF;
+}
+
+bool heartbeat_get_stats(uint8_t board_id, heartbeat_stats_t *out)
+{
+    if (board_id >= MAX_COUNT) return false;
+    __disable_irq();
+    *out = nodes[board_id].stats;
+    __enable_irq();
+    return true;
+}
+
+void heartbeat_reset_stats(void)
+{
+    __disable_irq();
+    for (uint8_t i = 0; i < MAX_COUNT; i++) {
+        heartbeat_state_t state = nodes[i].stats.state;
+        memset(&nodes[i].stats, 0, sizeof(nodes[i].stats));
+        nodes[i].stats.state = state;
+        nodes[i].stats.gap_min_ms = UINT32_MAX;
+    }
+    __enable_irq();
+}
+
+void heartbeat_print_stats(void)
+{
+    for (uint8_t i = 0; i < MAX_COUNT; i++) {
+        heartbeat_stats_t s;
+        heartbeat_get_stats(i, &s);
+        if (config[i].period_ms == 0 && s.beats == 0) continue;
+        dbg_printf("HRT_BT: board %u %s, %lu beats, gap %lu-%lu ms (period %u), %lu missed, %lu degraded, %lu lost, %lu recovered\n",
+                   i, state_names[s.state], s.beats, s.gap_min_ms == UINT32_MAX ? 0 : s.gap_min_ms, s.gap_max_ms,
+                   config[i].period_ms, s.missed, s.degraded, s.lost, s.recovered);
+        dbg_printf("  jitter <5 %lu, <10 %lu, <20 %lu, <50 %lu, <100 %lu, <200 %lu, <500 %lu, more %lu\n",
+                   s.jitter[0], s.jitter[1], s.jitter[2], s.jitter[3], s.jitter[4], s.jitter[5], s.jitter[6], s.jitter[7]);
+    }
+}
+
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
     if (htim->Instance == TIM14) {
-        for (uint8_t i = 0; i < MAX_COUNT; i++) {
-            if (heartbeat[i].is_active) {
-                if (heartbeat[i].cleared) {
-                    heartbeat[i].cleared = false;  // Reset clear flag
-                } else {
-                    // If not cleared, mark as inactive
-                    heartbeat[i].is_active = false;
-                    dbg_printf("HRT_BT: Heartbeat for board %d is inactive\n", i);
-
-                    #ifndef TEST_MODE
-                    fsm_raise_error(ECU_ERROR_HEARTBEAT_LOST);
-                    #endif
-                }
+        uint32_t now = HAL_GetTick();
+        wheel_pos = (wheel_pos + 1U) & WHEEL_MASK;
+        hb_node_t *n = wheel[wheel_pos];
+        while (n) {
+            hb_node_t *next = n->next; // expire() may requeue n
+            if (n->rounds > 0) {
+                n->rounds--;
+            } else {
+                wheel_remove(n);
+                expire((uint8_t)(n - nodes), now);
             }
+            n = next;
         }
     }
-}
\ No newline at end of file
+}
@@ -8,15 +8,56 @@
 
 #define MAX_COUNT 5
 
+// Heartbeat supervision per board. Every board has its own deadlines on one timer wheel
+// driven by TIM14, so more boards need no more timers. A board goes DEGRADED when a beat
+// is late and LOST (raising ECU_ERROR_HEARTBEAT_LOST) when it stays silent past its lost
+// timeout. Getting back to OK takes HEARTBEAT_RECOVER_BEATS beats in a row, each within
+// the degraded timeout, so a flapping board does not bounce in and out.
+//
+// Arrival times are taken when the frame is handled (CAN every 20 ms, RS422 every 10 ms),
+// so the jitter figures include that polling.
+
+#define HEARTBEAT_WHEEL_TICK_MS 10U
+#define HEARTBEAT_WHEEL_SLOTS   32U     // Power of two, deadlines further out wrap in rounds
+#define HEARTBEAT_RECOVER_BEATS 3U
+#define HEARTBEAT_JITTER_BINS   8U      // |gap - period| under 5, 10, 20, 50, 100, 200, 500 ms and over
+
+typedef enum {
+    HEARTBEAT_OFF = 0,      // Never heard from
+    HEARTBEAT_OK,
+    HEARTBEAT_DEGRADED,     // Late beat, or recovering
+    HEARTBEAT_LOST
+} heartbeat_state_t;
+
+typedef struct {
+    uint16_t period_ms;     // Expected interval, 0 if the board is not supervised
+    uint16_t degraded_ms;   // Silence before DEGRADED
+    uint16_t lost_ms;       // Silence before LOST
+} heartbeat_config_t;
 
 typedef struct {
-    bool is_active; // Is the heartbeat active
-    bool cleared;  // Clear the heartbeat
-} RemoteHeartbeat_t;
+    heartbeat_state_t state;
+    uint32_t beats;
+    uint32_t missed;        // Expected beats that never came
+    uint32_t degraded;      // Entries to DEGRADED
+    uint32_t lost;          // Entries to LOST
+    uint32_t recovered;     // Back to OK
+    uint32_t gap_min_ms;
+    uint32_t gap_max_ms;
+    uint32_t jitter[HEARTBEAT_JITTER_BINS];
+} heartbeat_stats_t;
 
 // Note: BOARD_ID is as in config.h and CAN messages. The RIU is id 0x00
+void heartbeat_init(void);
 void heartbeat_reload(uint8_t BOARD_ID);
 bool heartbeat_all_started(void);
-uint8_t get_heartbeat_status(void);
+uint8_t get_heartbeat_status(void);     // Bit per board, set while OK or DEGRADED
+// Bit per board that went LOST since the last call, even if it is back already. The loss
+// error is handled after the interrupt that raised it, by then a board can have beaten again.
+uint8_t heartbeat_take_lost(void);
+heartbeat_state_t heartbeat_get_state(uint8_t board_id);
+bool heartbeat_get_stats(uint8_t board_id, heartbeat_stats_t *out);
+void heartbeat_reset_stats(void);
+void heartbeat_print_stats(void);
 
-#endif // HEARTBEAT_H
\ No newline at end of file
+#endif // HEARTBEAT_H
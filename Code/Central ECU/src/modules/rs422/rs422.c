@@ -9,14 +9,48 @@
 #include "error_def.h"
 #include "heartbeat.h"
 #include "can.h"
+#include "rs422_cmd.h"
 
 // Global buffers for DMA operations
-RS422_TxBuffer_t tx_buffer = {0}; // Initialize circular buffer for transmission
+static RS422_TxBuffer_t tx_buffer = {0}; // Per lane circular buffers for transmission
 static volatile RS422_RxBuffer_t rx_buffer = {0}; // Initialize circular buffer for reception
 
 // UART handle pointer for callbacks
 static UART_HandleTypeDef *rs422_uart_handle = NULL;
 
+// Receive parser state. The decoder runs one byte at a time across calls, so a frame may
+// be split over any number of DMA events.
+static RS422_RxStats_t rx_stats = {0};
+static uint8_t rx_frame[RS422_RAW_FRAME_SIZE];  // Decoded bytes of the frame in progress
+static uint16_t rx_len = 0;
+static uint16_t rx_encoded = 0;                 // Encoded bytes consumed for this frame
+static uint8_t rx_code = 0;                     // Current COBS code byte
+static uint8_t rx_code_left = 0;                // Data bytes left in the current COBS block
+static bool rx_hunting = false;                 // Dropping bytes until the next delimiter
+static bool rx_seq_valid = false;
+static uint8_t rx_seq_expected = 0;
+static uint8_t tx_seq = 0;
+
+static volatile uint32_t rx_head_total = 0;    // Bytes written by the DMA since (re)start
+static uint32_t rx_tail_total = 0;              // Bytes consumed by the parser
+static uint16_t rx_last_head = 0;               // DMA position at the last head update
+
+static void rs422_rx_hunt(void);
+static void rs422_restart_rx(UART_HandleTypeDef *huart);
+
+#ifdef RS422_STRESS
+static bool rx_injecting = false;
+#endif
+
+static void rx_reset_positions(void)
+{
+    rx_head_total = 0;
+    rx_tail_total = 0;
+    rx_last_head = 0;
+    rx_buffer.read_pos = 0;
+    rx_buffer.write_pos = 0;
+}
+
 static inline uint8_t dlc_to_len(uint8_t dlc)
 {
     // DLC→length LUT for CAN FD (ISO 11898-1). Same as used here for RS422
@@ -40,11 +74,11 @@ static inline uint8_t len_to_dlc(uint8_t len)
 
 void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t transferred)
 {
-    if (HAL_UARTEx_GetRxEventType(huart) == HAL_UART_RXEVENT_IDLE) {
-        rs422_process_rx_dma(transferred);
-    }
-    else if (huart->Instance->ISR & USART_ISR_IDLE) { // Check if IDLE and happen to be TC or HT
-        rs422_process_rx_dma(transferred);
+    // Half complete, complete and idle events all just move the DMA head forward. The
+    // position comes from NDTR rather than transferred, which HAL reports per event type.
+    (void)transferred;
+    if (huart->Instance == USART1) {
+        rs422_process_rx_dma();
     }
 }
 
@@ -52,7 +86,10 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
     if (huart->Instance == USART1) {
         // Update buffer state after DMA transfer completes
-        tx_buffer.head = (tx_buffer.head + 1) % RS422_TX_BUFFER_SIZE;
+        RS422_TxLane_t *lane = &tx_buffer.lane[tx_buffer.active];
+        lane->stats.frames++;
+        lane->stats.bytes += lane->buffer[lane->head].size;
+        lane->head = (lane->head + 1) % RS422_TX_BUFFER_SIZE;
         tx_buffer.is_busy = false;
         
         // Process next packet if available
@@ -72,8 +109,11 @@ static void rs422_restart_rx(UART_HandleTypeDef *huart)
                                  UART_CLEAR_PEF  | UART_CLEAR_FEF);
 
     // Reset software buffer indices to avoid misaligned parsing
-    rx_buffer.read_pos = 0;
-    rx_buffer.write_pos = 0;
+    rx_reset_positions();
+
+    // Whatever was in flight is gone, pick up again at the next delimiter
+    rs422_rx_hunt();
+    rx_seq_valid = false;
 
     // Re-arm Rx-to-IDLE reception (use same mode as rs422_init)
     HAL_StatusTypeDef st = HAL_UARTEx_ReceiveToIdle_DMA(
@@ -82,12 +122,6 @@ static void rs422_restart_rx(UART_HandleTypeDef *huart)
         RS422_RX_BUFFER_SIZE
     );
 
-    // We rely on IDLE events, not DMA HT/TC
-    if (huart->hdmarx) {
-        __HAL_DMA_DISABLE_IT(huart->hdmarx, DMA_IT_HT);
-        __HAL_DMA_DISABLE_IT(huart->hdmarx, DMA_IT_TC);
-    }
-
     if (st != HAL_OK) {
         dbg_printf("RS422: RX restart failed (status %d)\r\n", st);
         fsm_raise_error(ECU_ERROR_RS422_RX_RESTART_FAIL);
@@ -103,6 +137,7 @@ void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
     // VERIFY: Stress test this some more. Might be able to recover without full reset?
     if (huart->Instance == USART1) {
         dbg_printf("RS422 UART Error: 0x%08lX\r\n", huart->ErrorCode);
+        rx_stats.uart_errors++;
 
         // Fully reset and re-arm the RX path in the same mode as init
         tx_buffer.is_busy = false; // Clear TX busy flag to allow new sends
@@ -115,22 +150,25 @@ bool rs422_init(UART_HandleTypeDef *huart)
     // Store UART handle for callbacks
     rs422_uart_handle = huart;
     
-    // Initialize TX circular buffer
-    tx_buffer.head = 0;
-    tx_buffer.tail = 0;
-    tx_buffer.is_busy = false;
+    // Initialize TX lanes, all buckets start full
+    memset(&tx_buffer, 0, sizeof(tx_buffer));
+    rs422_set_lane_budget(RS422_LANE_SAFETY, RS422_LANE_SAFETY_SHARE, RS422_LANE_SAFETY_BURST);
+    rs422_set_lane_budget(RS422_LANE_CONTROL, RS422_LANE_CONTROL_SHARE, RS422_LANE_CONTROL_BURST);
+    rs422_set_lane_budget(RS422_LANE_BULK, RS422_LANE_BULK_SHARE, RS422_LANE_BULK_BURST);
+    rs422_set_lane_budget(RS422_LANE_REPLAY, RS422_LANE_REPLAY_SHARE, RS422_LANE_REPLAY_BURST);
+    tx_buffer.last_refill = HAL_GetTick();
+    tx_buffer.stats_start = tx_buffer.last_refill;
     
     // Initialize RX circular buffer
-    rx_buffer.write_pos = 0;
-    rx_buffer.read_pos = 0;
+    rx_reset_positions();
 
     // Clear all RS422 errors before starting
     __HAL_UART_CLEAR_FLAG(huart, UART_CLEAR_OREF | UART_CLEAR_NEF | 
                          UART_CLEAR_PEF | UART_CLEAR_FEF);
 
-    // Start continuous DMA reception
-    __HAL_DMA_DISABLE_IT(huart->hdmarx, DMA_IT_HT);
-    __HAL_DMA_DISABLE_IT(huart->hdmarx, DMA_IT_TC);
+    // Start continuous DMA reception. The DMA channel is circular, HAL leaves the half and
+    // full transfer interrupts enabled so the head never moves more than half a buffer
+    // between events.
     HAL_StatusTypeDef status = HAL_UARTEx_ReceiveToIdle_DMA(huart, (uint8_t*)rx_buffer.buffer, RS422_RX_BUFFER_SIZE);
 
     // Debug output
@@ -143,138 +181,520 @@ bool rs422_init(UART_HandleTypeDef *huart)
     return (status == HAL_OK);
 }
 
-HAL_StatusTypeDef rs422_send(uint8_t *data, uint8_t size, RS422_FrameType_t frame_type)
+// COBS encoder writing straight into a TX slot, one pass over the frame bytes
+typedef struct {
+    uint8_t *out;
+    uint16_t len;
+    uint16_t code_pos;
+    uint8_t code;
+} cobs_writer_t;
+
+static void cobs_begin(cobs_writer_t *w, uint8_t *out)
 {
-    if (size > RS422_TX_MESSAGE_SIZE - 3) {
-        dbg_printf("RS422 TX: data size %d too large\r\n", size);
-        return HAL_ERROR; // Data too large for packet
+    w->out = out;
+    w->code_pos = 0;
+    w->len = 1;
+    w->code = 1;
+}
+
+static void cobs_put(cobs_writer_t *w, uint8_t byte)
+{
+    if (byte != RS422_COBS_DELIM) {
+        w->out[w->len++] = byte;
+        w->code++;
     }
-    
-    // Check if there's space in the buffer
-    if (rs422_get_tx_buffer_space() == 0) {
-        dbg_printf("RS422 TX: buffer full, cannot send frame\r\n");
-        return HAL_BUSY; // Buffer full
+    if (byte == RS422_COBS_DELIM || w->code == 0xFF) {
+        w->out[w->code_pos] = w->code;
+        w->code_pos = w->len++;
+        w->code = 1;
+    }
+}
+
+static uint16_t cobs_end(cobs_writer_t *w)
+{
+    w->out[w->code_pos] = w->code;
+    w->out[w->len++] = RS422_COBS_DELIM;
+    return w->len;
+}
+
+static RS422_Lane_t rs422_lane_for(RS422_FrameType_t frame_type)
+{
+    switch (frame_type) {
+        case RS422_FRAME_ABORT:
+        case RS422_FRAME_ERROR_WARNING:
+        case RS422_FRAME_FIRE:
+        case RS422_FRAME_CMD_ACK:
+            return RS422_LANE_SAFETY;
+        case RS422_FRAME_SENSOR:
+        case RS422_FRAME_SENSOR_SUMMARY:
+            return RS422_LANE_BULK;
+        case RS422_FRAME_REPLAY:
+            return RS422_LANE_REPLAY;
+        default:
+            return RS422_LANE_CONTROL;
     }
+}
+
+uint16_t rs422_encode_frame(uint8_t seq, RS422_FrameType_t frame_type, const uint8_t *data, uint8_t size, uint8_t *out)
+{
+    static const uint8_t zero_pad[RS422_MAX_PAYLOAD] = {0};
 
     uint8_t dlc = len_to_dlc(size); // Convert length to DLC format
-    size = dlc_to_len(dlc); // Get actual size based on DLC
+    uint8_t padded = dlc_to_len(dlc); // Payload is zero padded up to the DLC length
 
     // Compute Header
     uint8_t header = frame_type << 4; // Shift frame type to the upper nibble
     header |= dlc & 0x0F; // Set the lower nibble to the DLC
-    
-    // Copy data to the next packet in the buffer
-    memcpy(&tx_buffer.buffer[tx_buffer.tail].data[0], &header, 1); // Set header byte
-    memcpy(&tx_buffer.buffer[tx_buffer.tail].data[1], data, size); // Copy data bytes
 
-    // Compute CRC-16 using the HAL of header and data
-    uint16_t crc = crc16_compute(tx_buffer.buffer[tx_buffer.tail].data, size + 1); // Include header in CRC calculation
+    // CRC-16 over seq, header and padded payload. Table backend, rs422_send() is also reached
+    // from the UART and CAN error callbacks and would corrupt a main loop CRC unit user.
+    uint8_t prefix[2] = {seq, header};
+    crc16_ctx_t ctx;
+    crc16_begin(&ctx);
+    crc16_update_sw(&ctx, prefix, sizeof(prefix));
+    crc16_update_sw(&ctx, data, size);
+    crc16_update_sw(&ctx, zero_pad, padded - size);
+    uint16_t crc = crc16_final(&ctx);
+
+    cobs_writer_t w;
+    cobs_begin(&w, out);
+    cobs_put(&w, seq);
+    cobs_put(&w, header);
+    for (uint8_t i = 0; i < padded; i++) {
+        cobs_put(&w, (i < size) ? data[i] : 0);
+    }
+    cobs_put(&w, (uint8_t)crc);
+    cobs_put(&w, (uint8_t)(crc >> 8));
+    return cobs_end(&w);
+}
+
+HAL_StatusTypeDef rs422_send(uint8_t *data, uint8_t size, RS422_FrameType_t frame_type)
+{
+    if (size > RS422_MAX_PAYLOAD) {
+        dbg_printf("RS422 TX: data size %d too large\r\n", size);
+        return HAL_ERROR; // Data too large for packet
+    }
 
-    // Append CRC to the packet
-    memcpy(&tx_buffer.buffer[tx_buffer.tail].data[size + 1], &crc, 2); // Copy CRC after data
+    RS422_Lane_t lane_id = rs422_lane_for(frame_type);
+    RS422_TxLane_t *lane = &tx_buffer.lane[lane_id];
 
-    tx_buffer.buffer[tx_buffer.tail].size = size + 3; // Store total size (header + data + CRC)
-    tx_buffer.tail = (tx_buffer.tail + 1) % RS422_TX_BUFFER_SIZE;
-    
-    // Start DMA transfer if not already in progress
-    if (!tx_buffer.is_busy) {
-        return rs422_process_tx_queue();
+    // Frames are queued from the main loop and from UART/CAN error paths in interrupts
+    __disable_irq();
+
+    // Check if there's space in the lane
+    uint16_t space = rs422_get_tx_buffer_space(lane_id);
+    if (space == 0) {
+        lane->stats.dropped++;
+        __enable_irq();
+        if (lane_id < RS422_LANE_BULK) { // Telemetry drops show up in the link budget instead
+            dbg_printf("RS422 TX: lane %d full, cannot send frame\r\n", lane_id);
+        }
+        return HAL_BUSY; // Buffer full
     }
 
+    // Encoded size including delimiter
+    lane->buffer[lane->tail].size = rs422_encode_frame(tx_seq, frame_type, data, size, lane->buffer[lane->tail].data);
+    lane->tail = (lane->tail + 1) % RS422_TX_BUFFER_SIZE;
+    tx_seq++;
+
+    uint16_t queued = RS422_TX_BUFFER_SIZE - space;
+    if (queued > lane->stats.high_water) {
+        lane->stats.high_water = queued;
+    }
+    __enable_irq();
+
+    // Start DMA transfer if not already in progress. The frame is queued either way.
+    (void)rs422_process_tx_queue();
     return HAL_OK;
 }
 
-uint16_t rs422_get_tx_buffer_space(void)
+uint16_t rs422_get_tx_buffer_space(RS422_Lane_t lane)
 {
-    return RS422_TX_BUFFER_SIZE - ((tx_buffer.tail - tx_buffer.head + RS422_TX_BUFFER_SIZE) % RS422_TX_BUFFER_SIZE);
+    const RS422_TxLane_t *l = &tx_buffer.lane[lane];
+    return RS422_TX_BUFFER_SIZE - 1 - ((l->tail - l->head + RS422_TX_BUFFER_SIZE) % RS422_TX_BUFFER_SIZE);
+}
+
+static void rs422_refill_tokens(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - tx_buffer.last_refill;
+    if (elapsed == 0) {
+        return;
+    }
+    tx_buffer.last_refill = now;
+    if (elapsed > 100) {
+        elapsed = 100; // Buckets are full long before this anyway
+    }
+
+    for (uint8_t i = 0; i < RS422_LANE_COUNT; i++) {
+        RS422_TxLane_t *lane = &tx_buffer.lane[i];
+        int32_t cap = (int32_t)(lane->burst * 1000U);
+        lane->tokens += (int32_t)(elapsed * lane->rate); // ms * bytes/s = milli-bytes
+        if (lane->tokens > cap) {
+            lane->tokens = cap;
+        }
+    }
 }
 
 HAL_StatusTypeDef rs422_process_tx_queue(void)
 {
-    if (tx_buffer.is_busy) {
+    __disable_irq();
+    if (tx_buffer.is_busy || rs422_uart_handle == NULL) {
+        __enable_irq();
         return HAL_BUSY;
     }
-    
-    // Check if there are packets to send
-    if (tx_buffer.head == tx_buffer.tail) {
+
+    rs422_refill_tokens();
+
+    // Highest priority lane with a frame waiting and tokens left. A lane only needs a
+    // positive balance, so a burst smaller than one frame still makes progress.
+    RS422_TxLane_t *lane = NULL;
+    for (uint8_t i = 0; i < RS422_LANE_COUNT; i++) {
+        RS422_TxLane_t *candidate = &tx_buffer.lane[i];
+        if (candidate->head == candidate->tail) {
+            continue;
+        }
+        if (candidate->tokens <= 0) {
+            candidate->stats.throttled++;
+            continue;
+        }
+        lane = candidate;
+        tx_buffer.active = i;
+        break;
+    }
+
+    // Nothing to send, or everything waiting is over budget until the next service
+    if (lane == NULL) {
+        __enable_irq();
         return HAL_OK;
     }
-    
+
+    RS422_packet *packet = &lane->buffer[lane->head];
+    lane->tokens -= (int32_t)(packet->size * 1000U);
+
     // Start DMA transfer for the next packet with actual data size
     tx_buffer.is_busy = true;
-    return HAL_UART_Transmit_DMA(rs422_uart_handle, 
-                                 tx_buffer.buffer[tx_buffer.head].data, 
-                                 tx_buffer.buffer[tx_buffer.head].size);
+    __enable_irq();
+    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(rs422_uart_handle, packet->data, packet->size);
+    if (status != HAL_OK) {
+        tx_buffer.is_busy = false; // Frame stays queued and is retried on the next service
+    }
+    return status;
 }
 
-void rs422_process_rx_dma(uint16_t transferred)
+void rs422_service_tx(void)
 {
-    if (transferred != RS422_RX_BUFFER_SIZE) {
-        rx_buffer.write_pos = transferred;
-    } else {
-        uint8_t length_code = dlc_to_len(rx_buffer.buffer[rx_buffer.read_pos] & 0x0F); // Compute length of packet
-        if (rx_buffer.read_pos + length_code == RS422_RX_BUFFER_SIZE) {
-           rx_buffer.write_pos = transferred;
-        } else {
-            // Do nothing here, we will get the actual final position in the next callback
-        }
+    // Restarts lanes that were waiting for tokens when the last transfer finished
+    (void)rs422_process_tx_queue();
+}
+
+void rs422_set_lane_budget(RS422_Lane_t lane, uint8_t share_percent, uint32_t burst_bytes)
+{
+    if (lane >= RS422_LANE_COUNT) {
+        return;
     }
-    
+    if (share_percent > 100) {
+        share_percent = 100;
+    }
+    __disable_irq();
+    tx_buffer.lane[lane].rate = RS422_LINK_BYTES_PER_S / 100U * share_percent;
+    tx_buffer.lane[lane].burst = burst_bytes;
+    tx_buffer.lane[lane].tokens = (int32_t)(burst_bytes * 1000U);
+    __enable_irq();
+}
+
+void rs422_reset_link_stats(void)
+{
+    __disable_irq();
+    for (uint8_t i = 0; i < RS422_LANE_COUNT; i++) {
+        memset(&tx_buffer.lane[i].stats, 0, sizeof(RS422_LaneStats_t));
+    }
+    tx_buffer.stats_start = HAL_GetTick();
+    __enable_irq();
+}
+
+void rs422_get_lane_stats(RS422_Lane_t lane, RS422_LaneStats_t *out)
+{
+    __disable_irq();
+    *out = tx_buffer.lane[lane].stats;
+    __enable_irq();
+}
+
+void rs422_print_link_budget(void)
+{
+    static const char *lane_names[RS422_LANE_COUNT] = {"safety", "control", "bulk", "replay"};
+    uint32_t elapsed = HAL_GetTick() - tx_buffer.stats_start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+
+    uint32_t total = 0;
+    dbg_printf("RS422 link budget over %lu ms (%lu B/s link)\r\n", elapsed, (uint32_t)RS422_LINK_BYTES_PER_S);
+    for (uint8_t i = 0; i < RS422_LANE_COUNT; i++) {
+        const RS422_TxLane_t *lane = &tx_buffer.lane[i];
+        uint32_t rate = (uint32_t)((uint64_t)lane->stats.bytes * 1000U / elapsed);
+        total += rate;
+        dbg_printf("  %-7s %3lu%% %5lu B burst: %6lu B/s, %lu frames, %lu dropped, %lu throttled, hw %u/%u\r\n",
+                   lane_names[i], lane->rate * 100U / RS422_LINK_BYTES_PER_S, lane->burst, rate,
+                   lane->stats.frames, lane->stats.dropped, lane->stats.throttled,
+                   lane->stats.high_water, RS422_TX_BUFFER_SIZE - 1);
+    }
+    dbg_printf("  total   %lu B/s, %lu%% of link\r\n", total, total * 100U / RS422_LINK_BYTES_PER_S);
+}
+
+void rs422_process_rx_dma(void)
+{
+    if (rs422_uart_handle == NULL || rs422_uart_handle->hdmarx == NULL) {
+        return;
+    }
+#ifdef RS422_STRESS
+    if (rx_injecting) {
+        return; // Head is moved by rs422_stress_inject() instead
+    }
+#endif
+
+    // Called from the HT/TC/IDLE events, which are at most half a buffer apart, and from the
+    // parser. The distance moved since the last call is therefore never ambiguous and the
+    // running total shows when the DMA has lapped the parser.
+    __disable_irq();
+    uint16_t head = (RS422_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(rs422_uart_handle->hdmarx)) & RS422_RX_BUFFER_MASK;
+    rx_head_total += (uint16_t)(head - rx_last_head) & RS422_RX_BUFFER_MASK;
+    rx_last_head = head;
+    rx_buffer.write_pos = head;
+    __enable_irq();
 }
 
 uint16_t rs422_get_rx_available(void)
 {
-    uint16_t available = 0;
-    
-    // Calculate available bytes based on DMA position
-    if (rx_buffer.write_pos >= rx_buffer.read_pos) {
-        available = rx_buffer.write_pos - rx_buffer.read_pos;
-    } else {
-        available = RS422_RX_BUFFER_SIZE - rx_buffer.read_pos + rx_buffer.write_pos;
+    rs422_process_rx_dma();
+    uint32_t unread = rx_head_total - rx_tail_total;
+    return (unread > RS422_RX_BUFFER_SIZE) ? RS422_RX_BUFFER_SIZE : (uint16_t)unread;
+}
+
+static void rx_frame_reset(void)
+{
+    rx_len = 0;
+    rx_encoded = 0;
+    rx_code = 0;
+    rx_code_left = 0;
+}
+
+// Drop the frame in progress and everything up to the next delimiter
+static void rs422_rx_hunt(void)
+{
+    if (!rx_hunting) {
+        rx_hunting = true;
+        rx_stats.resyncs++;
     }
-    
-    return available;
+    rx_stats.bytes_discarded += rx_encoded;
+    rx_frame_reset();
 }
 
-uint16_t rs422_read(RS422_RxFrame_t *frame)
+// A delimiter arrived; check the decoded bytes and fill in the frame if they are good.
+// Returns the decoded frame length, 0 if there was no valid frame.
+static uint16_t rx_frame_complete(RS422_RxFrame_t *frame)
 {
-    static uint8_t message_buffer[RS422_TX_MESSAGE_SIZE]; // Static buffer for reading data
-    uint16_t available = rs422_get_rx_available();
-    if (available == 0) {
-        return 0; // No data available
+    if (rx_encoded == 0) {
+        return 0; // Back to back delimiters
+    }
+    if (rx_code_left != 0 || rx_len < 4) {
+        rx_stats.bad_frames++;
+        return 0;
     }
 
-    uint8_t header = rx_buffer.buffer[rx_buffer.read_pos]; // Read header byte
-    uint8_t data_length = dlc_to_len(header & 0x0F); // Actual data length
-    if (data_length > available - 3) {
-        return 0; // Not enough data available for a complete packet
+    uint8_t header = rx_frame[1];
+    uint8_t frame_type = (header >> 4) & 0x0F;
+    uint8_t data_length = dlc_to_len(header & 0x0F);
+    if (rx_len != data_length + 4U || !(RS422_RX_VALID_TYPES & (1U << frame_type))) {
+        rx_stats.bad_frames++;
+        return 0;
     }
+
+    uint16_t crc_calc = crc16_compute(rx_frame, rx_len - 2);
+    uint16_t crc_in_packet = (uint16_t)rx_frame[rx_len - 2] | ((uint16_t)rx_frame[rx_len - 1] << 8);
+    if (crc_calc != crc_in_packet) {
+        rx_stats.crc_failures++;
+        return 0;
+    }
+
+    uint8_t seq = rx_frame[0];
+    if (rx_seq_valid) {
+        rx_stats.frames_lost += (uint8_t)(seq - rx_seq_expected);
+    }
+    rx_seq_expected = seq + 1;
+    rx_seq_valid = true;
+
+    frame->frame_type = frame_type;
+    frame->seq = seq;
     frame->size = data_length;
-    frame->frame_type = (header >> 4) & 0x0F; // Extract frame type from header
+    frame->data = &rx_frame[2]; // Decoded in place, valid until the next rs422_read()
+    rx_stats.frames_ok++;
+    return rx_len;
+}
+
+// Decode a contiguous run of received bytes. Data inside a COBS block is copied as a block,
+// only code bytes and delimiters are handled one at a time. Stops after a complete frame.
+static uint16_t rx_decode(const uint8_t *p, uint16_t n, uint16_t *used, RS422_RxFrame_t *frame)
+{
+    const uint8_t *start = p;
+    const uint8_t *end = p + n;
+    uint16_t length = 0;
+
+    while (p < end && length == 0) {
+        if (rx_hunting) {
+            const uint8_t *delim = memchr(p, RS422_COBS_DELIM, end - p);
+            const uint8_t *stop = delim ? delim : end;
+            rx_stats.bytes_discarded += stop - p;
+            p = stop;
+            if (delim) {
+                p++;
+                rx_hunting = false; // Locked on again, next byte starts a frame
+                rx_frame_reset();
+            }
+            continue;
+        }
 
-    uint16_t bytes_read = 0;
-    uint16_t to_read = 1 + data_length + 2; // header + data + CRC
+        if (*p == RS422_COBS_DELIM) {
+            p++;
+            length = rx_frame_complete(frame);
+            if (length == 0) {
+                rx_stats.bytes_discarded += rx_encoded;
+            }
+            rx_frame_reset();
+            continue;
+        }
+
+        if (rx_code_left == 0) {
+            // Code byte. Every block but the first was preceded by a zero, unless the
+            // previous block was a full 254 bytes.
+            uint8_t code = *p++;
+            rx_encoded++;
+            if (rx_encoded > 1 && rx_code != 0xFF) {
+                if (rx_len >= RS422_RAW_FRAME_SIZE) {
+                    rx_stats.bad_frames++;
+                    rs422_rx_hunt();
+                    continue;
+                }
+                rx_frame[rx_len++] = 0;
+            }
+            rx_code = code;
+            rx_code_left = code - 1;
+            continue;
+        }
 
-    // Read data from circular buffer
-    while (bytes_read < to_read) {
-        message_buffer[bytes_read] = rx_buffer.buffer[rx_buffer.read_pos];
-        rx_buffer.read_pos = (rx_buffer.read_pos + 1) % RS422_RX_BUFFER_SIZE;
-        bytes_read++;
+        // Block data, up to the end of the block or an early delimiter
+        uint16_t run = (uint16_t)(end - p);
+        if (run > rx_code_left) {
+            run = rx_code_left;
+        }
+        const uint8_t *delim = memchr(p, RS422_COBS_DELIM, run);
+        if (delim) {
+            run = delim - p;
+        }
+        rx_encoded += run;
+        if (rx_len + run > RS422_RAW_FRAME_SIZE) {
+            p += run;
+            rx_stats.bad_frames++;
+            rs422_rx_hunt();
+            continue;
+        }
+        memcpy(&rx_frame[rx_len], p, run);
+        rx_len += run;
+        rx_code_left -= run;
+        p += run;
     }
 
-    // Check CRC to validate the packet
-    uint16_t crc_received = crc16_compute(message_buffer, data_length+1); // Compute CRC on received data
-    uint16_t crc_in_packet = (uint16_t)message_buffer[1 + data_length] | ((uint16_t)message_buffer[2 + data_length] << 8);
-    if (crc_received != crc_in_packet) {
-        dbg_printf("RS422 CRC mismatch: computed 0x%04X, received 0x%04X\r\n", crc_received, crc_in_packet);
-        rx_buffer.read_pos = rx_buffer.write_pos; // Discard packet and hope write position isn't part way through a new packet
-        return 0; // CRC mismatch, invalid packet
+    *used = p - start;
+    return length;
+}
+
+uint16_t rs422_read(RS422_RxFrame_t *frame)
+{
+    rs422_process_rx_dma();
+
+    uint32_t unread = rx_head_total - rx_tail_total;
+    if (unread > rx_stats.max_backlog) {
+        rx_stats.max_backlog = unread;
+    }
+    if (unread > RS422_RX_BUFFER_SIZE) {
+        // The DMA lapped the parser and overwrote unread bytes. Drop everything and lock on
+        // again at the next delimiter.
+        rx_stats.overruns++;
+        rx_stats.bytes_discarded += unread;
+        rx_tail_total = rx_head_total;
+        rs422_rx_hunt();
+        return 0;
     }
 
-    // Copy validated data to the frame
-    memcpy(frame->data, &message_buffer[1], data_length);
-    return bytes_read;
+    while (rx_tail_total != rx_head_total) {
+        // Contiguous bytes up to the DMA head or the end of the buffer
+        uint16_t pos = rx_tail_total & RS422_RX_BUFFER_MASK;
+        uint32_t run = rx_head_total - rx_tail_total;
+        if (run > (uint32_t)(RS422_RX_BUFFER_SIZE - pos)) {
+            run = (uint32_t)(RS422_RX_BUFFER_SIZE - pos);
+        }
+
+        uint16_t used = 0;
+        uint16_t length = rx_decode((const uint8_t*)&rx_buffer.buffer[pos], (uint16_t)run, &used, frame);
+        rx_tail_total += used;
+        rx_buffer.read_pos = rx_tail_total & RS422_RX_BUFFER_MASK;
+        if (length > 0) {
+            return length;
+        }
+    }
+    return 0; // No complete frame yet
+}
+
+void rs422_get_rx_stats(RS422_RxStats_t *out)
+{
+    *out = rx_stats;
+}
+
+void rs422_reset_rx_stats(void)
+{
+    memset(&rx_stats, 0, sizeof(rx_stats));
+}
+
+void rs422_print_rx_stats(void)
+{
+    dbg_printf("RS422 RX: %lu ok, %lu lost, %lu crc fail, %lu bad frames\r\n",
+               rx_stats.frames_ok, rx_stats.frames_lost, rx_stats.crc_failures, rx_stats.bad_frames);
+    dbg_printf("          %lu resyncs, %lu bytes discarded, %lu uart errors, %lu overruns\r\n",
+               rx_stats.resyncs, rx_stats.bytes_discarded, rx_stats.uart_errors, rx_stats.overruns);
+    dbg_printf("          backlog high water %lu/%u bytes\r\n", rx_stats.max_backlog, RS422_RX_BUFFER_SIZE);
+}
+
+#ifdef RS422_STRESS
+void rs422_stress_attach(bool attach)
+{
+    if (rs422_uart_handle == NULL) {
+        return;
+    }
+    if (attach) {
+        // Park the real receiver, the ring now only holds injected bytes
+        HAL_UART_AbortReceive(rs422_uart_handle);
+        rx_reset_positions();
+        rx_frame_reset();
+        rx_hunting = false;
+        rx_seq_valid = false;
+        rx_injecting = true;
+    } else {
+        rx_injecting = false;
+        rs422_restart_rx(rs422_uart_handle);
+    }
+}
+
+void rs422_stress_inject(const uint8_t *data, uint16_t len)
+{
+    // Written exactly as the DMA would, including lapping the parser if it falls behind
+    for (uint16_t i = 0; i < len; i++) {
+        rx_buffer.buffer[rx_head_total & RS422_RX_BUFFER_MASK] = data[i];
+        rx_head_total++;
+    }
+    rx_last_head = rx_head_total & RS422_RX_BUFFER_MASK;
+    rx_buffer.write_pos = rx_last_head;
 }
+#endif
 
 // Needs a uint8_t in the form [Servo A Pos, Servo B Pos, Servo C Pos, Servo D Pos, Servos Armed, Any Servos Error, 0 (Solenoid Position), 0 (Pyro Armed)]
 bool rs422_send_valve_position(uint8_t valve_pos)
@@ -323,7 +743,7 @@ bool rs422_send_battery_state(uint8_t percent_2s, uint8_t percent_6s)
 // VERIFY: Test this
 bool rs422_send_string_message(const char *str, uint8_t length)
 {
-    if (length > RS422_TX_MESSAGE_SIZE - 3) {
+    if (length > RS422_MAX_PAYLOAD) {
         return false; // String too long for packet
     }
     return (rs422_send((uint8_t*)str, length, RS422_STRING_MESSAGE) == HAL_OK);
@@ -342,5 +762,6 @@ bool rs422_send_spicy_state(uint8_t spicy_state)
 
 bool rs422_send_abort(uint8_t error_code)
 {
-    return (rs422_send(&error_code, 1, RS422_FRAME_ABORT) == HAL_OK);
+    // Retransmitted until the RIU acknowledges it
+    return rs422_cmd_send(RS422_FRAME_ABORT, &error_code, 1);
 }
\ No newline at end of file
@@ -3,14 +3,40 @@
 
 #include "stm32g0xx_hal.h"
 #include "peripherals.h"
+#include "config.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
+// Link layer: every frame is COBS encoded and terminated by a single 0x00 delimiter, so a
+// receiver locks onto the next frame boundary as soon as it sees a zero.
+//   decoded frame: [seq][type<<4 | DLC][payload (DLC->len)][CRC16 LE over seq..payload]
+// seq increments per frame sent, gaps in it count lost frames exactly.
+#define RS422_COBS_DELIM 0x00
+#define RS422_MAX_PAYLOAD 64
+#define RS422_RAW_FRAME_SIZE (RS422_MAX_PAYLOAD + 4)       // seq + header + payload + CRC
+#define RS422_TX_MESSAGE_SIZE (RS422_RAW_FRAME_SIZE + 2)   // + COBS code byte + delimiter
+
 // Buffer configurations for optimal DMA performance
-#define RS422_TX_BUFFER_SIZE 8
-#define RS422_TX_MESSAGE_SIZE 67
-#define RS422_RX_BUFFER_SIZE 335  // Double buffer for continuous DMA reception
+#define RS422_TX_BUFFER_SIZE 16   // Slots per TX lane (one is always kept free)
+// Circular DMA reception. Power of two so positions wrap with a mask. The RIU sends a few
+// short frames per 100 ms poll, so this is several times the expected backlog; RSSTAT
+// reports the measured high water to size it against.
+#define RS422_RX_BUFFER_SIZE 512
+#define RS422_RX_BUFFER_MASK (RS422_RX_BUFFER_SIZE - 1)
+#if (RS422_RX_BUFFER_SIZE & RS422_RX_BUFFER_MASK) != 0
+#error "RS422_RX_BUFFER_SIZE must be a power of two"
+#endif
+
+// Frame types the ECU can receive. A header with any other type is line noise and the
+// frame is dropped even if its CRC happens to match.
+#define RS422_RX_VALID_TYPES ((1U << RS422_FRAME_HEARTBEAT) | (1U << RS422_FRAME_SWITCH_CHANGE) | \
+                              (1U << RS422_FRAME_VALVE_UPDATE) | (1U << RS422_SPICY_STATUS_UPDATE) | \
+                              (1U << RS422_BATTERY_VOLTAGE_FRAME) | (1U << RS422_FRAME_SENSOR) | \
+                              (1U << RS422_STRING_MESSAGE) | (1U << RS422_FRAME_COUNTDOWN) | \
+                              (1U << RS422_FRAME_ERROR_WARNING) | (1U << RS422_FRAME_ABORT) | \
+                              (1U << RS422_FRAME_FIRE) | (1U << RS422_FRAME_CMD_ACK) | \
+                              (1U << RS422_FRAME_REPLAY) | (1U << RS422_FRAME_CALIBRATION))
 
 typedef enum {
     RS422_FRAME_HEARTBEAT = 0b0000,
@@ -18,12 +44,12 @@ typedef enum {
     RS422_FRAME_VALVE_UPDATE = 0b0010,
     RS422_SPICY_STATUS_UPDATE = 0b0011,
     RS422_BATTERY_VOLTAGE_FRAME = 0b0100,
-    // 0b0101
+    RS422_FRAME_SENSOR_SUMMARY = 0b0101,
     RS422_FRAME_SENSOR = 0b0110,
     RS422_STRING_MESSAGE = 0b0111,
-    // 0b1000
-    // 0b1001
-    // 0b1010
+    RS422_FRAME_CMD_ACK = 0b1000,
+    RS422_FRAME_REPLAY = 0b1001,      // RIU: replay request command, ECU: SD records (see sd_replay.h)
+    RS422_FRAME_CALIBRATION = 0b1010, // RIU: calibration command, ECU: reply (see calibration.h)
     // 0b1011
     RS422_FRAME_COUNTDOWN = 0b1100,
     RS422_FRAME_ERROR_WARNING = 0b1101,
@@ -31,6 +57,29 @@ typedef enum {
     RS422_FRAME_FIRE = 0b1111
 } RS422_FrameType_t;
 
+// TX priority lanes. Each lane has its own queue and token bucket. The scheduler always
+// serves the highest priority lane that has a frame and tokens, so safety traffic never
+// queues behind telemetry and bulk telemetry gets whatever the other lanes leave.
+typedef enum {
+    RS422_LANE_SAFETY = 0,      // Abort, error/warning, fire, command ACKs
+    RS422_LANE_CONTROL,         // Heartbeat, countdown and status updates
+    RS422_LANE_BULK,            // Sensor telemetry
+    RS422_LANE_REPLAY,          // SD replay, only what live traffic leaves over
+    RS422_LANE_COUNT
+} RS422_Lane_t;
+
+#define RS422_LINK_BYTES_PER_S 200000U  // 2 Mbaud, 10 bits per byte
+
+// Default share of the link (percent) and bucket depth (bytes) per lane
+#define RS422_LANE_SAFETY_SHARE 100U
+#define RS422_LANE_SAFETY_BURST 1024U
+#define RS422_LANE_CONTROL_SHARE 30U
+#define RS422_LANE_CONTROL_BURST 1024U
+#define RS422_LANE_BULK_SHARE 90U
+#define RS422_LANE_BULK_BURST 2048U
+#define RS422_LANE_REPLAY_SHARE 25U
+#define RS422_LANE_REPLAY_BURST 512U
+
 // Structure for RS422 transmission circular buffer
 typedef struct {
     uint8_t data[RS422_TX_MESSAGE_SIZE];
@@ -39,35 +88,82 @@ typedef struct {
 
 typedef struct {
     RS422_FrameType_t frame_type; // Type of RS422 frame
-    uint8_t data[RS422_TX_MESSAGE_SIZE - 3]; // Data payload (excluding header and CRC)
+    uint8_t seq; // Link sequence number
+    const uint8_t *data; // Data payload (excluding header and CRC), valid until the next rs422_read()
     uint16_t size; // Total size of the packet (header + data + CRC)
 } RS422_RxFrame_t;
 
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t dropped;           // Rejected because the lane queue was full
+    uint32_t throttled;         // Scheduler passes that found the lane out of tokens
+    uint16_t high_water;        // Most frames queued at once
+} RS422_LaneStats_t;
+
 typedef struct {
     RS422_packet buffer[RS422_TX_BUFFER_SIZE];
     volatile uint16_t head;
     volatile uint16_t tail;
+    int32_t tokens;             // Milli-bytes, goes negative after a frame bigger than the balance
+    uint32_t rate;              // Bytes per second
+    uint32_t burst;             // Bucket depth in bytes
+    RS422_LaneStats_t stats;
+} RS422_TxLane_t;
+
+typedef struct {
+    RS422_TxLane_t lane[RS422_LANE_COUNT];
+    volatile uint8_t active;    // Lane whose head frame is on the wire
     volatile bool is_busy;
+    uint32_t last_refill;
+    uint32_t stats_start;
 } RS422_TxBuffer_t;
 
 // Structure for RS422 reception circular buffer with DMA
 typedef struct {
     uint8_t buffer[RS422_RX_BUFFER_SIZE];
-    volatile uint16_t write_pos;  // Current DMA write position
+    volatile uint16_t write_pos;  // DMA write position (from NDTR) at the last update
     volatile uint16_t read_pos;   // Current read position
 } RS422_RxBuffer_t;
 
+// Receive parser health counters
+typedef struct {
+    uint32_t frames_ok;
+    uint32_t crc_failures;      // Complete frames with a bad CRC
+    uint32_t bad_frames;        // Invalid COBS, type or length
+    uint32_t resyncs;           // Times the parser lost the frame boundary and hunted for a delimiter
+    uint32_t bytes_discarded;   // Encoded bytes dropped (bad frames and hunting)
+    uint32_t frames_lost;       // Gaps in the sequence number
+    uint32_t uart_errors;       // UART errors that forced an RX restart
+    uint32_t overruns;          // DMA overwrote bytes the parser had not read yet
+    uint32_t max_backlog;       // Most unread bytes seen in the buffer
+} RS422_RxStats_t;
+
 // Function declarations
 void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t transferred);
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
 void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
 bool rs422_init(UART_HandleTypeDef *huart);
 HAL_StatusTypeDef rs422_send(uint8_t *data, uint8_t size, RS422_FrameType_t frame_type);
-uint16_t rs422_get_tx_buffer_space(void);
+uint16_t rs422_encode_frame(uint8_t seq, RS422_FrameType_t frame_type, const uint8_t *data, uint8_t size, uint8_t *out);
+uint16_t rs422_get_tx_buffer_space(RS422_Lane_t lane);
 HAL_StatusTypeDef rs422_process_tx_queue(void);
+void rs422_service_tx(void);
+void rs422_set_lane_budget(RS422_Lane_t lane, uint8_t share_percent, uint32_t burst_bytes);
+void rs422_reset_link_stats(void);
+void rs422_get_lane_stats(RS422_Lane_t lane, RS422_LaneStats_t *out);
+void rs422_print_link_budget(void);
 uint16_t rs422_get_rx_available(void);
 uint16_t rs422_read(RS422_RxFrame_t *frame);
-void rs422_process_rx_dma(uint16_t transferred);
+void rs422_process_rx_dma(void);
+void rs422_get_rx_stats(RS422_RxStats_t *out);
+void rs422_reset_rx_stats(void);
+void rs422_print_rx_stats(void);
+#ifdef RS422_STRESS
+// Bench only: replace the UART receiver with bytes injected by rs422_stress.c
+void rs422_stress_attach(bool attach);
+void rs422_stress_inject(const uint8_t *data, uint16_t len);
+#endif
 bool rs422_send_valve_position(uint8_t valve_pos);
 bool rs422_send_data(const uint8_t *data, uint8_t size, RS422_FrameType_t frame_type);
 bool rs422_send_countdown(int8_t countdown);
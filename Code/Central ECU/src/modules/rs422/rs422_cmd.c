@@ -0,0 +1,188 @@
+#include "rs422_cmd.h"
+#include "debug_io.h"
+
+typedef struct {
+    bool valid;
+    uint8_t seq;
+    uint8_t frame_type;
+    uint8_t status;
+    uint32_t time;
+} rs422_cmd_history_t;
+
+typedef struct {
+    bool active;
+    uint8_t seq;
+    uint8_t frame_type;
+    uint8_t size;
+    uint8_t tries;
+    uint32_t first_sent;
+    uint32_t last_sent;
+    uint8_t data[RS422_MAX_PAYLOAD];    // Including the sequence number
+} rs422_cmd_pending_t;
+
+static rs422_cmd_history_t history[RS422_CMD_HISTORY];
+static uint8_t history_next = 0;
+static rs422_cmd_pending_t pending[RS422_CMD_PENDING];
+static uint8_t tx_cmd_seq = 0;
+static rs422_cmd_stats_t cmd_stats = {0};
+
+bool rs422_cmd_is_command(RS422_FrameType_t frame_type)
+{
+    return frame_type == RS422_FRAME_SWITCH_CHANGE || frame_type == RS422_FRAME_VALVE_UPDATE ||
+           frame_type == RS422_FRAME_ABORT || frame_type == RS422_FRAME_FIRE ||
+           frame_type == RS422_FRAME_REPLAY || frame_type == RS422_FRAME_CALIBRATION;
+}
+
+static void send_ack(uint8_t cmd_seq, uint8_t frame_type, uint8_t status)
+{
+    uint8_t ack[3] = {cmd_seq, frame_type, status};
+    rs422_send_data(ack, sizeof(ack), RS422_FRAME_CMD_ACK);
+}
+
+bool rs422_cmd_begin(RS422_RxFrame_t *frame, uint8_t *cmd_seq)
+{
+    if (frame->size < 1) {
+        cmd_stats.malformed++;
+        return false;
+    }
+    *cmd_seq = frame->data[0];
+    frame->data++;
+    frame->size--;
+
+    uint32_t now = HAL_GetTick();
+    for (uint8_t i = 0; i < RS422_CMD_HISTORY; i++) {
+        rs422_cmd_history_t *h = &history[i];
+        if (h->valid && h->seq == *cmd_seq && h->frame_type == frame->frame_type &&
+            now - h->time < RS422_CMD_HISTORY_MS) {
+            // Our ACK was lost, answer again without executing a second time
+            cmd_stats.duplicates++;
+            send_ack(h->seq, h->frame_type, h->status);
+            return false;
+        }
+    }
+    return true;
+}
+
+void rs422_cmd_complete(uint8_t cmd_seq, RS422_FrameType_t frame_type, rs422_cmd_status_t status)
+{
+    rs422_cmd_history_t *h = &history[history_next];
+    history_next = (history_next + 1) % RS422_CMD_HISTORY;
+    h->valid = true;
+    h->seq = cmd_seq;
+    h->frame_type = frame_type;
+    h->status = status;
+    h->time = HAL_GetTick();
+
+    if (status == RS422_CMD_OK) {
+        cmd_stats.executed++;
+    } else {
+        cmd_stats.rejected++;
+        dbg_printf("RS422: command %d seq %d rejected (%d)\r\n", frame_type, cmd_seq, status);
+    }
+    send_ack(cmd_seq, frame_type, status);
+}
+
+bool rs422_cmd_send(RS422_FrameType_t frame_type, const uint8_t *data, uint8_t size)
+{
+    if (size > RS422_MAX_PAYLOAD - 1) {
+        return false;
+    }
+
+    // Reuse the oldest slot if everything is in flight, the newest command matters most
+    rs422_cmd_pending_t *p = &pending[0];
+    for (uint8_t i = 0; i < RS422_CMD_PENDING; i++) {
+        if (!pending[i].active) {
+            p = &pending[i];
+            break;
+        }
+        if ((int32_t)(pending[i].first_sent - p->first_sent) < 0) {
+            p = &pending[i];
+        }
+    }
+    if (p->active) {
+        cmd_stats.gave_up++;
+    }
+
+    p->seq = tx_cmd_seq++;
+    p->frame_type = frame_type;
+    p->data[0] = p->seq;
+    memcpy(&p->data[1], data, size);
+    p->size = size + 1;
+    p->tries = 1;
+    p->first_sent = HAL_GetTick();
+    p->last_sent = p->first_sent;
+    p->active = true;
+    cmd_stats.sent++;
+
+    // Even if the queue is full now the retry timer sends it later
+    (void)rs422_send_data(p->data, p->size, frame_type);
+    return true;
+}
+
+void rs422_cmd_handle_ack(const RS422_RxFrame_t *frame)
+{
+    if (frame->size < 3) {
+        return;
+    }
+    uint8_t seq = frame->data[0];
+    uint8_t frame_type = frame->data[1];
+    uint8_t status = frame->data[2];
+
+    for (uint8_t i = 0; i < RS422_CMD_PENDING; i++) {
+        rs422_cmd_pending_t *p = &pending[i];
+        if (p->active && p->seq == seq && p->frame_type == frame_type) {
+            p->active = false;
+            uint32_t ack_ms = HAL_GetTick() - p->first_sent;
+            if (ack_ms > cmd_stats.max_ack_ms) {
+                cmd_stats.max_ack_ms = ack_ms;
+            }
+            if (status == RS422_CMD_OK) {
+                cmd_stats.acked++;
+            } else {
+                cmd_stats.nak_received++;
+                dbg_printf("RS422: RIU rejected command %d seq %d (%d)\r\n", frame_type, seq, status);
+            }
+            return;
+        }
+    }
+}
+
+void rs422_cmd_poll(void)
+{
+    uint32_t now = HAL_GetTick();
+    for (uint8_t i = 0; i < RS422_CMD_PENDING; i++) {
+        rs422_cmd_pending_t *p = &pending[i];
+        if (!p->active || now - p->last_sent < RS422_CMD_RETRY_MS) {
+            continue;
+        }
+        if (p->tries >= RS422_CMD_MAX_TRIES) {
+            p->active = false;
+            cmd_stats.gave_up++;
+            dbg_printf("RS422: command %d seq %d not acknowledged\r\n", p->frame_type, p->seq);
+            continue;
+        }
+        p->tries++;
+        p->last_sent = now;
+        cmd_stats.retransmits++;
+        (void)rs422_send_data(p->data, p->size, (RS422_FrameType_t)p->frame_type);
+    }
+}
+
+void rs422_cmd_get_stats(rs422_cmd_stats_t *out)
+{
+    *out = cmd_stats;
+}
+
+void rs422_cmd_reset_stats(void)
+{
+    memset(&cmd_stats, 0, sizeof(cmd_stats));
+}
+
+void rs422_cmd_print_stats(void)
+{
+    dbg_printf("RS422 CMD: rx %lu ok, %lu nak, %lu dup, %lu malformed\r\n",
+               cmd_stats.executed, cmd_stats.rejected, cmd_stats.duplicates, cmd_stats.malformed);
+    dbg_printf("           tx %lu sent, %lu retx, %lu ack, %lu nak, %lu lost, slowest ack %lu ms\r\n",
+               cmd_stats.sent, cmd_stats.retransmits, cmd_stats.acked, cmd_stats.nak_received,
+               cmd_stats.gave_up, cmd_stats.max_ack_ms);
+}
@@ -0,0 +1,66 @@
+#ifndef RS422_CMD_H
+#define RS422_CMD_H
+
+#include "rs422.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Command sublayer on top of the RS422 link. Command frames carry a command sequence
+// number as their first payload byte and are answered with RS422_FRAME_CMD_ACK:
+//   [cmd seq][frame type][status]     status RS422_CMD_OK or a NAK reason
+//
+// The sender retransmits until it sees the ACK/NAK. The receiver remembers recent
+// sequence numbers so a retransmitted command is answered again but not executed twice.
+// RIU -> ECU commands: switch change, valve update, abort, fire, replay request, calibration.
+// ECU -> RIU commands: abort.
+
+#define RS422_CMD_RETRY_MS      50U     // Retransmit interval for unacknowledged commands
+#define RS422_CMD_MAX_TRIES     5U      // Sends before giving up
+#define RS422_CMD_PENDING       4U      // Unacknowledged ECU commands in flight
+#define RS422_CMD_HISTORY       16U     // Received commands remembered for duplicate suppression
+#define RS422_CMD_HISTORY_MS    2000U   // Longer than a sender's whole retry span, short enough
+                                        // that a rebooted sender reusing numbers is not suppressed
+
+typedef enum {
+    RS422_CMD_OK = 0,
+    RS422_CMD_NAK_MALFORMED = 1,        // Payload too short or invalid argument
+    RS422_CMD_NAK_STATE = 2,            // Not allowed in the current state
+    RS422_CMD_NAK_RATE = 3,             // Too soon after the previous one
+    RS422_CMD_NAK_UNSUPPORTED = 4
+} rs422_cmd_status_t;
+
+typedef struct {
+    uint32_t executed;
+    uint32_t rejected;          // NAKed
+    uint32_t duplicates;        // Retransmits answered from history
+    uint32_t malformed;         // Command frames without a sequence number
+    uint32_t sent;              // ECU commands sent for the first time
+    uint32_t retransmits;
+    uint32_t acked;
+    uint32_t nak_received;
+    uint32_t gave_up;           // ECU commands never acknowledged
+    uint32_t max_ack_ms;        // Slowest ACK for an ECU command
+} rs422_cmd_stats_t;
+
+bool rs422_cmd_is_command(RS422_FrameType_t frame_type);
+
+// Strip the command sequence number from a received command frame. Returns true if the
+// command is new and should be executed, after which rs422_cmd_complete() must be called.
+// Duplicates are answered here with the original result.
+bool rs422_cmd_begin(RS422_RxFrame_t *frame, uint8_t *cmd_seq);
+void rs422_cmd_complete(uint8_t cmd_seq, RS422_FrameType_t frame_type, rs422_cmd_status_t status);
+
+// Send a command to the RIU and retransmit it until acknowledged
+bool rs422_cmd_send(RS422_FrameType_t frame_type, const uint8_t *data, uint8_t size);
+
+// Handle an RS422_FRAME_CMD_ACK from the RIU
+void rs422_cmd_handle_ack(const RS422_RxFrame_t *frame);
+
+// Retransmit timers. Call at least every RS422_CMD_RETRY_MS.
+void rs422_cmd_poll(void);
+
+void rs422_cmd_get_stats(rs422_cmd_stats_t *out);
+void rs422_cmd_reset_stats(void);
+void rs422_cmd_print_stats(void);
+
+#endif // RS422_CMD_H
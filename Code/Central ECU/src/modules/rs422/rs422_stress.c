@@ -0,0 +1,192 @@
+#include "rs422_stress.h"
+#include <string.h>
+#include "debug_io.h"
+#include "rs422_cmd.h"
+
+#ifdef RS422_STRESS
+
+static rs422_stress_config_t stress_cfg;
+static bool running = false;
+static uint32_t start_time = 0;
+static uint32_t last_poll = 0;
+static uint32_t acc_frames = 0;     // Fractional frames carried between polls (x1000)
+static uint32_t acc_cmds = 0;
+static uint32_t acc_tx = 0;
+static uint8_t emu_seq = 0;         // Link sequence of the emulated RIU
+static uint8_t emu_cmd_seq = 0;
+static uint32_t rng = 0x12345678UL;
+
+static RS422_RxStats_t rx_before;
+static rs422_cmd_stats_t cmd_before;
+
+static rs422_stress_result_t run;
+
+static uint32_t rand_next(void)
+{
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void inject_frame(RS422_FrameType_t frame_type, const uint8_t *data, uint8_t size)
+{
+    uint8_t buf[RS422_TX_MESSAGE_SIZE];
+
+    if (rand_next() % 1000U < stress_cfg.noise_per_mille) {
+        // Line noise between frames, may contain zeros that look like delimiters
+        uint8_t noise[16];
+        uint8_t n = 1 + rand_next() % sizeof(noise);
+        for (uint8_t i = 0; i < n; i++) noise[i] = (uint8_t)rand_next();
+        rs422_stress_inject(noise, n);
+        run.noise_bursts++;
+        run.noise_bytes += n;
+    }
+
+    uint16_t len = rs422_encode_frame(emu_seq++, frame_type, data, size, buf);
+    if (rand_next() % 1000U < stress_cfg.corrupt_per_mille) {
+        buf[rand_next() % (len - 1)] ^= (uint8_t)(1U << (rand_next() % 8)); // Never the delimiter
+        run.corrupted++;
+    }
+    rs422_stress_inject(buf, len);
+    run.frames++;
+}
+
+static void send_heartbeat(uint32_t now)
+{
+    uint8_t hb[7] = {0, 0, RS422_STRESS_MARKER,
+                     (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16), (uint8_t)(now >> 24)};
+    inject_frame(RS422_FRAME_HEARTBEAT, hb, sizeof(hb));
+}
+
+static void send_command(void)
+{
+    uint8_t cmd[2] = {emu_cmd_seq++, 0};
+    inject_frame(RS422_FRAME_VALVE_UPDATE, cmd, sizeof(cmd));
+    run.commands++;
+    if ((cmd[0] & 0x03) == 0) {
+        // As if our ACK was lost and the RIU retransmitted
+        inject_frame(RS422_FRAME_VALVE_UPDATE, cmd, sizeof(cmd));
+        run.duplicates++;
+    }
+}
+
+static void send_bulk(void)
+{
+    uint8_t payload[RS422_MAX_PAYLOAD];
+    memset(payload, 0xA5, sizeof(payload));
+    if (rs422_send_data(payload, sizeof(payload), RS422_FRAME_SENSOR)) {
+        run.tx_queued++;
+    } else {
+        run.tx_rejected++;
+    }
+}
+
+static void report(void)
+{
+    RS422_RxStats_t rx;
+    rs422_get_rx_stats(&rx);
+    rs422_cmd_stats_t cmd;
+    rs422_cmd_get_stats(&cmd);
+
+    uint32_t elapsed = HAL_GetTick() - start_time;
+    if (elapsed == 0) elapsed = 1;
+    uint32_t heartbeats = run.frames - run.commands - run.duplicates;
+
+    dbg_printf("RS422 stress: %lu ms, injected %lu frames (%lu corrupt), %lu noise bytes\r\n",
+               elapsed, run.frames, run.corrupted, run.noise_bytes);
+    dbg_printf("  heartbeats %lu sent, %lu handled = %lu/s, latency avg %lu ms max %lu ms\r\n",
+               heartbeats, run.delivered, run.delivered * 1000U / elapsed,
+               run.delivered ? run.latency_sum / run.delivered : 0, run.latency_max);
+    dbg_printf("  parser: %lu ok, %lu crc, %lu bad, %lu lost, %lu resyncs, %lu discarded, %lu overruns\r\n",
+               rx.frames_ok - rx_before.frames_ok, rx.crc_failures - rx_before.crc_failures,
+               rx.bad_frames - rx_before.bad_frames, rx.frames_lost - rx_before.frames_lost,
+               rx.resyncs - rx_before.resyncs, rx.bytes_discarded - rx_before.bytes_discarded,
+               rx.overruns - rx_before.overruns);
+    dbg_printf("  commands: %lu sent + %lu repeats, %lu executed, %lu answered as duplicates\r\n",
+               run.commands, run.duplicates, cmd.executed - cmd_before.executed,
+               cmd.duplicates - cmd_before.duplicates);
+    dbg_printf("  bulk tx: %lu queued, %lu rejected (lane full)\r\n", run.tx_queued, run.tx_rejected);
+    rs422_print_link_budget();
+}
+
+void rs422_stress_start(const rs422_stress_config_t *cfg)
+{
+    if (running) rs422_stress_stop();
+
+    stress_cfg = *cfg;
+    memset(&run, 0, sizeof(run));
+    rs422_get_rx_stats(&rx_before);
+    rs422_cmd_get_stats(&cmd_before);
+    rs422_reset_link_stats();
+
+    acc_frames = 0;
+    acc_cmds = 0;
+    acc_tx = 0;
+    start_time = HAL_GetTick();
+    last_poll = start_time;
+    rs422_stress_attach(true);
+    running = true;
+}
+
+void rs422_stress_stop(void)
+{
+    if (!running) return;
+    running = false;
+    rs422_stress_attach(false);
+    report();
+}
+
+bool rs422_stress_running(void)
+{
+    return running;
+}
+
+void rs422_stress_get_result(rs422_stress_result_t *out)
+{
+    *out = run;
+}
+
+void rs422_stress_poll(void)
+{
+    if (!running) return;
+
+    uint32_t now = HAL_GetTick();
+    uint32_t dt = now - last_poll;
+    last_poll = now;
+
+    acc_frames += dt * stress_cfg.frames_per_s;
+    acc_cmds += dt * stress_cfg.commands_per_s;
+    acc_tx += dt * stress_cfg.tx_frames_per_s;
+
+    while (acc_frames >= 1000U) {
+        acc_frames -= 1000U;
+        send_heartbeat(now);
+    }
+    while (acc_cmds >= 1000U) {
+        acc_cmds -= 1000U;
+        send_command();
+    }
+    while (acc_tx >= 1000U) {
+        acc_tx -= 1000U;
+        send_bulk();
+    }
+
+    if (now - start_time >= (uint32_t)stress_cfg.seconds * 1000U) {
+        rs422_stress_stop();
+    }
+}
+
+void rs422_stress_on_frame(const RS422_RxFrame_t *frame)
+{
+    if (!running || frame->size < 7 || frame->data[2] != RS422_STRESS_MARKER) return;
+
+    uint32_t sent = frame->data[3] | (frame->data[4] << 8) | (frame->data[5] << 16) | ((uint32_t)frame->data[6] << 24);
+    uint32_t latency = HAL_GetTick() - sent;
+    run.delivered++;
+    run.latency_sum += latency;
+    if (latency > run.latency_max) run.latency_max = latency;
+}
+
+#endif // RS422_STRESS
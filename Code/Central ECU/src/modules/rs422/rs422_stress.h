@@ -0,0 +1,60 @@
+#ifndef RS422_STRESS_H
+#define RS422_STRESS_H
+
+#include "stm32g0xx_hal.h"
+#include "rs422.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// RIU emulator for stress testing the RS422 stack on the bench without the ground station.
+// While running, the UART receiver is parked and RIU frames are written into the RX ring as
+// the DMA would, so the real parser, command layer and handler process them. Only built
+// when RS422_STRESS is defined in config.h.
+//
+// Traffic: heartbeats stamped with the injection time (latency is measured when the handler
+// sees them), valve update commands with every fourth one sent twice to exercise duplicate
+// suppression, corrupted frames and bursts of line noise. Optional bulk TX load saturates
+// the downlink at the same time.
+//
+// tools/host builds this too (rs422_stress_sim), on the host USART1 emulation with the link
+// drained at the line rate, so the same runs can go under ctest. The bench run remains the
+// one for the CRC unit and interrupt timing.
+
+#define RS422_STRESS_MARKER     0x5AU   // Third heartbeat byte on emulator frames
+
+typedef struct {
+    uint16_t frames_per_s;      // Emulated RIU heartbeat rate
+    uint16_t commands_per_s;    // Valve update commands
+    uint16_t corrupt_per_mille; // Frames with a flipped bit
+    uint16_t noise_per_mille;   // Chance of a noise burst before each frame
+    uint16_t tx_frames_per_s;   // 64 byte bulk frames queued for the downlink
+    uint16_t seconds;
+} rs422_stress_config_t;
+
+// Counters of the current or last run
+typedef struct {
+    uint32_t frames;            // Injected, heartbeats and commands
+    uint32_t corrupted;
+    uint32_t noise_bursts;
+    uint32_t noise_bytes;
+    uint32_t commands;
+    uint32_t duplicates;        // Commands sent a second time
+    uint32_t delivered;         // Heartbeats that reached the handler
+    uint32_t latency_sum;       // ms
+    uint32_t latency_max;
+    uint32_t tx_queued;
+    uint32_t tx_rejected;
+} rs422_stress_result_t;
+
+void rs422_stress_start(const rs422_stress_config_t *cfg);
+void rs422_stress_stop(void);
+bool rs422_stress_running(void);
+void rs422_stress_get_result(rs422_stress_result_t *out);
+
+// Generator, call every ms
+void rs422_stress_poll(void);
+
+// Handler hook for received heartbeats
+void rs422_stress_on_frame(const RS422_RxFrame_t *frame);
+
+#endif // RS422_STRESS_H
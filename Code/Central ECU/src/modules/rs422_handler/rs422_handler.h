@@ -6,6 +6,8 @@
 #include "config.h"
 // #include "legacy_stager.h"
 
+#define RS422_HANDLER_MAX_FRAMES 16   // Frames handled per rx poll
+
 // Function declarations
 void rs422_handler_init(void);
 void rs422_handler_rx_poll(void);
@@ -0,0 +1,165 @@
+#include "sd_format.h"
+#include <string.h>
+#include <stdio.h>
+#include "ff_gen_drv.h"
+#include "user_diskio.h"
+#include "sd_index.h"
+#include "debug_io.h"
+
+// Boot sector / MBR offsets (see FatFs ff.c)
+#define MBR_TABLE_OFFSET    446U
+#define BPB_HIDDSEC_OFFSET  28U
+#define FAT32_BACKUP_BOOT   6U
+
+static FATFS fmt_fs;
+static BYTE work[4 * _MAX_SS];
+
+static void put_le32(BYTE *p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static FRESULT write_mbr(DWORD start, DWORD size, BYTE sys)
+{
+    memset(work, 0, _MAX_SS);
+    BYTE *pte = work + MBR_TABLE_OFFSET;
+    pte[0] = 0x00;                              // Not bootable
+    pte[1] = 0xFE; pte[2] = 0xFF; pte[3] = 0xFF; // CHS start unused, LBA only
+    pte[4] = sys;
+    pte[5] = 0xFE; pte[6] = 0xFF; pte[7] = 0xFF; // CHS end unused, LBA only
+    put_le32(pte + 8, start);
+    put_le32(pte + 12, size);
+    work[510] = 0x55;
+    work[511] = 0xAA;
+    return (disk_write(0, work, 0, 1) == RES_OK) ? FR_OK : FR_DISK_ERR;
+}
+
+// f_mkfs(FM_SFD) writes hidden sectors = 0; point them at the real partition start.
+// Sector numbers are relative to the volume window set by the caller.
+static FRESULT patch_hidden_sectors(DWORD sector, DWORD hidden)
+{
+    if (disk_read(0, work, sector, 1) != RES_OK) return FR_DISK_ERR;
+    put_le32(work + BPB_HIDDSEC_OFFSET, hidden);
+    return (disk_write(0, work, sector, 1) == RES_OK) ? FR_OK : FR_DISK_ERR;
+}
+
+static FRESULT prepare_layout(void)
+{
+    uint32_t next;
+    char dir[10];
+
+    // Fresh volume, so the index is always created from scratch here
+    (void)sd_index_open(&next);
+    if (!sd_index_reserve_table(SD_INDEX_MAX_SESSION) || !sd_index_commit_next(1)) {
+        sd_index_close();
+        return FR_DISK_ERR;
+    }
+    sd_index_close();
+
+    for (uint32_t i = 1; i <= SD_FORMAT_PRECREATE_DIRS; i++) {
+        snprintf(dir, sizeof(dir), "LOG_%04lu", i);
+        FRESULT res = f_mkdir(dir);
+        if (res != FR_OK) return res;
+    }
+    return FR_OK;
+}
+
+FRESULT sd_format_card(void)
+{
+    FRESULT res;
+    DWORD card_blocks;
+    DWORD au;
+    uint32_t start = HAL_GetTick();
+
+    USER_set_volume_window(0, 0, 0);
+    if (disk_initialize(0) & STA_NOINIT) return FR_NOT_READY;
+    if (disk_ioctl(0, GET_SECTOR_COUNT, &card_blocks) != RES_OK) return FR_DISK_ERR;
+    if (disk_ioctl(0, GET_BLOCK_SIZE, &au) != RES_OK || au <= 1) au = SD_FORMAT_DEFAULT_AU;
+
+    // The first AU only holds the MBR, like the SD Association formatter, and the
+    // partition is trimmed to a whole number of AUs
+    if (card_blocks < 4U * au) return FR_MKFS_ABORTED;
+    DWORD part_start = au;
+    DWORD part_size = ((card_blocks - part_start) / au) * au;
+    DWORD align = (au < SD_FORMAT_MAX_ALIGN) ? au : SD_FORMAT_MAX_ALIGN;
+
+    dbg_printf("SD format: %lu blocks, AU %lu blocks, partition at %lu, data aligned to %lu\r\n",
+               card_blocks, au, part_start, align);
+
+    // Format the partition as if it were the whole card, FatFs aligns the data area to
+    // the block the window reports, relative to the window start which is AU aligned.
+    // Also when the card reported no AU and the default is used.
+    USER_set_volume_window(part_start, part_size, align);
+    res = f_mkfs("", FM_FAT | FM_FAT32 | FM_SFD, SD_FORMAT_CLUSTER_BYTES, work, sizeof(work));
+    BYTE fat_type = 0;
+    if (res == FR_OK) {
+        res = f_mount(&fmt_fs, "", 1);
+        fat_type = fmt_fs.fs_type;
+        (void)f_mount(NULL, "", 0);
+    }
+    if (res == FR_OK) res = patch_hidden_sectors(0, part_start);
+    if (res == FR_OK && fat_type == FS_FAT32) res = patch_hidden_sectors(FAT32_BACKUP_BOOT, part_start);
+    USER_set_volume_window(0, 0, 0);
+    if (res != FR_OK) {
+        dbg_printf("SD format failed: %d\r\n", res);
+        return res;
+    }
+
+    res = write_mbr(part_start, part_size, (fat_type == FS_FAT32) ? 0x0C : 0x06);
+    if (res == FR_OK) res = f_mount(&fmt_fs, "", 1);
+    if (res == FR_OK) {
+        res = prepare_layout();
+        (void)f_mount(NULL, "", 0);
+    }
+
+    dbg_printf("SD format %s (%d), FAT%s, %lu KiB clusters, %lu ms\r\n",
+               res == FR_OK ? "done" : "failed", res, fat_type == FS_FAT32 ? "32" : "16",
+               SD_FORMAT_CLUSTER_BYTES / 1024U, HAL_GetTick() - start);
+    return res;
+}
+
+FRESULT sd_format_benchmark(uint32_t size_kb)
+{
+    FIL file;
+    UINT bw;
+    FRESULT res;
+
+    res = f_mount(&fmt_fs, "", 1);
+    if (res != FR_OK) return res;
+
+    res = f_open(&file, "BENCH.BIN", FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        (void)f_mount(NULL, "", 0);
+        return res;
+    }
+
+    memset(work, 0xA5, sizeof(work));
+    uint32_t total = size_kb * 1024U;
+    uint32_t written = 0;
+    uint32_t worst = 0;
+    uint32_t start = HAL_GetTick();
+
+    while (written < total && res == FR_OK) {
+        uint32_t t0 = HAL_GetTick();
+        res = f_write(&file, work, sizeof(work), &bw);
+        if (res == FR_OK && bw != sizeof(work)) res = FR_DENIED; // Card full
+        written += bw;
+        uint32_t dt = HAL_GetTick() - t0;
+        if (dt > worst) worst = dt;
+    }
+    if (res == FR_OK) res = f_sync(&file);
+    uint32_t elapsed = HAL_GetTick() - start;
+
+    (void)f_close(&file);
+    (void)f_unlink("BENCH.BIN");
+    (void)f_mount(NULL, "", 0);
+
+    if (elapsed == 0) elapsed = 1;
+    dbg_printf("SD bench: %lu KiB in %lu ms = %lu KiB/s, worst %u B write %lu ms (%d)\r\n",
+               written / 1024U, elapsed, written / elapsed * 1000U / 1024U,
+               (unsigned)sizeof(work), worst, res);
+    return res;
+}
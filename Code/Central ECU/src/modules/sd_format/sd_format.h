@@ -0,0 +1,33 @@
+#ifndef SD_FORMAT_H
+#define SD_FORMAT_H
+
+#include "stm32g0xx_hal.h"
+#include "ff.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cluster size for the log volume. Large clusters keep FAT updates rare during long
+// sequential writes; 32 KiB matches what the SD Association formatter uses for SDHC.
+#define SD_FORMAT_CLUSTER_BYTES     32768UL
+
+// Allocation unit used when the card does not report one (4 MiB, typical for SDHC)
+#define SD_FORMAT_DEFAULT_AU        8192UL
+
+// Largest data area alignment f_mkfs can give (16 MiB). It pads the FAT (FAT16) or the
+// reserved sectors (FAT32) up to the boundary, both 16 bit fields, so the 32 and 64 MiB
+// AUs of SDXC cards get 16 MiB; the partition itself still starts on their AU boundary.
+#define SD_FORMAT_MAX_ALIGN         32768UL
+
+// Session directories created up front so their entries sit ahead of the log data
+#define SD_FORMAT_PRECREATE_DIRS    16U
+
+// Repartition and format the card: a single FAT partition starting on an allocation unit
+// boundary with the data area aligned to the AU (at most SD_FORMAT_MAX_ALIGN), then create the log index and the first
+// session directories. Erases the whole card. sd_log must be shut down first.
+FRESULT sd_format_card(void);
+
+// Write size_kb of data to a scratch file and print the sustained throughput.
+// Blocks the caller for the duration; sd_log must be shut down first.
+FRESULT sd_format_benchmark(uint32_t size_kb);
+
+#endif // SD_FORMAT_H
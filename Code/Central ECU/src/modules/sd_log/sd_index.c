@@ -0,0 +1,146 @@
+#include "sd_index.h"
+#include <stddef.h>
+#include <string.h>
+#include "crc.h"
+#include "debug_io.h"
+
+static FIL index_file;
+static bool index_open = false;
+static uint32_t header_generation = 0;
+static uint8_t header_slot = 0;     // Slot holding the latest valid header
+
+static uint16_t header_crc(const sd_index_header_t *hdr)
+{
+    return crc16_compute((const uint8_t*)hdr, offsetof(sd_index_header_t, crc));
+}
+
+static uint16_t record_crc(const sd_index_session_t *rec)
+{
+    return crc16_compute((const uint8_t*)rec, offsetof(sd_index_session_t, crc));
+}
+
+static bool read_at(FSIZE_t offset, void *dst, UINT len)
+{
+    UINT br;
+    if (f_lseek(&index_file, offset) != FR_OK) return false;
+    if (f_read(&index_file, dst, len, &br) != FR_OK) return false;
+    return br == len;
+}
+
+static bool write_at(FSIZE_t offset, const void *src, UINT len)
+{
+    UINT bw;
+    if (f_lseek(&index_file, offset) != FR_OK) return false;
+    if (f_write(&index_file, src, len, &bw) != FR_OK || bw != len) return false;
+    return f_sync(&index_file) == FR_OK;
+}
+
+static bool header_valid(const sd_index_header_t *hdr)
+{
+    return hdr->magic == SD_INDEX_MAGIC
+        && hdr->version == SD_INDEX_VERSION
+        && hdr->record_size == SD_INDEX_RECORD_SIZE
+        && hdr->crc == header_crc(hdr);
+}
+
+bool sd_index_open(uint32_t *next_session)
+{
+    sd_index_header_t slots[2];
+    bool valid[2] = {false, false};
+
+    index_open = false;
+    header_generation = 0;
+    header_slot = 1;    // So the first commit lands in slot A
+
+    if (f_open(&index_file, SD_INDEX_FILENAME, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK) {
+        dbg_printf("SD: Unable to open %s\n", SD_INDEX_FILENAME);
+        return false;
+    }
+    index_open = true;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        if (f_size(&index_file) >= (FSIZE_t)(i + 1) * SD_INDEX_SLOT_SIZE) {
+            valid[i] = read_at((FSIZE_t)i * SD_INDEX_SLOT_SIZE, &slots[i], sizeof(slots[i]))
+                    && header_valid(&slots[i]);
+        }
+    }
+
+    if (!valid[0] && !valid[1]) return false;
+
+    // Pick the newest valid slot (generation wraps are not a concern at one commit per boot)
+    uint8_t best;
+    if (valid[0] && valid[1]) {
+        best = (slots[1].generation > slots[0].generation) ? 1 : 0;
+    } else {
+        best = valid[0] ? 0 : 1;
+    }
+
+    header_slot = best;
+    header_generation = slots[best].generation;
+    *next_session = slots[best].next_session;
+    return true;
+}
+
+void sd_index_close(void)
+{
+    if (!index_open) return;
+    (void)f_close(&index_file);
+    index_open = false;
+}
+
+bool sd_index_reserve_table(uint32_t max_session)
+{
+    if (!index_open || max_session > SD_INDEX_MAX_SESSION) return false;
+
+    // Seeking past the end in write mode allocates the clusters without writing them
+    FSIZE_t end = SD_INDEX_TABLE_OFFSET + (FSIZE_t)(max_session + 1U) * SD_INDEX_RECORD_SIZE;
+    if (f_size(&index_file) >= end) return true;
+    if (f_lseek(&index_file, end) != FR_OK || f_tell(&index_file) != end) return false;
+    return f_sync(&index_file) == FR_OK;
+}
+
+bool sd_index_commit_next(uint32_t next_session)
+{
+    if (!index_open) return false;
+
+    sd_index_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SD_INDEX_MAGIC;
+    hdr.version = SD_INDEX_VERSION;
+    hdr.record_size = SD_INDEX_RECORD_SIZE;
+    hdr.generation = header_generation + 1;
+    hdr.next_session = next_session;
+    hdr.crc = header_crc(&hdr);
+
+    // Always overwrite the older slot so the current one survives a torn write
+    uint8_t slot = header_slot ^ 1U;
+    if (!write_at((FSIZE_t)slot * SD_INDEX_SLOT_SIZE, &hdr, sizeof(hdr))) {
+        return false;
+    }
+
+    header_slot = slot;
+    header_generation = hdr.generation;
+    return true;
+}
+
+bool sd_index_read_session(uint32_t session, sd_index_session_t *rec)
+{
+    if (!index_open || session == 0 || session > SD_INDEX_MAX_SESSION) return false;
+
+    FSIZE_t offset = SD_INDEX_TABLE_OFFSET + (FSIZE_t)session * SD_INDEX_RECORD_SIZE;
+    if (offset + SD_INDEX_RECORD_SIZE > f_size(&index_file)) return false;
+    if (!read_at(offset, rec, sizeof(*rec))) return false;
+
+    return rec->session == session
+        && rec->status != SD_SESSION_EMPTY
+        && rec->crc == record_crc(rec);
+}
+
+bool sd_index_write_session(sd_index_session_t *rec)
+{
+    if (!index_open || rec->session == 0 || rec->session > SD_INDEX_MAX_SESSION) return false;
+
+    rec->crc = record_crc(rec);
+    FSIZE_t offset = SD_INDEX_TABLE_OFFSET + (FSIZE_t)rec->session * SD_INDEX_RECORD_SIZE;
+    return write_at(offset, rec, sizeof(*rec));
+}
@@ -0,0 +1,75 @@
+#ifndef SD_INDEX_H
+#define SD_INDEX_H
+
+#include "stm32g0xx_hal.h"
+#include "ff.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Session index kept in the card root so boot does not have to walk every LOG_xxxx directory.
+//
+// File layout (LOGINDEX.BIN):
+//   0x000  header slot A (one sector)
+//   0x200  header slot B (one sector)
+//   0x400  session table, SD_INDEX_RECORD_SIZE bytes per session, indexed by session number
+//
+// The header is written alternately to slot A and B with an increasing generation, so a
+// torn write only ever damages the slot that was not the latest valid one. Each session
+// record is CRC protected on its own and occupies a single sector, so it is either the old
+// or the new version after a power cut.
+
+#define SD_INDEX_FILENAME       "LOGINDEX.BIN"
+#define SD_INDEX_MAGIC          0x58444E49UL  // "INDX"
+#define SD_INDEX_VERSION        1U
+#define SD_INDEX_SLOT_SIZE      512U
+#define SD_INDEX_TABLE_OFFSET   (2U * SD_INDEX_SLOT_SIZE)
+#define SD_INDEX_RECORD_SIZE    32U
+#define SD_INDEX_MAX_SESSION    9999U         // LOG_%04lu with 8.3 names
+
+typedef enum {
+    SD_SESSION_EMPTY = 0,
+    SD_SESSION_ACTIVE = 1,      // Session was running when the record was last updated
+    SD_SESSION_ENDED = 2        // A later boot found the session still ACTIVE (power removed)
+} sd_session_status_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t generation;        // Highest valid generation wins
+    uint32_t next_session;      // Next LOG_xxxx number to hand out
+    uint16_t crc;
+} sd_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t session;
+    uint32_t start_time;        // FAT packed date/time (get_fattime)
+    uint32_t last_time;         // FAT packed date/time of the last record update
+    uint32_t log_bytes;
+    uint32_t sens_bytes;
+    uint8_t  status;            // sd_session_status_t
+    uint8_t  fsm_state;         // Last main FSM state seen
+    uint8_t  error_code;        // Last FSM error code seen
+    uint8_t  reserved[7];
+    uint16_t crc;
+} sd_index_session_t;
+
+// Open (or create) the index file. Returns true and the next session number if a valid
+// header was found, false if the index is missing or corrupt (caller should fall back to
+// scanning the card and then call sd_index_commit_next()).
+bool sd_index_open(uint32_t *next_session);
+
+// Close the index file (before unmounting or formatting)
+void sd_index_close(void);
+
+// Allocate the session table up to max_session so it is contiguous on a fresh card
+bool sd_index_reserve_table(uint32_t max_session);
+
+// Atomically record the next session number to hand out
+bool sd_index_commit_next(uint32_t next_session);
+
+// Read / write a single session record. Reads fail on an empty slot or bad CRC.
+bool sd_index_read_session(uint32_t session, sd_index_session_t *rec);
+bool sd_index_write_session(sd_index_session_t *rec);
+
+#endif // SD_INDEX_H
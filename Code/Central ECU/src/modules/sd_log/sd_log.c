@@ -7,17 +7,51 @@
 #include "sdcard.h"
 #include "rs422.h"
 #include "error_def.h"
+#include "sd_index.h"
+#include "main_FSM.h"
+#include "cycle_count.h"
+#if SD_LOG_COMPRESS
+#include "sd_lz.h"
+#endif
 
 // File system objects
 static FATFS fs;
-static FIL log_file;        // log.txt (text)
-static FIL sensors_file;    // sensors.raw (binary multiplexed sensor packets)
+static FIL log_file;        // SD_LOG_TEXT_FILE (text)
+static FIL sensors_file;    // SD_LOG_SENS_FILE (binary multiplexed sensor packets)
+static FIL sens_index_file; // SD_LOG_SENS_INDEX_FILE (one sd_log_block_index_t per sensor block)
+
+// file_bit() of each file that is open, and of each with a failed write since it was opened
+static uint8_t files_open = 0;
+static uint8_t files_failed = 0;
+
+static uint8_t file_bit(const FIL *file)
+{
+    if (file == &log_file) return 1U << 0;
+    if (file == &sensors_file) return 1U << 1;
+    return 1U << 2;
+}
 
 // Current directory name
 static char current_dir[10];
 static bool is_initialized = false;
 static uint32_t dir_counter = 1;  // Counter for sequential directory numbering
 
+// Session record for this boot, refreshed periodically from sd_log_service
+static sd_index_session_t session_rec;
+static bool session_indexed = false;
+static uint32_t last_index_update = 0;
+
+// Arguments of the last sd_log_init, for sd_log_restart
+static uint8_t init_log_mb = 0;
+static uint8_t init_sens_mb = 0;
+
+#ifndef SD_LOG_INDEX_UPDATE_MS
+#define SD_LOG_INDEX_UPDATE_MS 10000U
+#endif
+
+// How many numbers to skip past a stale index before giving up and scanning
+#define SD_LOG_INDEX_MAX_PROBE 16U
+
 // Buffer for formatted messages
 static char msg_buffer[SD_LOG_MAX_MSG_LEN];
 
@@ -35,6 +69,8 @@ static char dbg_ring[SD_LOG_DEBUG_BUF_SIZE];
 static uint8_t sens_ring[SD_LOG_SENS_BUF_SIZE];
 static volatile uint16_t sens_head = 0;
 static volatile uint16_t sens_tail = 0;
+static uint32_t sens_dropped_records[32];  // Per sensor ID
+static uint32_t sens_dropped_gap_frames[32];
 
 // Flush control flags/state
 static volatile bool flush_logs_requested = false;
@@ -42,10 +78,33 @@ static volatile bool flush_sensors_requested = false;
 static bool flush_logs_in_progress = false;
 static bool flush_sensors_in_progress = false;
 
+// Health counters, see sd_log_get_stats()
+static sd_log_stats_t stats;
+static bool write_failing = false;
+static uint32_t write_fail_start = 0;
+static uint32_t last_reopen_attempt = 0;
+
+// First record timestamp of the last indexed sensor block, for blocks that contain no
+// record start of their own
+static uint32_t sens_index_last_ts = 0;
+
+#ifndef SD_LOG_REOPEN_INTERVAL_MS
+#define SD_LOG_REOPEN_INTERVAL_MS 1000U
+#endif
+
 #ifndef SD_LOG_WRITE_CHUNK
 #define SD_LOG_WRITE_CHUNK 256U
 #endif
 
+// With compression the rings are drained in whole LZ blocks, otherwise in plain chunks
+#if SD_LOG_COMPRESS
+#define SD_LOG_FLUSH_BLOCK SD_LZ_BLOCK_SIZE
+static uint8_t lz_out[SD_LZ_FRAME_MAX];
+#else
+#define SD_LOG_FLUSH_BLOCK SD_LOG_WRITE_CHUNK
+#endif
+static uint8_t flush_buf[SD_LOG_FLUSH_BLOCK];
+
 #ifndef MIN
 #define MIN(a,b) (( (a) < (b) ) ? (a) : (b))
 #endif
@@ -68,11 +127,18 @@ static inline void dbg_ring_push_char(char c)
     uint16_t next = dbg_ring_next(dbg_ring_head);
     if(next == dbg_ring_tail) { // overflow drop oldest
         dbg_ring_tail = dbg_ring_next(dbg_ring_tail);
+        stats.dbg_dropped++;
     }
     dbg_ring[dbg_ring_head] = c;
     dbg_ring_head = next;
 }
 
+static inline void dbg_ring_note_level(void)
+{
+    uint16_t used = (uint16_t)((dbg_ring_head + SD_LOG_DEBUG_BUF_SIZE - dbg_ring_tail) % SD_LOG_DEBUG_BUF_SIZE);
+    if (used > stats.dbg_high_water) stats.dbg_high_water = used;
+}
+
 static inline uint16_t dbg_ring_pop_chunk(char *dst, uint16_t max_len)
 {
     if(dbg_ring_empty()) return 0;
@@ -109,16 +175,49 @@ static inline uint16_t sens_space(void)
     return (uint16_t)(SD_LOG_SENS_BUF_SIZE - sens_used() - 1U);
 } 
 
-static void sens_push(const uint8_t *data, uint16_t len)
+static inline uint8_t sens_at(uint16_t offset)
 {
-    // Ensure space (drop oldest data if necessary to guarantee forward progress)
-    if (sens_space() < len) {
-        uint16_t to_free = (uint16_t)(len - sens_space());
-        dbg_printf("!!WARN!! - Dropping %u bytes from sensor ring buffer\n", to_free);
-        uint8_t who = CAN_ERROR_ACTION_WARNING << 6 | BOARD_ID_ECU;
-        rs422_send_error_warning(who, ECU_ERROR_SD_DATA_WRITE_FAIL);
-        sens_tail = (uint16_t)((sens_tail + to_free) % SD_LOG_SENS_BUF_SIZE);
+    return sens_ring[(sens_tail + offset) % SD_LOG_SENS_BUF_SIZE];
+}
+
+// Drop oldest data until len bytes fit, to guarantee forward progress. Whole records go,
+// so the file never holds a cut-off record from the drop. The tail is a record start
+// (flushes take whole records), so the records are walked by their lengths as in
+// sens_whole_records() rather than searched for, sample data can look like a marker.
+static void sens_make_room(uint16_t len)
+{
+    if (sens_space() >= len) return;
+    uint16_t need = (uint16_t)(len - sens_space());
+    uint16_t used = sens_used();
+    uint32_t cut = 0;
+    while (cut < need) {
+        if (cut + 7U > used) { // Cannot happen with whole records in the ring, drop the rest
+            cut = used;
+            break;
+        }
+        uint8_t id = sens_at((uint16_t)(cut + 5U)) >> 3;
+        if (sens_at((uint16_t)(cut + 4U)) == SD_LOG_SENS_GAP) {
+            // The frames a gap record stood for are off the card again, sensor_seq relogs them
+            sens_dropped_gap_frames[id] += sens_at((uint16_t)(cut + 10U)) | (uint32_t)sens_at((uint16_t)(cut + 11U)) << 8;
+            cut += 13U;
+        } else {
+            sens_dropped_records[id]++;
+            stats.sens_records_dropped++;
+            cut += 10U + sens_at((uint16_t)(cut + 6U));
+        }
     }
+    if (cut > used) cut = used;
+
+    dbg_printf("!!WARN!! - Dropping %u bytes from sensor ring buffer\n", cut);
+    uint8_t who = CAN_ERROR_ACTION_WARNING << 6 | BOARD_ID_ECU;
+    rs422_send_error_warning(who, ECU_ERROR_SD_DATA_WRITE_FAIL);
+    sens_tail = (uint16_t)((sens_tail + cut) % SD_LOG_SENS_BUF_SIZE);
+    stats.sens_dropped += cut;
+}
+
+static void sens_push(const uint8_t *data, uint16_t len)
+{
+    sens_make_room(len);
 
     uint16_t first = (uint16_t)MIN(len, (uint16_t)(SD_LOG_SENS_BUF_SIZE - sens_head));
     memcpy(&sens_ring[sens_head], data, first);
@@ -127,26 +226,36 @@ static void sens_push(const uint8_t *data, uint16_t len)
     if(rem) memcpy(&sens_ring[0], data + first, rem);
 
     sens_head = (uint16_t)((sens_head + len) % SD_LOG_SENS_BUF_SIZE);
+
+    uint16_t used = sens_used();
+    if (used > stats.sens_high_water) stats.sens_high_water = used;
 }
 
+// Copy up to max_len bytes from the tail without consuming them, across the wrap
 static uint16_t sens_peek(uint8_t *dst, uint16_t max_len)
 {
-    if(sens_empty()) return 0;
-
-    if(sens_head >= sens_tail) {
-        uint16_t avail = (uint16_t)(sens_head - sens_tail);
-        if(avail > max_len) avail = max_len;
-        memcpy(dst, &sens_ring[sens_tail], avail);
-        return avail;
+    uint16_t avail = sens_used();
+    if(avail > max_len) avail = max_len;
 
-    } else {
-        uint16_t to_end = (uint16_t)(SD_LOG_SENS_BUF_SIZE - sens_tail);
-        if(to_end > max_len) to_end = max_len;
-        memcpy(dst, &sens_ring[sens_tail], to_end);
-        return to_end;
+    uint16_t first = (uint16_t)MIN(avail, (uint16_t)(SD_LOG_SENS_BUF_SIZE - sens_tail));
+    memcpy(dst, &sens_ring[sens_tail], first);
+    if(avail > first) memcpy(dst + first, &sens_ring[0], avail - first);
+    return avail;
+}
 
+// Length of the whole records at the start of a peeked block. Ones cut off by the end of the
+// block stay in the ring for the next, so a drop never leaves half a record on the card.
+static uint16_t sens_whole_records(const uint8_t *data, uint16_t len)
+{
+    uint16_t end = 0;
+    while ((uint32_t)end + 7U <= len) {
+        uint16_t size = data[end + 4U] == SD_LOG_SENS_GAP ? 13U : (uint16_t)(10U + data[end + 6U]);
+        if ((uint32_t)end + size > len) break;
+        end = (uint16_t)(end + size);
     }
+    return end ? end : len;
 }
+
 static void sens_consume(uint16_t n)
 {
     sens_tail = (uint16_t)((sens_tail + n) % SD_LOG_SENS_BUF_SIZE);
@@ -212,8 +321,77 @@ static bool open_file_path(FIL* file, const char* path, BYTE mode) {
     return res == FR_OK;
 }
 
+// Mark the previous session as ended if it never got a final update
+static void close_previous_session(uint32_t session) {
+    sd_index_session_t prev;
+    if (!sd_index_read_session(session, &prev)) return;
+    if (prev.status != SD_SESSION_ACTIVE) return;
+    prev.status = SD_SESSION_ENDED;
+    (void)sd_index_write_session(&prev);
+}
+
+// Directories created ahead of time by sd_format are empty and can be taken over
+static bool dir_is_empty(const char *path) {
+    DIR dir;
+    FILINFO fno;
+    if (f_opendir(&dir, path) != FR_OK) return false;
+    FRESULT res = f_readdir(&dir, &fno);
+    f_closedir(&dir);
+    return res == FR_OK && fno.fname[0] == 0;
+}
+
+// Pick the session number for this boot and create its directory. The next number is
+// committed to the index before the directory exists, so a crash in between can only
+// skip a number, never hand the same one out twice.
+static bool reserve_session(void) {
+    FRESULT res;
+    uint32_t next = 0;
+
+    bool indexed = sd_index_open(&next);
+    if (!indexed || next == 0 || next > SD_INDEX_MAX_SESSION) {
+        dbg_printf("SD: Log index missing or corrupt, scanning card\n");
+        next = find_highest_log_number() + 1;
+    } else {
+        close_previous_session(next - 1);
+    }
+
+    uint32_t session = next;
+    res = FR_EXIST;
+    for (uint8_t attempt = 0; attempt < SD_LOG_INDEX_MAX_PROBE && res == FR_EXIST; attempt++) {
+        if (attempt == SD_LOG_INDEX_MAX_PROBE - 1U) {
+            // Index is well behind the card contents (e.g. card edited on a PC)
+            next = find_highest_log_number() + 1;
+        }
+        session = next++;
+        session_indexed = sd_index_commit_next(next);
+        dir_counter = session;
+        generate_dir_name();
+
+        res = f_mkdir(current_dir);
+        if (res == FR_EXIST && dir_is_empty(current_dir)) res = FR_OK;
+        if (res != FR_OK && res != FR_EXIST) return false;
+    }
+    if (res == FR_EXIST) {
+        dbg_printf("SD: Reusing existing %s\n", current_dir);
+    }
+
+    memset(&session_rec, 0, sizeof(session_rec));
+    session_rec.session = session;
+    session_rec.start_time = get_fattime();
+    session_rec.last_time = session_rec.start_time;
+    session_rec.status = SD_SESSION_ACTIVE;
+    if (session_indexed) {
+        session_indexed = sd_index_write_session(&session_rec);
+    }
+    last_index_update = HAL_GetTick();
+    return true;
+}
+
 bool sd_log_init(uint8_t log_mb, uint8_t sens_mb) {
     FRESULT res;
+
+    init_log_mb = log_mb;
+    init_sens_mb = sens_mb;
     
     // Mount the file system
     res = f_mount(&fs, "", 1);
@@ -222,25 +400,27 @@ bool sd_log_init(uint8_t log_mb, uint8_t sens_mb) {
         return false;
     }
     
-    // Find the highest existing log number and set our counter
-    dir_counter = find_highest_log_number() + 1;
-    
-    // Generate unique directory name
-    generate_dir_name();
-    
-    // Create directory
-    res = f_mkdir(current_dir);
-    if (res != FR_OK && res != FR_EXIST) {
+    if (!reserve_session()) {
         return false;
     }
     
-    // Create log.txt and sensors.raw
-    if (!open_file(&log_file, "log.txt", FA_CREATE_ALWAYS | FA_WRITE)) {
+    cycle_count_init();
+
+    // Create the text and sensor log files
+    if (!open_file(&log_file, SD_LOG_TEXT_FILE, FA_CREATE_ALWAYS | FA_WRITE)) {
+        return false;
+    }
+    // Readable as well so sd_replay can read back the running session, FatFs will not
+    // open a file a second time while it is open for writing
+    if (!open_file(&sensors_file, SD_LOG_SENS_FILE, FA_CREATE_ALWAYS | FA_WRITE | FA_READ)) {
         return false;
     }
-    if (!open_file(&sensors_file, "sensors.raw", FA_CREATE_ALWAYS | FA_WRITE)) {
+    if (!open_file(&sens_index_file, SD_LOG_SENS_INDEX_FILE, FA_CREATE_ALWAYS | FA_WRITE | FA_READ)) {
         return false;
     }
+    files_open = file_bit(&log_file) | file_bit(&sensors_file) | file_bit(&sens_index_file);
+    files_failed = 0;
+    sens_index_last_ts = 0;
 
     // Preallocate log_mb to log.txt and sens_mb to sensors.raw using sd_preallocate_extra
     sd_preallocate_extra(&log_file, log_mb * 1024 * 1024);
@@ -283,6 +463,7 @@ bool sd_log_write(SD_LogType_t type, const char* format, ...) {
     // Enqueue into debug ring
     const char *p = msg_buffer;
     while (*p) dbg_ring_push_char(*p++);
+    dbg_ring_note_level();
     flush_logs_requested = true;
     return true;
 }
@@ -298,24 +479,122 @@ void sd_log_request_flush_sensors(void)
     flush_sensors_requested = true;
 }
 
+// Track failing writes so the time from the first error to the next good write is known.
+// A good write only counts once every failed file has been reopened: the other files can
+// keep taking writes into their FatFs buffers while the card is still gone.
+static void note_write_result(FIL *file, bool ok)
+{
+    if (!ok) {
+        files_failed |= file_bit(file);
+        stats.write_errors++;
+        if (!write_failing) {
+            write_failing = true;
+            write_fail_start = HAL_GetTick();
+            last_reopen_attempt = write_fail_start;
+        }
+        return;
+    }
+    if (write_failing && files_failed == 0) {
+        write_failing = false;
+        stats.last_recovery_ms = HAL_GetTick() - write_fail_start;
+        if (stats.last_recovery_ms > stats.max_recovery_ms) stats.max_recovery_ms = stats.last_recovery_ms;
+        stats.recoveries++;
+    }
+}
+
+// FatFs latches a hard error in the FIL object, so after a failed write the file has to be
+// reopened before any further write can succeed. f_close retries the pending sync and
+// releases the file lock; if the card is still failing we try again next interval.
+static void reopen_file(FIL *file, const char *filename)
+{
+    uint8_t bit = file_bit(file);
+    if ((files_failed & bit) == 0) return;
+    if (files_open & bit) {
+        if (f_close(file) != FR_OK) return;
+        files_open &= (uint8_t)~bit;
+    }
+    if (open_file(file, filename, FA_OPEN_APPEND | FA_WRITE | FA_READ)) {
+        files_open |= bit;
+        files_failed &= (uint8_t)~bit;
+    }
+}
+
+static void reopen_failed_files(void)
+{
+    if (files_failed == 0) return;
+    if ((HAL_GetTick() - last_reopen_attempt) < SD_LOG_REOPEN_INTERVAL_MS) return;
+    last_reopen_attempt = HAL_GetTick();
+
+    reopen_file(&log_file, SD_LOG_TEXT_FILE);
+    reopen_file(&sensors_file, SD_LOG_SENS_FILE);
+    reopen_file(&sens_index_file, SD_LOG_SENS_INDEX_FILE);
+}
+
+// Write one block of ring data to the card, as an LZ block when SD_LOG_COMPRESS is set.
+// Returns the bytes written to the card, 0 on failure.
+static uint16_t write_block(FIL *file, const uint8_t *data, uint16_t len)
+{
+    UINT written;
+    stats.raw_bytes += len;
+#if SD_LOG_COMPRESS
+    uint32_t t0 = cycle_count_now();
+    len = sd_lz_frame(data, len, lz_out);
+    stats.compress_cycles += cycle_count_since(t0);
+    data = lz_out;
+#endif
+    FRESULT res = f_write(file, data, len, &written);
+    stats.card_bytes += written;
+    bool ok = (res == FR_OK && written == len);
+    note_write_result(file, ok);
+    return ok ? len : 0;
+}
+
+// Timestamp of the first sensor record that starts inside a block
+static bool sens_block_first_ts(const uint8_t *data, uint16_t len, uint32_t *ts)
+{
+    // [00 00 00 00 A1][what][length][timestamp BE24]
+    for (uint16_t i = 0; i + 10U <= len; i++) {
+        if (data[i + 4] == SD_LOG_SENS_RECORD && data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 0 && data[i + 3] == 0) {
+            *ts = ((uint32_t)data[i + 7] << 16) | ((uint32_t)data[i + 8] << 8) | data[i + 9];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Record where a sensor block landed so replay can seek by time without a scan
+static void index_sensor_block(uint32_t offset, uint16_t card_len, const uint8_t *raw, uint16_t raw_len)
+{
+    sd_log_block_index_t entry;
+    UINT written;
+    // A block in the middle of one long record keeps the previous block's time
+    (void)sens_block_first_ts(raw, raw_len, &sens_index_last_ts);
+    entry.offset = offset;
+    entry.first_ts = sens_index_last_ts;
+    entry.length = card_len;
+    entry.raw_len = raw_len;
+    FRESULT res = f_write(&sens_index_file, &entry, sizeof(entry), &written);
+    note_write_result(&sens_index_file, res == FR_OK && written == sizeof(entry));
+}
+
 static bool flush_logs_step(uint32_t *budget_ms)
 {
     if (!flush_logs_requested && !flush_logs_in_progress) return true;
 
     flush_logs_in_progress = true;
     uint32_t start = HAL_GetTick();
-    char chunk[SD_LOG_WRITE_CHUNK];
-    UINT written;
 
     while (*budget_ms > 0 && !dbg_ring_empty()) {
-        uint16_t n = dbg_ring_pop_chunk(chunk, sizeof(chunk));
+        uint16_t n = dbg_ring_pop_chunk((char*)flush_buf, sizeof(flush_buf));
+        // Top up from the start of the ring if the data wrapped
+        n += dbg_ring_pop_chunk((char*)flush_buf + n, (uint16_t)(sizeof(flush_buf) - n));
         if(n == 0) break;
-        (void)f_write(&log_file, chunk, n, &written); // ignore errors
+        write_block(&log_file, flush_buf, n);
         if((HAL_GetTick() - start) >= *budget_ms) break;
     }
 
     if(dbg_ring_empty()) {
-        (void)f_sync(&log_file);
+        note_write_result(&log_file, f_sync(&log_file) == FR_OK);
         flush_logs_requested = false;
         flush_logs_in_progress = false;
     }
@@ -330,17 +609,19 @@ static bool flush_sensors_step(uint32_t *budget_ms){
     if(!flush_sensors_requested && !flush_sensors_in_progress) return true;
     flush_sensors_in_progress = true;
     uint32_t start = HAL_GetTick();
-    uint8_t chunk[SD_LOG_WRITE_CHUNK];
-    UINT written;
     while(*budget_ms > 0 && !sens_empty()){
-        uint16_t n = sens_peek(chunk, sizeof(chunk));
+        uint16_t n = sens_peek(flush_buf, sizeof(flush_buf));
         if(n == 0) break;
-        (void)f_write(&sensors_file, chunk, n, &written); // ignore errors
+        n = sens_whole_records(flush_buf, n);
+        uint32_t offset = (uint32_t)f_tell(&sensors_file);
+        uint16_t card_len = write_block(&sensors_file, flush_buf, n);
+        if(card_len) index_sensor_block(offset, card_len, flush_buf, n);
         sens_consume(n);
         if((HAL_GetTick() - start) >= *budget_ms) break;
     }
     if(sens_empty()){
-        (void)f_sync(&sensors_file);
+        note_write_result(&sensors_file, f_sync(&sensors_file) == FR_OK);
+        note_write_result(&sens_index_file, f_sync(&sens_index_file) == FR_OK);
         flush_sensors_requested = false;
         flush_sensors_in_progress = false;
     }
@@ -349,11 +630,31 @@ static bool flush_sensors_step(uint32_t *budget_ms){
     return !flush_sensors_in_progress;
 }
 
+static void update_session_record(void){
+    session_rec.last_time = get_fattime();
+    session_rec.log_bytes = (uint32_t)f_tell(&log_file);
+    session_rec.sens_bytes = (uint32_t)f_tell(&sensors_file);
+    session_rec.fsm_state = (uint8_t)fsm_get_state();
+    session_rec.error_code = fsm_get_error_code();
+    if (!sd_index_write_session(&session_rec)) {
+        dbg_printf("SD: Failed to update log index\n");
+        session_indexed = false;
+    }
+}
+
 bool sd_log_service(uint32_t time_budget_ms){
     if(!is_initialized) return true;
+    uint32_t start = HAL_GetTick();
+    reopen_failed_files();
     // Simple ordering: logs then sensors
     (void)flush_logs_step(&time_budget_ms);
     if(time_budget_ms > 0) (void)flush_sensors_step(&time_budget_ms);
+    if(session_indexed && time_budget_ms > 0 && (HAL_GetTick() - last_index_update) >= SD_LOG_INDEX_UPDATE_MS){
+        last_index_update = HAL_GetTick();
+        update_session_record();
+    }
+    uint32_t elapsed = HAL_GetTick() - start;
+    if(elapsed > stats.max_service_ms) stats.max_service_ms = elapsed;
     return !(flush_logs_in_progress || flush_sensors_in_progress);
 }
 
@@ -410,20 +711,120 @@ const char* sd_log_get_dir_name(void) {
     return current_dir;
 }
 
+uint32_t sd_log_get_session_number(void) {
+    return session_rec.session;
+}
+
+bool sd_log_read_back(sd_log_read_t which, uint32_t offset, void *dst, uint32_t len, uint32_t *got) {
+    FIL *file = (which == SD_LOG_READ_SENS_INDEX) ? &sens_index_file : &sensors_file;
+    UINT n = 0;
+    *got = 0;
+    if (!is_initialized || (files_open & file_bit(file)) == 0) return false;
+
+    // The writer's own handle, so the position has to be put back for the next flush
+    FSIZE_t pos = f_tell(file);
+    if (offset >= pos) return true; // Only what has been written so far
+    if (len > pos - offset) len = (uint32_t)(pos - offset);
+    bool ok = f_lseek(file, offset) == FR_OK && f_read(file, dst, len, &n) == FR_OK;
+    ok = (f_lseek(file, pos) == FR_OK) && ok;
+    *got = n;
+    return ok;
+}
+
+uint32_t sd_log_sens_index_entries(void) {
+    if (!is_initialized || (files_open & file_bit(&sens_index_file)) == 0) return 0;
+    return (uint32_t)(f_tell(&sens_index_file) / sizeof(sd_log_block_index_t));
+}
+
+void sd_log_shutdown(void) {
+    if (!is_initialized) return;
+
+    (void)sd_log_flush_blocking(1000);
+    if (session_indexed) update_session_record();
+    is_initialized = false;
+    session_indexed = false;
+
+    (void)f_close(&log_file);
+    (void)f_close(&sensors_file);
+    (void)f_close(&sens_index_file);
+    files_open = 0;
+    sd_index_close();
+    (void)f_mount(NULL, "", 0);
+}
+
+bool sd_log_restart(void) {
+    sd_log_shutdown();
+    write_failing = false;
+    return sd_log_init(init_log_mb, init_sens_mb);
+}
+
+void sd_log_get_stats(sd_log_stats_t *out) {
+    *out = stats;
+}
+
+void sd_log_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void sd_log_print_stats(void) {
+    dbg_printf("SD log: dbg drop %lu hw %u/%u, sens drop %lu (%lu records) hw %u/%u\r\n",
+               stats.dbg_dropped, stats.dbg_high_water, SD_LOG_DEBUG_BUF_SIZE,
+               stats.sens_dropped, stats.sens_records_dropped, stats.sens_high_water, SD_LOG_SENS_BUF_SIZE);
+    dbg_printf("        write err %lu, recoveries %lu (last %lums, max %lums), max service %lums%s\r\n",
+               stats.write_errors, stats.recoveries, stats.last_recovery_ms, stats.max_recovery_ms,
+               stats.max_service_ms, write_failing ? ", FAILING" : "");
+    uint32_t raw = stats.raw_bytes ? stats.raw_bytes : 1U;
+    dbg_printf("        %lu bytes in, %lu to card (%lu%%)", stats.raw_bytes, stats.card_bytes,
+               (uint32_t)((uint64_t)stats.card_bytes * 100U / raw));
+#if SD_LOG_COMPRESS
+    dbg_printf(", LZ %lu cycles/byte", (uint32_t)(stats.compress_cycles / raw));
+#endif
+    dbg_printf("\r\n");
+}
+
+void sd_log_benchmark_compression(void) {
+#if SD_LOG_COMPRESS
+    // Borrows the flush buffers, which are only used from the main loop
+    sd_lz_benchmark(flush_buf, lz_out);
+#else
+    dbg_printf("SD log compression is disabled\r\n");
+#endif
+}
+
 bool sd_log_write_sensor_chunk(CAN_ADCFrame* frame, uint8_t length) {
     if (!is_initialized) return false;
     if (frame == NULL) return false;
-    uint8_t marker[5] = {0x00, 0x00, 0x00, 0x00, 0xA1};
+    uint8_t marker[5] = {0x00, 0x00, 0x00, 0x00, SD_LOG_SENS_RECORD};
+    sens_make_room(sizeof(marker) + length); // Make room once, a second drop could take the marker
     sens_push(marker, sizeof(marker));
     sens_push((uint8_t*)frame, length);
     flush_sensors_requested = true;
     return true;
 }
 
+bool sd_log_write_sensor_gap(uint8_t what, const uint8_t timestamp[3], uint8_t seq, uint16_t lost, uint8_t stage) {
+    if (!is_initialized) return false;
+    uint8_t record[13] = {0x00, 0x00, 0x00, 0x00, SD_LOG_SENS_GAP, what,
+                          timestamp[0], timestamp[1], timestamp[2], seq,
+                          (uint8_t)lost, (uint8_t)(lost >> 8), stage};
+    sens_push(record, sizeof(record));
+    flush_sensors_requested = true;
+    return true;
+}
+
+uint32_t sd_log_sensor_records_dropped(uint8_t id) {
+    return id < 32U ? sens_dropped_records[id] : 0;
+}
+
+uint32_t sd_log_sensor_gap_frames_dropped(uint8_t id) {
+    return id < 32U ? sens_dropped_gap_frames[id] : 0;
+}
+
 void sd_log_capture_debug(const char *text) {
     if (text == NULL) return;
     const char *p = text;
     while(*p) dbg_ring_push_char(*p++);
+    dbg_ring_note_level();
     flush_logs_requested = true;
 }
 
@@ -18,6 +18,23 @@
 #define SD_LOG_DEBUG_BUF_SIZE 2048
 #define SD_LOG_SENS_BUF_SIZE 8192
 
+// Write both log files as LZ compressed blocks (log.lzb / sensors.lzb, decode with
+// tools/sd_unpack). Set to 0 to write log.txt / sensors.raw uncompressed.
+#ifndef SD_LOG_COMPRESS
+#define SD_LOG_COMPRESS 1
+#endif
+
+#if SD_LOG_COMPRESS
+#define SD_LOG_TEXT_FILE "log.lzb"
+#define SD_LOG_SENS_FILE "sensors.lzb"
+#else
+#define SD_LOG_TEXT_FILE "log.txt"
+#define SD_LOG_SENS_FILE "sensors.raw"
+#endif
+
+// Written next to the sensor file, one sd_log_block_index_t per block in file order
+#define SD_LOG_SENS_INDEX_FILE "sensors.idx"
+
 // Log types
 typedef enum {
     SD_LOG_RAW,
@@ -26,6 +43,38 @@ typedef enum {
     SD_LOG_CRASH
 } SD_LogType_t;
 
+// Sensor block index entry. Blocks hold whole records (files from before that can have
+// records straddling blocks); first_ts is the ADC timestamp (ms, 24 bit) of the first
+// record that starts in the block.
+typedef struct __attribute__((packed)) {
+    uint32_t offset;            // Block start in the sensor file
+    uint32_t first_ts;
+    uint16_t length;            // Bytes on the card (LZ frame when compressed)
+    uint16_t raw_len;           // Sensor bytes in the block
+} sd_log_block_index_t;
+
+typedef enum {
+    SD_LOG_READ_SENSORS,
+    SD_LOG_READ_SENS_INDEX
+} sd_log_read_t;
+
+// Health counters for tuning ring sizes and flush policy
+typedef struct {
+    uint32_t dbg_dropped;       // Debug text bytes overwritten before they reached the card
+    uint32_t sens_dropped;      // Sensor bytes overwritten before they reached the card
+    uint32_t sens_records_dropped;  // Whole sensor records among them
+    uint16_t dbg_high_water;    // Peak debug ring usage (bytes)
+    uint16_t sens_high_water;   // Peak sensor ring usage (bytes)
+    uint32_t write_errors;      // Failed f_write/f_sync calls
+    uint32_t recoveries;        // Times writes started succeeding again after a failure
+    uint32_t last_recovery_ms;  // Time from first failed write to next good write
+    uint32_t max_recovery_ms;
+    uint32_t max_service_ms;    // Longest single sd_log_service call
+    uint32_t raw_bytes;         // Bytes taken from the rings
+    uint32_t card_bytes;        // Bytes written to the card after compression
+    uint64_t compress_cycles;   // CPU cycles spent compressing
+} sd_log_stats_t;
+
 // Initialize the SD logging system
 // Returns true if successful, false otherwise
 bool sd_log_init(uint8_t log_mb, uint8_t sens_mb);
@@ -53,15 +102,57 @@ bool sd_log_flush_blocking(uint32_t timeout_ms);
 // Returns the directory name as a string
 const char* sd_log_get_dir_name(void);
 
+// Get the session number of the current log directory (LOG_xxxx), 0 if not initialized
+uint32_t sd_log_get_session_number(void);
+
+// Read back the running session's sensor file or its block index through the writer's
+// handles (the files cannot be opened twice). Only bytes already flushed by sd_log_service
+// are returned; *got is short at the end. Main loop only.
+bool sd_log_read_back(sd_log_read_t which, uint32_t offset, void *dst, uint32_t len, uint32_t *got);
+
+// Number of sd_log_block_index_t entries written this session
+uint32_t sd_log_sens_index_entries(void);
+
 // Append a binary sensor chunk to the per-sensor file with a simple delimited record:
 // [0xA1][sampleRate(1)][timestamp(3)][len(2 LE)][payload(len)]
 // Returns true on success. File is created on first write if not already opened.
 bool sd_log_write_sensor_chunk(CAN_ADCFrame* frame, uint8_t length);
 
+// Sensor file record tags, after four zero bytes
+#define SD_LOG_SENS_RECORD  0xA1U
+#define SD_LOG_SENS_GAP     0xA2U
+
+// Note frames of one sensor that never made it, in place of them in the sensor file:
+// [00 00 00 00 A2][what][timestamp BE24][seq][lost LE16][stage]
+// seq is the first missing frame, timestamp the last frame received before the gap and
+// stage where they were lost (sensor_seq_stage_t). Readers that only know A1 skip it.
+bool sd_log_write_sensor_gap(uint8_t what, const uint8_t timestamp[3], uint8_t seq, uint16_t lost, uint8_t stage);
+
+// Sensor records of this sensor ID dropped from the ring since boot. Wraps, take differences.
+uint32_t sd_log_sensor_records_dropped(uint8_t id);
+
+// Frames this sensor ID's dropped gap records stood for, which have to be logged again.
+// Wraps, take differences.
+uint32_t sd_log_sensor_gap_frames_dropped(uint8_t id);
+
 // Non-blocking capture of debug text. Safe to call from ISRs; it enqueues into an internal ring.
-// The ring is drained and written to log.txt on sd_log_flush() or via sd_log_write().
+// The ring is drained and written to the text log by sd_log_service().
 void sd_log_capture_debug(const char *text);
 
+// Flush, record the session state and release the card (files closed, volume unmounted)
+void sd_log_shutdown(void);
+
+// Shut down and start a new session with the sizes given to the last sd_log_init
+bool sd_log_restart(void);
+
+// Copy / clear / print the health counters
+void sd_log_get_stats(sd_log_stats_t *out);
+void sd_log_reset_stats(void);
+void sd_log_print_stats(void);
+
+// Print compression ratio and cycles per byte for synthetic text and sensor blocks
+void sd_log_benchmark_compression(void);
+
 // Add allocated space to sensors file
 bool sd_log_preallocate_sensors(uint32_t size);
 
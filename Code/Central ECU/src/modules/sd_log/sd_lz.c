@@ -0,0 +1,261 @@
+#include "sd_lz.h"
+#include <string.h>
+#include <stdio.h>
+#include "crc.h"
+#include "cycle_count.h"
+#include "debug_io.h"
+
+// LZ4 block format constraints
+#define MINMATCH        4U
+#define LAST_LITERALS   5U      // Last 5 bytes are always literals
+#define MFLIMIT         12U     // Last match must start at least 12 bytes before the end
+
+// Offsets into the current block of the last position seen for each hash
+static uint16_t hash_table[1U << SD_LZ_HASH_BITS];
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint16_t hash4(uint32_t v)
+{
+    return (uint16_t)((uint32_t)(v * 2654435761U) >> (32U - SD_LZ_HASH_BITS));
+}
+
+static uint8_t *put_length(uint8_t *op, uint16_t len)
+{
+    len -= 15U;
+    while (len >= 255U) {
+        *op++ = 255U;
+        len -= 255U;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Emit one sequence: literals, then (if has_match) offset and match length - MINMATCH
+static uint8_t *emit_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *lit, uint16_t lit_len,
+                              uint16_t offset, uint16_t match_len, bool has_match)
+{
+    uint32_t need = 1U + lit_len + (lit_len / 255U) + 1U;
+    if (has_match) need += 2U + (match_len / 255U) + 1U;
+    if ((uint32_t)(oend - op) < need) return NULL;
+
+    uint8_t *token = op++;
+    uint8_t t;
+    if (lit_len >= 15U) {
+        t = 0xF0;
+        op = put_length(op, lit_len);
+    } else {
+        t = (uint8_t)(lit_len << 4);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (has_match) {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        if (match_len >= 15U) {
+            t |= 0x0F;
+            op = put_length(op, match_len);
+        } else {
+            t |= (uint8_t)match_len;
+        }
+    }
+    *token = t;
+    return op;
+}
+
+uint16_t sd_lz_compress(const uint8_t *src, uint16_t len, uint8_t *dst, uint16_t dst_cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *const end = src + len;
+    uint8_t *op = dst;
+    const uint8_t *const oend = dst + dst_cap;
+
+    if (len > MFLIMIT) {
+        const uint8_t *const mflimit = end - MFLIMIT;
+        const uint8_t *const matchlimit = end - LAST_LITERALS;
+
+        // Stale entries from the previous block are harmless (every candidate is
+        // verified) but clearing keeps the output deterministic
+        memset(hash_table, 0, sizeof(hash_table));
+        ip++;
+
+        while (ip <= mflimit) {
+            uint32_t seq = read32(ip);
+            uint16_t h = hash4(seq);
+            const uint8_t *ref = src + hash_table[h];
+            hash_table[h] = (uint16_t)(ip - src);
+
+            if (read32(ref) != seq || ref >= ip) {
+                ip++;
+                continue;
+            }
+
+            // Extend backwards over pending literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *mp = ip + MINMATCH;
+            const uint8_t *mr = ref + MINMATCH;
+            while (mp < matchlimit && *mp == *mr) {
+                mp++;
+                mr++;
+            }
+
+            op = emit_sequence(op, oend, anchor, (uint16_t)(ip - anchor),
+                               (uint16_t)(ip - ref), (uint16_t)(mp - ip - MINMATCH), true);
+            if (op == NULL) return 0;
+
+            ip = mp;
+            anchor = ip;
+            if (ip <= mflimit) {
+                hash_table[hash4(read32(ip - 2))] = (uint16_t)(ip - 2 - src);
+            }
+        }
+    }
+
+    op = emit_sequence(op, oend, anchor, (uint16_t)(end - anchor), 0, 0, false);
+    if (op == NULL) return 0;
+    return (uint16_t)(op - dst);
+}
+
+uint16_t sd_lz_frame(const uint8_t *src, uint16_t len, uint8_t *dst)
+{
+    sd_lz_header_t hdr;
+    uint8_t *data = dst + sizeof(hdr);
+
+    if (len == 0 || len > SD_LZ_BLOCK_SIZE) return 0;
+
+    // Only keep the compressed form if it is actually smaller
+    uint16_t n = sd_lz_compress(src, len, data, (uint16_t)(len - 1U));
+    if (n == 0) {
+        memcpy(data, src, len);
+        n = len;
+        hdr.data_len = (uint16_t)(len | SD_LZ_STORED);
+    } else {
+        hdr.data_len = n;
+    }
+    hdr.magic = SD_LZ_MAGIC;
+    hdr.raw_len = len;
+    hdr.crc = crc16_compute(data, n);
+    memcpy(dst, &hdr, sizeof(hdr));
+    return (uint16_t)(sizeof(hdr) + n);
+}
+
+// Read a run length extension (bytes of 255 continue it). Returns NULL past the end.
+static const uint8_t *get_length(const uint8_t *ip, const uint8_t *iend, uint16_t *len)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend) return NULL;
+        b = *ip++;
+        *len += b;
+    } while (b == 255U);
+    return ip;
+}
+
+uint16_t sd_lz_decompress(const uint8_t *src, uint16_t len, uint8_t *dst, uint16_t dst_cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        uint16_t lit = token >> 4;
+        if (lit == 15U && (ip = get_length(ip, iend, &lit)) == NULL) return 0;
+        if ((uint16_t)(iend - ip) < lit || (uint16_t)(oend - op) < lit) return 0;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) break; // Last sequence has no match
+
+        if (iend - ip < 2) return 0;
+        uint16_t offset = (uint16_t)(ip[0] | (ip[1] << 8));
+        ip += 2;
+        if (offset == 0 || offset > (uint16_t)(op - dst)) return 0;
+
+        uint16_t mlen = token & 0x0FU;
+        if (mlen == 15U && (ip = get_length(ip, iend, &mlen)) == NULL) return 0;
+        mlen += MINMATCH;
+        if ((uint16_t)(oend - op) < mlen) return 0;
+        const uint8_t *ref = op - offset;
+        while (mlen--) *op++ = *ref++; // Overlapping copy is intended
+    }
+    return (uint16_t)(op - dst);
+}
+
+uint16_t sd_lz_unframe(const uint8_t *frame, uint16_t len, uint8_t *dst)
+{
+    sd_lz_header_t hdr;
+    if (len < sizeof(hdr)) return 0;
+    memcpy(&hdr, frame, sizeof(hdr));
+
+    uint16_t n = hdr.data_len & (uint16_t)~SD_LZ_STORED;
+    const uint8_t *data = frame + sizeof(hdr);
+    if (hdr.magic != SD_LZ_MAGIC || hdr.raw_len == 0 || hdr.raw_len > SD_LZ_BLOCK_SIZE ||
+        n > len - sizeof(hdr) || crc16_compute(data, n) != hdr.crc) {
+        return 0;
+    }
+
+    if (hdr.data_len & SD_LZ_STORED) {
+        if (n != hdr.raw_len) return 0;
+        memcpy(dst, data, n);
+        return n;
+    }
+    return sd_lz_decompress(data, n, dst, SD_LZ_BLOCK_SIZE) == hdr.raw_len ? hdr.raw_len : 0;
+}
+
+static void bench_block(const char *name, const uint8_t *raw, uint16_t len, uint8_t *out)
+{
+    uint32_t start = cycle_count_now();
+    uint16_t n = sd_lz_frame(raw, len, out);
+    uint32_t cycles = cycle_count_since(start);
+    dbg_printf("  %-8s %4u -> %4u bytes (%lu%%), %lu cycles/byte\r\n", name, len, n,
+               (uint32_t)n * 100U / len, cycles / len);
+}
+
+void sd_lz_benchmark(uint8_t *raw, uint8_t *out)
+{
+    uint16_t len = 0;
+    cycle_count_init();
+    dbg_printf("LZ bench, %u byte blocks:\r\n", SD_LZ_BLOCK_SIZE);
+
+    // Debug text in the shape sd_log_write produces
+    for (uint32_t i = 0; len < SD_LZ_BLOCK_SIZE - 64U; i++) {
+        len += (uint16_t)snprintf((char*)raw + len, SD_LZ_BLOCK_SIZE - len,
+                                  "[12:%02lu:%02lu.%03lu] FSM: tick state %lu chamber %lu\r\n",
+                                  (i / 60U) % 60U, i % 60U, (i * 37U) % 1000U, i & 3U, 400U + (i % 7U));
+    }
+    bench_block("text", raw, len, out);
+
+    // MIPA frames as written to sensors.raw: marker, what, length, timestamp, 28 samples
+    len = 0;
+    for (uint32_t f = 0; len + 68U <= SD_LZ_BLOCK_SIZE; f++) {
+        static const uint8_t marker[5] = {0x00, 0x00, 0x00, 0x00, 0xA1};
+        memcpy(raw + len, marker, sizeof(marker));
+        len += sizeof(marker);
+        raw[len++] = 0x00;
+        raw[len++] = 58;
+        raw[len++] = (uint8_t)(f >> 8);
+        raw[len++] = (uint8_t)f;
+        raw[len++] = 0;
+        for (uint32_t s = 0; s < 29U; s++) {
+            uint16_t v = (uint16_t)(12000U + ((f * 28U + s) % 13U));
+            raw[len++] = (uint8_t)v;
+            raw[len++] = (uint8_t)(v >> 8);
+        }
+    }
+    bench_block("sensors", raw, len, out);
+
+    memset(raw, 0, SD_LZ_BLOCK_SIZE);
+    bench_block("zeros", raw, SD_LZ_BLOCK_SIZE, out);
+}
@@ -0,0 +1,49 @@
+#ifndef SD_LZ_H
+#define SD_LZ_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block compressor for the SD log files. Each block is an independent LZ4 block (no
+// history across blocks) behind a small header, so a truncated or damaged file can still
+// be decoded from the next good block. Decoder: tools/sd_unpack.c
+//
+// Block on disk: [sd_lz_header_t][data_len bytes]
+
+#define SD_LZ_BLOCK_SIZE    2048U           // Max raw bytes per block
+#define SD_LZ_HASH_BITS     10U             // 2 KiB match table
+#define SD_LZ_MAGIC         0x5A4CU         // "LZ" on disk
+#define SD_LZ_STORED        0x8000U         // data_len flag: block stored uncompressed
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t raw_len;
+    uint16_t data_len;      // Bytes following the header, | SD_LZ_STORED if not compressed
+    uint16_t crc;           // crc16_compute over the data bytes
+} sd_lz_header_t;
+
+// Blocks that do not shrink are stored, so a frame never exceeds header + raw size
+#define SD_LZ_FRAME_MAX     (sizeof(sd_lz_header_t) + SD_LZ_BLOCK_SIZE)
+
+// Compress len bytes into a raw LZ4 block. Returns the compressed size, or 0 if it
+// would not fit in dst_cap.
+uint16_t sd_lz_compress(const uint8_t *src, uint16_t len, uint8_t *dst, uint16_t dst_cap);
+
+// Build a framed block (header + compressed or stored data) in dst, which must hold
+// SD_LZ_FRAME_MAX bytes. len must be <= SD_LZ_BLOCK_SIZE. Returns the frame size.
+uint16_t sd_lz_frame(const uint8_t *src, uint16_t len, uint8_t *dst);
+
+// Decode a raw LZ4 block. Returns the decoded size, or 0 if the block is malformed or
+// would not fit in dst_cap.
+uint16_t sd_lz_decompress(const uint8_t *src, uint16_t len, uint8_t *dst, uint16_t dst_cap);
+
+// Check and decode a framed block of len bytes into dst, which must hold SD_LZ_BLOCK_SIZE
+// bytes. Returns the raw size, or 0 if the header, CRC or data is bad.
+uint16_t sd_lz_unframe(const uint8_t *frame, uint16_t len, uint8_t *dst);
+
+// Compress synthetic log text and sensor frames and print ratio and cycles per byte.
+// raw must hold SD_LZ_BLOCK_SIZE bytes and out SD_LZ_FRAME_MAX bytes.
+void sd_lz_benchmark(uint8_t *raw, uint8_t *out);
+
+#endif // SD_LZ_H
@@ -0,0 +1,329 @@
+#include "sd_replay.h"
+#include <stdio.h>
+#include <string.h>
+#include "debug_io.h"
+#include "main_FSM.h"
+#include "rs422.h"
+#include "sd_log.h"
+#include "sd_lz.h"
+
+#define REPLAY_MARKER_ZEROS 4U      // Record marker is 00 00 00 00 A1
+#define REPLAY_HEADER_LEN   5U      // what, length, timestamp[3]
+#define REPLAY_MAX_DATA     59U     // CAN_ADCFrame data
+#define REPLAY_REQUEST_LEN  14U
+
+typedef enum {
+    PARSE_HUNT,
+    PARSE_HEADER,
+    PARSE_DATA
+} replay_parse_t;
+
+static struct {
+    bool active;                // Until the end report is queued
+    bool reading;
+    bool live;                  // Running session, read through sd_log's handles
+    uint32_t mask;
+    uint32_t start;
+    uint32_t end;
+    uint32_t next_block;        // Next index entry to read
+    uint32_t block_count;       // Index entries when the request arrived
+    uint16_t raw_len;           // Decoded bytes in raw_buf
+    uint16_t pos;               // Parse position in raw_buf
+    replay_parse_t state;
+    uint8_t match;              // Marker zeros seen
+    uint8_t rec[REPLAY_HEADER_LEN + REPLAY_MAX_DATA];
+    uint8_t rec_len;
+    bool rec_ready;             // rec is complete, selected and waiting for lane space
+    uint32_t records;
+    sd_replay_end_t end_reason;
+} replay;
+
+static sd_replay_stats_t stats;
+
+// Past sessions are opened here, the running one is read back through sd_log
+static FIL replay_sens_file;
+static FIL replay_index_file;
+#if SD_LOG_COMPRESS
+static uint8_t frame_buf[SD_LZ_FRAME_MAX];
+#endif
+static uint8_t raw_buf[SD_LZ_BLOCK_SIZE];
+
+static const char *end_names[] = {"done", "stopped", "read error", "aborted"};
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool read_at(sd_log_read_t which, uint32_t offset, void *dst, uint32_t len)
+{
+    uint32_t got = 0;
+    if (replay.live) {
+        if (!sd_log_read_back(which, offset, dst, len, &got)) return false;
+    } else {
+        FIL *file = (which == SD_LOG_READ_SENS_INDEX) ? &replay_index_file : &replay_sens_file;
+        UINT n = 0;
+        if (f_lseek(file, offset) != FR_OK || f_read(file, dst, len, &n) != FR_OK) return false;
+        got = n;
+    }
+    return got == len;
+}
+
+static bool read_entry(uint32_t i, sd_log_block_index_t *entry)
+{
+    return read_at(SD_LOG_READ_SENS_INDEX, i * sizeof(*entry), entry, sizeof(*entry));
+}
+
+static bool open_session(uint16_t session)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "LOG_%04u/%s", session, SD_LOG_SENS_FILE);
+    if (f_open(&replay_sens_file, path, FA_READ) != FR_OK) return false;
+    snprintf(path, sizeof(path), "LOG_%04u/%s", session, SD_LOG_SENS_INDEX_FILE);
+    if (f_open(&replay_index_file, path, FA_READ) != FR_OK) {
+        (void)f_close(&replay_sens_file);
+        return false;
+    }
+    return true;
+}
+
+static void close_session(void)
+{
+    if (replay.live) return;
+    (void)f_close(&replay_sens_file);
+    (void)f_close(&replay_index_file);
+}
+
+// Index of the last block starting at or before target, by its first record time
+static uint32_t seek_block(uint32_t target)
+{
+    uint32_t lo = 0;
+    uint32_t hi = replay.block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2U;
+        sd_log_block_index_t entry;
+        stats.seek_reads++;
+        if (!read_entry(mid, &entry)) return 0; // Fall back to reading from the start
+        if (entry.first_ts <= target) {
+            lo = mid + 1U;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? lo - 1U : 0;
+}
+
+static void finish(sd_replay_end_t reason)
+{
+    close_session();
+    replay.reading = false;
+    replay.rec_ready = false;
+    replay.end_reason = reason;
+    dbg_printf("SD replay %s, %lu records\r\n", end_names[reason], replay.records);
+}
+
+static bool send_end_report(void)
+{
+    uint8_t report[4] = {(uint8_t)replay.end_reason, (uint8_t)replay.records,
+                         (uint8_t)(replay.records >> 8), (uint8_t)(replay.records >> 16)};
+    return rs422_send_data(report, sizeof(report), RS422_FRAME_REPLAY);
+}
+
+// Decode the next block into raw_buf. Returns false once the replay has finished.
+static bool load_next_block(void)
+{
+    sd_log_block_index_t entry;
+
+    if (replay.next_block >= replay.block_count) {
+        finish(SD_REPLAY_END_DONE);
+        return false;
+    }
+    if (!read_entry(replay.next_block, &entry)) {
+        finish(SD_REPLAY_END_READ_ERROR);
+        return false;
+    }
+    replay.next_block++;
+    if (entry.first_ts > SD_REPLAY_SEEK_MARGIN_MS && entry.first_ts - SD_REPLAY_SEEK_MARGIN_MS > replay.end) {
+        finish(SD_REPLAY_END_DONE);
+        return false;
+    }
+
+    stats.blocks++;
+    replay.pos = 0;
+    replay.raw_len = 0;
+#if SD_LOG_COMPRESS
+    if (entry.length <= sizeof(frame_buf)) {
+        if (!read_at(SD_LOG_READ_SENSORS, entry.offset, frame_buf, entry.length)) {
+            finish(SD_REPLAY_END_READ_ERROR);
+            return false;
+        }
+        replay.raw_len = sd_lz_unframe(frame_buf, entry.length, raw_buf);
+    }
+#else
+    if (entry.length <= sizeof(raw_buf)) {
+        if (!read_at(SD_LOG_READ_SENSORS, entry.offset, raw_buf, entry.length)) {
+            finish(SD_REPLAY_END_READ_ERROR);
+            return false;
+        }
+        replay.raw_len = entry.length;
+    }
+#endif
+    if (replay.raw_len == 0 || replay.raw_len != entry.raw_len) {
+        // Lose the record that straddles the bad block, pick up at the next marker
+        stats.bad_blocks++;
+        replay.raw_len = 0;
+        replay.state = PARSE_HUNT;
+        replay.match = 0;
+    }
+    return true;
+}
+
+static void record_complete(void)
+{
+    uint8_t id = replay.rec[0] >> 3;
+    uint32_t ts = ((uint32_t)replay.rec[2] << 16) | ((uint32_t)replay.rec[3] << 8) | replay.rec[4];
+    replay.state = PARSE_HUNT;
+    replay.match = 0;
+    replay.rec_ready = (replay.mask & (1UL << id)) && ts >= replay.start && ts <= replay.end;
+}
+
+// Run the record parser over raw_buf until a selected record is complete or the block
+// ends. Records straddle blocks, so the parser state carries over.
+static void parse_block(void)
+{
+    while (replay.pos < replay.raw_len && !replay.rec_ready) {
+        uint8_t b = raw_buf[replay.pos++];
+        switch (replay.state) {
+            case PARSE_HUNT:
+                if (b == 0) {
+                    if (replay.match < REPLAY_MARKER_ZEROS) replay.match++;
+                } else if (b == 0xA1 && replay.match == REPLAY_MARKER_ZEROS) {
+                    replay.state = PARSE_HEADER;
+                    replay.rec_len = 0;
+                } else {
+                    replay.match = 0;
+                }
+                break;
+            case PARSE_HEADER:
+                replay.rec[replay.rec_len++] = b;
+                if (replay.rec_len == REPLAY_HEADER_LEN) {
+                    uint8_t length = replay.rec[1];
+                    if (length > REPLAY_MAX_DATA) {
+                        replay.state = PARSE_HUNT;
+                        replay.match = 0;
+                    } else if (length == 0) {
+                        record_complete();
+                    } else {
+                        replay.state = PARSE_DATA;
+                    }
+                }
+                break;
+            case PARSE_DATA:
+                replay.rec[replay.rec_len++] = b;
+                if (replay.rec_len == REPLAY_HEADER_LEN + replay.rec[1]) {
+                    record_complete();
+                }
+                break;
+        }
+    }
+}
+
+rs422_cmd_status_t sd_replay_start(uint16_t session, uint32_t sensor_mask, uint32_t start_ms, uint32_t end_ms)
+{
+    sd_replay_stop();
+    if (sensor_mask == 0) return RS422_CMD_OK;
+    if (end_ms < start_ms) return RS422_CMD_NAK_MALFORMED;
+    if (fsm_get_state() == STATE_SEQUENCER) return RS422_CMD_NAK_STATE;
+
+    replay.live = (session == 0 || session == sd_log_get_session_number());
+    if (replay.live) {
+        replay.block_count = sd_log_sens_index_entries();
+    } else if (open_session(session)) {
+        replay.block_count = (uint32_t)(f_size(&replay_index_file) / sizeof(sd_log_block_index_t));
+    } else {
+        dbg_printf("SD replay: no index for session %u\r\n", session);
+        return RS422_CMD_NAK_MALFORMED;
+    }
+
+    replay.mask = sensor_mask;
+    replay.start = start_ms;
+    replay.end = end_ms;
+    replay.raw_len = 0;
+    replay.pos = 0;
+    replay.state = PARSE_HUNT;
+    replay.match = 0;
+    replay.rec_ready = false;
+    replay.records = 0;
+    replay.next_block = seek_block(start_ms > SD_REPLAY_SEEK_MARGIN_MS ? start_ms - SD_REPLAY_SEEK_MARGIN_MS : 0);
+    replay.reading = true;
+    replay.active = true;
+    stats.requests++;
+
+    dbg_printf("SD replay: session %u mask %08lX %lu-%lu ms, block %lu of %lu\r\n",
+               session, sensor_mask, start_ms, end_ms, replay.next_block, replay.block_count);
+    return RS422_CMD_OK;
+}
+
+rs422_cmd_status_t sd_replay_handle_request(const uint8_t *data, uint16_t size)
+{
+    if (size < REPLAY_REQUEST_LEN) return RS422_CMD_NAK_MALFORMED;
+    uint16_t session = data[0] | (data[1] << 8);
+    return sd_replay_start(session, get_u32(&data[2]), get_u32(&data[6]), get_u32(&data[10]));
+}
+
+void sd_replay_stop(void)
+{
+    if (!replay.active) return;
+    if (replay.reading) finish(SD_REPLAY_END_STOPPED);
+    (void)send_end_report(); // Best effort, a new replay follows straight away
+    replay.active = false;
+}
+
+bool sd_replay_active(void)
+{
+    return replay.active;
+}
+
+void sd_replay_poll(void)
+{
+    if (!replay.active) return;
+
+    if (replay.reading && fsm_get_state() == STATE_SEQUENCER) {
+        finish(SD_REPLAY_END_ABORTED);
+    }
+    if (!replay.reading) {
+        if (rs422_get_tx_buffer_space(RS422_LANE_REPLAY) > 0 && send_end_report()) {
+            replay.active = false;
+        }
+        return;
+    }
+
+    bool block_read = false;
+    uint8_t sent = 0;
+    while (sent < SD_REPLAY_FRAMES_PER_POLL) {
+        if (replay.rec_ready) {
+            // Leave the lane room so live traffic sharing the link never waits on a backlog
+            if (rs422_get_tx_buffer_space(RS422_LANE_REPLAY) <= SD_REPLAY_LANE_RESERVE) return;
+            if (!rs422_send_data(replay.rec, replay.rec_len, RS422_FRAME_REPLAY)) return;
+            replay.rec_ready = false;
+            replay.records++;
+            stats.records++;
+            sent++;
+        } else if (replay.pos < replay.raw_len) {
+            parse_block();
+        } else if (block_read) {
+            return; // One card read per poll
+        } else if (!load_next_block()) {
+            return;
+        } else {
+            block_read = true;
+        }
+    }
+}
+
+void sd_replay_print_stats(void)
+{
+    dbg_printf("SD replay: %s, %lu requests, %lu records, %lu blocks (%lu bad), %lu seek reads\r\n",
+               replay.active ? "running" : "idle", stats.requests, stats.records, stats.blocks,
+               stats.bad_blocks, stats.seek_reads);
+}
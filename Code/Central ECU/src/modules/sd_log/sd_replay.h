@@ -0,0 +1,58 @@
+#ifndef SD_REPLAY_H
+#define SD_REPLAY_H
+
+#include "stm32g0xx_hal.h"
+#include "rs422_cmd.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Replay of logged sensor records from the SD card to the RIU, for quick look analysis
+// between runs without pulling the card.
+//
+// Request, RIU -> ECU command RS422_FRAME_REPLAY (after the command sequence number):
+//   [session u16][sensor mask u32][start u32][end u32]     all LE
+//   session 0 is the running one; bit n of the mask selects sensor ID n (CAN what >> 3);
+//   start/end are ADC frame timestamps in ms, inclusive. A mask of 0 stops a replay.
+// Data, ECU -> RIU RS422_FRAME_REPLAY on RS422_LANE_REPLAY:
+//   one record per frame, exactly as logged: [what][length][timestamp BE24][data]
+//   then a 4 byte end report: [sd_replay_end_t][records sent u24 LE]
+// Records are at least 5 bytes, so the size tells the two apart.
+//
+// The start is found by binary search of the session's sensors.idx block index. Records of
+// different boards interleave with their own clocks, so the search backs off by
+// SD_REPLAY_SEEK_MARGIN_MS and every record is filtered on its own timestamp.
+
+#define SD_REPLAY_SEEK_MARGIN_MS    1000U
+#define SD_REPLAY_FRAMES_PER_POLL   8U      // Records queued per poll at most
+#define SD_REPLAY_LANE_RESERVE      4U      // Free replay lane slots left for the next poll
+
+typedef enum {
+    SD_REPLAY_END_DONE = 0,         // Reached the end of the window or the session
+    SD_REPLAY_END_STOPPED = 1,      // Stopped by request or replaced by a new request
+    SD_REPLAY_END_READ_ERROR = 2,   // Card read failed
+    SD_REPLAY_END_ABORTED = 3       // Sequencer started, the card is the flight log's again
+} sd_replay_end_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t records;           // Records sent
+    uint32_t blocks;            // Blocks read from the card
+    uint32_t bad_blocks;        // Blocks skipped on a bad header, CRC or decode
+    uint32_t seek_reads;        // Index entries read by the binary search
+} sd_replay_stats_t;
+
+// Start (or with an empty mask stop) a replay. Returns the status for the command ACK.
+rs422_cmd_status_t sd_replay_start(uint16_t session, uint32_t sensor_mask, uint32_t start_ms, uint32_t end_ms);
+
+// Handle the payload of a RS422_FRAME_REPLAY command
+rs422_cmd_status_t sd_replay_handle_request(const uint8_t *data, uint16_t size);
+
+void sd_replay_stop(void);
+bool sd_replay_active(void);
+
+// Read the card and queue records. Call every few ms from the main loop.
+void sd_replay_poll(void);
+
+void sd_replay_print_stats(void);
+
+#endif // SD_REPLAY_H
@@ -0,0 +1,114 @@
+#include "sd_fault.h"
+#include <string.h>
+#include "debug_io.h"
+#include "sd_log.h"
+#include "frames.h"
+
+static sd_fault_config_t fault_cfg;
+static uint32_t write_calls = 0;
+static uint32_t injected_failures = 0;
+static bool power_lost = false;
+
+static uint16_t load_rate = 0;
+static uint32_t load_end = 0;
+static uint32_t load_last = 0;
+static uint32_t load_sent = 0;
+static uint32_t load_acc = 0;       // Fractional frames carried between polls (x1000)
+
+void sd_fault_configure(const sd_fault_config_t *cfg)
+{
+    fault_cfg = *cfg;
+    write_calls = 0;
+    injected_failures = 0;
+    power_lost = false;
+}
+
+void sd_fault_clear(void)
+{
+    memset(&fault_cfg, 0, sizeof(fault_cfg));
+    power_lost = false;
+}
+
+bool sd_fault_on_write(uint32_t sector, uint32_t count)
+{
+    (void)sector;
+    write_calls++;
+
+    if (fault_cfg.power_loss_after && write_calls >= fault_cfg.power_loss_after) {
+        power_lost = true;
+    }
+    if (power_lost) {
+        injected_failures++;
+        return false;
+    }
+
+    if (fault_cfg.write_latency_ms) {
+        HAL_Delay(fault_cfg.write_latency_ms * count);
+    }
+    if (fault_cfg.busy_every && (write_calls % fault_cfg.busy_every) == 0) {
+        HAL_Delay(fault_cfg.busy_ms);
+    }
+    if (fault_cfg.fail_every && (write_calls % fault_cfg.fail_every) == 0) {
+        injected_failures++;
+        return false;
+    }
+    return true;
+}
+
+bool sd_fault_on_read(void)
+{
+    return !power_lost;
+}
+
+bool sd_fault_power_lost(void)
+{
+    return power_lost;
+}
+
+void sd_fault_load_start(uint16_t frames_per_s, uint16_t seconds)
+{
+    load_rate = frames_per_s;
+    load_last = HAL_GetTick();
+    load_end = load_last + (uint32_t)seconds * 1000U;
+    load_sent = 0;
+    load_acc = 0;
+}
+
+void sd_fault_load_poll(void)
+{
+    if (load_rate == 0) return;
+
+    uint32_t now = HAL_GetTick();
+    load_acc += (now - load_last) * load_rate;
+    load_last = now;
+
+    // Same shape as a MIPA chamber pressure frame from the ADC board
+    CAN_ADCFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.what = 0;
+    frame.length = 58;
+
+    while (load_acc >= 1000U) {
+        load_acc -= 1000U;
+        frame.timestamp[0] = (uint8_t)(now >> 16);
+        frame.timestamp[1] = (uint8_t)(now >> 8);
+        frame.timestamp[2] = (uint8_t)now;
+        frame.data[0] = (uint8_t)load_sent;
+        sd_log_write_sensor_chunk(&frame, frame.length + 5);
+        load_sent++;
+    }
+
+    if ((int32_t)(now - load_end) >= 0) {
+        dbg_printf("SD load done, %lu frames\r\n", load_sent);
+        load_rate = 0;
+    }
+}
+
+void sd_fault_print(void)
+{
+    dbg_printf("SD fault: lat %ums busy %ums/%lu fail 1/%lu loss@%lu\r\n",
+               fault_cfg.write_latency_ms, fault_cfg.busy_ms, fault_cfg.busy_every,
+               fault_cfg.fail_every, fault_cfg.power_loss_after);
+    dbg_printf("          writes %lu injected %lu power %s\r\n",
+               write_calls, injected_failures, power_lost ? "LOST" : "ok");
+}
@@ -0,0 +1,36 @@
+#ifndef SD_FAULT_H
+#define SD_FAULT_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fault injection for the SD block layer (user_diskio.c) and a synthetic sensor load
+// generator, used to tune the sd_log ring sizes and flush policy on the bench.
+// Only hooked into the driver when SD_FAULT_INJECT is defined in config.h.
+
+typedef struct {
+    uint16_t write_latency_ms;  // Extra delay per block written
+    uint32_t busy_every;        // Every N write calls, stall for busy_ms (0 = never)
+    uint16_t busy_ms;
+    uint32_t fail_every;        // Every N write calls, fail the write (0 = never)
+    uint32_t power_loss_after;  // After N more write calls, fail all I/O until cleared (0 = never)
+} sd_fault_config_t;
+
+void sd_fault_configure(const sd_fault_config_t *cfg);
+void sd_fault_clear(void);
+
+// Driver hooks. Return false if the access should fail.
+bool sd_fault_on_write(uint32_t sector, uint32_t count);
+bool sd_fault_on_read(void);
+
+// Card has lost power (power_loss_after reached) and fails all I/O until cleared
+bool sd_fault_power_lost(void);
+
+// Push synthetic ADC frames into the sensor log at frames_per_s for the given duration
+void sd_fault_load_start(uint16_t frames_per_s, uint16_t seconds);
+void sd_fault_load_poll(void);
+
+void sd_fault_print(void);
+
+#endif // SD_FAULT_H
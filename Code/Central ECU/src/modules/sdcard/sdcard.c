@@ -318,6 +318,78 @@ int SDCARD_GetBlocksNumber(uint32_t* num) {
     return 0;
 }
 
+int SDCARD_GetAllocationUnit(uint32_t* num) {
+    uint8_t status[64];
+    uint8_t crc[2];
+
+    SDCARD_Select();
+
+    if(SDCARD_WaitNotBusy() < 0) { // keep this!
+        SDCARD_Unselect();
+        return -1;
+    }
+
+    /* ACMD13 (SD_STATUS) = CMD55 followed by CMD13 */
+    {
+        static const uint8_t cmd[] =
+            { 0x40 | 0x37 /* CMD55 */, 0x00, 0x00, 0x00, 0x00 /* ARG */, (0x7F << 1) | 1 /* CRC7 + end bit */ };
+        HAL_SPI_Transmit(&SDCARD_SPI_PORT, (uint8_t*)cmd, sizeof(cmd), HAL_MAX_DELAY);
+    }
+
+    if(SDCARD_ReadR1() != 0x00) {
+        SDCARD_Unselect();
+        return -2;
+    }
+
+    {
+        static const uint8_t cmd[] =
+            { 0x40 | 0x0D /* ACMD13 */, 0x00, 0x00, 0x00, 0x00 /* ARG */, (0x7F << 1) | 1 /* CRC7 + end bit */ };
+        HAL_SPI_Transmit(&SDCARD_SPI_PORT, (uint8_t*)cmd, sizeof(cmd), HAL_MAX_DELAY);
+    }
+
+    // R2 response: R1 followed by a second status byte
+    uint8_t r2;
+    if(SDCARD_ReadR1() != 0x00 || SDCARD_ReadBytes(&r2, sizeof(r2)) < 0) {
+        SDCARD_Unselect();
+        return -3;
+    }
+
+    if(SDCARD_WaitDataToken(DATA_TOKEN_CMD17) < 0) {
+        SDCARD_Unselect();
+        return -4;
+    }
+
+    if(SDCARD_ReadBytes(status, sizeof(status)) < 0) {
+        SDCARD_Unselect();
+        return -5;
+    }
+
+    if(SDCARD_ReadBytes(crc, sizeof(crc)) < 0) {
+        SDCARD_Unselect();
+        return -6;
+    }
+
+    SDCARD_Unselect();
+
+    // AU_SIZE is bits [431:428] of the 512-bit SD status
+    // 1..9: 16KB << (n-1), A: 8MB, C: 16MB, E: 32MB, F: 64MB; B (12MB) and D (24MB) are
+    // not powers of two
+    uint8_t au = status[10] >> 4;
+    if(au >= 1 && au <= 0x0A) {
+        *num = 32UL << (au - 1); // 16KB == 32 blocks
+    } else if(au == 0x0C) {
+        *num = 32768UL;
+    } else if(au == 0x0E) {
+        *num = 65536UL;
+    } else if(au == 0x0F) {
+        *num = 131072UL;
+    } else {
+        return -7;
+    }
+
+    return 0;
+}
+
 int SDCARD_ReadSingleBlock(uint32_t blockNum, uint8_t* buff) {
     uint8_t crc[2];
 
@@ -18,6 +18,7 @@ void SDCARD_Unselect();
 
 int SDCARD_Init();
 int SDCARD_GetBlocksNumber(uint32_t* num);
+int SDCARD_GetAllocationUnit(uint32_t* num); // erase allocation unit in 512 byte blocks (ACMD13)
 int SDCARD_ReadSingleBlock(uint32_t blockNum, uint8_t* buff); // sizeof(buff) == 512!
 int SDCARD_WriteSingleBlock(uint32_t blockNum, const uint8_t* buff); // sizeof(buff) == 512!
 
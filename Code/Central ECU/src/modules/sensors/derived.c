@@ -0,0 +1,241 @@
+#include "derived.h"
+#include <stdio.h>
+#include <string.h>
+#include "debug_io.h"
+#include "sd_log.h"
+#include "sensors.h"
+#include "sensor_history.h"
+
+// Channel indices, for DERIVED_OP_CHANNEL
+enum {
+    CH_BURN = 0,
+    CH_BURN_TIME,
+    CH_PC_MEAN,
+    CH_OX_FLOW,
+    CH_OX_USED,
+    CH_IMPULSE,
+};
+
+#define N_SENSOR(id)            { DERIVED_OP_SENSOR, (id), 0, 0, 0 }
+#define N_SLOPE(id)             { DERIVED_OP_SLOPE, (id), 0, 0, 0 }
+#define N_CHANNEL(ch)           { DERIVED_OP_CHANNEL, (ch), 0, 0, 0 }
+#define N_CONST(k)              { DERIVED_OP_CONST, 0, 0, (k), 0 }
+#define N_ADD(a, b)             { DERIVED_OP_ADD, (a), (b), 0, 0 }
+#define N_SCALE(a, k)           { DERIVED_OP_SCALE, (a), 0, (k), 0 }
+#define N_HYST(a, on, off)      { DERIVED_OP_HYST, (a), 0, (on), (off) }
+#define N_INTEGRAL(a, gate, k)  { DERIVED_OP_INTEGRAL, (a), (gate), (k), 0 }
+#define N_MEAN(a, gate)         { DERIVED_OP_MEAN, (a), (gate), 0, 0 }
+
+// Channels that read another channel come after it
+static const derived_channel_t channels[] = {
+    // Burning while the chamber is over 5 bar, until it drops under 3 bar
+    [CH_BURN] = { "burn", SENSOR_D_BURN, SENSOR_P_CHAMBER, true, 2, {
+        N_SENSOR(SENSOR_P_CHAMBER),
+        N_HYST(0, 50, 30),
+    }},
+    [CH_BURN_TIME] = { "burn_time", SENSOR_D_BURN_TIME, SENSOR_P_CHAMBER, false, 3, {
+        N_CHANNEL(CH_BURN),
+        N_CONST(1),
+        N_INTEGRAL(1, 0, 10),
+    }},
+    [CH_PC_MEAN] = { "pc_mean", SENSOR_D_PC_MEAN, SENSOR_P_CHAMBER, false, 3, {
+        N_SENSOR(SENSOR_P_CHAMBER),
+        N_CHANNEL(CH_BURN),
+        N_MEAN(0, 1),
+    }},
+    // The tank empties through both load cells, flow is the negated sum of their slopes
+    [CH_OX_FLOW] = { "ox_flow", SENSOR_D_OX_FLOW, SENSOR_LC_N2O_A, false, 4, {
+        N_SLOPE(SENSOR_LC_N2O_A),
+        N_SLOPE(SENSOR_LC_N2O_B),
+        N_ADD(0, 1),
+        N_SCALE(2, -65536),
+    }},
+    [CH_OX_USED] = { "ox_used", SENSOR_D_OX_USED, SENSOR_LC_N2O_A, false, 3, {
+        N_CHANNEL(CH_OX_FLOW),
+        N_CHANNEL(CH_BURN),
+        N_INTEGRAL(0, 1, 1000),
+    }},
+    [CH_IMPULSE] = { "impulse", SENSOR_D_IMPULSE, SENSOR_LC_Thrust, false, 3, {
+        N_SENSOR(SENSOR_LC_Thrust),
+        N_CHANNEL(CH_BURN),
+        N_INTEGRAL(0, 1, 1000),
+    }},
+};
+
+#define CHANNEL_COUNT (sizeof(channels) / sizeof(channels[0]))
+
+_Static_assert(CHANNEL_COUNT <= DERIVED_MAX_CHANNELS, "Raise DERIVED_MAX_CHANNELS");
+
+typedef struct {
+    int32_t value;
+    int64_t acc;                // Integral or mean sum
+    uint32_t count;             // Mean samples
+    bool gate;                  // Gate was open at the last sample
+} derived_node_state_t;
+
+typedef struct {
+    derived_node_state_t node[DERIVED_MAX_NODES];
+    int32_t value;
+    uint32_t time;              // HAL tick of the last evaluation
+    bool seen;
+    bool active;                // Edge channels: output non-zero
+} derived_state_t;
+
+static derived_state_t state[CHANNEL_COUNT];
+
+// Sample period in ms for the 3 bit rate code, 1 Hz to 1 kHz
+static const uint16_t period_ms[8] = {1000, 100, 50, 20, 10, 5, 2, 1};
+
+static int16_t saturate16(int32_t v)
+{
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// Inputs from other sensors are read once per frame, they do not change within it
+static int32_t evaluate(uint8_t c, int32_t sample, uint16_t period, bool first)
+{
+    const derived_channel_t *ch = &channels[c];
+    derived_node_state_t *st = state[c].node;
+    for (uint8_t i = 0; i < ch->nodes; i++) {
+        const derived_node_t *n = &ch->node[i];
+        derived_node_state_t *s = &st[i];
+        switch (n->op) {
+            case DERIVED_OP_SENSOR:
+                if (n->a == ch->trigger) {
+                    s->value = sample;
+                } else if (first && !sensor_history_latest(n->a, &s->value, NULL)) {
+                    s->value = 0;
+                }
+                break;
+            case DERIVED_OP_SLOPE:
+                if (first) {
+                    sensor_history_stats_t stats;
+                    s->value = sensor_history_get_stats(n->a, &stats) ? stats.slope_per_s : 0;
+                }
+                break;
+            case DERIVED_OP_CHANNEL:
+                s->value = state[n->a].value;
+                break;
+            case DERIVED_OP_CONST:
+                s->value = n->k;
+                break;
+            case DERIVED_OP_ADD:
+                s->value = st[n->a].value + st[n->b].value;
+                break;
+            case DERIVED_OP_SUB:
+                s->value = st[n->a].value - st[n->b].value;
+                break;
+            case DERIVED_OP_SCALE:
+                s->value = (int32_t)(((int64_t)st[n->a].value * n->k) / 65536);
+                break;
+            case DERIVED_OP_HYST:
+                if (st[n->a].value > n->k) s->value = 1;
+                else if (st[n->a].value < n->k2) s->value = 0;
+                break;
+            case DERIVED_OP_INTEGRAL:
+            case DERIVED_OP_MEAN: {
+                bool gate = st[n->b].value != 0;
+                if (gate && !s->gate) {
+                    s->acc = 0; // Restart when the gate opens
+                    s->count = 0;
+                }
+                s->gate = gate;
+                if (gate) {
+                    s->acc += (n->op == DERIVED_OP_INTEGRAL) ? (int64_t)st[n->a].value * period : st[n->a].value;
+                    s->count++;
+                }
+                if (n->op == DERIVED_OP_INTEGRAL) {
+                    s->value = (int32_t)(s->acc / n->k);
+                } else {
+                    s->value = s->count ? (int32_t)(s->acc / (int64_t)s->count) : 0;
+                }
+                break;
+            }
+        }
+    }
+    return st[ch->nodes - 1].value;
+}
+
+static void log_edge(uint8_t c, bool active)
+{
+    if (active) {
+        dbg_printf("DERIVED: %s start\r\n", channels[c].name);
+        sd_log_write(SD_LOG_INFO, "DERIVED: %s start", channels[c].name);
+        return;
+    }
+    // Post-fire summary, channels on other triggers are as of their last frame
+    char summary[160];
+    int len = 0;
+    for (uint8_t i = 0; i < CHANNEL_COUNT && len < (int)sizeof(summary); i++) {
+        len += snprintf(summary + len, sizeof(summary) - len, " %s %ld", channels[i].name, state[i].value);
+    }
+    dbg_printf("DERIVED: %s stop,%s\r\n", channels[c].name, summary);
+    sd_log_write(SD_LOG_INFO, "DERIVED: %s stop,%s", channels[c].name, summary);
+}
+
+uint8_t derived_add_frame(const CAN_ADCFrame *frame, CAN_ADCFrame *out, uint8_t max)
+{
+    uint8_t id = frame->what >> 3;
+    uint8_t slot[CHANNEL_COUNT];
+    uint8_t triggered = 0;
+    for (uint8_t c = 0; c < CHANNEL_COUNT && triggered < max; c++) {
+        if (channels[c].trigger == id) slot[triggered++] = c;
+    }
+    if (triggered == 0) return 0;
+
+    int32_t values[SENSORS_FRAME_MAX_SAMPLES];
+    uint8_t n = sensors_convert_frame(frame, values);
+    if (n == 0) return 0;
+
+    uint16_t period = period_ms[frame->what & 0x07];
+    for (uint8_t k = 0; k < n; k++) {
+        for (uint8_t t = 0; t < triggered; t++) {
+            uint8_t c = slot[t];
+            int32_t v = evaluate(c, values[k], period, k == 0);
+            state[c].value = v;
+            if (channels[c].edges && (v != 0) != state[c].active) {
+                state[c].active = v != 0;
+                log_edge(c, state[c].active);
+            }
+            int16_t s = saturate16(v);
+            out[t].data[2 * k] = (uint8_t)s;
+            out[t].data[2 * k + 1] = (uint8_t)((uint16_t)s >> 8);
+        }
+    }
+
+    uint32_t now = HAL_GetTick();
+    for (uint8_t t = 0; t < triggered; t++) {
+        state[slot[t]].seen = true;
+        state[slot[t]].time = now;
+        out[t].what = (uint8_t)(channels[slot[t]].id << 3) | (frame->what & 0x07);
+        out[t].length = 2 * n;
+        memcpy(out[t].timestamp, frame->timestamp, sizeof(out[t].timestamp));
+    }
+    return triggered;
+}
+
+bool derived_get(uint8_t id, int32_t *value)
+{
+    for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+        if (channels[c].id != id) continue;
+        if (!state[c].seen || HAL_GetTick() - state[c].time > SENSOR_HISTORY_STALE_MS) return false;
+        *value = state[c].value;
+        return true;
+    }
+    return false;
+}
+
+void derived_print(void)
+{
+    for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+        const derived_channel_t *ch = &channels[c];
+        if (!state[c].seen) {
+            dbg_printf("DERIVED: %-9s id %2u from sensor %2u, not evaluated yet\r\n", ch->name, ch->id, ch->trigger);
+            continue;
+        }
+        dbg_printf("DERIVED: %-9s id %2u from sensor %2u, %ld (%lu ms ago)\r\n", ch->name, ch->id, ch->trigger,
+                   state[c].value, HAL_GetTick() - state[c].time);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include "stm32g0xx_hal.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Channels computed on the ECU from the sensors, published as sensors of their own: each
+// gets a free sensor ID (sensors.h) and its own ADC frames, which are logged and summarised
+// to the RIU like any other. sensors_get_data() returns their latest output.
+//
+// A channel is a short node list evaluated once per sample of its trigger sensor, the last
+// node being the output. Nodes read the trigger's current sample, other sensors' newest
+// sample or window slope (sensor_history.h), other channels, or earlier nodes. The output
+// frame mirrors the trigger frame: one value per sample, same rate code and timestamp.
+// Values are int32 internally and saturate to int16 in the frames. Stale inputs read 0.
+//
+// Gated integrals and means restart when their gate opens and hold once it closes, so after
+// a burn they are the totals for that burn. Channels marked as edges log their start and
+// stop to the SD card, with every channel's value at the stop as the post-fire summary.
+// The channel table is in derived.c.
+
+#define DERIVED_MAX_NODES       6U
+#define DERIVED_MAX_CHANNELS    8U
+
+typedef enum {
+    DERIVED_OP_SENSOR = 0,  // Sample of sensor a (the current one if a is the trigger)
+    DERIVED_OP_SLOPE,       // Window slope of sensor a, units per second
+    DERIVED_OP_CHANNEL,     // Latest output of channel a, earlier in the table
+    DERIVED_OP_CONST,       // k
+    DERIVED_OP_ADD,         // Node a + node b
+    DERIVED_OP_SUB,         // Node a - node b
+    DERIVED_OP_SCALE,       // Node a * k / 65536
+    DERIVED_OP_HYST,        // 1 once node a > k, 0 again once it is < k2
+    DERIVED_OP_INTEGRAL,    // Sum of node a * ms / k while node b is non-zero
+    DERIVED_OP_MEAN         // Mean of node a while node b is non-zero
+} derived_op_t;
+
+typedef struct {
+    derived_op_t op;
+    uint8_t a;
+    uint8_t b;
+    int32_t k;
+    int32_t k2;
+} derived_node_t;
+
+typedef struct {
+    const char *name;
+    uint8_t id;                     // Published sensor ID
+    uint8_t trigger;                // Sensor whose samples drive the evaluation
+    bool edges;                     // Log start and stop, with the summary at stop
+    uint8_t nodes;
+    derived_node_t node[DERIVED_MAX_NODES];
+} derived_channel_t;
+
+// Evaluate the channels triggered by this frame's sensor into out, one frame per channel.
+// Call after the frame is in the sensor history. Returns the number of frames written.
+uint8_t derived_add_frame(const CAN_ADCFrame *frame, CAN_ADCFrame *out, uint8_t max);
+
+// Latest output of the channel published as id, false if there is none
+bool derived_get(uint8_t id, int32_t *value);
+
+void derived_print(void);
+
+#endif // DERIVED_H
@@ -0,0 +1,163 @@
+#include "redline.h"
+#include <string.h>
+#include "debug_io.h"
+#include "error_def.h"
+#include "main_FSM.h"
+#include "rs422.h"
+#include "sensors.h"
+#include "sequencer.h"
+
+#define REDLINE_TS_MASK 0xFFFFFFU   // ADC frame timestamps are 24 bit ms
+
+// Rules are independent, a sensor can have several
+static const redline_rule_t rules[] = {
+    // Chamber over 60 bar while burning
+    { SENSOR_P_CHAMBER, true, 600, 3, 1U << STATE_SEQUENCER, true, 0,
+      REDLINE_ACTION_ABORT, ECU_ERROR_CHAMBER_OVERPRESSURE },
+    // Chamber under 5 bar once the burn should be established
+    { SENSOR_P_CHAMBER, false, 50, 10, 1U << STATE_SEQUENCER, true, 300,
+      REDLINE_ACTION_ABORT, ECU_ERROR_CHAMBER_UNDERPRESSURE },
+};
+
+#define REDLINE_RULE_COUNT (sizeof(rules) / sizeof(rules[0]))
+
+typedef struct {
+    uint8_t count;                  // Consecutive samples past the threshold
+    bool tripped;                   // Acted on, until the rule goes inactive or recovers
+} redline_rule_state_t;
+
+static redline_rule_state_t rule_state[REDLINE_RULE_COUNT];
+static redline_stats_t stats;
+
+static main_states_t last_state = STATE_INIT;
+static uint32_t state_entry = 0;
+
+// Smallest (local - remote) timestamp difference, this window and the last
+static uint32_t offset_min[2] = {UINT32_MAX, UINT32_MAX};
+static uint32_t offset_window = 0;
+
+// Sample period in ms for the 3 bit rate code, 1 Hz to 1 kHz
+static const uint16_t period_ms[8] = {1000, 100, 50, 20, 10, 5, 2, 1};
+
+static void update_offset(uint32_t now, uint32_t remote)
+{
+    uint32_t d = (now - remote) & REDLINE_TS_MASK;
+    if (now - offset_window >= REDLINE_OFFSET_WINDOW_MS) {
+        offset_min[1] = offset_min[0];
+        offset_min[0] = d;
+        offset_window = now;
+    } else if (d < offset_min[0]) {
+        offset_min[0] = d;
+    }
+}
+
+static uint32_t sample_latency(uint32_t now, uint32_t sample_remote)
+{
+    uint32_t offset = offset_min[0] < offset_min[1] ? offset_min[0] : offset_min[1];
+    uint32_t latency = (now - sample_remote - offset) & REDLINE_TS_MASK;
+    return latency > REDLINE_TS_MASK / 2U ? 0 : latency; // Faster than the best seen so far
+}
+
+static bool rule_active(const redline_rule_t *rule, main_states_t state, uint32_t now)
+{
+    if ((rule->state_mask & (1U << state)) == 0) {
+        return false;
+    }
+    if (rule->burn_only) {
+        uint32_t burn_ms;
+        return sequencer_in_burn(&burn_ms) && burn_ms >= rule->delay_ms;
+    }
+    return now - state_entry >= rule->delay_ms;
+}
+
+static void trip(uint8_t r, int32_t value, uint32_t sample_remote)
+{
+    const redline_rule_t *rule = &rules[r];
+
+    if (rule->action == REDLINE_ACTION_ABORT) {
+        fsm_set_abort(rule->error_code);
+    } else {
+        rs422_send_error_warning(CAN_ERROR_ACTION_WARNING << 6 | BOARD_ID_ECU, rule->error_code);
+    }
+    uint32_t now = HAL_GetTick();
+    uint32_t latency = sample_latency(now, sample_remote);
+
+    stats.trips++;
+    stats.last_latency_ms = latency;
+    if (latency > stats.max_latency_ms) stats.max_latency_ms = latency;
+    if (latency > REDLINE_LATENCY_BUDGET_MS) stats.over_budget++;
+
+    dbg_printf("REDLINE: sensor %u %ld %s %ld for %u samples, %s, %lu ms after the sample%s\n",
+               rule->sensor_id, value, rule->above ? ">" : "<", rule->threshold, rule->persistence,
+               rule->action == REDLINE_ACTION_ABORT ? "abort" : "warning", latency,
+               latency > REDLINE_LATENCY_BUDGET_MS ? " (over budget)" : "");
+}
+
+void redline_check_frame(const CAN_ADCFrame *frame)
+{
+    uint8_t id = frame->what >> 3;
+    uint32_t now = HAL_GetTick();
+    uint32_t ts = ((uint32_t)frame->timestamp[0] << 16) | ((uint32_t)frame->timestamp[1] << 8) | frame->timestamp[2];
+    update_offset(now, ts);
+
+    main_states_t state = fsm_get_state();
+    if (state != last_state) {
+        last_state = state;
+        state_entry = now;
+    }
+
+    // Rules for this sensor that apply right now, as a bit mask
+    uint32_t active = 0;
+    for (uint8_t r = 0; r < REDLINE_RULE_COUNT; r++) {
+        if (rules[r].sensor_id != id) continue;
+        if (rule_active(&rules[r], state, now)) {
+            active |= 1UL << r;
+        } else {
+            rule_state[r].count = 0;
+            rule_state[r].tripped = false;
+        }
+    }
+    if (active == 0) return;
+
+    int32_t values[SENSORS_FRAME_MAX_SAMPLES];
+    uint8_t n = sensors_convert_frame(frame, values);
+    uint16_t period = period_ms[frame->what & 0x07];
+
+    for (uint8_t k = 0; k < n; k++) {
+        int32_t value = values[k];
+        stats.samples++;
+
+        for (uint8_t r = 0; r < REDLINE_RULE_COUNT; r++) {
+            if ((active & (1UL << r)) == 0) continue;
+            const redline_rule_t *rule = &rules[r];
+            redline_rule_state_t *rs = &rule_state[r];
+            bool past = rule->above ? value > rule->threshold : value < rule->threshold;
+            if (!past) {
+                rs->count = 0;
+                rs->tripped = false;
+                continue;
+            }
+            if (rs->tripped || ++rs->count < rule->persistence) continue;
+            rs->tripped = true;
+            trip(r, value, ts + (uint32_t)k * period);
+            if (rule->action == REDLINE_ACTION_ABORT) return; // The rest of the frame is moot
+        }
+    }
+}
+
+void redline_get_stats(redline_stats_t *out)
+{
+    *out = stats;
+}
+
+void redline_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void redline_print_stats(void)
+{
+    dbg_printf("REDLINE: %u rules, %lu samples checked, %lu trips, latency last %lu ms max %lu ms, %lu over %u ms budget\n",
+               (unsigned)REDLINE_RULE_COUNT, stats.samples, stats.trips, stats.last_latency_ms,
+               stats.max_latency_ms, stats.over_budget, REDLINE_LATENCY_BUDGET_MS);
+}
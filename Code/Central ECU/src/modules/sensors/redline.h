@@ -0,0 +1,52 @@
+#ifndef REDLINE_H
+#define REDLINE_H
+
+#include "stm32g0xx_hal.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Redline rules checked against every sample of every ADC frame as it is handled, instead
+// of the first sample of the latest frame at the FSM tick. The rule table is in redline.c.
+//
+// Latency is measured from the tripping sample to the action. The ADC boards stamp frames
+// with their own clock, so the offset to ours is taken as the smallest (local - remote)
+// seen over the last two REDLINE_OFFSET_WINDOW_MS windows; latency is relative to the
+// fastest frame delivery seen, which is as close as we can get without a shared clock.
+
+#define REDLINE_LATENCY_BUDGET_MS   25U     // Counted and logged when an action is later
+#define REDLINE_OFFSET_WINDOW_MS    10000U
+
+typedef enum {
+    REDLINE_ACTION_ABORT = 0,       // fsm_set_abort(error_code)
+    REDLINE_ACTION_WARN             // Error warning to the RIU, once per excursion
+} redline_action_t;
+
+typedef struct {
+    uint8_t sensor_id;
+    bool above;                     // Trip above the threshold, else below it
+    int32_t threshold;              // Units of sensors_get_data()
+    uint8_t persistence;            // Consecutive samples past the threshold to trip
+    uint16_t state_mask;            // Bit per main_states_t the rule is active in
+    bool burn_only;                 // Also only between T-0 and the end of the burn
+    uint16_t delay_ms;              // Hold off after T-0 (burn rules) or entering the state
+    redline_action_t action;
+    uint8_t error_code;
+} redline_rule_t;
+
+typedef struct {
+    uint32_t samples;               // Samples checked against at least one rule
+    uint32_t trips;
+    uint32_t over_budget;           // Actions later than REDLINE_LATENCY_BUDGET_MS
+    uint32_t max_latency_ms;
+    uint32_t last_latency_ms;
+} redline_stats_t;
+
+// Check every sample of a frame. Call first thing when an ADC frame is handled.
+void redline_check_frame(const CAN_ADCFrame *frame);
+
+void redline_get_stats(redline_stats_t *out);
+void redline_reset_stats(void);
+void redline_print_stats(void);
+
+#endif // REDLINE_H
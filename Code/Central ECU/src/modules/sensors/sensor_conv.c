@@ -0,0 +1,69 @@
+#include "sensor_conv.h"
+
+float sensor_conv_poly(const float *coeffs, uint8_t degree, float x)
+{
+    // Horner's method, highest degree first
+    float y = coeffs[0];
+    for (uint8_t i = 1; i <= degree; i++) {
+        y = y * x + coeffs[i];
+    }
+    return y;
+}
+
+static int32_t to_q4(float y)
+{
+    y *= (float)(1U << SENSOR_CONV_KNOT_FRAC_BITS);
+    return (int32_t)(y + (y >= 0.0f ? 0.5f : -0.5f));
+}
+
+bool sensor_conv_lut_build(sensor_conv_lut_t *lut, const float *coeffs, uint8_t degree,
+                           int32_t in_min, int32_t in_max, uint8_t seg_shift)
+{
+    uint32_t knots = ((uint32_t)(in_max - in_min) >> seg_shift) + 2U;
+    if (in_max <= in_min || knots > SENSOR_CONV_MAX_KNOTS) {
+        return false;
+    }
+    lut->in_min = in_min;
+    lut->in_max = in_max;
+    lut->seg_shift = seg_shift;
+    lut->knots = (uint16_t)knots;
+    lut->max_error_q4 = 0;
+
+    for (uint32_t k = 0; k < knots; k++) {
+        float x = (float)(in_min + (int32_t)(k << seg_shift));
+        lut->knot[k] = to_q4(sensor_conv_poly(coeffs, degree, x));
+    }
+    // The chord is furthest from a smooth curve near the middle of each segment
+    for (uint32_t k = 0; k + 1U < knots; k++) {
+        float x = (float)(in_min + (int32_t)(k << seg_shift)) + (float)(1U << seg_shift) / 2.0f;
+        int32_t exact = to_q4(sensor_conv_poly(coeffs, degree, x));
+        int32_t chord = (lut->knot[k] + lut->knot[k + 1]) / 2;
+        uint32_t err = (uint32_t)(exact > chord ? exact - chord : chord - exact);
+        if (err > lut->max_error_q4) lut->max_error_q4 = err;
+    }
+    return true;
+}
+
+void sensor_conv_linear_init(sensor_conv_linear_t *lin, int32_t in_min, int32_t in_max,
+                             int32_t out_min, int32_t out_max)
+{
+    lin->in_min = in_min;
+    lin->in_max = in_max > in_min ? in_max : in_min + 1;
+    lin->out_min = out_min;
+    lin->out_max = out_max;
+    lin->mul_q16 = ((out_max - out_min) * 65536) / (lin->in_max - lin->in_min);
+}
+
+void sensor_conv_lut_block(const sensor_conv_lut_t *lut, const int16_t *in, int32_t *out, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        out[i] = sensor_conv_lut(lut, in[i]);
+    }
+}
+
+void sensor_conv_linear_block(const sensor_conv_linear_t *lin, const uint16_t *in, int32_t *out, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        out[i] = sensor_conv_linear(lin, in[i]);
+    }
+}
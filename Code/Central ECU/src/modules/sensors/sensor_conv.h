@@ -0,0 +1,73 @@
+#ifndef SENSOR_CONV_H
+#define SENSOR_CONV_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Integer sample conversions for the FPU-less M0+. Curves (thermocouple polynomials) are
+// turned into a piecewise linear table once, from the float reference, and then cost an
+// index, a multiply and two shifts per sample. Straight line conversions are a clamp, a
+// multiply and a shift. Both convert whole blocks of samples.
+//
+// Table knots hold the output in 1/16 units so interpolation adds no rounding of its own;
+// the error is the curve's deviation from its chords plus the final rounding. The build
+// measures it at every segment midpoint, the host test (tools/host/conv_test.c) checks every
+// input.
+
+#define SENSOR_CONV_KNOT_FRAC_BITS  4U
+#define SENSOR_CONV_MAX_KNOTS       330U
+
+typedef struct {
+    int32_t in_min;             // Input of the first knot, lower inputs clamp to it
+    int32_t in_max;             // Higher inputs clamp to this
+    uint8_t seg_shift;          // log2 of the inputs per segment
+    uint16_t knots;
+    uint32_t max_error_q4;      // Largest midpoint error seen while building, 1/16 units
+    int32_t knot[SENSOR_CONV_MAX_KNOTS];
+} sensor_conv_lut_t;
+
+typedef struct {
+    int32_t in_min;             // At or below gives out_min
+    int32_t in_max;             // At or above gives out_max
+    int32_t out_min;
+    int32_t out_max;
+    int32_t mul_q16;            // Output per input step, Q16
+} sensor_conv_linear_t;
+
+// Polynomial, highest order coefficient first, evaluated in float. The reference the
+// tables are built from and checked against.
+float sensor_conv_poly(const float *coeffs, uint8_t degree, float x);
+
+// Build a table of the polynomial over in_min..in_max in segments of 2^seg_shift inputs.
+// False if that needs more than SENSOR_CONV_MAX_KNOTS knots.
+bool sensor_conv_lut_build(sensor_conv_lut_t *lut, const float *coeffs, uint8_t degree,
+                           int32_t in_min, int32_t in_max, uint8_t seg_shift);
+
+// Straight line through (in_min, out_min) and (in_max, out_max). The output span must be
+// under 2^15 so the multiply stays in 32 bits.
+void sensor_conv_linear_init(sensor_conv_linear_t *lin, int32_t in_min, int32_t in_max,
+                             int32_t out_min, int32_t out_max);
+
+static inline int32_t sensor_conv_lut(const sensor_conv_lut_t *lut, int32_t x)
+{
+    if (x < lut->in_min) x = lut->in_min;
+    if (x > lut->in_max) x = lut->in_max;
+    uint32_t pos = (uint32_t)(x - lut->in_min);
+    uint32_t i = pos >> lut->seg_shift;
+    int32_t frac = (int32_t)(pos & ((1UL << lut->seg_shift) - 1U));
+    int32_t y = lut->knot[i] + (((lut->knot[i + 1] - lut->knot[i]) * frac) >> lut->seg_shift);
+    return (y + (1 << (SENSOR_CONV_KNOT_FRAC_BITS - 1))) >> SENSOR_CONV_KNOT_FRAC_BITS;
+}
+
+static inline int32_t sensor_conv_linear(const sensor_conv_linear_t *lin, int32_t x)
+{
+    if (x <= lin->in_min) return lin->out_min;
+    if (x >= lin->in_max) return lin->out_max;
+    return lin->out_min + (((x - lin->in_min) * lin->mul_q16) >> 16);
+}
+
+void sensor_conv_lut_block(const sensor_conv_lut_t *lut, const int16_t *in, int32_t *out, uint16_t n);
+void sensor_conv_linear_block(const sensor_conv_linear_t *lin, const uint16_t *in, int32_t *out, uint16_t n);
+
+#endif // SENSOR_CONV_H
@@ -0,0 +1,230 @@
+#include "sensor_history.h"
+#include "debug_io.h"
+#include "sensors.h"
+
+#if SENSOR_HISTORY_LEN > 256U || (SENSOR_HISTORY_LEN & (SENSOR_HISTORY_LEN - 1U)) != 0
+#error "SENSOR_HISTORY_LEN must be a power of two, at most 256"
+#endif
+
+#define HIST_MASK       (SENSOR_HISTORY_LEN - 1U)
+#define REBASE_MS       0x10000U    // Keeps the slope sums well inside int64
+
+// Tracked sensors and their window
+static const struct {
+    uint8_t id;
+    uint16_t window_ms;
+} tracked[] = {
+    { SENSOR_P_CHAMBER,   100 },
+    { SENSOR_P_MANIFOLD,  100 },
+    { SENSOR_PT_MAINLINE, 100 },
+    { SENSOR_PT_BRANCH_A, 100 },
+    { SENSOR_PT_BRANCH_B, 100 },
+    { SENSOR_THERMO_A,    1000 },
+    { SENSOR_THERMO_B,    1000 },
+    { SENSOR_THERMO_C,    1000 },
+    { SENSOR_CJT,         1000 },
+    { SENSOR_LC_Thrust,   100 },
+    { SENSOR_LC_N2O_A,    1000 },
+    { SENSOR_LC_N2O_B,    1000 },
+};
+
+#define TRACKED_COUNT (sizeof(tracked) / sizeof(tracked[0]))
+
+// Monotonic deque of ring indices
+typedef struct {
+    uint8_t idx[SENSOR_HISTORY_LEN];
+    uint8_t head;
+    uint16_t count;
+} hist_deque_t;
+
+typedef struct {
+    int32_t value[SENSOR_HISTORY_LEN];
+    uint32_t time[SENSOR_HISTORY_LEN];
+    uint8_t next;               // Next write
+    uint16_t count;             // In the ring
+    uint8_t win_start;          // Oldest sample in the window
+    uint16_t win_count;
+    hist_deque_t minq;          // Values increasing from the front
+    hist_deque_t maxq;          // Values decreasing from the front
+    uint32_t base;              // Slope sums use times relative to this
+    int64_t sum_v;
+    int64_t sum_t;
+    int64_t sum_tt;
+    int64_t sum_tv;
+} sensor_hist_t;
+
+static sensor_hist_t hist[TRACKED_COUNT];
+static uint8_t slot_of[32];     // Sensor id to hist index + 1, 0 if not tracked
+static bool slots_ready = false;
+
+// Sample period in ms for the 3 bit rate code, 1 Hz to 1 kHz
+static const uint16_t period_ms[8] = {1000, 100, 50, 20, 10, 5, 2, 1};
+
+static sensor_hist_t *lookup(uint8_t id, uint16_t *window_ms)
+{
+    if (!slots_ready) {
+        for (uint8_t i = 0; i < TRACKED_COUNT; i++) {
+            slot_of[tracked[i].id] = i + 1;
+        }
+        slots_ready = true;
+    }
+    if (id >= sizeof(slot_of) || slot_of[id] == 0) return NULL;
+    if (window_ms) *window_ms = tracked[slot_of[id] - 1].window_ms;
+    return &hist[slot_of[id] - 1];
+}
+
+static inline uint8_t dq_front(const hist_deque_t *q)
+{
+    return q->idx[q->head];
+}
+
+static inline uint8_t dq_back(const hist_deque_t *q)
+{
+    return q->idx[(q->head + q->count - 1U) & HIST_MASK];
+}
+
+static void window_evict(sensor_hist_t *h)
+{
+    uint8_t i = h->win_start;
+    int64_t t = (int64_t)(h->time[i] - h->base);
+    int64_t v = h->value[i];
+    h->sum_v -= v;
+    h->sum_t -= t;
+    h->sum_tt -= t * t;
+    h->sum_tv -= t * v;
+    if (h->minq.count && dq_front(&h->minq) == i) { h->minq.head = (h->minq.head + 1U) & HIST_MASK; h->minq.count--; }
+    if (h->maxq.count && dq_front(&h->maxq) == i) { h->maxq.head = (h->maxq.head + 1U) & HIST_MASK; h->maxq.count--; }
+    h->win_start = (i + 1U) & HIST_MASK;
+    h->win_count--;
+}
+
+// Move the time base up to the oldest sample in the window, in O(1):
+// sum(t - d) = sum(t) - n.d, sum((t - d)^2) = sum(t^2) - 2d.sum(t) + n.d^2, sum((t - d)v) = sum(tv) - d.sum(v)
+static void rebase(sensor_hist_t *h, uint32_t now)
+{
+    if (h->win_count == 0) {
+        h->base = now;
+        h->sum_v = h->sum_t = h->sum_tt = h->sum_tv = 0;
+        return;
+    }
+    int64_t d = (int64_t)(h->time[h->win_start] - h->base);
+    int64_t n = h->win_count;
+    h->sum_tt -= 2 * d * h->sum_t - n * d * d;
+    h->sum_tv -= d * h->sum_v;
+    h->sum_t -= n * d;
+    h->base += (uint32_t)d;
+}
+
+static void push(sensor_hist_t *h, uint16_t window_ms, int32_t v, uint32_t t)
+{
+    if (h->count > 0) {
+        uint32_t newest = h->time[(h->next - 1U) & HIST_MASK];
+        if ((int32_t)(t - newest) < 0) t = newest; // Frames may overlap, keep time monotonic
+    }
+    if (h->count == SENSOR_HISTORY_LEN && h->win_count == SENSOR_HISTORY_LEN) {
+        window_evict(h); // The oldest is about to be overwritten
+    }
+    if (h->win_count == 0 || t - h->base >= REBASE_MS) {
+        rebase(h, t);
+    }
+
+    uint8_t i = h->next;
+    h->value[i] = v;
+    h->time[i] = t;
+    h->next = (i + 1U) & HIST_MASK;
+    if (h->count < SENSOR_HISTORY_LEN) h->count++;
+    if (h->win_count == 0) h->win_start = i;
+    h->win_count++;
+
+    int64_t rt = (int64_t)(t - h->base);
+    h->sum_v += v;
+    h->sum_t += rt;
+    h->sum_tt += rt * rt;
+    h->sum_tv += rt * v;
+
+    while (h->minq.count && h->value[dq_back(&h->minq)] >= v) h->minq.count--;
+    h->minq.idx[(h->minq.head + h->minq.count++) & HIST_MASK] = i;
+    while (h->maxq.count && h->value[dq_back(&h->maxq)] <= v) h->maxq.count--;
+    h->maxq.idx[(h->maxq.head + h->maxq.count++) & HIST_MASK] = i;
+
+    while (h->win_count > 1 && t - h->time[h->win_start] > window_ms) {
+        window_evict(h);
+    }
+}
+
+void sensor_history_add_frame(const CAN_ADCFrame *frame)
+{
+    uint8_t id = frame->what >> 3;
+    uint16_t window_ms;
+    sensor_hist_t *h = lookup(id, &window_ms);
+    if (h == NULL) return;
+
+    int32_t values[SENSORS_FRAME_MAX_SAMPLES];
+    uint8_t n = sensors_convert_frame(frame, values);
+    if (n == 0) return;
+
+    uint16_t period = period_ms[frame->what & 0x07];
+    uint32_t t = HAL_GetTick() - (uint32_t)(n - 1) * period;
+    for (uint8_t k = 0; k < n; k++, t += period) {
+        push(h, window_ms, values[k], t);
+    }
+}
+
+static bool fresh(const sensor_hist_t *h)
+{
+    if (h == NULL || h->count == 0) return false;
+    return HAL_GetTick() - h->time[(h->next - 1U) & HIST_MASK] <= SENSOR_HISTORY_STALE_MS;
+}
+
+bool sensor_history_get_stats(uint8_t id, sensor_history_stats_t *out)
+{
+    uint16_t window_ms;
+    sensor_hist_t *h = lookup(id, &window_ms);
+    if (!fresh(h)) return false;
+
+    int64_t n = h->win_count;
+    out->count = h->win_count;
+    out->window_ms = window_ms;
+    out->mean = (int32_t)(h->sum_v / n);
+    out->min = h->value[dq_front(&h->minq)];
+    out->max = h->value[dq_front(&h->maxq)];
+    out->last = h->value[(h->next - 1U) & HIST_MASK];
+    out->newest_ms = h->time[(h->next - 1U) & HIST_MASK];
+
+    int64_t den = n * h->sum_tt - h->sum_t * h->sum_t;
+    out->slope_per_s = (n < 2 || den == 0) ? 0 : (int32_t)((n * h->sum_tv - h->sum_t * h->sum_v) * 1000 / den);
+    return true;
+}
+
+bool sensor_history_latest(uint8_t id, int32_t *value, uint32_t *time_ms)
+{
+    sensor_hist_t *h = lookup(id, NULL);
+    if (!fresh(h)) return false;
+    uint8_t i = (h->next - 1U) & HIST_MASK;
+    if (value) *value = h->value[i];
+    if (time_ms) *time_ms = h->time[i];
+    return true;
+}
+
+uint16_t sensor_history_read(uint8_t id, int32_t *values, uint16_t max)
+{
+    sensor_hist_t *h = lookup(id, NULL);
+    if (h == NULL) return 0;
+    uint16_t n = h->count < max ? h->count : max;
+    uint8_t i = (h->next - n) & HIST_MASK;
+    for (uint16_t k = 0; k < n; k++, i = (i + 1U) & HIST_MASK) {
+        values[k] = h->value[i];
+    }
+    return n;
+}
+
+void sensor_history_print(uint8_t id)
+{
+    sensor_history_stats_t s;
+    if (!sensor_history_get_stats(id, &s)) {
+        dbg_printf("HIST: sensor %u not tracked or no recent data\r\n", id);
+        return;
+    }
+    dbg_printf("HIST: sensor %u last %ld, over %u ms (%u samples) mean %ld min %ld max %ld slope %ld/s\r\n",
+               id, s.last, s.window_ms, s.count, s.mean, s.min, s.max, s.slope_per_s);
+}
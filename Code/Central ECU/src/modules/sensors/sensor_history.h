@@ -0,0 +1,45 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include "stm32g0xx_hal.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Every sample of every tracked sensor, converted to the units of sensors_get_data(), in a
+// ring per sensor. Each sensor also keeps a sliding window of its last window_ms (table in
+// sensor_history.c) with mean, min, max and least squares slope, all updated in O(1) per
+// sample: running sums for the mean and slope, monotonic deques for min and max.
+//
+// Sample times are local ms. The last sample of a frame is taken to be the arrival time and
+// the others are spaced back from it at the frame's sample rate.
+
+#define SENSOR_HISTORY_LEN          256U    // Samples per sensor, at most 256 (uint8_t indices)
+#define SENSOR_HISTORY_STALE_MS     5000U   // Nothing newer than this and queries fail
+
+typedef struct {
+    uint16_t count;             // Samples in the window
+    uint16_t window_ms;
+    int32_t mean;
+    int32_t min;
+    int32_t max;
+    int32_t last;
+    int32_t slope_per_s;        // Units per second, 0 with fewer than two samples
+    uint32_t newest_ms;         // HAL tick of the newest sample
+} sensor_history_stats_t;
+
+// Every sample of an ADC frame into its sensor's ring
+void sensor_history_add_frame(const CAN_ADCFrame *frame);
+
+// Window statistics, false if the sensor is not tracked or has gone stale
+bool sensor_history_get_stats(uint8_t id, sensor_history_stats_t *out);
+
+// Newest sample, false if the sensor is not tracked or has gone stale
+bool sensor_history_latest(uint8_t id, int32_t *value, uint32_t *time_ms);
+
+// Copy up to max of the newest samples, oldest first. Returns the number copied.
+uint16_t sensor_history_read(uint8_t id, int32_t *values, uint16_t max);
+
+void sensor_history_print(uint8_t id);
+
+#endif // SENSOR_HISTORY_H
@@ -0,0 +1,156 @@
+#include "sensor_seq.h"
+#include <string.h>
+#include "debug_io.h"
+#include "sd_log.h"
+
+#define SEQ_MAX_ID      32U     // 5 bit sensor IDs
+#define TS_MASK         0xFFFFFFU
+#define TS_BACKWARDS    0x800000U
+
+typedef struct {
+    bool synced;
+    uint8_t next;               // Expected sequence number
+    uint8_t what;               // Of the last frame, for the gap records
+    uint8_t last_ts[3];         // ADC timestamp of the last frame
+    uint32_t frame_ms;          // Interval between the last two consecutive frames, 0 unknown
+    uint32_t sd_accounted;      // sd_log_sensor_records_dropped() already counted
+    uint32_t gaps_accounted;    // sd_log_sensor_gap_frames_dropped() already logged again
+    sensor_seq_stats_t stats;
+} seq_stream_t;
+
+static seq_stream_t streams[SEQ_MAX_ID];
+
+// Bit per (sensor, seq) of frames the ISR dropped and the main loop has not reached yet
+static uint32_t rx_dropped[SEQ_MAX_ID][256U / 32U];
+
+static inline uint32_t ts24(const uint8_t ts[3])
+{
+    return ((uint32_t)ts[0] << 16) | ((uint32_t)ts[1] << 8) | ts[2];
+}
+
+void sensor_seq_note_rx_drop(const CAN_ADCFrame *frame)
+{
+    if ((frame->length & 1U) == 0 || frame->length > sizeof(frame->data)) return;
+    uint8_t id = frame->what >> 3;
+    uint8_t seq = frame->data[frame->length - 1U];
+    rx_dropped[id][seq >> 5] |= 1UL << (seq & 31U);
+}
+
+// Claim the ISR's mark for this frame, if it dropped it
+static bool take_rx_drop(uint8_t id, uint8_t seq)
+{
+    uint32_t bit = 1UL << (seq & 31U);
+    __disable_irq();
+    bool dropped = (rx_dropped[id][seq >> 5] & bit) != 0;
+    rx_dropped[id][seq >> 5] &= ~bit;
+    __enable_irq();
+    return dropped;
+}
+
+static void log_gap(const seq_stream_t *s, uint8_t seq, uint32_t lost, sensor_seq_stage_t stage)
+{
+    if (lost == 0) return;
+    uint16_t n = lost > UINT16_MAX ? UINT16_MAX : (uint16_t)lost;
+    sd_log_write_sensor_gap(s->what, s->last_ts, seq, n, stage);
+}
+
+static void resync(seq_stream_t *s, uint8_t id, uint8_t seq)
+{
+    s->synced = true;
+    s->next = seq;
+    s->frame_ms = 0;
+    s->stats.resyncs++;
+    __disable_irq();
+    memset(rx_dropped[id], 0, sizeof(rx_dropped[id])); // Marks from before the restart
+    __enable_irq();
+}
+
+void sensor_seq_check(const CAN_ADCFrame *frame)
+{
+    if ((frame->length & 1U) == 0 || frame->length > sizeof(frame->data)) return;
+    uint8_t id = frame->what >> 3;
+    uint8_t seq = frame->data[frame->length - 1U];
+    seq_stream_t *s = &streams[id];
+    uint32_t dt = (ts24(frame->timestamp) - ts24(s->last_ts)) & TS_MASK;
+
+    if (!s->synced || (dt & TS_BACKWARDS)) {
+        if (s->synced) dbg_printf("SEQ: sensor %u restarted at seq %u\r\n", id, seq);
+        resync(s, id, seq);
+    } else {
+        uint32_t lost = (uint8_t)(seq - s->next);
+        if (s->frame_ms) {
+            // Gaps of 256 or more alias, the timestamps tell how many wraps went by
+            uint32_t missed = dt / s->frame_ms;
+            missed = missed ? missed - 1U : 0;
+            if (missed > lost + 128U) lost += ((missed - lost + 128U) / 256U) * 256U;
+        }
+        if (lost == 0) {
+            s->frame_ms = dt;
+        } else {
+            uint32_t rx = 0;
+            for (uint32_t k = 0; k < lost && k < 256U; k++) {
+                if (take_rx_drop(id, (uint8_t)(s->next + k))) rx++;
+            }
+            // Whole wraps are past the ISR marks, they went missing before the queue
+            uint32_t link = lost - rx;
+            s->stats.lost_link += link;
+            s->stats.lost_rx_queue += rx;
+            log_gap(s, s->next, link, SENSOR_SEQ_STAGE_LINK);
+            log_gap(s, s->next, rx, SENSOR_SEQ_STAGE_RX_QUEUE);
+            dbg_printf("SEQ: sensor %u lost %lu frames before seq %u (%lu link, %lu RX queue)\r\n",
+                       id, lost, seq, link, rx);
+        }
+    }
+
+    s->stats.frames++;
+    s->next = (uint8_t)(seq + 1U);
+    s->what = frame->what;
+    memcpy(s->last_ts, frame->timestamp, sizeof(s->last_ts));
+}
+
+void sensor_seq_poll(void)
+{
+    for (uint8_t id = 0; id < SEQ_MAX_ID; id++) {
+        seq_stream_t *s = &streams[id];
+        uint32_t dropped = sd_log_sensor_records_dropped(id);
+        uint32_t gaps = sd_log_sensor_gap_frames_dropped(id);
+        uint32_t lost = dropped - s->sd_accounted;
+        uint32_t relog = gaps - s->gaps_accounted; // Already in the stats under their own stage
+        if (lost == 0 && relog == 0) continue;
+        s->sd_accounted = dropped;
+        s->gaps_accounted = gaps;
+        s->stats.lost_sd += lost;
+        // The dropped records are gone, the gap record carries the newest frame's seq and time
+        if (s->stats.frames == 0) s->what = (uint8_t)(id << 3);
+        log_gap(s, s->next, lost + relog, SENSOR_SEQ_STAGE_SD);
+    }
+}
+
+bool sensor_seq_get_stats(uint8_t id, sensor_seq_stats_t *out)
+{
+    if (id >= SEQ_MAX_ID) return false;
+    const sensor_seq_stats_t *st = &streams[id].stats;
+    if (st->frames == 0 && st->lost_sd == 0) return false;
+    *out = *st;
+    return true;
+}
+
+void sensor_seq_reset_stats(void)
+{
+    for (uint8_t id = 0; id < SEQ_MAX_ID; id++) {
+        memset(&streams[id].stats, 0, sizeof(streams[id].stats));
+    }
+}
+
+void sensor_seq_print(void)
+{
+    bool any = false;
+    for (uint8_t id = 0; id < SEQ_MAX_ID; id++) {
+        sensor_seq_stats_t st;
+        if (!sensor_seq_get_stats(id, &st)) continue;
+        any = true;
+        dbg_printf("SEQ: sensor %2u %lu frames, lost %lu link %lu RX queue %lu SD, %u resyncs, %lu ms/frame\r\n",
+                   id, st.frames, st.lost_link, st.lost_rx_queue, st.lost_sd, st.resyncs, streams[id].frame_ms);
+    }
+    if (!any) dbg_printf("SEQ: no sequenced sensor frames yet\r\n");
+}
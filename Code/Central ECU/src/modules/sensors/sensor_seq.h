@@ -0,0 +1,52 @@
+#ifndef SENSOR_SEQ_H
+#define SENSOR_SEQ_H
+
+#include "stm32g0xx_hal.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Per sensor frame sequence tracking, so lost frames are counted rather than looking like a
+// quiet sensor. The ADC boards number each sensor's frames (frames.h, odd length); a jump in
+// the number is a gap, attributed to the stage that lost it:
+//   LINK      never reached the RX queue: ADC TX queue full, bus errors, FDCAN FIFO overrun
+//   RX_QUEUE  received, but the RX queue was full (noted per seq from the CAN ISR)
+//   SD        handled, but dropped from the SD sensor ring before it reached the card
+// Every gap is written to the sensor file as a gap record (sd_log.h) and the counts go to
+// the RIU with the sensor summaries (sensor_summary.h). A gap record that is itself dropped
+// from the SD ring is written again as an SD gap, counted once in the stats.
+//
+// The sequence number wraps at 256. Longer gaps are sized from the ADC timestamps and the
+// frame interval seen before the gap. A timestamp going backwards means the ADC board
+// restarted, the stream resyncs without counting a gap.
+
+typedef enum {
+    SENSOR_SEQ_STAGE_LINK = 0,
+    SENSOR_SEQ_STAGE_RX_QUEUE,
+    SENSOR_SEQ_STAGE_SD
+} sensor_seq_stage_t;
+
+typedef struct {
+    uint32_t frames;                // Sequenced frames received
+    uint32_t lost_link;
+    uint32_t lost_rx_queue;
+    uint32_t lost_sd;               // Also counts derived channel frames, which have no seq
+    uint16_t resyncs;               // First frame and ADC restarts
+} sensor_seq_stats_t;
+
+// CAN ISR: an ADC frame is being dropped because the RX queue is full
+void sensor_seq_note_rx_drop(const CAN_ADCFrame *frame);
+
+// Check an ADC frame's sequence number, logging any gap before it. Frames without one are
+// ignored. Call before the frame is written to the SD card.
+void sensor_seq_check(const CAN_ADCFrame *frame);
+
+// Pick up frames dropped from the SD sensor ring. 100 ms task.
+void sensor_seq_poll(void);
+
+// False if nothing was received or lost for this sensor
+bool sensor_seq_get_stats(uint8_t id, sensor_seq_stats_t *out);
+void sensor_seq_reset_stats(void);
+void sensor_seq_print(void);
+
+#endif // SENSOR_SEQ_H
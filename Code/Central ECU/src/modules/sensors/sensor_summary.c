@@ -0,0 +1,135 @@
+#include "sensor_summary.h"
+#include "sensors.h"
+#include "sensor_seq.h"
+#include "rs422.h"
+
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint16_t count;
+    int16_t last;
+    uint16_t reference;     // MIPA only, latest reference sample
+} sensor_summary_t;
+
+static sensor_summary_t summary[SENSOR_SUMMARY_MAX_ID];
+static uint8_t summary_hz = SENSOR_SUMMARY_DEFAULT_HZ;
+static uint32_t last_send = 0;
+static uint32_t last_loss_send = 0;
+
+void sensor_summary_add(const CAN_ADCFrame *frame)
+{
+    uint8_t id = frame->what >> 3;
+    if (id >= SENSOR_SUMMARY_MAX_ID || summary_hz == 0) return;
+
+    uint8_t length = frame->length;
+    if (length > sizeof(frame->data)) length = sizeof(frame->data);
+    uint8_t samples = length / 2;
+    uint8_t stride = 1;
+
+    sensor_summary_t *s = &summary[id];
+    if (id <= SENSOR_P_MANIFOLD) {
+        // Last sample is the supply reference, not a reading
+        if (samples < 2) return;
+        samples--;
+        s->reference = frame->data[2 * samples] | (frame->data[2 * samples + 1] << 8);
+    } else if (id >= SENSOR_PT_MAINLINE && id <= SENSOR_PT_BRANCH_B) {
+        stride = 2; // Pressure and temperature interleaved
+    }
+
+    for (uint8_t i = 0; i < samples; i += stride) {
+        int16_t v = (int16_t)(frame->data[2 * i] | (frame->data[2 * i + 1] << 8));
+        if (id <= SENSOR_P_MANIFOLD) {
+            // Ratiometric value is unsigned; offset so it orders correctly as int16
+            v = (int16_t)(sensors_pressure_ratiometric((uint16_t)v, s->reference) - 0x8000);
+        }
+        if (s->count == 0 || v < s->min) s->min = v;
+        if (s->count == 0 || v > s->max) s->max = v;
+        s->sum += v;
+        s->count++;
+        s->last = v;
+    }
+}
+
+static uint8_t *put_i16(uint8_t *p, int16_t v, bool ratiometric)
+{
+    uint16_t u = ratiometric ? (uint16_t)(v + 0x8000) : (uint16_t)v;
+    p[0] = (uint8_t)u;
+    p[1] = (uint8_t)(u >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_count(uint8_t *p, uint32_t v)
+{
+    uint16_t u = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+    p[0] = (uint8_t)u;
+    p[1] = (uint8_t)(u >> 8);
+    return p + 2;
+}
+
+static void send_summaries(bool losses)
+{
+    uint8_t payload[SENSOR_SUMMARY_PER_FRAME * SENSOR_SUMMARY_ENTRY_SIZE];
+    uint8_t entries = 0;
+    uint8_t *p = payload;
+
+    for (uint8_t id = 0; id < SENSOR_SUMMARY_MAX_ID; id++) {
+        sensor_seq_stats_t st;
+        if (losses && sensor_seq_get_stats(id, &st)) {
+            *p++ = SENSOR_SUMMARY_LOSS_FLAG | id;
+            p = put_count(p, st.lost_link);
+            p = put_count(p, st.lost_rx_queue);
+            p = put_count(p, st.lost_sd);
+            p = put_count(p, st.frames);
+            if (++entries == SENSOR_SUMMARY_PER_FRAME) {
+                rs422_send_data(payload, p - payload, RS422_FRAME_SENSOR_SUMMARY);
+                entries = 0;
+                p = payload;
+            }
+        }
+
+        sensor_summary_t *s = &summary[id];
+        if (s->count == 0) continue; // Nothing heard this period
+
+        bool ratiometric = (id <= SENSOR_P_MANIFOLD);
+        *p++ = id;
+        p = put_i16(p, s->min, ratiometric);
+        p = put_i16(p, s->max, ratiometric);
+        p = put_i16(p, (int16_t)(s->sum / s->count), ratiometric);
+        p = put_i16(p, s->last, ratiometric);
+        s->count = 0;
+        s->sum = 0;
+
+        if (++entries == SENSOR_SUMMARY_PER_FRAME) {
+            rs422_send_data(payload, p - payload, RS422_FRAME_SENSOR_SUMMARY);
+            entries = 0;
+            p = payload;
+        }
+    }
+    if (entries > 0) {
+        rs422_send_data(payload, p - payload, RS422_FRAME_SENSOR_SUMMARY);
+    }
+}
+
+void sensor_summary_poll(void)
+{
+    if (summary_hz == 0) return;
+
+    uint32_t now = HAL_GetTick();
+    if (now - last_send < 1000U / summary_hz) return;
+    last_send = now;
+    bool losses = now - last_loss_send >= SENSOR_SUMMARY_LOSS_MS;
+    if (losses) last_loss_send = now;
+    send_summaries(losses);
+}
+
+void sensor_summary_set_rate(uint8_t hz)
+{
+    if (hz > SENSOR_SUMMARY_MAX_HZ) hz = SENSOR_SUMMARY_MAX_HZ;
+    summary_hz = hz;
+}
+
+uint8_t sensor_summary_get_rate(void)
+{
+    return summary_hz;
+}
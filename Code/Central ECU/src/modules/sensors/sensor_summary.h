@@ -0,0 +1,44 @@
+#ifndef SENSOR_SUMMARY_H
+#define SENSOR_SUMMARY_H
+
+#include "stm32g0xx_hal.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Per sensor min/max/mean/last over every sample received from the ADC boards, sent to the
+// RIU at the display rate instead of forwarding raw CAN frames.
+//
+// RS422_FRAME_SENSOR_SUMMARY payload: up to SENSOR_SUMMARY_PER_FRAME entries of
+//   [sensor id][min][max][mean][last]    values int16 LE
+// Values are raw ADC counts as in the CAN frame, except MIPA pressure which is already
+// scaled against its reference to 0-0xFFFF of range (see sensors_pressure_ratiometric).
+// PT entries cover the pressure samples only.
+//
+// Once every SENSOR_SUMMARY_LOSS_MS the same frames also carry a frame loss entry per
+// sensor that has sent sequenced frames or lost any (sensor_seq.h), flagged by the top bit:
+//   [0x80 | sensor id][lost link][lost RX queue][lost SD][frames]    uint16 LE, since boot
+// Counts saturate at 0xFFFF.
+
+#define SENSOR_SUMMARY_MAX_ID           32U     // 5 bit sensor IDs
+#define SENSOR_SUMMARY_ENTRY_SIZE       9U
+#define SENSOR_SUMMARY_PER_FRAME        7U      // 63 bytes, fits one RS422 frame
+#define SENSOR_SUMMARY_DEFAULT_HZ       20U
+#define SENSOR_SUMMARY_MAX_HZ           100U
+#define SENSOR_SUMMARY_LOSS_FLAG        0x80U
+#define SENSOR_SUMMARY_LOSS_MS          1000U
+
+// Keep forwarding every raw ADC frame to the RIU as well (old behaviour)
+#define SENSOR_SUMMARY_FORWARD_RAW      0
+
+// Fold every sample of an ADC frame into the current period
+void sensor_summary_add(const CAN_ADCFrame *frame);
+
+// Send the summaries once per period. Call every few ms.
+void sensor_summary_poll(void);
+
+// Display rate in Hz, 0 stops the summaries
+void sensor_summary_set_rate(uint8_t hz);
+uint8_t sensor_summary_get_rate(void);
+
+#endif // SENSOR_SUMMARY_H
@@ -1,93 +1,161 @@
 #include "sensors.h"
+#include "sensor_history.h"
+#include "sensor_conv.h"
+#include "debug_io.h"
+#include "cycle_count.h"
+#include "calibration.h"
+#include "derived.h"
 
-sensor_reading_t sensor_data[3][3] = {{0}};
+// Thermocouple ADC counts (int16) to centi-Celsius with the calibration's 7th-degree
+// polynomial, tabulated over SENSORS_THERMO_IN_MIN..SENSORS_THERMO_IN_MAX whenever the
+// calibration changes; sensor_conv_poly() evaluates it directly for checking.
+#define THERMO_SEG_SHIFT 7U     // 128 counts per segment, 321 knots, about 1 centi-C worst case
 
-// Convert thermocouple ADC counts (int16) to centi-Celsius using a 7th-degree polynomial.
-// Coefficients derived from Python (NumPy) fit:
-// coeffs = [-8.46349804e-27,  7.10985650e-22, -2.14114276e-17,  2.48424392e-13,
-//            -1.63198889e-10, -1.40441053e-05,  1.52510733e+00, -2.25001136e+00]
-// The evaluation uses Horner's method with single-precision floats for efficiency on Cortex-M0+.
-static inline int32_t thermo_counts_to_centiC(int16_t counts)
+static sensor_conv_lut_t thermo_lut;
+static bool conv_ready = false;
+
+void sensors_init(void)
 {
-    const float x = (float)counts;
-    // Horner's method, highest degree first
-    float y = -8.46349804e-27f;
-    y = y * x + 7.10985650e-22f;
-    y = y * x + -2.14114276e-17f;
-    y = y * x + 2.48424392e-13f;
-    y = y * x + -1.63198889e-10f;
-    y = y * x + -1.40441053e-05f;
-    y = y * x + 1.52510733e+00f;
-    y = y * x + -2.25001136e+00f;
+    if (!sensor_conv_lut_build(&thermo_lut, calibration_get()->thermo_coeffs, SENSORS_THERMO_DEGREE,
+                               SENSORS_THERMO_IN_MIN, SENSORS_THERMO_IN_MAX, THERMO_SEG_SHIFT)) {
+        dbg_printf("SENSORS: Thermocouple table does not fit\r\n");
+        return;
+    }
+    conv_ready = true;
+}
 
-    // Round to nearest integer centi-Celsius
-    return (int32_t)(y + (y >= 0.0f ? 0.5f : -0.5f));
+// 10*bar over the calibrated span of the MIPA supply reference (PTE7100: 10-90%, 0-50 bar)
+static void mipa_line(sensor_conv_linear_t *lin, uint16_t reference)
+{
+    const calibration_t *cal = calibration_get();
+    sensor_conv_linear_init(lin, (reference * (uint32_t)cal->mipa_zero_permille) / 1000U,
+                            (reference * (uint32_t)cal->mipa_span_permille) / 1000U, 0, cal->mipa_full_scale);
 }
 
-// Stores pressure as 
-void sensors_add_pressure(uint8_t id, uint16_t first_sample, uint16_t reference) {
-    // Add a pressure sensor reading
-    // value is the raw ADC value (0-65535)
+uint16_t sensors_pressure_ratiometric(uint16_t sample, uint16_t reference) {
+    // sample is the raw ADC value (0-65535)
     // reference is the reference voltage (0-65535) corresponding to 0-100% of sensor range
-    // Map value such that 0.1 * reference is the zero output level and 0.9 * reference is 0xFFFF
-    uint32_t in_min = reference / 10;         // 0.1 * reference
-    uint32_t in_max = (reference * 9) / 10;   // 0.9 * reference
+    // Map value such that the calibrated zero (0.1 * reference) is 0 and full scale (0.9 * reference) is 0xFFFF
+    const calibration_t *cal = calibration_get();
+    uint32_t in_min = (reference * (uint32_t)cal->mipa_zero_permille) / 1000U;
+    uint32_t in_max = (reference * (uint32_t)cal->mipa_span_permille) / 1000U;
 
-    if (first_sample <= in_min) first_sample = 0x0000;
-    else if (first_sample >= in_max) first_sample = 0xFFFF;
-    else {
-        uint32_t range = in_max - in_min;
-        uint32_t scaled = (first_sample - in_min) * 65535UL / range;
-        first_sample = (uint16_t)scaled;
-    }
-    // Convert to 10*bar, reading correspond to 0-50bar with PTE7100
-    int32_t pressure_cbar = (first_sample * 100UL) / 13107UL;
+    if (sample <= in_min) return 0x0000;
+    if (sample >= in_max) return 0xFFFF;
+    uint32_t range = in_max - in_min;
+    return (uint16_t)((sample - in_min) * 65535UL / range);
+}
 
-    uint8_t type = (id >> 3) & 0x03; // Bits 3-4 for type
-    uint8_t sub_id = id & 0x07;      // Bits 0
-    if (type <= 2 && sub_id <= 2) {
-        sensor_data[type][sub_id].value = pressure_cbar;
-        sensor_data[type][sub_id].rx_time = HAL_GetTick();
+int32_t sensors_convert(uint8_t id, int16_t sample, uint16_t reference) {
+    if (id <= SENSOR_P_MANIFOLD) {
+        // Convert to 10*bar, reading correspond to 0-50bar with PTE7100
+        sensor_conv_linear_t lin;
+        mipa_line(&lin, reference);
+        return sensor_conv_linear(&lin, (uint16_t)sample);
+    } else if (id >= SENSOR_THERMO_A && id <= SENSOR_THERMO_C) {
+        if (!conv_ready) sensors_init();
+        return sensor_conv_lut(&thermo_lut, sample);
+    } else if (id >= SENSOR_PT_MAINLINE && id <= SENSOR_PT_BRANCH_B) {
+        // Value maps from 0->100bar with values -16000->16000
+        const calibration_t *cal = calibration_get();
+        return ((int32_t)sample + cal->pt_offset) / cal->pt_divisor; // Scale to bar * 10
     }
+    return sample;
 }
 
-void sensors_add_temperature(uint8_t id, int16_t value) {
-    // Add a temperature sensor reading
-    // Value is thermocouple voltage in ADC counts; convert to centi-Celsius via polynomial fit
-    uint8_t type = (id >> 3) & 0x03; // Bits 3-4 for type
-    uint8_t sub_id = id & 0x07;      // Bits 0-2 for sub ID
-    if (type <= 2 && sub_id <= 2) {
-        int32_t centi_c = thermo_counts_to_centiC(value);
-        sensor_data[type][sub_id].value = centi_c;
-        sensor_data[type][sub_id].rx_time = HAL_GetTick();
+int32_t sensors_get_data(uint8_t id) {
+    // Get the latest sensor reading by ID, -1 if not tracked or older than 5 seconds
+    int32_t value;
+    if (derived_get(id, &value)) {
+        return value;
     }
+    if (!sensor_history_latest(id, &value, NULL)) {
+        return -1;
+    }
+    return value;
 }
 
-void sensors_add_pt(uint8_t id, int16_t value) {
-    // Add a PT sensor reading (only pressure part)
-    // Value maps from 0->100bar with values -16000->16000
-    // Converts to millibar
-    uint8_t type = (id >> 3) & 0x03; // Bits 3-4 for type
-    uint8_t sub_id = id & 0x07;      // Bits 0-2 for sub ID
-    int32_t pressure_mbar = ((int32_t)value + 16000) / 32; // Scale to bar * 10
-    if (type <= 2 && sub_id <= 2) {
-        sensor_data[type][sub_id].value = pressure_mbar;
-        sensor_data[type][sub_id].rx_time = HAL_GetTick();
+uint8_t sensors_convert_frame(const CAN_ADCFrame *frame, int32_t *out)
+{
+    uint8_t id = frame->what >> 3;
+    uint8_t length = frame->length;
+    if (length > sizeof(frame->data)) length = sizeof(frame->data);
+    uint8_t samples = length / 2;
+    uint8_t stride = 1;
+    uint16_t reference = 0;
+    if (id <= SENSOR_P_MANIFOLD) {
+        // Last sample is the supply reference, not a reading
+        if (samples < 2) return 0;
+        samples--;
+        reference = frame->data[2 * samples] | (frame->data[2 * samples + 1] << 8);
+    } else if (id >= SENSOR_PT_MAINLINE && id <= SENSOR_PT_BRANCH_B) {
+        stride = 2; // Pressure and temperature interleaved
     }
-}
 
-int32_t sensors_get_data(uint8_t id) {
-    // Get the latest sensor reading by ID
-    uint8_t type = (id >> 3) & 0x03; // Bits 3-4 for type
-    uint8_t sub_id = id & 0x07;      // Bits 0-2 for sub ID
-    if (type <= 2 && sub_id <= 2) {
-        sensor_reading_t reading = sensor_data[type][sub_id];
-        // If data is older than 5 seconds, consider it stale and return -1
-        if (HAL_GetTick() - reading.rx_time > 5000) {
-            return -1;
-        }
-        return reading.value;
+    // Gather the readings, the frame bytes are unaligned
+    uint16_t raw[SENSORS_FRAME_MAX_SAMPLES];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < samples; i += stride) {
+        raw[n++] = frame->data[2 * i] | (frame->data[2 * i + 1] << 8);
+    }
+
+    if (id <= SENSOR_P_MANIFOLD) {
+        sensor_conv_linear_t lin;
+        mipa_line(&lin, reference);
+        sensor_conv_linear_block(&lin, raw, out, n);
+    } else if (id >= SENSOR_THERMO_A && id <= SENSOR_THERMO_C) {
+        if (!conv_ready) sensors_init();
+        sensor_conv_lut_block(&thermo_lut, (const int16_t *)raw, out, n);
     } else {
-        return -1;
+        for (uint8_t k = 0; k < n; k++) {
+            out[k] = sensors_convert(id, (int16_t)raw[k], reference);
+        }
+    }
+    return n;
+}
+
+// Float reference for the MIPA line, as it was converted before the integer line
+static int32_t mipa_reference(uint16_t sample, uint16_t reference)
+{
+    return (sensors_pressure_ratiometric(sample, reference) * (uint32_t)calibration_get()->mipa_full_scale) / 0xFFFFUL;
+}
+
+void sensors_conv_bench(void)
+{
+    if (!conv_ready) sensors_init();
+    dbg_printf("CONV: thermo table %u knots, build estimate %lu/16 centi-C\r\n",
+               thermo_lut.knots, thermo_lut.max_error_q4);
+
+    // Cycles per sample on a full frame, old per sample path against the block path
+    uint16_t raw[SENSORS_FRAME_MAX_SAMPLES];
+    int32_t out[SENSORS_FRAME_MAX_SAMPLES];
+    volatile int32_t sink = 0;
+    for (uint8_t i = 0; i < SENSORS_FRAME_MAX_SAMPLES; i++) {
+        raw[i] = (uint16_t)(i * 1031U + 700U);
+    }
+    cycle_count_init();
+    uint32_t start = cycle_count_now();
+    for (uint8_t i = 0; i < SENSORS_FRAME_MAX_SAMPLES; i++) {
+        float y = sensor_conv_poly(calibration_get()->thermo_coeffs, SENSORS_THERMO_DEGREE, (float)(int16_t)raw[i]);
+        sink += (int32_t)(y + (y >= 0.0f ? 0.5f : -0.5f));
     }
-}
\ No newline at end of file
+    uint32_t poly_cycles = cycle_count_since(start);
+    start = cycle_count_now();
+    sensor_conv_lut_block(&thermo_lut, (const int16_t *)raw, out, SENSORS_FRAME_MAX_SAMPLES);
+    uint32_t lut_cycles = cycle_count_since(start);
+    start = cycle_count_now();
+    for (uint8_t i = 0; i < SENSORS_FRAME_MAX_SAMPLES; i++) {
+        sink += mipa_reference(raw[i], 60000);
+    }
+    uint32_t div_cycles = cycle_count_since(start);
+    start = cycle_count_now();
+    sensor_conv_linear_t lin;
+    mipa_line(&lin, 60000);
+    sensor_conv_linear_block(&lin, raw, out, SENSORS_FRAME_MAX_SAMPLES);
+    uint32_t lin_cycles = cycle_count_since(start);
+    (void)sink;
+
+    dbg_printf("CONV bench: thermo float %lu, table %lu cycles/sample; MIPA divide %lu, line %lu cycles/sample\r\n",
+               poly_cycles / SENSORS_FRAME_MAX_SAMPLES, lut_cycles / SENSORS_FRAME_MAX_SAMPLES,
+               div_cycles / SENSORS_FRAME_MAX_SAMPLES, lin_cycles / SENSORS_FRAME_MAX_SAMPLES);
+}
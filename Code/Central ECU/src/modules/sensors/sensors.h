@@ -3,6 +3,8 @@
 
 #include "stm32g0xx_hal.h"
 #include "config.h"
+#include "frames.h"
+#include <stdbool.h>
 
 #define SENSOR_P_CHAMBER 0u   // MIPA A ID
 #define SENSOR_P_MANIFOLD 1u  // MIPA B ID
@@ -20,15 +22,43 @@
 #define SENSOR_THERMO_C 10u  // Thermo C ID 
 #define SENSOR_CJT 11u       // CJT ID
 
-typedef struct {
-    int32_t value;
-    int32_t rx_time;
-} sensor_reading_t;
+// Derived channels, computed on the ECU (see derived.h)
+#define SENSOR_D_BURN 2u          // 1 while burning, from chamber pressure
+#define SENSOR_D_BURN_TIME 3u     // Burn duration so far, 10 ms
+#define SENSOR_D_PC_MEAN 4u       // Mean chamber pressure over the burn, 10*bar
+#define SENSOR_D_OX_FLOW 27u      // N2O flow out of the tank, load cell counts per second
+#define SENSOR_D_OX_USED 28u      // N2O used over the burn, load cell counts
+#define SENSOR_D_IMPULSE 29u      // Total impulse over the burn, thrust counts * s
 
-void sensors_add_pressure(uint8_t id, uint16_t value, uint16_t reference);
-void sensors_add_temperature(uint8_t id, int16_t value);
-void sensors_add_pt(uint8_t id, int16_t value);                             // Only decodes the pressure part of PT sensors
+#define SENSORS_FRAME_MAX_SAMPLES   (sizeof(((CAN_ADCFrame *)0)->data) / 2U)
+#define SENSORS_CONV_MAX_ERROR      2   // Integer conversions against the float originals, output units
 
+// Thermocouple polynomial (calibration thermo_coeffs) and the ADC counts it is fitted over,
+// inputs outside convert as the nearest end
+#define SENSORS_THERMO_DEGREE       7U
+#define SENSORS_THERMO_IN_MIN       (-8192)
+#define SENSORS_THERMO_IN_MAX       32767
+
+// Build the conversion tables. Before frames arrive; conversions build them on first use otherwise.
+void sensors_init(void);
+
+// Newest sample from the sensor history (see sensor_history.h) or derived channel, -1 if stale
 int32_t sensors_get_data(uint8_t id);
 
+// One raw sample to the units sensors_get_data() returns. reference is the MIPA supply
+// reference sample, unused for other sensors.
+int32_t sensors_convert(uint8_t id, int16_t sample, uint16_t reference);
+
+// Every reading in an ADC frame to the units sensors_get_data() returns, in block
+// conversions. Skips the MIPA reference and the PT temperatures. out must hold
+// SENSORS_FRAME_MAX_SAMPLES. Returns the number of readings.
+uint8_t sensors_convert_frame(const CAN_ADCFrame *frame, int32_t *out);
+
+// Cycles per sample of the integer conversions and of the float code they replaced. Their
+// accuracy is checked on the host, tools/host/conv_test.c.
+void sensors_conv_bench(void);
+
+// Raw MIPA sample to 0-0xFFFF of sensor range, using the supply reference sent with each frame
+uint16_t sensors_pressure_ratiometric(uint16_t sample, uint16_t reference);
+
 #endif // SENSORS_H
\ No newline at end of file
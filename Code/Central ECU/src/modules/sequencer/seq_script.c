@@ -0,0 +1,320 @@
+#include "seq_script.h"
+#include <stdlib.h>
+#include <string.h>
+#include "crc.h"
+#include "debug_io.h"
+#include "sd_log.h"
+#include "servo.h"
+
+#define SEQ_SCRIPT_LINE_MAX 96U
+
+// Used when there is no SEQ_SCRIPT_FILE on the card
+static const char default_script[] =
+    "countdown 20000\n"
+    "burn 6000\n"
+    "T-16000 servo_arm\n"
+    "T-15000 open nos_a, open nos_b\n"
+    "T-6000 checks\n"
+    "T-5000 arm\n"
+    "T-3000 ignite\n"
+    "T-2000 ignite_off\n"
+    "T0 solenoid_open\n"
+    "B0 solenoid_close, close nos_a, close nos_b\n"
+    "B1000 open vent\n"
+    "B6000 open nitrogen\n"
+    "B8000 close vent, solenoid_open\n"
+    "B13000 solenoid_close, disarm, close nitrogen\n"
+    "B14000 open vent\n"
+    "B20000 close vent, end\n";
+
+static const char *op_names[SEQ_OP_COUNT] = {
+    [SEQ_OP_SERVO_ARM] = "servo_arm",
+    [SEQ_OP_OPEN] = "open",
+    [SEQ_OP_CLOSE] = "close",
+    [SEQ_OP_CHECKS] = "checks",
+    [SEQ_OP_ARM] = "arm",
+    [SEQ_OP_DISARM] = "disarm",
+    [SEQ_OP_IGNITE] = "ignite",
+    [SEQ_OP_IGNITE_OFF] = "ignite_off",
+    [SEQ_OP_SOLENOID_OPEN] = "solenoid_open",
+    [SEQ_OP_SOLENOID_CLOSE] = "solenoid_close",
+    [SEQ_OP_END] = "end"
+};
+
+// Indexed by valve_index_t
+static const char *valve_names[] = {"vent", "nitrogen", "nos_a", "nos_b"};
+
+#define VALVE_NAME_COUNT (sizeof(valve_names) / sizeof(valve_names[0]))
+
+static char script_buf[SEQ_SCRIPT_MAX_SIZE + 1];
+
+// Output state as the script leaves it, for the safety checks
+typedef struct {
+    bool checked;
+    bool armed;
+    bool igniter;
+    bool solenoid;
+    bool t0;
+    bool ended;
+    int32_t ignite_ms;
+} script_sim_t;
+
+const char *seq_script_op_name(uint8_t op)
+{
+    return op < SEQ_OP_COUNT ? op_names[op] : "?";
+}
+
+const char *seq_script_valve_name(uint8_t valve)
+{
+    return valve < VALVE_NAME_COUNT ? valve_names[valve] : "?";
+}
+
+static bool fail(uint16_t line, const char *msg)
+{
+    dbg_printf("SEQ script line %u: %s\n", line, msg);
+    return false;
+}
+
+static bool parse_ms(const char *s, int32_t *out)
+{
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || v < -(long)SEQ_SCRIPT_MAX_AFTER_MS || v > (long)SEQ_SCRIPT_MAX_AFTER_MS) {
+        return false;
+    }
+    *out = (int32_t)v;
+    return true;
+}
+
+// One "name [valve]" op, in place in a line already split at commas
+static bool parse_op(char *s, seq_script_op_t *op)
+{
+    char *name = strtok(s, " \t");
+    char *arg = strtok(NULL, " \t");
+    if (name == NULL || strtok(NULL, " \t") != NULL) return false;
+
+    for (uint8_t i = 0; i < SEQ_OP_COUNT; i++) {
+        if (strcmp(name, op_names[i]) != 0) continue;
+        op->op = i;
+        op->arg = 0;
+        if (i != SEQ_OP_OPEN && i != SEQ_OP_CLOSE) {
+            return arg == NULL;
+        }
+        if (arg == NULL) return false;
+        for (uint8_t v = 0; v < VALVE_NAME_COUNT; v++) {
+            if (strcmp(arg, valve_names[v]) == 0) {
+                op->arg = v;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+// Run one step's ops against the simulated outputs
+static bool check_step(const seq_script_step_t *step, uint16_t line, script_sim_t *sim)
+{
+    bool t0 = !step->after_burn && step->execution_ms == 0;
+    if (t0 && sim->igniter) return fail(line, "igniter still on at T0");
+    if (step->after_burn && !sim->t0) return fail(line, "no T0 step");
+    sim->t0 = sim->t0 || t0;
+    // The timer interrupt runs every op of a step at once, the checks and the arm result are
+    // only looked at from the main loop afterwards, so a gate only holds back later steps
+    if (step->gate && step->op_count != 1) return fail(line, "checks and arm need a step of their own");
+
+    for (uint8_t i = 0; i < step->op_count; i++) {
+        if (sim->ended) return fail(line, "ops after end");
+        switch (step->ops[i].op) {
+            case SEQ_OP_CHECKS:
+                if (step->after_burn || sim->checked) return fail(line, "checks must be in the countdown, once");
+                sim->checked = true;
+                break;
+            case SEQ_OP_ARM:
+                if (step->after_burn || !sim->checked || sim->armed) return fail(line, "arm must follow checks in the countdown, once");
+                sim->armed = true;
+                break;
+            case SEQ_OP_DISARM:
+                if (!step->after_burn) return fail(line, "disarm before the burn");
+                if (sim->solenoid) return fail(line, "disarm with the solenoid open");
+                sim->armed = false;
+                break;
+            case SEQ_OP_IGNITE:
+                if (step->after_burn || t0 || !sim->armed) return fail(line, "ignite must be armed and before T0");
+                sim->igniter = true;
+                sim->ignite_ms = step->execution_ms;
+                break;
+            case SEQ_OP_IGNITE_OFF:
+                if (sim->igniter && step->execution_ms - sim->ignite_ms > (int32_t)SEQ_SCRIPT_MAX_IGNITE_MS) {
+                    return fail(line, "igniter on too long");
+                }
+                sim->igniter = false;
+                break;
+            case SEQ_OP_SOLENOID_OPEN:
+                if (!sim->armed) return fail(line, "solenoid_open while disarmed");
+                if (!step->after_burn && !t0) return fail(line, "solenoid_open before T0");
+                sim->solenoid = true;
+                break;
+            case SEQ_OP_SOLENOID_CLOSE:
+                sim->solenoid = false;
+                break;
+            case SEQ_OP_END:
+                if (!step->after_burn) return fail(line, "end before the burn");
+                if (sim->solenoid || sim->igniter || sim->armed) {
+                    return fail(line, "end needs solenoid closed, igniter off and disarmed");
+                }
+                sim->ended = true;
+                break;
+            default:
+                break;
+        }
+    }
+    if (t0 && !sim->solenoid) return fail(line, "T0 must open the solenoid");
+    return true;
+}
+
+// Split a step line "T-5000 op, op" into out. Returns false on a syntax error.
+static bool parse_step(char *s, seq_script_step_t *step)
+{
+    step->after_burn = (s[0] == 'B');
+    char *ops = strpbrk(s, " \t");
+    if (ops == NULL) return false;
+    *ops++ = '\0';
+    if (!parse_ms(&s[1], &step->execution_ms)) return false;
+
+    step->op_count = 0;
+    step->gate = false;
+    char *next = ops;
+    while (next != NULL) {
+        char *op = next;
+        next = strchr(op, ',');
+        if (next != NULL) *next++ = '\0';
+        if (step->op_count >= SEQ_SCRIPT_MAX_OPS) return false;
+        seq_script_op_t *o = &step->ops[step->op_count++];
+        if (!parse_op(op, o)) return false;
+        if (o->op == SEQ_OP_CHECKS || o->op == SEQ_OP_ARM) step->gate = true;
+    }
+    return true;
+}
+
+bool seq_script_parse(const char *text, uint32_t length, seq_script_t *out)
+{
+    script_sim_t sim = {0};
+    char line[SEQ_SCRIPT_LINE_MAX];
+    uint16_t line_no = 0;
+    uint32_t pos = 0;
+
+    memset(out, 0, sizeof(*out));
+    while (pos < length) {
+        // Copy out one line without the comment and surrounding whitespace
+        uint32_t n = 0;
+        bool comment = false;
+        line_no++;
+        while (pos < length && text[pos] != '\n') {
+            char c = text[pos++];
+            if (c == '#') comment = true;
+            if (comment || c == '\r') continue;
+            if (n >= sizeof(line) - 1) return fail(line_no, "line too long");
+            line[n++] = c;
+        }
+        pos++;
+        while (n > 0 && (line[n - 1] == ' ' || line[n - 1] == '\t')) n--;
+        line[n] = '\0';
+        char *s = line;
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0') continue;
+
+        if (s[0] == 'T' || s[0] == 'B') {
+            if (out->step_count >= SEQ_SCRIPT_MAX_STEPS) return fail(line_no, "too many steps");
+            seq_script_step_t *step = &out->steps[out->step_count];
+            if (!parse_step(s, step)) return fail(line_no, "bad step");
+
+            if (step->after_burn) {
+                if (step->execution_ms < 0) return fail(line_no, "negative time after the burn");
+            } else if (step->execution_ms > 0 || step->execution_ms < -(int32_t)out->countdown_ms) {
+                return fail(line_no, "countdown step outside the countdown");
+            }
+            if (out->step_count == 0) {
+                if (out->countdown_ms == 0 || out->burn_ms == 0) return fail(line_no, "countdown and burn must come first");
+            } else {
+                const seq_script_step_t *prev = &out->steps[out->step_count - 1];
+                if (prev->after_burn && !step->after_burn) return fail(line_no, "countdown step after the burn steps");
+                if (prev->after_burn == step->after_burn && step->execution_ms <= prev->execution_ms) {
+                    return fail(line_no, "steps out of order");
+                }
+            }
+            if (step->after_burn && (out->step_count == 0 || !out->steps[out->step_count - 1].after_burn)) {
+                // First step after the burn ends it
+                bool closes = false;
+                for (uint8_t i = 0; i < step->op_count; i++) {
+                    if (step->ops[i].op == SEQ_OP_SOLENOID_CLOSE) closes = true;
+                }
+                if (step->execution_ms != 0 || !closes) return fail(line_no, "B0 must close the solenoid");
+            }
+            if (!check_step(step, line_no, &sim)) return false;
+            out->step_count++;
+        } else {
+            char *key = strtok(s, " \t");
+            char *value = strtok(NULL, " \t");
+            int32_t ms;
+            if (value == NULL || strtok(NULL, " \t") != NULL || !parse_ms(value, &ms)) {
+                return fail(line_no, "bad setting");
+            }
+            if (out->step_count > 0) return fail(line_no, "settings must come before the steps");
+            if (strcmp(key, "countdown") == 0) {
+                if (ms < (int32_t)SEQ_SCRIPT_MIN_COUNTDOWN_MS || ms > (int32_t)SEQ_SCRIPT_MAX_COUNTDOWN_MS) {
+                    return fail(line_no, "countdown out of range");
+                }
+                out->countdown_ms = (uint32_t)ms;
+            } else if (strcmp(key, "burn") == 0) {
+                if (ms < (int32_t)SEQ_SCRIPT_MIN_BURN_MS || ms > (int32_t)SEQ_SCRIPT_MAX_BURN_MS) {
+                    return fail(line_no, "burn out of range");
+                }
+                out->burn_ms = (uint16_t)ms;
+            } else {
+                return fail(line_no, "unknown setting");
+            }
+        }
+    }
+    if (!sim.ended) return fail(line_no, "no end");
+
+    crc16_ctx_t crc;
+    crc16_begin(&crc);
+    crc16_update(&crc, (const uint8_t *)text, length);
+    out->crc = crc.crc; // Full 32 bits, more useful than the 16 bit link checksum here
+    return true;
+}
+
+bool seq_script_load(seq_script_t *out)
+{
+    FIL file;
+    UINT n = 0;
+    const char *name = "built in";
+    bool ok;
+
+    FRESULT res = f_open(&file, SEQ_SCRIPT_FILE, FA_READ);
+    if (res == FR_NO_FILE) {
+        ok = seq_script_parse(default_script, sizeof(default_script) - 1, out);
+    } else {
+        name = SEQ_SCRIPT_FILE;
+        ok = (res == FR_OK);
+        if (ok && f_size(&file) > SEQ_SCRIPT_MAX_SIZE) {
+            dbg_printf("SEQ script: %s larger than %u bytes\n", name, SEQ_SCRIPT_MAX_SIZE);
+            ok = false;
+        }
+        ok = ok && f_read(&file, script_buf, SEQ_SCRIPT_MAX_SIZE, &n) == FR_OK;
+        if (res == FR_OK) (void)f_close(&file);
+        ok = ok && seq_script_parse(script_buf, n, out);
+        out->from_card = true;
+    }
+
+    if (!ok) {
+        dbg_printf("SEQ script: %s rejected, firing disabled\n", name);
+        sd_log_write(SD_LOG_ERROR, "SEQ script %s rejected", name);
+        return false;
+    }
+    dbg_printf("SEQ script: %s, crc %08lX, %u steps, countdown %lu ms, burn %u ms\n",
+               name, out->crc, out->step_count, out->countdown_ms, out->burn_ms);
+    sd_log_write(SD_LOG_INFO, "SEQ script %s crc %08lX", name, out->crc);
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef SEQ_SCRIPT_H
+#define SEQ_SCRIPT_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sequence script, read from SEQ_SCRIPT_FILE in the card root at init so timings can be
+// changed between runs without a reflash. Without the file the built in default is used.
+// Text, one step per line, '#' starts a comment:
+//   countdown 20000                     Countdown length in ms (fire button to T-0)
+//   burn 6000                           Burn length used when the fire command gives none
+//   T-5000 arm                          Step at T-5 s
+//   T0 solenoid_open                    The T-0 step, ends the countdown
+//   B1000 open vent, close nitrogen     Step 1 s after the burn ends (T+burn+1 s)
+// Ops: servo_arm, open <valve>, close <valve>, checks, arm, disarm, ignite, ignite_off,
+//      solenoid_open, solenoid_close, end. Valves: vent, nitrogen, nos_a, nos_b.
+//
+// The whole script is checked before it is accepted, see seq_script_parse(). A script on
+// the card that fails the checks is not replaced by the default, the sequencer refuses to
+// fire until it is fixed.
+
+#define SEQ_SCRIPT_FILE             "SEQ.TXT"
+#define SEQ_SCRIPT_MAX_SIZE         2048U
+#define SEQ_SCRIPT_MAX_STEPS        24U
+#define SEQ_SCRIPT_MAX_OPS          4U      // Per step
+#define SEQ_SCRIPT_MIN_COUNTDOWN_MS 10000U
+#define SEQ_SCRIPT_MAX_COUNTDOWN_MS 60000U
+#define SEQ_SCRIPT_MIN_BURN_MS      1000U
+#define SEQ_SCRIPT_MAX_BURN_MS      10000U  // Same limit as the fire command
+#define SEQ_SCRIPT_MAX_AFTER_MS     60000U  // Last step after the burn
+#define SEQ_SCRIPT_MAX_IGNITE_MS    2000U   // Igniter on time
+
+typedef enum {
+    SEQ_OP_SERVO_ARM = 0,
+    SEQ_OP_OPEN,                // arg valve_index_t
+    SEQ_OP_CLOSE,               // arg valve_index_t
+    SEQ_OP_CHECKS,              // Pre-ignition checks, abort on failure
+    SEQ_OP_ARM,
+    SEQ_OP_DISARM,
+    SEQ_OP_IGNITE,
+    SEQ_OP_IGNITE_OFF,
+    SEQ_OP_SOLENOID_OPEN,
+    SEQ_OP_SOLENOID_CLOSE,
+    SEQ_OP_END,                 // Sequence complete, to post fire
+    SEQ_OP_COUNT
+} seq_op_t;
+
+typedef struct {
+    uint8_t op;                 // seq_op_t
+    uint8_t arg;
+} seq_script_op_t;
+
+typedef struct {
+    int32_t execution_ms;       // From T-0, or from burn completion if after_burn
+    bool after_burn;
+    bool gate;                  // Has checks or arm, the sequencer waits for the result
+    uint8_t op_count;
+    seq_script_op_t ops[SEQ_SCRIPT_MAX_OPS];
+} seq_script_step_t;
+
+typedef struct {
+    uint32_t countdown_ms;
+    uint16_t burn_ms;
+    uint8_t step_count;
+    seq_script_step_t steps[SEQ_SCRIPT_MAX_STEPS];
+    uint32_t crc;               // CRC-32/MPEG-2 of the script text, logged with every run
+    bool from_card;
+} seq_script_t;
+
+// Parse and check a script. Besides syntax and limits the checks are:
+//  - steps in time order, countdown steps within the countdown and before the burn steps
+//  - checks before arm, arm before ignite and solenoid_open, igniter on at most
+//    SEQ_SCRIPT_MAX_IGNITE_MS and off again before T-0
+//  - checks and arm alone in their step, nothing runs before their result is in
+//  - a T0 step that opens the solenoid, a B0 step that closes it
+//  - end as the last op, with the solenoid closed, igniter off and spicy disarmed, the
+//    same state an abort leaves the outputs in
+// Errors are printed with their line number. Returns false if the script is unusable.
+bool seq_script_parse(const char *text, uint32_t length, seq_script_t *out);
+
+// Load SEQ_SCRIPT_FILE, or the built in script if there is none. Call after sd_log_init.
+bool seq_script_load(seq_script_t *out);
+
+const char *seq_script_op_name(uint8_t op);
+const char *seq_script_valve_name(uint8_t valve);
+
+#endif // SEQ_SCRIPT_H
@@ -0,0 +1,100 @@
+#include "seq_timer.h"
+
+static volatile uint16_t overflows = 0;    // Upper 16 bits of the timeline
+static volatile bool armed = false;
+static volatile uint32_t target_us = 0;
+static seq_timer_fn callback = NULL;
+
+// Timeline read that also accounts for an overflow the interrupt has not counted yet
+static uint32_t now_us_locked(void)
+{
+    uint16_t hi = overflows;
+    uint16_t lo = (uint16_t)TIM3->CNT;
+    if ((TIM3->SR & TIM_SR_UIF) && lo < 0x8000U) {
+        hi++;
+    }
+    return ((uint32_t)hi << 16) | lo;
+}
+
+// Program channel 1 if the counter reaches the target's low half at the target, i.e. it is
+// less than a full period away. Interrupts off or in the ISR.
+static void arm_compare(void)
+{
+    uint32_t delta = target_us - now_us_locked();
+    if ((int32_t)delta > (int32_t)0xFFFFU) {
+        return; // The overflow interrupt looks again, at most one period before the target
+    }
+    TIM3->CCR1 = (uint16_t)target_us;
+    TIM3->SR = ~TIM_SR_CC1IF;
+    TIM3->DIER |= TIM_DIER_CC1IE;
+    if ((int32_t)(target_us - now_us_locked()) <= 0) {
+        // Already due (or passed while programming), a match would be a full wrap away
+        TIM3->EGR = TIM_EGR_CC1G;
+    }
+}
+
+void seq_timer_init(void)
+{
+    __HAL_RCC_TIM3_CLK_ENABLE();
+
+    TIM3->CR1 = 0;
+    TIM3->PSC = HAL_RCC_GetPCLK1Freq() / SEQ_TIMER_HZ - 1U; // APB prescaler is 1, TIMCLK = PCLK
+    TIM3->ARR = 0xFFFFU;
+    TIM3->CCMR1 = 0;            // Channel 1 frozen output compare, used for its interrupt only
+    TIM3->CNT = 0;
+    TIM3->EGR = TIM_EGR_UG;     // Load the prescaler
+    TIM3->SR = 0;
+    TIM3->DIER = TIM_DIER_UIE;
+    overflows = 0;
+
+    HAL_NVIC_SetPriority(TIM3_TIM4_IRQn, SEQ_TIMER_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM3_TIM4_IRQn);
+    TIM3->CR1 = TIM_CR1_CEN;
+}
+
+uint32_t seq_timer_now_us(void)
+{
+    __disable_irq();
+    uint32_t now = now_us_locked();
+    __enable_irq();
+    return now;
+}
+
+void seq_timer_schedule(uint32_t at_us, seq_timer_fn fn)
+{
+    __disable_irq();
+    TIM3->DIER &= ~TIM_DIER_CC1IE;
+    callback = fn;
+    target_us = at_us;
+    armed = true;
+    arm_compare();
+    __enable_irq();
+}
+
+void seq_timer_cancel(void)
+{
+    __disable_irq();
+    armed = false;
+    TIM3->DIER &= ~TIM_DIER_CC1IE;
+    TIM3->SR = ~TIM_SR_CC1IF;
+    __enable_irq();
+}
+
+void TIM3_TIM4_IRQHandler(void)
+{
+    if (TIM3->SR & TIM_SR_UIF) {
+        TIM3->SR = ~TIM_SR_UIF;
+        overflows++;
+        if (armed && !(TIM3->DIER & TIM_DIER_CC1IE)) {
+            arm_compare();
+        }
+    }
+    if ((TIM3->SR & TIM_SR_CC1IF) && (TIM3->DIER & TIM_DIER_CC1IE)) {
+        TIM3->SR = ~TIM_SR_CC1IF;
+        TIM3->DIER &= ~TIM_DIER_CC1IE;
+        armed = false;
+        if (callback != NULL) {
+            callback(); // May schedule the next event
+        }
+    }
+}
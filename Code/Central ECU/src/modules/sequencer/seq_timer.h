@@ -0,0 +1,27 @@
+#ifndef SEQ_TIMER_H
+#define SEQ_TIMER_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Microsecond timeline for the sequencer on TIM3 (TIM2 is the 1 ms HAL tick). TIM3 counts
+// at 1 MHz and its overflows extend it to 32 bits (wraps after ~71 minutes). One compare
+// event at a time on channel 1, armed once the target is less than a counter period away
+// (the overflow interrupt re-checks targets further out). The callback runs in the TIM3
+// interrupt, so it must only do bounded work (GPIO, queueing CAN frames) and no logging.
+
+#define SEQ_TIMER_HZ            1000000U
+#define SEQ_TIMER_IRQ_PRIORITY  0U
+
+typedef void (*seq_timer_fn)(void);
+
+void seq_timer_init(void);
+uint32_t seq_timer_now_us(void);
+
+// Call fn from the timer interrupt at at_us, or straight away if that time has passed.
+// Replaces any pending event.
+void seq_timer_schedule(uint32_t at_us, seq_timer_fn fn);
+void seq_timer_cancel(void);
+
+#endif // SEQ_TIMER_H
@@ -10,30 +10,63 @@
 #include "rs422.h"
 #include "error_def.h"
 #include "sensors.h"
-
-#define COUNTDOWN_START_MS 20000
+#include "sensor_history.h"
+#include "sd_log.h"
+#include "seq_timer.h"
+#include "seq_script.h"
+#include "fsm_monitor.h"
+
+// Measured against the plan by the timer interrupt
+typedef struct {
+    int32_t late_us;                // Action start minus planned time
+    uint16_t action_us;             // Time spent in the action
+    bool ok;
+} sequencer_event_t;
 
 static sequencer_states_t sequencer_state = SEQUENCER_UNINITIALISED;
-static uint32_t sequencer_start_tick = 0u;
-static uint8_t task_list_index = 0;
+static uint32_t t0_us = 0;                  // T-0 on the sequencer timer
 static uint16_t burn_time = 6000; // Default burn time if not set by RS422 command
 
+// Steps run in table order. Note that the after burn times DO NOT include the burn time,
+// times are after burn completion
+static seq_script_t script;
+static bool script_ok = false;
+
+static sequencer_event_t events[SEQ_SCRIPT_MAX_STEPS];
+static volatile uint8_t events_done = 0;    // Advanced by the timer interrupt
+static uint8_t events_reported = 0;
+
 // Static declarations
-static void countdown_tasks(void);
-static void fire_tasks(void);
+static void schedule_next(void);
+static void report_events(void);
 
 static int32_t get_countdown(void)
 {
-    return HAL_GetTick() - (sequencer_start_tick + COUNTDOWN_START_MS);
+    return (int32_t)(seq_timer_now_us() - t0_us) / 1000;
+}
+
+void sequencer_init(void)
+{
+    seq_timer_init();
+    script_ok = seq_script_load(&script);
+    if (script_ok) {
+        burn_time = script.burn_ms;
+    }
 }
 
 void sequencer_set_state(sequencer_states_t new_state)
 {
     dbg_printf("SEQ: State change %d -> %d\n", sequencer_state, new_state);
+    if (new_state != SEQUENCER_COUNTDOWN && new_state != SEQUENCER_FIRE) {
+        seq_timer_cancel(); // Nothing scripted may run once the sequence is left
+    }
     sequencer_state = new_state;
-    task_list_index = 0;
     if (new_state == SEQUENCER_COUNTDOWN) {
-        sequencer_start_tick = HAL_GetTick();
+        memset(events, 0, sizeof(events));
+        events_done = 0;
+        events_reported = 0;
+        t0_us = seq_timer_now_us() + script.countdown_ms * 1000U;
+        schedule_next();
     }
 }
 
@@ -42,17 +75,45 @@ sequencer_states_t sequencer_get_state(void)
     return sequencer_state;
 }
 
-void sequencer_fire(uint8_t length)
+bool sequencer_in_burn(uint32_t *ms_into_burn)
 {
-    if (length == 0) length = 6;
-    if (sequencer_state == SEQUENCER_READY && length <= 10) {
+    if (sequencer_state != SEQUENCER_COUNTDOWN && sequencer_state != SEQUENCER_FIRE) {
+        return false;
+    }
+    int32_t t = get_countdown(); // From the step timer, not the T-0 report
+    if (t < 0 || t >= burn_time) {
+        return false;
+    }
+    *ms_into_burn = (uint32_t)t;
+    return true;
+}
+
+// Returns false if the countdown was not started (not ready, no valid script or burn too long)
+bool sequencer_fire(uint8_t length)
+{
+    if (!script_ok) {
+        dbg_printf("SEQ: No valid sequence script, not firing\n");
+        return false;
+    }
+    // The FSM only sees an ESTOP press on its next dispatch, a fire command handled before
+    // that would start a countdown only to abort it
+    if (!comp_get_interlock()) {
+        dbg_printf("SEQ: ESTOP pressed, not firing\n");
+        return false;
+    }
+    uint16_t burn_ms = (length == 0) ? script.burn_ms : length * 1000; // Convert to ms
+    if (sequencer_state == SEQUENCER_READY && burn_ms <= SEQ_SCRIPT_MAX_BURN_MS) {
         char msg[6];
-        snprintf(msg, sizeof(msg), "CFL:%d", length);
+        snprintf(msg, sizeof(msg), "CFL:%d", burn_ms / 1000);
         rs422_send_string_message(msg, strlen(msg));
-        dbg_printf("SEQ: Fire button pushed, countdown begun (burn len = %ds)\n", length);
+        dbg_printf("SEQ: Fire button pushed, countdown begun (burn len = %dms, script %08lX)\n", burn_ms, script.crc);
+        sd_log_write(SD_LOG_INFO, "SEQ fire, burn %u ms, script %s crc %08lX", burn_ms,
+                     script.from_card ? SEQ_SCRIPT_FILE : "built in", script.crc);
+        burn_time = burn_ms;
         sequencer_set_state(SEQUENCER_COUNTDOWN);
-        burn_time = length * 1000; // Convert to ms
+        return true;
     }
+    return false;
 }
 
 void sequencer_tick(void)
@@ -64,11 +125,11 @@ void sequencer_tick(void)
             break;
         case SEQUENCER_COUNTDOWN: // Fun things are about to happen, make sure we are ready
             rs422_send_countdown(get_countdown()/1000);
-            countdown_tasks();
+            report_events();
             break;
         case SEQUENCER_FIRE: // We are cooking now!
             rs422_send_countdown(get_countdown()/1000);
-            fire_tasks();
+            report_events();
             break;
         case SEQUENCER_FAILED_START: // Something went wrong
             // Also do nothing here, just waiting for a switch change to pull us back to ready in main FSM
@@ -83,53 +144,70 @@ void sequencer_tick(void)
     }
 }
 
-typedef void (*sequencer_task_fn)(void);
-
-typedef struct sequencer_task {
-    sequencer_task_fn task;
-    int32_t execution_ms;
-} sequencer_task_t;
-
-static void seq_task_tm10_arm(void);
-static void seq_task_tm9_nos_a_b(void);
-static void seq_task_tm6_checks(void);
-static void seq_task_tm5_softarm(void);
-static void seq_task_tm3_ignition(void);
-static void seq_task_tm2_ign_off(void);
-static void seq_task_tm0_solenoid(void);
+static int32_t task_time_ms(uint8_t i)
+{
+    return script.steps[i].execution_ms + (script.steps[i].after_burn ? burn_time : 0);
+}
 
-// Tasks must be in order they will be executed in
-static const sequencer_task_t countdown_task_list[] = {
-    { seq_task_tm10_arm, -16000 },
-    { seq_task_tm9_nos_a_b, -15000 },
-    { seq_task_tm6_checks, -6000 },
-    { seq_task_tm5_softarm, -5000 },
-    { seq_task_tm3_ignition, -3000 },
-    { seq_task_tm2_ign_off, -2000 },
-    { seq_task_tm0_solenoid, 0 },
-};
+static uint32_t task_time_us(uint8_t i)
+{
+    return t0_us + (uint32_t)(task_time_ms(i) * 1000);
+}
 
-static void countdown_tasks(void) 
+// Timer interrupt only: GPIO and queueing CAN frames, no logging
+static bool run_op(const seq_script_op_t *op)
 {
-    if (get_countdown() >= countdown_task_list[task_list_index].execution_ms) {
-        countdown_task_list[task_list_index++].task();
+    switch (op->op) {
+        case SEQ_OP_SERVO_ARM:      return servo_post_arm_all();
+        case SEQ_OP_OPEN:           return servo_post_position(op->arg, SERVO_POSITION_OPEN);
+        case SEQ_OP_CLOSE:          return servo_post_position(op->arg, SERVO_POSITION_CLOSE);
+        case SEQ_OP_ARM:            return spicy_arm_nolog();
+        case SEQ_OP_DISARM:         return spicy_disarm_nolog();
+        case SEQ_OP_IGNITE:         return spicy_fire_ematch1_nolog();
+        case SEQ_OP_IGNITE_OFF:     return spicy_off_ematch1_nolog();
+        case SEQ_OP_SOLENOID_OPEN:  return spicy_open_solenoid_nolog();
+        case SEQ_OP_SOLENOID_CLOSE: return spicy_close_solenoid_nolog();
+        default:                    return true; // checks and end are handled in the report
     }
 }
 
-static void seq_task_tm10_arm(void)
+// Timer interrupt: run every step that is due, then arm the timer for the next one
+static void sequencer_timer_event(void)
 {
-    dbg_printf("SEQ: T-10 Arming all systems\n");
-    servo_arm_all();
+    while (events_done < script.step_count) {
+        uint8_t i = events_done;
+        uint32_t planned = task_time_us(i);
+        uint32_t start = seq_timer_now_us();
+        if ((int32_t)(start - planned) < 0) {
+            seq_timer_schedule(planned, sequencer_timer_event);
+            return;
+        }
+
+        const seq_script_step_t *step = &script.steps[i];
+        bool ok = true;
+        for (uint8_t j = 0; j < step->op_count; j++) {
+            ok = run_op(&step->ops[j]) && ok;
+        }
+        can_kick_tx_queue(); // Servo commands go out now, not on the next CAN service
+        events[i].late_us = (int32_t)(start - planned);
+        events[i].action_us = (uint16_t)(seq_timer_now_us() - start);
+        events[i].ok = ok;
+        events_done = i + 1;
+        fsm_post(FSM_EV_SEQ_STEP, i); // Reported on the next dispatch, not the next tick
+        if (step->gate) {
+            return; // report_events() resumes
+        }
+    }
 }
 
-static void seq_task_tm9_nos_a_b(void)
+static void schedule_next(void)
 {
-    dbg_printf("SEQ: T-9 Opening NOS A and B\n");
-    servo_set_position(VALVE_NOS_A, SERVO_POSITION_OPEN);
-    servo_set_position(VALVE_NOS_B, SERVO_POSITION_OPEN);
+    if (events_done < script.step_count) {
+        seq_timer_schedule(task_time_us(events_done), sequencer_timer_event);
+    }
 }
 
-static void seq_task_tm6_checks(void)
+static bool prefire_checks(void)
 {
     bool checks_good = true;
 
@@ -142,165 +220,131 @@ static void seq_task_tm6_checks(void)
     servo_feedback_t servos[4];
     servo_get_states(servos);
     if (servos[VALVE_NOS_A].setPos != SERVO_POSITION_OPEN || !servos[VALVE_NOS_A].atSetPos) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, NOS A not open\n");
+        dbg_printf("SEQ: Pre-ignition check failed, NOS A not open\n");
         checks_good = false;
     }
     if (servos[VALVE_NOS_B].setPos != SERVO_POSITION_OPEN || !servos[VALVE_NOS_B].atSetPos) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, NOS B not open\n");
+        dbg_printf("SEQ: Pre-ignition check failed, NOS B not open\n");
         checks_good = false;
     }
     if (servos[VALVE_NITROGEN].setPos != SERVO_POSITION_CLOSE || !servos[VALVE_NITROGEN].atSetPos) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, Nitrogen not closed\n");
+        dbg_printf("SEQ: Pre-ignition check failed, Nitrogen not closed\n");
         checks_good = false;
     }
     if (servos[VALVE_VENT].setPos != SERVO_POSITION_CLOSE || !servos[VALVE_VENT].atSetPos) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, Vent not closed\n");
+        dbg_printf("SEQ: Pre-ignition check failed, Vent not closed\n");
         checks_good = false;
     }
     // 2) ESTOP is released
     if (comp_get_interlock() == false) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, ESTOP pressed\n");
+        dbg_printf("SEQ: Pre-ignition check failed, ESTOP pressed\n");
         checks_good = false;
     }
     // 3) Continuity on ignitor 1
     #ifndef COLDFLOW_MODE
     if (comp_get_ematch1() == false) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, Ignitor 1 continuity bad\n");
+        dbg_printf("SEQ: Pre-ignition check failed, Ignitor 1 continuity bad\n");
         checks_good = false;
     }
     #endif
-    // 4) Mainline pressure > 30 bar
+    // 4) Mainline pressure > 30 bar over the whole history window, not just the last sample
     #ifndef TEST_MODE
-    int32_t mainline_pressure = sensors_get_data(SENSOR_PT_MAINLINE);
-    if (mainline_pressure < 300) {
-        dbg_printf("SEQ: T-6 Pre-ignition check failed, Mainline pressure low (%ld mbar)\n", mainline_pressure);
+    sensor_history_stats_t mainline;
+    if (!sensor_history_get_stats(SENSOR_PT_MAINLINE, &mainline)) {
+        dbg_printf("SEQ: Pre-ignition check failed, no recent mainline pressure\n");
+        checks_good = false;
+    } else if (mainline.min < 300) {
+        dbg_printf("SEQ: Pre-ignition check failed, Mainline pressure low (min %ld, mean %ld over %u ms)\n",
+                   mainline.min, mainline.mean, mainline.window_ms);
         checks_good = false;
     }
     #endif
 
     // If successful, move on, otherwise abort
     if (checks_good) {
-        dbg_printf("SEQ: T-6 Pre-ignition checks good, go for flamey stuff\n");
+        dbg_printf("SEQ: Pre-ignition checks good, go for flamey stuff\n");
     } else {
-        dbg_printf("SEQ: T-6 Pre-ignition checks failed, aborting\n");
+        dbg_printf("SEQ: Pre-ignition checks failed, aborting\n");
         fsm_set_abort(ECU_ERROR_PREFIRE_CHECKS_FAIL);
     }
+    fsm_monitor_note_checks(checks_good);
+    return checks_good;
 }
 
-static void seq_task_tm5_softarm(void)
+static void report_step(uint8_t i)
 {
-    bool stat = spicy_arm();
-    if (!stat) {
-        fsm_set_abort(ECU_ERROR_ARM_FAIL);
+    const seq_script_step_t *step = &script.steps[i];
+    bool ok = events[i].ok;
+
+    for (uint8_t j = 0; j < step->op_count; j++) {
+        switch (step->ops[j].op) {
+            case SEQ_OP_CHECKS:
+                if (!prefire_checks()) return;
+                break;
+            case SEQ_OP_ARM:
+                if (!ok) {
+                    fsm_set_abort(ECU_ERROR_ARM_FAIL);
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
     }
-    dbg_printf("SEQ: T-5, Armed\n");
-}
 
-static void seq_task_tm3_ignition(void)
-{
-    spicy_fire_ematch1();
-    dbg_printf("SEQ: T-3, ignition sequence started\n");
-}
-
-static void seq_task_tm2_ign_off(void)
-{
-    spicy_off_ematch1();
-    dbg_printf("SEQ: T-2, ignition end\n");
+    if (!step->after_burn && step->execution_ms == 0) {
+        dbg_printf("SEQ: T-0, Solenoid %s, we are go!\n", ok ? "opened" : "checks failed");
+        sequencer_set_state(SEQUENCER_FIRE);
+    }
+    if (step->ops[step->op_count - 1].op == SEQ_OP_END) { // Always last when present
+        int32_t worst = 0;
+        for (uint8_t k = 0; k < script.step_count; k++) {
+            if (events[k].late_us > worst) worst = events[k].late_us;
+        }
+        dbg_printf("SEQ: Sequencer complete, %u steps, worst %ld us from plan\n", script.step_count, worst);
+        dbg_printf("SEQ: Time for the pub?\n");
+        fsm_post(FSM_EV_SEQ_DONE, 0);
+    }
 }
 
-static void seq_task_tm0_solenoid(void)
+void sequencer_report(void)
 {
-    spicy_open_solenoid();
-    dbg_printf("SEQ: T-0, Solenoid opened, we are go!\n");
-    sequencer_set_state(SEQUENCER_FIRE);
+    if (sequencer_state == SEQUENCER_COUNTDOWN || sequencer_state == SEQUENCER_FIRE) {
+        report_events();
+    }
 }
 
-static void seq_task_tp0_solenoid_nos_close(void);
-static void seq_task_tp1_open_vent(void);
-static void seq_task_tp3_open_nitrogen(void);
-static void seq_task_tp5_close_vent_open_solenoid(void);
-static void seq_task_tp10_close_solenoid_nitrogen(void);
-static void seq_task_tp12_open_vent(void);
-static void seq_task_tp20_close_vent(void);
-
-// Tasks must be in order they will be executed in. Note that the times DO NOT include the burn time, times are after burn completion
-static const sequencer_task_t fire_task_list[] = {
-    { seq_task_tp0_solenoid_nos_close, 0 },
-    { seq_task_tp1_open_vent, 1000 },
-    { seq_task_tp3_open_nitrogen, 6000 },
-    { seq_task_tp5_close_vent_open_solenoid, 8000 },
-    { seq_task_tp10_close_solenoid_nitrogen, 13000 },
-    { seq_task_tp12_open_vent, 14000 },
-    { seq_task_tp20_close_vent, 20000 }
-};
-
-static void fire_tasks(void)
+// Main loop: log what the timer ran against the plan and run the reports
+static void report_events(void)
 {
-    if (get_countdown() <= burn_time) {
-        // While burning perform checks to ensure nominal conditions.
-        // 1) Check combustion chamber stays below 60 bar
-        int32_t cc_pressure = sensors_get_data(SENSOR_P_CHAMBER); // Note returns in 10*bar
-        if (cc_pressure > 600) { // CHANGE AFTER 3rd OCT TESTING - INCREASE TO 60 BAR
-            dbg_printf("SEQ: During burn, combustion chamber overpressure (%ld.%02ld bar), aborting\n", cc_pressure / 10, cc_pressure % 10);
-            fsm_set_abort(ECU_ERROR_CHAMBER_OVERPRESSURE);
+    while (events_reported < events_done) {
+        uint8_t i = events_reported++;
+        const seq_script_step_t *step = &script.steps[i];
+        int32_t t_ms = task_time_ms(i);
+        uint32_t abs_ms = (uint32_t)(t_ms < 0 ? -t_ms : t_ms);
+        char ops[48];
+        uint8_t n = 0;
+        for (uint8_t j = 0; j < step->op_count && n < sizeof(ops); j++) {
+            const seq_script_op_t *op = &step->ops[j];
+            bool valve = (op->op == SEQ_OP_OPEN || op->op == SEQ_OP_CLOSE);
+            int len = snprintf(&ops[n], sizeof(ops) - n, "%s%s%s%s", j ? ", " : "", seq_script_op_name(op->op),
+                               valve ? " " : "", valve ? seq_script_valve_name(op->arg) : "");
+            n = (len < 0) ? sizeof(ops) : n + (uint8_t)len;
         }
-        // 2) If more than 300ms into burn, abort if chamber pressure drops below 5 bar
-        if (get_countdown() >= 300 && cc_pressure < 50) {
-            dbg_printf("SEQ: During burn, combustion chamber pressure low (%ld.%02ld bar), aborting\n", cc_pressure / 10, cc_pressure % 10);
-            fsm_set_abort(ECU_ERROR_CHAMBER_UNDERPRESSURE);
+        dbg_printf("SEQ: T%c%lu.%03lu %s, %s%ld us from plan, action %u us%s\n",
+                   t_ms < 0 ? '-' : '+', abs_ms / 1000U, abs_ms % 1000U, ops,
+                   events[i].late_us >= 0 ? "+" : "", events[i].late_us, events[i].action_us,
+                   events[i].ok ? "" : ", FAILED");
+        if (events[i].late_us >= (int32_t)SEQUENCER_LATE_WARN_US) {
+            dbg_printf("SEQ: WARN step %u late by %ld us\n", i, events[i].late_us);
         }
-    }
 
-    if (get_countdown() >= fire_task_list[task_list_index].execution_ms + burn_time) {
-        fire_task_list[task_list_index++].task();
+        report_step(i);
+        if (sequencer_state != SEQUENCER_COUNTDOWN && sequencer_state != SEQUENCER_FIRE) {
+            return; // The report ended the sequence
+        }
+        if (step->gate) {
+            schedule_next();
+        }
     }
 }
-
-static void seq_task_tp0_solenoid_nos_close(void)
-{
-    spicy_close_solenoid();
-    servo_set_position(VALVE_NOS_A, SERVO_POSITION_CLOSE);
-    servo_set_position(VALVE_NOS_B, SERVO_POSITION_CLOSE);
-    dbg_printf("SEQ: T+%d(0) Burn complete, NOS closed\n", burn_time/1000);
-}
-
-static void seq_task_tp1_open_vent(void)
-{
-    servo_set_position(VALVE_VENT, SERVO_POSITION_OPEN);
-    dbg_printf("SEQ: T+%d(2) Vent opened\n", (burn_time + 2000)/1000);
-}
-
-static void seq_task_tp3_open_nitrogen(void)
-{
-    servo_set_position(VALVE_NITROGEN, SERVO_POSITION_OPEN);
-    dbg_printf("SEQ: T+%d(3) Nitrogen opened\n", (burn_time + 3000)/1000);
-}
-
-static void seq_task_tp5_close_vent_open_solenoid(void)
-{
-    servo_set_position(VALVE_VENT, SERVO_POSITION_CLOSE);
-    spicy_open_solenoid();
-    dbg_printf("SEQ: T+%d(4) Vent closed, Solenoid opened\n", (burn_time + 4000)/1000);
-}
-
-static void seq_task_tp10_close_solenoid_nitrogen(void)
-{
-    spicy_close_solenoid();
-    spicy_disarm();
-    servo_set_position(VALVE_NITROGEN, SERVO_POSITION_CLOSE);
-    dbg_printf("SEQ: T+%d(10) Nitrogen and Solenoid closed\n", (burn_time + 10000)/1000);
-}
-
-static void seq_task_tp12_open_vent(void)
-{
-    servo_set_position(VALVE_VENT, SERVO_POSITION_OPEN);
-    dbg_printf("SEQ: T+%d(12) Vent opened\n", (burn_time + 12000)/1000);
-}
-
-static void seq_task_tp20_close_vent(void)
-{
-    servo_set_position(VALVE_VENT, SERVO_POSITION_CLOSE);
-    dbg_printf("SEQ: T+%d(20) Vent closed, sequencer complete\n", (burn_time + 20000)/1000);
-    dbg_printf("SEQ: Time for the pub?\n");
-    fsm_set_state(STATE_POST_FIRE);
-}
\ No newline at end of file
@@ -13,9 +13,19 @@ typedef enum {
     SEQUENCER_UNINITIALISED = 0b1110
 } sequencer_states_t;
 
+// Steps come from the sequence script (see seq_script.h) and run from a hardware timer
+// interrupt at their planned T-time (see seq_timer.h), the main loop logs each one with
+// how far it was from plan afterwards.
+#define SEQUENCER_LATE_WARN_US  1000    // Log a warning for steps later than this
+
+void sequencer_init(void);
 void sequencer_set_state(sequencer_states_t new_state);
 sequencer_states_t sequencer_get_state(void);
+// True between T-0 and the end of the burn, with the time since T-0
+bool sequencer_in_burn(uint32_t *ms_into_burn);
 void sequencer_tick(void);
-void sequencer_fire(uint8_t length);
+// Report the steps the timer has run, from the FSM on FSM_EV_SEQ_STEP
+void sequencer_report(void);
+bool sequencer_fire(uint8_t length);
 
 #endif /* SEQUENCER_H */
\ No newline at end of file
@@ -19,6 +19,14 @@ void servo_get_states(servo_feedback_t feedback[4])
     }
 }
 
+bool servo_post_position(uint8_t servo_id, servo_positions_t position)
+{
+    if(servo_id > 3) {
+        return false;
+    }
+    return can_send_command(CAN_NODE_TYPE_SERVO, CAN_NODE_ADDR_BROADCAST, CAN_CMD_SET_SERVO_POS, servo_id << 6 | position);
+}
+
 void servo_set_position(uint8_t servo_id, servo_positions_t position)
 {
     if(servo_id > 3) {
@@ -26,13 +34,18 @@ void servo_set_position(uint8_t servo_id, servo_positions_t position)
         return;
     }
     dbg_printf("SERVO: Set servo %d to position %d\n", servo_id, position);
-    can_send_command(CAN_NODE_TYPE_SERVO, CAN_NODE_ADDR_BROADCAST, CAN_CMD_SET_SERVO_POS, servo_id << 6 | position);
+    servo_post_position(servo_id, position);
+}
+
+bool servo_post_arm_all(void)
+{
+    return can_send_command(CAN_NODE_TYPE_SERVO, CAN_NODE_ADDR_BROADCAST, CAN_CMD_SET_SERVO_ARM, 0xFF);
 }
 
 void servo_arm_all(void)
 {
     dbg_printf("SERVO: ARM ALL\n");
-    can_send_command(CAN_NODE_TYPE_SERVO, CAN_NODE_ADDR_BROADCAST, CAN_CMD_SET_SERVO_ARM, 0xFF);
+    servo_post_arm_all();
 }
 
 void servo_disarm_all(void)
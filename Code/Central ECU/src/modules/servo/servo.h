@@ -52,6 +52,11 @@ void servo_disarm_all(void);
 void servo_set_position(uint8_t valve, servo_positions_t position);
 void servo_print_current_state(void);
 
+// Queue the CAN command without logging, for the sequencer timer interrupt. False if the
+// CAN queue is full.
+bool servo_post_position(uint8_t servo_id, servo_positions_t position);
+bool servo_post_arm_all(void);
+
 bool servo_helper_check_all_closed(void);
 void servo_status_update(uint8_t main_state, uint8_t substates);
 void servo_status_get(servo_status_u* status);
@@ -2,6 +2,9 @@
 #include "debug_io.h"
 #include "rs422.h"
 #include "main_FSM.h"
+#ifdef FSM_FUZZ
+#include "fsm_fuzz.h"
+#endif
 
 ADC_ChannelConfTypeDef ADC_IMON_Config = {
     .Channel = ADC_CHANNEL_15, // PB15
@@ -46,10 +49,18 @@ static bool spicy_checks(void)
 
 // SOFT ARM COMMANDS
 
+bool spicy_arm_nolog(void)
+{
+    if (!spicy_checks()) {
+        return false;
+    }
+    HAL_GPIO_WritePin(ARM_HS_GPIO_Port, ARM_HS_Pin, GPIO_PIN_SET);
+    return true;
+}
+
 bool spicy_arm(void)
 {
-    if (spicy_checks()) {
-        HAL_GPIO_WritePin(ARM_HS_GPIO_Port, ARM_HS_Pin, GPIO_PIN_SET);
+    if (spicy_arm_nolog()) {
         dbg_printf("SPICY: Arm Set\n");
         return true;
     } else {
@@ -58,9 +69,15 @@ bool spicy_arm(void)
     }
 }
 
-bool spicy_disarm(void)
+bool spicy_disarm_nolog(void)
 {
     HAL_GPIO_WritePin(ARM_HS_GPIO_Port, ARM_HS_Pin, GPIO_PIN_RESET);
+    return true;
+}
+
+bool spicy_disarm(void)
+{
+    spicy_disarm_nolog();
     dbg_printf("SPICY: Arm Cleared\n");
     return true;
 }
@@ -74,6 +91,9 @@ bool spicy_get_arm(void)
 
 bool comp_get_interlock(void)
 {
+#ifdef FSM_FUZZ
+    if (!fsm_fuzz_interlock()) return false; // Emulated ESTOP
+#endif
     return HAL_GPIO_ReadPin(INTERLOCK_GPIO_Port, INTERLOCK_Pin);
 }
 
@@ -110,10 +130,18 @@ bool hss_get_PGOOD(void)
 
 // FIRE COMMANDS
 
+bool spicy_open_solenoid_nolog(void)
+{
+    if (!spicy_checks()) {
+        return false;
+    }
+    HAL_GPIO_WritePin(OX_FIRE_GPIO_Port, OX_FIRE_Pin, GPIO_PIN_SET);
+    return true;
+}
+
 bool spicy_open_solenoid(void) 
 {
-    if (spicy_checks()) {
-        HAL_GPIO_WritePin(OX_FIRE_GPIO_Port, OX_FIRE_Pin, GPIO_PIN_SET);
+    if (spicy_open_solenoid_nolog()) {
         dbg_printf("SPICY: Opened Solenoid\n");
         return true;
     } else {
@@ -122,9 +150,15 @@ bool spicy_open_solenoid(void)
     }
 }
 
-bool spicy_close_solenoid(void)
+bool spicy_close_solenoid_nolog(void)
 {
     HAL_GPIO_WritePin(OX_FIRE_GPIO_Port, OX_FIRE_Pin, GPIO_PIN_RESET);
+    return true;
+}
+
+bool spicy_close_solenoid(void)
+{
+    spicy_close_solenoid_nolog();
     dbg_printf("SPICY: Closed Solenoid\n");
     return true;
 }
@@ -134,10 +168,18 @@ bool spicy_get_solenoid(void)
     return HAL_GPIO_ReadPin(OX_FIRE_GPIO_Port, OX_FIRE_Pin);
 }
 
+bool spicy_fire_ematch1_nolog(void)
+{
+    if (!spicy_checks()) {
+        return false;
+    }
+    HAL_GPIO_WritePin(EMATCH1_FIRE_GPIO_Port, EMATCH1_FIRE_Pin, GPIO_PIN_SET);
+    return true;
+}
+
 bool spicy_fire_ematch1(void)
 {
-    if (spicy_checks()) {
-        HAL_GPIO_WritePin(EMATCH1_FIRE_GPIO_Port, EMATCH1_FIRE_Pin, GPIO_PIN_SET);
+    if (spicy_fire_ematch1_nolog()) {
         dbg_printf("SPICY: Fired Ematch1\n");
         return true;
     } else {
@@ -146,9 +188,15 @@ bool spicy_fire_ematch1(void)
     }
 }
 
-bool spicy_off_ematch1(void)
+bool spicy_off_ematch1_nolog(void)
 {
     HAL_GPIO_WritePin(EMATCH1_FIRE_GPIO_Port, EMATCH1_FIRE_Pin, GPIO_PIN_RESET);
+    return true;
+}
+
+bool spicy_off_ematch1(void)
+{
+    spicy_off_ematch1_nolog();
     dbg_printf("SPICY: Ematch1 Off\n");
     return true;
 }
@@ -36,4 +36,12 @@ bool spicy_get_ematch1(void);
 bool spicy_fire_ematch2(void);
 bool spicy_off_ematch2(void);
 
+// Same as above without logging, for the sequencer timer interrupt
+bool spicy_arm_nolog(void);
+bool spicy_disarm_nolog(void);
+bool spicy_open_solenoid_nolog(void);
+bool spicy_close_solenoid_nolog(void);
+bool spicy_fire_ematch1_nolog(void);
+bool spicy_off_ematch1_nolog(void);
+
 #endif // SPICY_H
\ No newline at end of file
@@ -5,17 +5,21 @@
 
 #if defined(SSD1306_USE_I2C)
 
+static void ssd1306_WaitUpdate(void);
+
 void ssd1306_Reset(void) {
     /* for I2C - do nothing */
 }
 
 // Send a byte to the command register
 void ssd1306_WriteCommand(uint8_t byte) {
+    ssd1306_WaitUpdate();
     HAL_I2C_Mem_Write(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x00, 1, &byte, 1, HAL_MAX_DELAY);
 }
 
 // Send data
 void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
+    ssd1306_WaitUpdate();
     HAL_I2C_Mem_Write(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x40, 1, buffer, buff_size, HAL_MAX_DELAY);
 }
 
@@ -56,9 +60,131 @@ void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
 // Screenbuffer
 static uint8_t SSD1306_Buffer[SSD1306_BUFFER_SIZE];
 
+// What the panel shows. Updates send only the columns of each page where the screenbuffer
+// differs from it, and DMA reads from here so drawing can go on during an update.
+static uint8_t SSD1306_Shown[SSD1306_BUFFER_SIZE];
+static uint8_t shown_valid = 0; // 0 until the first update, or after a failed one: send it all
+
 // Screen object
 static SSD1306_t SSD1306;
 
+static SSD1306_Stats_t SSD1306_Stats;
+
+#define SSD1306_PAGES   (SSD1306_HEIGHT / 8)
+#define SSD1306_COLUMN0 ((SSD1306_X_OFFSET_UPPER << 4) | SSD1306_X_OFFSET_LOWER)
+
+// Changed columns of each page for the update in flight, first > last if unchanged
+static uint8_t span_first[SSD1306_PAGES];
+static uint8_t span_last[SSD1306_PAGES];
+
+/* Find the changed span of each page and take it into the shown copy, 0 if nothing changed */
+static uint8_t ssd1306_TakeChanges(void) {
+    uint8_t changed = 0;
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        const uint8_t *buf = &SSD1306_Buffer[SSD1306_WIDTH * page];
+        uint8_t *shown = &SSD1306_Shown[SSD1306_WIDTH * page];
+        uint16_t first = 0;
+        uint16_t last = SSD1306_WIDTH - 1;
+        if(shown_valid) {
+            while(first < SSD1306_WIDTH && buf[first] == shown[first]) first++;
+            while(last > first && buf[last] == shown[last]) last--;
+        }
+        if(first == SSD1306_WIDTH) {
+            span_first[page] = 1;
+            span_last[page] = 0;
+            continue;
+        }
+        memcpy(&shown[first], &buf[first], last - first + 1);
+        span_first[page] = first;
+        span_last[page] = last;
+        changed = 1;
+    }
+    shown_valid = 1;
+    return changed;
+}
+
+/* Column and page address window of one span, horizontal addressing mode */
+static void ssd1306_SpanWindow(uint8_t *cmd, uint8_t page) {
+    cmd[0] = 0x21; // Set column address
+    cmd[1] = SSD1306_COLUMN0 + span_first[page];
+    cmd[2] = SSD1306_COLUMN0 + span_last[page];
+    cmd[3] = 0x22; // Set page address
+    cmd[4] = page;
+    cmd[5] = page;
+}
+
+#if defined(SSD1306_USE_I2C)
+
+// DMA update state, advanced from the I2C completion callback
+typedef enum {
+    SSD1306_UPDATE_IDLE = 0,
+    SSD1306_UPDATE_WINDOW,      // Address window of update_page going out
+    SSD1306_UPDATE_DATA         // Its changed columns going out
+} SSD1306_UpdateStep_t;
+
+static volatile SSD1306_UpdateStep_t update_step = SSD1306_UPDATE_IDLE;
+static uint8_t update_page;
+static uint8_t update_cmd[6];
+static uint32_t update_start;
+
+static void ssd1306_UpdateFailed(void) {
+    shown_valid = 0; // Panel content unknown now
+    SSD1306_Stats.errors++;
+    update_step = SSD1306_UPDATE_IDLE;
+}
+
+/* Send the window of the next changed page from update_page on, or finish */
+static void ssd1306_UpdateNextPage(void) {
+    while(update_page < SSD1306_PAGES && span_first[update_page] > span_last[update_page]) update_page++;
+    if(update_page >= SSD1306_PAGES) {
+        update_step = SSD1306_UPDATE_IDLE;
+        return;
+    }
+    ssd1306_SpanWindow(update_cmd, update_page);
+    update_step = SSD1306_UPDATE_WINDOW;
+    SSD1306_Stats.bytes += sizeof(update_cmd) + 1;
+    if(HAL_I2C_Mem_Write_DMA(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x00, 1, update_cmd, sizeof(update_cmd)) != HAL_OK) {
+        ssd1306_UpdateFailed();
+    }
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    if(hi2c != &SSD1306_I2C_PORT) return;
+    if(update_step == SSD1306_UPDATE_WINDOW) {
+        uint8_t first = span_first[update_page];
+        uint16_t len = span_last[update_page] - first + 1;
+        update_step = SSD1306_UPDATE_DATA;
+        SSD1306_Stats.bytes += len + 1;
+        if(HAL_I2C_Mem_Write_DMA(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x40, 1,
+                                 &SSD1306_Shown[SSD1306_WIDTH * update_page + first], len) != HAL_OK) {
+            ssd1306_UpdateFailed();
+        }
+    } else if(update_step == SSD1306_UPDATE_DATA) {
+        update_page++;
+        ssd1306_UpdateNextPage();
+    }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    if(hi2c != &SSD1306_I2C_PORT) return;
+    if(update_step != SSD1306_UPDATE_IDLE) ssd1306_UpdateFailed();
+}
+
+/* A stuck update (no completion, e.g. the panel held SDA) resets the bus */
+static void ssd1306_CheckStuck(void) {
+    if(update_step == SSD1306_UPDATE_IDLE || HAL_GetTick() - update_start < SSD1306_UPDATE_TIMEOUT_MS) return;
+    HAL_I2C_DeInit(&SSD1306_I2C_PORT);
+    HAL_I2C_Init(&SSD1306_I2C_PORT);
+    ssd1306_UpdateFailed();
+}
+
+/* Blocking writes share the bus, let an update finish first */
+static void ssd1306_WaitUpdate(void) {
+    while(update_step != SSD1306_UPDATE_IDLE) ssd1306_CheckStuck();
+}
+
+#endif
+
 /* Fills the Screenbuffer with values from a given buffer of a fixed length */
 SSD1306_Error_t ssd1306_FillBuffer(uint8_t* buf, uint32_t len) {
     SSD1306_Error_t ret = SSD1306_ERR;
@@ -178,18 +304,42 @@ void ssd1306_Fill(SSD1306_COLOR color) {
 
 /* Write the screenbuffer with changed to the screen */
 void ssd1306_UpdateScreen(void) {
-    // Write data to each page of RAM. Number of pages
+    // Only the changed columns of each page of RAM are sent. Number of pages
     // depends on the screen height:
     //
     //  * 32px   ==  4 pages
     //  * 64px   ==  8 pages
     //  * 128px  ==  16 pages
-    for(uint8_t i = 0; i < SSD1306_HEIGHT/8; i++) {
-        ssd1306_WriteCommand(0xB0 + i); // Set the current RAM page address.
-        ssd1306_WriteCommand(0x00 + SSD1306_X_OFFSET_LOWER);
-        ssd1306_WriteCommand(0x10 + SSD1306_X_OFFSET_UPPER);
-        ssd1306_WriteData(&SSD1306_Buffer[SSD1306_WIDTH*i],SSD1306_WIDTH);
+#if defined(SSD1306_USE_I2C)
+    ssd1306_CheckStuck();
+    if(update_step != SSD1306_UPDATE_IDLE) {
+        // Still sending the last one, the next call picks these changes up
+        SSD1306_Stats.busy++;
+        return;
     }
+    if(!ssd1306_TakeChanges()) return;
+    SSD1306_Stats.updates++;
+    update_start = HAL_GetTick();
+    update_page = 0;
+    ssd1306_UpdateNextPage();
+#else
+    if(!ssd1306_TakeChanges()) return;
+    SSD1306_Stats.updates++;
+    for(uint8_t i = 0; i < SSD1306_PAGES; i++) {
+        if(span_first[i] > span_last[i]) continue;
+        uint8_t cmd[6];
+        ssd1306_SpanWindow(cmd, i);
+        for(uint8_t k = 0; k < sizeof(cmd); k++) ssd1306_WriteCommand(cmd[k]);
+        uint16_t len = span_last[i] - span_first[i] + 1;
+        ssd1306_WriteData(&SSD1306_Shown[SSD1306_WIDTH*i + span_first[i]], len);
+        SSD1306_Stats.bytes += sizeof(cmd) + len;
+    }
+#endif
+}
+
+/* Update counters since boot */
+void ssd1306_GetStats(SSD1306_Stats_t *stats) {
+    *stats = SSD1306_Stats;
 }
 
 /*
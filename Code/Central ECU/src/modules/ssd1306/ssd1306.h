@@ -90,6 +90,11 @@ extern SPI_HandleTypeDef SSD1306_SPI_PORT;
 #define SSD1306_BUFFER_SIZE   SSD1306_WIDTH * SSD1306_HEIGHT / 8
 #endif
 
+// Give up on a DMA screen update after this long and reset the bus
+#ifndef SSD1306_UPDATE_TIMEOUT_MS
+#define SSD1306_UPDATE_TIMEOUT_MS 100
+#endif
+
 // Enumeration for screen colors
 typedef enum {
     Black = 0x00, // Black color, no pixel
@@ -114,6 +119,14 @@ typedef struct {
     uint8_t y;
 } SSD1306_VERTEX;
 
+// Screen update counters
+typedef struct {
+    uint32_t updates;       // Updates that had changes to send
+    uint32_t bytes;         // Sent to the panel, address windows and control bytes included
+    uint32_t busy;          // Calls while the previous update was still going out
+    uint32_t errors;        // Failed updates, the next one resends the whole screen
+} SSD1306_Stats_t;
+
 /** Font */
 typedef struct {
 	const uint8_t width;                /**< Font width in pixels */
@@ -125,7 +138,15 @@ typedef struct {
 // Procedure definitions
 void ssd1306_Init(void);
 void ssd1306_Fill(SSD1306_COLOR color);
+/**
+ * @brief Send the changed parts of the screenbuffer to the screen.
+ * @note Compared per page against what was last sent, only the changed column span of each
+ *       page goes out. Over I2C this returns at once and the transfer runs on DMA, driven by
+ *       the I2C completion callbacks; a call while one is still going out is skipped and its
+ *       changes go with the next call.
+ */
 void ssd1306_UpdateScreen(void);
+void ssd1306_GetStats(SSD1306_Stats_t *stats);
 void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color);
 char ssd1306_WriteChar(char ch, SSD1306_Font_t Font, SSD1306_COLOR color);
 char ssd1306_WriteString(char* str, SSD1306_Font_t Font, SSD1306_COLOR color);
@@ -5,12 +5,62 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "rtc_helper.h"
+#include "sd_log.h"
+#include "sd_format.h"
+#include "main_FSM.h"
+#include "config.h"
+#include "rs422.h"
+#include "rs422_cmd.h"
+#include "sensor_summary.h"
+#include "crc.h"
+#include "sd_replay.h"
+#include "redline.h"
+#include "sensor_history.h"
+#include "derived.h"
+#include "sensor_seq.h"
+#include "sensors.h"
+#include "calibration.h"
+#include "heartbeat.h"
+#include "fsm_monitor.h"
+#include "ssd1306.h"
+#ifdef SD_FAULT_INJECT
+#include "sd_fault.h"
+#endif
+#ifdef RS422_STRESS
+#include "rs422_stress.h"
+#endif
+#ifdef FSM_FUZZ
+#include "fsm_fuzz.h"
+#endif
 
 // Simple serial command interface over debug_io
 // Commands:
 //   ARM <mask>        - Arm servos bitmask (lower 4 bits), eg: ARM 0xF
 //   DISARM            - Disarm all servos
 //   POS <s0> <s1> <s2> <s3>  - Set 4 servo positions (0-255). Use - to keep current
+//   SDSTAT [RESET]    - Show (or clear) SD log health counters
+//   SDLZ              - Benchmark SD log compression (ratio, cycles/byte)
+//   CRCTEST           - Check both CRC backends against known vectors, cycles/byte
+//   CONVBENCH         - Sensor conversion cycles/sample, integer against float
+//   CAL               - Calibration version, seq and hash of each board
+//   REPLAY ...        - Replay logged sensor records to the RIU, or show replay counters
+//   RSSTAT [RESET]    - Show (or clear) RS422 receive parser counters
+//   REDLINE [RESET]   - Show (or clear) redline trip and latency counters
+//   HIST <id>         - Windowed mean/min/max/slope of a sensor from its sample history
+//   DERIVED           - Latest value of each derived channel (burn, impulse, N2O flow...)
+//   SEQSTAT [RESET]   - Show (or clear) per sensor frame counts and losses by stage
+//   OLED              - Display update counters (updates, bytes sent, busy, errors)
+//   HBSTAT [RESET]    - Show (or clear) per board heartbeat jitter and loss counters
+//   FSMMON [RESET]    - Show (or clear) FSM invariant violation counters
+//   FSMEV [RESET]     - Show (or clear) FSM event queue and latency counters
+//   RSLINK [RESET | <lane> <share%> <burst>] - RS422 TX lane budget report / settings
+//   SUMRATE [hz]      - Show or set the RIU sensor summary rate (0 = off)
+//   SDFORMAT YES      - Repartition/format the card with AU aligned layout (erases everything)
+//   SDBENCH <KiB>     - Measure sustained card write throughput
+//   SDFAULT ...       - SD fault injection (SD_FAULT_INJECT builds only)
+//   SDLOAD <fps> <s>  - Synthetic sensor load into the SD log (SD_FAULT_INJECT builds only)
+//   RSSTRESS ...      - Emulated RIU traffic into the RS422 stack (RS422_STRESS builds only)
+//   FSMFUZZ ...       - Randomised countdowns with disturbances (FSM_FUZZ builds only)
 //   HELP              - Show help
 // Ex: POS 128 64 255 0
 // Ex: ARM 0x3
@@ -54,6 +104,35 @@ static void cmd_help(void) {
     dbg_printf("  DISARM              Disarm all servos\r\n");
     dbg_printf("  POS <servoID(0-3)> <howSet(0-1)> <pos (0-3 if howSet=0, else 0-20)>\r\n");
     dbg_printf("  TIM <DAYS> <MILLIS> Set the RTC with the number of days and milliseconds since 2K25\r\n");
+    dbg_printf("  SDSTAT [RESET]      Show or clear SD log health counters\r\n");
+    dbg_printf("  SDLZ                Benchmark SD log compression\r\n");
+    dbg_printf("  CRCTEST             CRC backend self test and benchmark\r\n");
+    dbg_printf("  CONVBENCH           Benchmark sensor conversions\r\n");
+    dbg_printf("  CAL                 Show calibration of each board\r\n");
+    dbg_printf("  REPLAY [<session> <mask> <start ms> <end ms> | STOP]  SD replay to the RIU\r\n");
+    dbg_printf("  RSSTAT [RESET]      Show or clear RS422 receive counters\r\n");
+    dbg_printf("  REDLINE [RESET]     Show or clear redline trip and latency counters\r\n");
+    dbg_printf("  HIST <sensor id>    Windowed statistics from the sensor history\r\n");
+    dbg_printf("  DERIVED             Show derived channel values\r\n");
+    dbg_printf("  SEQSTAT [RESET]     Show or clear sensor frame loss counters\r\n");
+    dbg_printf("  OLED                Show display update counters\r\n");
+    dbg_printf("  HBSTAT [RESET]      Show or clear heartbeat jitter and loss counters\r\n");
+    dbg_printf("  FSMMON [RESET]      Show or clear FSM invariant violation counters\r\n");
+    dbg_printf("  FSMEV [RESET]       Show or clear FSM event latency counters\r\n");
+    dbg_printf("  RSLINK [RESET | <lane 0-3> <share%%> <burst B>]  RS422 link budget\r\n");
+    dbg_printf("  SUMRATE [hz]        Show or set RIU sensor summary rate (0 = off)\r\n");
+    dbg_printf("  SDFORMAT YES        Format card (AU aligned, large clusters). ERASES CARD\r\n");
+    dbg_printf("  SDBENCH <KiB>       Measure card write throughput\r\n");
+#ifdef SD_FAULT_INJECT
+    dbg_printf("  SDFAULT <lat_ms> <busy_every> <busy_ms> <fail_every> <loss_after> | OFF\r\n");
+    dbg_printf("  SDLOAD <frames/s> <seconds>  Synthetic sensor frames into the SD log\r\n");
+#endif
+#ifdef RS422_STRESS
+    dbg_printf("  RSSTRESS <hb/s> <s> [cmd/s] [corrupt/1000] [noise/1000] [tx/s] | STOP\r\n");
+#endif
+#ifdef FSM_FUZZ
+    dbg_printf("  FSMFUZZ <runs> [seed] | STOP  Randomised countdowns from an emulated RIU\r\n");
+#endif
     dbg_printf("  HELP                This help\r\n");
 }
 
@@ -96,6 +175,140 @@ void test_servo_poll(void) {
         if(!timeStr) { dbg_printf("Need time string\r\n"); return; }
         rtc_helper_set_from_string(timeStr);
         dbg_printf("RTC set\r\n");
+    } else if(strcasecmp(tok, "SDFORMAT") == 0 || strcasecmp(tok, "SDBENCH") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(fsm_get_state() == STATE_SEQUENCER) { dbg_printf("Not while the sequencer is running\r\n"); return; }
+        if(strcasecmp(tok, "SDFORMAT") == 0 && (!arg || strcmp(arg, "YES") != 0)) {
+            dbg_printf("This erases the card. Type SDFORMAT YES\r\n");
+            return;
+        }
+        // Logging is stopped for the duration and resumes in a new session
+        sd_log_shutdown();
+        if(strcasecmp(tok, "SDFORMAT") == 0) {
+            (void)sd_format_card();
+        } else {
+            (void)sd_format_benchmark(arg ? strtoul(arg, NULL, 0) : 4096U);
+        }
+        if(!sd_log_restart()) dbg_printf("SD log restart failed\r\n");
+    } else if(strcasecmp(tok, "SDLZ") == 0) {
+        sd_log_benchmark_compression();
+    } else if(strcasecmp(tok, "CRCTEST") == 0) {
+        crc16_self_test();
+    } else if(strcasecmp(tok, "CONVBENCH") == 0) {
+        sensors_conv_bench();
+    } else if(strcasecmp(tok, "CAL") == 0) {
+        calibration_print();
+    } else if(strcasecmp(tok, "REPLAY") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(!arg) { sd_replay_print_stats(); return; }
+        if(strcasecmp(arg, "STOP") == 0) { sd_replay_stop(); return; }
+        char *mask = strtok(NULL, " \t");
+        char *start = strtok(NULL, " \t");
+        char *end = strtok(NULL, " \t");
+        if(!mask || !start || !end) { dbg_printf("Need session, mask, start and end\r\n"); return; }
+        rs422_cmd_status_t st = sd_replay_start((uint16_t)atoi(arg), strtoul(mask, NULL, 0), strtoul(start, NULL, 0), strtoul(end, NULL, 0));
+        if(st != RS422_CMD_OK) dbg_printf("Replay refused (%d)\r\n", st);
+    } else if(strcasecmp(tok, "RSLINK") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { rs422_reset_link_stats(); dbg_printf("RS422 link stats cleared\r\n"); return; }
+        if(arg) {
+            char *share = strtok(NULL, " \t");
+            char *burst = strtok(NULL, " \t");
+            int lane = atoi(arg);
+            if(!share || !burst || lane < 0 || lane >= RS422_LANE_COUNT) { dbg_printf("Need lane (0-3), share and burst\r\n"); return; }
+            rs422_set_lane_budget((RS422_Lane_t)lane, (uint8_t)atoi(share), strtoul(burst, NULL, 0));
+        }
+        rs422_print_link_budget();
+    } else if(strcasecmp(tok, "SUMRATE") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg) sensor_summary_set_rate((uint8_t)atoi(arg));
+        dbg_printf("Sensor summary rate %u Hz\r\n", sensor_summary_get_rate());
+    } else if(strcasecmp(tok, "RSSTAT") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { rs422_reset_rx_stats(); rs422_cmd_reset_stats(); dbg_printf("RS422 stats cleared\r\n"); return; }
+        rs422_print_rx_stats();
+        rs422_cmd_print_stats();
+    } else if(strcasecmp(tok, "HBSTAT") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { heartbeat_reset_stats(); dbg_printf("Heartbeat stats cleared\r\n"); return; }
+        heartbeat_print_stats();
+    } else if(strcasecmp(tok, "HIST") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(!arg) { dbg_printf("Need a sensor id\r\n"); return; }
+        sensor_history_print((uint8_t)strtoul(arg, NULL, 0));
+    } else if(strcasecmp(tok, "DERIVED") == 0) {
+        derived_print();
+    } else if(strcasecmp(tok, "SEQSTAT") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { sensor_seq_reset_stats(); dbg_printf("Sensor frame loss stats cleared\r\n"); return; }
+        sensor_seq_print();
+    } else if(strcasecmp(tok, "OLED") == 0) {
+        SSD1306_Stats_t st;
+        ssd1306_GetStats(&st);
+        dbg_printf("OLED: %lu updates, %lu bytes (%lu per update), %lu skipped busy, %lu errors\r\n",
+                   st.updates, st.bytes, st.updates ? st.bytes / st.updates : 0, st.busy, st.errors);
+    } else if(strcasecmp(tok, "REDLINE") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { redline_reset_stats(); dbg_printf("Redline stats cleared\r\n"); return; }
+        redline_print_stats();
+    } else if(strcasecmp(tok, "FSMEV") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { fsm_reset_event_stats(); dbg_printf("FSM event stats cleared\r\n"); return; }
+        fsm_print_event_stats();
+    } else if(strcasecmp(tok, "FSMMON") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { fsm_monitor_reset_stats(); dbg_printf("FSM monitor stats cleared\r\n"); return; }
+        fsm_monitor_print_stats();
+    } else if(strcasecmp(tok, "SDSTAT") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "RESET") == 0) { sd_log_reset_stats(); dbg_printf("SD stats cleared\r\n"); return; }
+        sd_log_print_stats();
+#ifdef SD_FAULT_INJECT
+        sd_fault_print();
+    } else if(strcasecmp(tok, "SDFAULT") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(!arg) { sd_fault_print(); return; }
+        if(strcasecmp(arg, "OFF") == 0) { sd_fault_clear(); dbg_printf("SD faults off\r\n"); return; }
+        uint32_t v[5] = {0};
+        for(int i=0;i<5 && arg;i++) { v[i] = strtoul(arg, NULL, 0); arg = strtok(NULL, " \t"); }
+        sd_fault_config_t cfg = {
+            .write_latency_ms = (uint16_t)v[0], .busy_every = v[1], .busy_ms = (uint16_t)v[2],
+            .fail_every = v[3], .power_loss_after = v[4]
+        };
+        sd_fault_configure(&cfg);
+        sd_fault_print();
+    } else if(strcasecmp(tok, "SDLOAD") == 0) {
+        char *rate = strtok(NULL, " \t");
+        char *secs = strtok(NULL, " \t");
+        if(!rate || !secs) { dbg_printf("Need rate and duration\r\n"); return; }
+        sd_fault_load_start((uint16_t)atoi(rate), (uint16_t)atoi(secs));
+        dbg_printf("SD load started\r\n");
+#endif
+#ifdef RS422_STRESS
+    } else if(strcasecmp(tok, "RSSTRESS") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "STOP") == 0) { rs422_stress_stop(); return; }
+        if(fsm_get_state() == STATE_SEQUENCER) { dbg_printf("Not while the sequencer is running\r\n"); return; }
+        uint32_t v[6] = {0};
+        for(int i=0;i<6 && arg;i++) { v[i] = strtoul(arg, NULL, 0); arg = strtok(NULL, " \t"); }
+        if(v[0] == 0 || v[1] == 0) { dbg_printf("Need heartbeat rate and duration\r\n"); return; }
+        rs422_stress_config_t cfg = {
+            .frames_per_s = (uint16_t)v[0], .seconds = (uint16_t)v[1], .commands_per_s = (uint16_t)v[2],
+            .corrupt_per_mille = (uint16_t)v[3], .noise_per_mille = (uint16_t)v[4], .tx_frames_per_s = (uint16_t)v[5]
+        };
+        rs422_stress_start(&cfg);
+        dbg_printf("RS422 stress started, RIU link parked\r\n");
+#endif
+#ifdef FSM_FUZZ
+    } else if(strcasecmp(tok, "FSMFUZZ") == 0) {
+        char *arg = strtok(NULL, " \t");
+        if(arg && strcasecmp(arg, "STOP") == 0) { fsm_fuzz_stop(); return; }
+        if(!arg) { dbg_printf("Need a run count\r\n"); return; }
+        uint32_t runs = strtoul(arg, NULL, 0);
+        arg = strtok(NULL, " \t");
+        uint32_t seed = arg ? strtoul(arg, NULL, 0) : HAL_GetTick();
+        fsm_fuzz_start(runs, seed);
+#endif
     } else {
         dbg_printf("Unknown command. Type HELP.\r\n");
     }
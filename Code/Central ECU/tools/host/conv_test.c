@@ -0,0 +1,112 @@
+// Host accuracy test of the integer sensor conversions (sensors.c, sensor_conv.h) against
+// the float and divide chain code they replaced, over every input. The cycle counts are
+// measured on the board, CONVBENCH on the debug interface.
+//
+// Usage: conv_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "calibration.h"
+#include "sensor_conv.h"
+#include "sensors.h"
+
+static int32_t round_float(float y)
+{
+    return (int32_t)(y + (y >= 0.0f ? 0.5f : -0.5f));
+}
+
+static int32_t thermo_reference(int32_t x)
+{
+    if (x < SENSORS_THERMO_IN_MIN) x = SENSORS_THERMO_IN_MIN;
+    if (x > SENSORS_THERMO_IN_MAX) x = SENSORS_THERMO_IN_MAX;
+    return round_float(sensor_conv_poly(calibration_get()->thermo_coeffs, SENSORS_THERMO_DEGREE, (float)x));
+}
+
+static int32_t mipa_reference(uint16_t sample, uint16_t reference)
+{
+    return (sensors_pressure_ratiometric(sample, reference) * (uint32_t)calibration_get()->mipa_full_scale) / 0xFFFFUL;
+}
+
+// One ADC frame of samples through the block path, against one sample at a time
+static bool check_frame(uint8_t id, const uint16_t *raw, uint8_t samples, uint16_t reference)
+{
+    CAN_ADCFrame frame = {0};
+    frame.what = (uint8_t)(id << 3);
+    for (uint8_t i = 0; i < samples; i++) {
+        frame.data[2 * i] = (uint8_t)raw[i];
+        frame.data[2 * i + 1] = (uint8_t)(raw[i] >> 8);
+    }
+    frame.length = (uint8_t)(2U * samples);
+    if (id <= SENSOR_P_MANIFOLD) {
+        frame.data[2 * samples] = (uint8_t)reference;
+        frame.data[2 * samples + 1] = (uint8_t)(reference >> 8);
+        frame.length += 2U;
+    }
+
+    int32_t out[SENSORS_FRAME_MAX_SAMPLES];
+    uint8_t n = sensors_convert_frame(&frame, out);
+    if (n != samples) return false;
+    for (uint8_t i = 0; i < n; i++) {
+        if (out[i] != sensors_convert(id, (int16_t)raw[i], reference)) return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    bool ok = true;
+    calibration_init(); // Blank store, so the built in defaults
+    sensors_init();
+
+    // Every thermocouple input, plus the clamped ends
+    int32_t worst = 0;
+    int32_t worst_at = 0;
+    for (int32_t x = INT16_MIN; x <= INT16_MAX; x++) {
+        int32_t err = labs(sensors_convert(SENSOR_THERMO_A, (int16_t)x, 0) - thermo_reference(x));
+        if (err > worst) {
+            worst = err;
+            worst_at = x;
+        }
+    }
+    printf("thermo table: max error %d centi-C at %d counts\n", worst, worst_at);
+    if (worst > SENSORS_CONV_MAX_ERROR) ok = false;
+
+    // MIPA line against the divide chain, every sample over a spread of supply references
+    int32_t mipa_worst = 0;
+    uint32_t mipa_worst_ref = 0;
+    uint32_t mipa_worst_at = 0;
+    for (uint32_t reference = 1024; reference <= 65535; reference += 13) {
+        for (uint32_t s = 0; s <= 65535; s++) {
+            int32_t err = labs(sensors_convert(SENSOR_P_MANIFOLD, (int16_t)s, (uint16_t)reference) -
+                               mipa_reference((uint16_t)s, (uint16_t)reference));
+            if (err > mipa_worst) {
+                mipa_worst = err;
+                mipa_worst_ref = reference;
+                mipa_worst_at = s;
+            }
+        }
+    }
+    printf("MIPA line: max error %d (0.1 bar) at sample %u, reference %u\n",
+           mipa_worst, mipa_worst_at, mipa_worst_ref);
+    if (mipa_worst > SENSORS_CONV_MAX_ERROR) ok = false;
+
+    // Block conversions of whole frames match the single sample conversions
+    bool frames_ok = true;
+    srand(1);
+    for (uint32_t f = 0; f < 20000U; f++) {
+        uint16_t raw[SENSORS_FRAME_MAX_SAMPLES];
+        for (uint8_t i = 0; i < SENSORS_FRAME_MAX_SAMPLES; i++) {
+            raw[i] = (uint16_t)rand();
+        }
+        uint16_t reference = (uint16_t)(30000 + rand() % 35536);
+        if (!check_frame(SENSOR_THERMO_A + (uint8_t)(f % 3U), raw, SENSORS_FRAME_MAX_SAMPLES, 0) ||
+            !check_frame(SENSOR_P_MANIFOLD, raw, SENSORS_FRAME_MAX_SAMPLES - 1U, reference)) {
+            frames_ok = false;
+        }
+    }
+    printf("frame conversions: %s\n", frames_ok ? "match" : "MISMATCH");
+    if (!frames_ok) ok = false;
+
+    printf("conversion test %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
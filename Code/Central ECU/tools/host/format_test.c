@@ -0,0 +1,128 @@
+// Host test of the AU aligned card format (sd_format.c) on the RAM disk, for the allocation
+// units cards report and for none, on FAT16 and FAT32 sized cards. After sd_format_card()
+// the image is read back: the MBR alone in the first AU with the partition on an AU boundary
+// and a whole number of AUs long, the data area AU aligned (SD_FORMAT_MAX_ALIGN for the
+// larger SDXC AUs), 32 KiB clusters, and the mounted volume holding the preallocated log
+// index and the LOG_xxxx directories. Throughput is SDBENCH on the board.
+//
+// Usage: format_test
+
+#include <stdio.h>
+#include <string.h>
+#include "ramdisk.h"
+#include "ff.h"
+#include "sd_format.h"
+#include "sd_index.h"
+
+static uint32_t le16(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return le16(p) | le16(p + 2) << 16;
+}
+
+static bool fail(uint32_t au, const char *msg, uint32_t value)
+{
+    printf("  AU %u: %s (%u)\n", au, msg, value);
+    return false;
+}
+
+// Format a card of sectors reporting au_sectors (1 = none) and check the result
+static bool check_format(uint32_t sectors, uint32_t au_sectors)
+{
+    ramdisk_config_t disk = {.sectors = sectors, .au_sectors = au_sectors};
+    if (!ramdisk_create(&disk)) return fail(au_sectors, "cannot create the RAM disk", 0);
+    FRESULT res = sd_format_card();
+    if (res != FR_OK) return fail(au_sectors, "sd_format_card failed", res);
+
+    uint32_t au = au_sectors > 1U ? au_sectors : SD_FORMAT_DEFAULT_AU;
+    uint32_t align = au < SD_FORMAT_MAX_ALIGN ? au : SD_FORMAT_MAX_ALIGN;
+    const uint8_t *img = ramdisk_image();
+    bool ok = true;
+
+    // MBR: nothing but the partition table, one entry, starting on an AU boundary
+    const uint8_t *mbr = img;
+    const uint8_t *pte = mbr + 446;
+    uint32_t part_start = le32(pte + 8);
+    uint32_t part_size = le32(pte + 12);
+    if (mbr[510] != 0x55 || mbr[511] != 0xAA) ok = fail(au, "no MBR signature", le16(mbr + 510));
+    for (uint32_t i = 0; i < 446U; i++) {
+        if (mbr[i] != 0) {
+            ok = fail(au, "sector 0 is not a bare MBR, byte", i);
+            break;
+        }
+    }
+    for (uint32_t i = 16; i < 64U; i++) {
+        if (pte[i] != 0) {
+            ok = fail(au, "more than one partition entry, byte", i);
+            break;
+        }
+    }
+    if (part_start != au) ok = fail(au, "partition does not start at the second AU", part_start);
+    if (part_size == 0 || part_size % au != 0) ok = fail(au, "partition not whole AUs", part_size);
+    if (part_start + part_size > sectors) ok = fail(au, "partition past the end", part_size);
+
+    // Boot sector: cluster size and where the data area lands
+    const uint8_t *bpb = img + (size_t)part_start * 512U;
+    uint32_t cluster = le16(bpb + 11) * bpb[13];
+    uint32_t fat_sectors = le16(bpb + 22) ? le16(bpb + 22) : le32(bpb + 36);
+    uint32_t root_sectors = (le16(bpb + 17) * 32U + 511U) / 512U;
+    uint32_t data = part_start + le16(bpb + 14) + bpb[16] * fat_sectors + root_sectors;
+    if (le16(bpb + 510) != 0xAA55) ok = fail(au, "no boot sector at the partition start", part_start);
+    if (le32(bpb + 28) != part_start) ok = fail(au, "hidden sectors not the partition start", le32(bpb + 28));
+    if (le16(bpb + 22) == 0 && le32(bpb + 6U * 512U + 28) != part_start) { // FAT32 backup boot sector
+        ok = fail(au, "backup boot sector hidden sectors", le32(bpb + 6U * 512U + 28));
+    }
+    if (cluster != SD_FORMAT_CLUSTER_BYTES) ok = fail(au, "cluster bytes", cluster);
+    if (data % align != 0) ok = fail(au, "data area not AU aligned, sector", data);
+
+    // Volume as sd_log finds it
+    static FATFS fs;
+    FILINFO fno;
+    res = f_mount(&fs, "", 1);
+    if (res != FR_OK) return fail(au, "cannot mount the formatted card", res);
+    FSIZE_t table = SD_INDEX_TABLE_OFFSET + (FSIZE_t)(SD_INDEX_MAX_SESSION + 1U) * SD_INDEX_RECORD_SIZE;
+    if (f_stat(SD_INDEX_FILENAME, &fno) != FR_OK) {
+        ok = fail(au, "no " SD_INDEX_FILENAME, 0);
+    } else if (fno.fsize < table) {
+        ok = fail(au, SD_INDEX_FILENAME " session table not preallocated, bytes", (uint32_t)fno.fsize);
+    }
+    for (uint32_t i = 1; i <= SD_FORMAT_PRECREATE_DIRS; i++) {
+        char dir[10];
+        snprintf(dir, sizeof(dir), "LOG_%04u", i);
+        if (f_stat(dir, &fno) != FR_OK || !(fno.fattrib & AM_DIR)) {
+            ok = fail(au, "missing session directory", i);
+            break;
+        }
+    }
+    (void)f_mount(NULL, "", 0);
+
+    printf("%4u MiB, AU %6u sectors%s: partition %u + %u, FAT%s, data at %u, %u KiB clusters: %s\n",
+           sectors / 2048U, au,
+           au_sectors > 1U ? "" : " (none reported)", part_start, part_size,
+           le16(bpb + 22) ? "16" : "32", data, cluster / 1024U, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(void)
+{
+    // None reported, then 4, 8, 16, 32 and 64 MiB (AU_SIZE codes 9, A, C, E and F). The
+    // images are sparse, only what the format writes takes memory.
+    static const struct {
+        uint32_t sectors;
+        uint32_t au;
+    } cards[] = {
+        {1UL << 21, 1}, {1UL << 21, 8192}, {1UL << 21, 16384}, {1UL << 21, 32768},
+        {1UL << 21, 65536}, {1UL << 21, 131072},   // 1 GiB, FAT16
+        {1UL << 23, 1}, {1UL << 23, 8192}, {1UL << 23, 65536}, // 4 GiB, FAT32
+    };
+    bool ok = true;
+    for (uint32_t i = 0; i < sizeof(cards) / sizeof(cards[0]); i++) {
+        ok = check_format(cards[i].sectors, cards[i].au) && ok;
+    }
+    printf("format_test %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
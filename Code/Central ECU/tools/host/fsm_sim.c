@@ -0,0 +1,1753 @@
+// Host simulation of the main FSM and the sequencer: main_FSM.c, sequencer.c, heartbeat.c
+// and rs422_handler.c with everything between them and the wires (RS422 link and command
+// layer, CAN driver and handlers, servo, spicy, fsm_monitor) unchanged, on the virtual clock
+// with the task intervals of app.c. The RS422 link, the CAN bus and the heartbeat timer are
+// the HAL drivers of host_periph.c, so the firmware's own interrupt callbacks run; the RIU,
+// the servo board and the ADC board are emulated at the other ends.
+//
+// Every run is a countdown of its own, forked from one booted firmware: the RIU arms and
+// fires, and one disturbance lands at a random time around it (abort command, disarm,
+// override, ESTOP, a second fire command, a board going silent, a servo board restart, a CAN
+// shutdown, or nothing). RIU frames reach the ECU after a random delay, some twice, some
+// overtaking others, some corrupted; sequencer timer events run late by a random amount and
+// the main loop stalls like an SD flush does. fsm_monitor checks its invariants throughout
+// and the outcome is checked against what the disturbance should have caused (check_run()).
+//
+// Usage: fsm_sim [options] [trace]
+//   trace       Scripted run instead of the random ones, "<ms> <event>" lines (see
+//               load_trace()) and candump -l lines. Run 0 keeps the exact timing, further
+//               runs (-n) add the delivery delays, stalls and timer latency of the options.
+//   -n runs     Runs (default 1000, 1 with a trace)
+//   -j jobs     Runs in parallel (default the number of CPUs)
+//   -S seed     Random seed (default 1), each run derives its own from it and its index
+//   -r run      Only this run, to reproduce a failure (with -v for the whole story)
+//   -J ms       RIU frame delivery delay, 0 to this (default 40)
+//   -d n        Per mille of RIU frames delivered twice (default 100)
+//   -o n        Per mille of RIU frames that may overtake the ones before them (default 50)
+//   -e n        Per mille of RIU frames corrupted on the line (default 0)
+//   -t us       Sequencer timer latency, 0 to this (default 200)
+//   -l ms       Main loop stall every 500 ms, 0 to this (default 10)
+//   -s file     Sequence script for the card (SEQ.TXT), default the built in one
+//   -v          Print the firmware's debug output and the harness events
+//
+// Exits 1 if any run fails a check, 2 on a setup error or a failed boot.
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "host_hal.h"
+#include "host_periph.h"
+#include "ramdisk.h"
+#include "app.h"
+#include "calibration.h"
+#include "can.h"
+#include "can_handlers.h"
+#include "crc.h"
+#include "error_def.h"
+#include "ff.h"
+#include "fsm_monitor.h"
+#include "heartbeat.h"
+#include "main_FSM.h"
+#include "rs422.h"
+#include "rs422_cmd.h"
+#include "rs422_handler.h"
+#include "seq_script.h"
+#include "sensors.h"
+#include "sequencer.h"
+#include "servo.h"
+#include "spicy.h"
+
+#define SIM_DISK_SECTORS        (64UL * 2048UL)     // 64 MB, only SEQ.TXT on it
+#define SIM_BOOT_MS             6000U       // Past the fire rate limit, which starts at boot
+#define SIM_BOOT_TIMEOUT_MS     15000U
+#define SIM_READY_TIMEOUT_MS    3000U       // Switches on to the ECU reporting the sequencer ready
+#define SIM_FIRE_DELAY_MS       500U        // Sequencer ready to the fire command, 0 to this
+#define SIM_EARLY_MS            200U        // Disturbances start this long before the fire command
+#define SIM_RUN_TIMEOUT_MS      5000U       // Past the planned end of the sequence
+#define SIM_TAIL_MS             600U        // Kept running after the sequencer state is left
+#define SIM_TRACE_TAIL_MS       1000U       // After the last trace event without an end
+#define SIM_TASK_US             30U         // Main loop time per task run, 0 to this
+#define SIM_STALL_EVERY_MS      500U        // Stall interval, as the SD flush task
+#define SIM_DROPOUT_MIN_MS      200U
+#define SIM_DROPOUT_MAX_MS      3000U
+#define SIM_SERVO_RESTART_MS    300U        // Silent while the servo board reboots
+#define SIM_SERVO_CMD_MIN_US    1000U       // Servo board command handling
+#define SIM_SERVO_CMD_MAX_US    3000U
+#define SIM_SERVO_MOVE_MIN_MS   250U        // Full travel
+#define SIM_SERVO_MOVE_MAX_MS   350U
+#define SIM_SERVO_REPORT_MS     100U
+#define SIM_BOARD_BEAT_MS       500U        // Servo and ADC board heartbeats
+#define SIM_ADC_FRAME_MS        50U
+#define SIM_ADC_SAMPLES         5U
+#define SIM_MAINLINE_BAR10      450         // Mainline pressure the ADC board reports, 10*bar
+#define SIM_RIU_BEAT_MS         100U
+#define SIM_RIU_RETRY_MS        50U         // RIU command retransmit interval
+#define SIM_RIU_TRIES           20U
+#define SIM_RIU_COMMANDS        8U
+#define SIM_CAN_DELAY_US        200U        // Arbitration and frame time on the bus, 0 to this
+#define SIM_QUEUE_LEN           256U
+
+// Allowances, on top of the main loop stall (-l)
+#define SIM_REACTION_MS         15U         // Cause at the ECU to the sequencer state left: one
+                                            // RS422 poll (10 ms) and a dispatch
+#define SIM_ABORT_REPORT_MS     50U         // ABORT entered to the abort command at the RIU
+#define SIM_HB_MARGIN_MS        30U         // Heartbeat loss detection, past the lost timeout
+
+#define SIM_SW_ARMED            0xE000U     // Master power, valve and pyro
+#define SIM_SW_DISARMED         0x8000U     // Master power only
+#define SIM_SW_OVERRIDE         0xF000U     // Armed, with the sequencer override
+#define SIM_FIRE_ARG            0xC0U       // Fire command, burn length in the low nibble
+
+#define SIM_TRACE_MAX           4096U
+#define SIM_MAX_FAILURES        20U
+#define SIM_BOARDS              4U          // BOARD_ID_RIU .. BOARD_ID_ADC_A
+
+#define ALLOW(state)            (1U << (state))
+
+uint8_t BOARD_ID = BOARD_ID_ECU;    // app.c
+
+typedef enum {
+    DIST_NONE = 0,
+    DIST_ABORT,             // RIU abort command
+    DIST_DISARM,            // Master pyro and valve off
+    DIST_OVERRIDE,          // Sequencer override on
+    DIST_ESTOP,
+    DIST_DOUBLE_FIRE,       // A second fire command, one of the two must be refused
+    DIST_RIU_DROPOUT,       // Link cut both ways
+    DIST_SERVO_DROPOUT,
+    DIST_ADC_DROPOUT,
+    DIST_SERVO_RESTART,     // Servo board reboots, startup warning when it is back
+    DIST_CAN_SHUTDOWN,      // ADC board sends a shutdown error
+    DIST_COUNT,
+    DIST_TRACE = DIST_COUNT
+} sim_dist_t;
+
+static const char *const dist_names[DIST_COUNT + 1] = {
+    "none", "abort", "disarm", "override", "estop", "double fire", "riu dropout",
+    "servo dropout", "adc dropout", "servo restart", "can shutdown", "trace",
+};
+
+static const char *const inv_names[FSM_INV_COUNT] = {
+    "igniter prefire", "solenoid state", "sequencer state", "abort outputs", "abort valves",
+};
+
+// Silence before heartbeat.c declares a board lost
+static const uint16_t lost_ms[SIM_BOARDS] = {
+    [BOARD_ID_RIU] = 1500, [BOARD_ID_SERVO] = 1200, [BOARD_ID_ADC_A] = 1200,
+};
+
+typedef struct {
+    uint32_t runs;
+    uint32_t jobs;
+    uint32_t seed;
+    int32_t only;               // -r, -1 for all
+    uint32_t jitter_ms;
+    uint32_t dup_permille;
+    uint32_t overtake_permille;
+    uint32_t corrupt_permille;
+    uint32_t timer_jitter_us;
+    uint32_t stall_ms;
+    const char *script;
+    const char *trace;
+} sim_options_t;
+
+// Per run results, in shared memory so they survive the run's process
+typedef struct {
+    bool done;
+    bool ok;
+    uint8_t dist;               // sim_dist_t
+    uint8_t outcome;            // main_states_t the sequencer state was left for
+    uint32_t seed;
+    int32_t dist_ms;            // Disturbance sent, from the fire command; INT32_MIN if never
+    uint32_t reaction_ms;       // Cause at the ECU to the sequencer state left, if it had one
+    uint32_t report_ms;         // ABORT to the abort command at the RIU, if checked
+    uint32_t disarm_ms;         // ABORT to every servo disarmed, if checked
+    uint32_t violations[FSM_INV_COUNT];
+    uint32_t excused;           // Abort valve violations with the servo board silent
+    char why[160];
+} sim_result_t;
+
+typedef enum {
+    TR_SWITCHES = 0,
+    TR_FIRE,
+    TR_ABORT,
+    TR_ESTOP,
+    TR_LINK,
+    TR_SERVO_RESTART,
+    TR_CAN,
+    TR_RS422,
+    TR_EXPECT,
+    TR_END,
+} sim_trace_op_t;
+
+typedef struct {
+    uint64_t at_us;             // From the run start
+    uint8_t op;                 // sim_trace_op_t
+    uint8_t board;              // TR_LINK
+    uint16_t value;             // Switch word, fire argument, abort code, on/off, CAN ID,
+                                // RS422 frame type, expected state
+    uint8_t len;
+    uint8_t data[64];
+    uint32_t line;
+} sim_trace_event_t;
+
+// A frame on its way to the ECU
+typedef struct {
+    bool used;
+    bool rs422;
+    bool tag;                   // Carries the disturbance
+    bool corrupt;
+    uint8_t beat;               // Heartbeat of this board + 1, 0 if not one
+    uint64_t at_us;
+    uint16_t can_id;
+    uint16_t len;
+    uint8_t data[RS422_TX_MESSAGE_SIZE];
+} sim_delivery_t;
+
+typedef struct {
+    bool active;                // Waiting for its ACK
+    bool tag;
+    uint8_t seq;
+    uint8_t type;
+    uint8_t size;
+    uint8_t data[8];            // Command sequence number first
+    uint8_t tries;
+    uint64_t last_us;
+} sim_riu_cmd_t;
+
+typedef struct {
+    bool armed;
+    uint8_t set;                // servo_positions_t
+    uint8_t pos;                // 0 closed .. 20 open
+    uint8_t from;
+    uint64_t move_start_us;     // 0 when not moving
+    uint32_t move_us;
+} sim_servo_t;
+
+typedef enum {
+    PHASE_BOOT = 0,
+    PHASE_ARM,                  // Switches sent, waiting for the sequencer to report ready
+    PHASE_RUN,                  // Fire command and disturbance, until the sequencer state is left
+    PHASE_TAIL,
+    PHASE_TRACE,
+    PHASE_DONE,
+} sim_phase_t;
+
+static sim_options_t opt = {
+    .runs = 0,
+    .seed = 1,
+    .only = -1,
+    .jitter_ms = 40,
+    .dup_permille = 100,
+    .overtake_permille = 50,
+    .corrupt_permille = 0,
+    .timer_jitter_us = 200,
+    .stall_ms = 10,
+};
+
+static sim_result_t *results;
+static sim_trace_event_t *trace;
+static uint32_t trace_len;
+static seq_script_t plan;       // The script the firmware loaded, for the run timing
+static int16_t mainline_raw;
+static uint32_t task_us = SIM_TASK_US;
+
+// ---------------- Firmware process state ----------------
+
+static uint64_t rng;
+static sim_delivery_t queue[SIM_QUEUE_LEN];
+
+static struct {
+    bool up;                    // Link up, both ways
+    uint8_t link_seq;
+    uint8_t cmd_seq;
+    uint64_t line_free_us;      // Frames leave in order unless they overtake
+    uint64_t next_beat_us;
+    sim_riu_cmd_t cmds[SIM_RIU_COMMANDS];
+    uint32_t gave_up;           // Commands never acknowledged
+    uint8_t rx[RS422_TX_MESSAGE_SIZE];
+    uint16_t rx_len;
+    bool rx_overflow;
+    uint8_t ecu_msb;            // ECU heartbeat: state << 4 | sub state
+    uint64_t abort_rx_us;       // First abort command from the ECU in the run
+    uint32_t bad_frames;        // ECU frames that did not decode
+} riu;
+
+static struct {
+    bool up;                    // Talking on the bus
+    sim_servo_t s[4];
+    uint64_t next_beat_us;
+    uint64_t next_report_us;
+    uint64_t restart_end_us;    // Rebooting until then, 0 if not
+    struct {
+        uint64_t at_us;
+        uint8_t what;
+        uint8_t options;
+    } cmds[16];
+    uint8_t cmd_count;
+} servo;
+
+static struct {
+    bool up;
+    uint64_t next_beat_us;
+    uint64_t next_frame_us;
+    uint8_t frame_seq;
+} adc;
+
+static struct {
+    uint32_t index;
+    sim_result_t *res;
+    sim_phase_t phase;
+    sim_dist_t dist;
+    uint64_t start_us;
+    uint64_t arm_us;
+    uint64_t fire_at_us;
+    bool fire_sent;
+    uint8_t fire_arg;
+    uint8_t fire_seq;
+    int16_t fire_status;        // -1 until the ACK is back
+    uint8_t fire2_arg;
+    uint8_t fire2_seq;
+    uint32_t burn_ms;           // Of the fire command accepted
+    int16_t fire2_status;
+    uint64_t dist_due_us;
+    bool dist_sent;
+    uint64_t dist_sent_us;
+    uint64_t dist_reached_us;   // First good copy at the ECU, 0 if none
+    uint8_t drop_board;         // Dropout or restart: this board is silent
+    uint64_t drop_start_us;
+    uint64_t drop_end_us;
+    bool riu_was_down;
+    uint64_t tail_end_us;
+    uint32_t trace_next;
+    // What the firmware did, sampled every ms
+    uint64_t countdown_us;
+    uint64_t t0_us;
+    uint64_t end_us;
+    main_states_t outcome;
+    bool outputs_safe;
+    uint64_t disarmed_us;
+    uint64_t lost_us[SIM_BOARDS];
+    uint64_t beat_last_us[SIM_BOARDS];      // Last heartbeat at the ECU
+    uint64_t gap_max_us[SIM_BOARDS];
+    uint64_t gap_start_us[SIM_BOARDS];
+    fsm_monitor_stats_t monitor_start;
+    fsm_event_stats_t events_start;
+} run;
+
+// ---------------- Random ----------------
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint32_t rand_below(uint32_t n)
+{
+    return n ? (uint32_t)(((splitmix64(&rng) >> 32) * n) >> 32) : 0U;
+}
+
+static uint32_t rand_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rand_below(hi - lo + 1U);
+}
+
+static bool chance(uint32_t per_mille)
+{
+    return rand_below(1000U) < per_mille;
+}
+
+static uint32_t run_seed(uint32_t index)
+{
+    uint64_t state = (uint64_t)opt.seed << 32 | index;
+    return (uint32_t)splitmix64(&state);
+}
+
+// ---------------- Helpers ----------------
+
+static void sim_log(const char *fmt, ...)
+{
+    if (!host_verbose) return;
+    va_list args;
+    va_start(args, fmt);
+    printf("[%9.3f] sim: ", (double)host_now_us() / 1e6);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+static void fail(const char *fmt, ...)
+{
+    sim_result_t *res = run.res;
+    if (res->ok) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(res->why, sizeof(res->why), fmt, args);
+        va_end(args);
+    }
+    res->ok = false;
+    if (host_verbose) {
+        va_list args;
+        va_start(args, fmt);
+        printf("[%9.3f] sim: FAIL: ", (double)host_now_us() / 1e6);
+        vprintf(fmt, args);
+        printf("\n");
+        va_end(args);
+    }
+}
+
+static const char *state_name(main_states_t state)
+{
+    switch (state) {
+        case STATE_INIT: return "INIT";
+        case STATE_READY: return "READY";
+        case STATE_SEQUENCER: return "SEQUENCER";
+        case STATE_POST_FIRE: return "POST_FIRE";
+        case STATE_MANUAL_MODE: return "MANUAL";
+        case STATE_ABORT: return "ABORT";
+    }
+    return "?";
+}
+
+static bool parse_state(const char *name, main_states_t *out)
+{
+    static const main_states_t states[] = {STATE_INIT, STATE_READY, STATE_SEQUENCER,
+                                           STATE_POST_FIRE, STATE_MANUAL_MODE, STATE_ABORT};
+    for (unsigned i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+        if (strcmp(name, state_name(states[i])) == 0) {
+            *out = states[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void put_timestamp(uint8_t ts[3])
+{
+    uint32_t ms = HAL_GetTick();
+    ts[0] = (uint8_t)(ms >> 16);
+    ts[1] = (uint8_t)(ms >> 8);
+    ts[2] = (uint8_t)ms;
+}
+
+// Burn length of a fire command argument, as sequencer_fire() takes it
+static uint32_t fire_burn_ms(uint8_t arg)
+{
+    return (arg & 0x0FU) ? (arg & 0x0FU) * 1000U : plan.burn_ms;
+}
+
+// Script timing: the end of the sequence from the countdown start, the servo steps up to
+// the pre-ignition checks (a silent servo board there can fail the checks)
+static uint32_t plan_total_ms(uint32_t burn_ms)
+{
+    uint32_t total = plan.countdown_ms;
+    for (uint8_t i = 0; i < plan.step_count; i++) {
+        const seq_script_step_t *s = &plan.steps[i];
+        int32_t at = (int32_t)plan.countdown_ms + s->execution_ms + (s->after_burn ? (int32_t)burn_ms : 0);
+        if (at > (int32_t)total) total = (uint32_t)at;
+    }
+    return total;
+}
+
+static void plan_servo_window(uint32_t *from_ms, uint32_t *to_ms)
+{
+    *from_ms = UINT32_MAX;
+    *to_ms = 0;
+    for (uint8_t i = 0; i < plan.step_count; i++) {
+        const seq_script_step_t *s = &plan.steps[i];
+        if (s->after_burn) continue;
+        uint32_t at = (uint32_t)((int32_t)plan.countdown_ms + s->execution_ms);
+        for (uint8_t k = 0; k < s->op_count; k++) {
+            uint8_t op = s->ops[k].op;
+            if (op == SEQ_OP_SERVO_ARM || op == SEQ_OP_OPEN || op == SEQ_OP_CLOSE) {
+                if (at < *from_ms) *from_ms = at;
+            } else if (op == SEQ_OP_CHECKS && at > *to_ms) {
+                *to_ms = at;
+            }
+        }
+    }
+    if (*from_ms > *to_ms) *from_ms = *to_ms;
+    *to_ms += SIM_SERVO_REPORT_MS;  // The report the checks looked at
+}
+
+// ---------------- Links ----------------
+
+static sim_delivery_t *queue_add(void)
+{
+    for (unsigned i = 0; i < SIM_QUEUE_LEN; i++) {
+        if (!queue[i].used) {
+            memset(&queue[i], 0, sizeof(queue[i]));
+            queue[i].used = true;
+            return &queue[i];
+        }
+    }
+    fprintf(stderr, "fsm_sim: delivery queue full\n");
+    exit(2);
+}
+
+static sim_delivery_t *queue_earliest(void)
+{
+    sim_delivery_t *first = NULL;
+    for (unsigned i = 0; i < SIM_QUEUE_LEN; i++) {
+        if (queue[i].used && (first == NULL || queue[i].at_us < first->at_us)) first = &queue[i];
+    }
+    return first;
+}
+
+static void deliver(sim_delivery_t *d)
+{
+    uint64_t now = host_now_us();
+    if (d->rs422) {
+        if (!riu.up) return; // Lost with the link
+        host_uart_receive(&huart1, d->data, d->len);
+    } else {
+        host_can_receive(d->can_id, d->data, (uint8_t)d->len);
+    }
+    if (d->corrupt) return;
+    if (d->tag && run.dist_reached_us == 0) {
+        run.dist_reached_us = now;
+        sim_log("%s reached the ECU\n", dist_names[run.dist]);
+    }
+    if (d->beat != 0) {
+        uint8_t b = d->beat - 1U;
+        if (run.beat_last_us[b] != 0 && now - run.beat_last_us[b] > run.gap_max_us[b]) {
+            run.gap_max_us[b] = now - run.beat_last_us[b];
+            run.gap_start_us[b] = run.beat_last_us[b];
+        }
+        run.beat_last_us[b] = now;
+    }
+}
+
+// Frames to the ECU, each at its time, in time order
+static uint64_t link_irq(void)
+{
+    sim_delivery_t *d;
+    while ((d = queue_earliest()) != NULL && d->at_us <= host_now_us()) {
+        d->used = false;
+        deliver(d);
+    }
+    return d != NULL ? d->at_us : UINT64_MAX;
+}
+
+static void link_rearm(void)
+{
+    sim_delivery_t *d = queue_earliest();
+    if (d != NULL) host_irq_attach(link_irq, d->at_us);
+}
+
+// A frame from the RIU, after the line delay. Frames keep their order on the line unless
+// one overtakes (a retransmit racing the original, as over a serial to network bridge).
+static void riu_send(RS422_FrameType_t type, const uint8_t *data, uint8_t size, bool tag, uint8_t beat)
+{
+    if (!riu.up) return;
+    uint64_t now = host_now_us();
+    sim_delivery_t *d = queue_add();
+    d->rs422 = true;
+    d->tag = tag;
+    d->beat = beat;
+    d->len = rs422_encode_frame(riu.link_seq++, type, data, size, d->data);
+    uint64_t at = now + (uint64_t)rand_below(opt.jitter_ms * 1000U + 1U);
+    if (!chance(opt.overtake_permille)) {
+        if (at < riu.line_free_us) at = riu.line_free_us;
+        riu.line_free_us = at + (uint64_t)d->len * HOST_UART_US_PER_BYTE;
+    }
+    d->at_us = at;
+    if (chance(opt.corrupt_permille)) {
+        d->corrupt = true;
+        d->data[rand_below(d->len - 1U)] ^= (uint8_t)(1U << rand_below(8));
+    }
+    link_rearm();
+}
+
+static void bus_send(CAN_Priority prio, CAN_MessageType type, const void *data, uint8_t len, bool tag, uint8_t beat)
+{
+    sim_delivery_t *d = queue_add();
+    d->can_id = pack_can_id((CAN_ID){.priority = prio, .nodeType = CAN_NODE_TYPE_CENTRAL,
+                                     .nodeAddr = CAN_NODE_ADDR_CENTRAL, .frameType = type});
+    d->tag = tag;
+    d->beat = beat;
+    d->len = len;
+    memcpy(d->data, data, len);
+    d->at_us = host_now_us() + rand_below(SIM_CAN_DELAY_US + 1U);
+    link_rearm();
+}
+
+// ---------------- RIU ----------------
+
+static void riu_transmit(sim_riu_cmd_t *c)
+{
+    riu_send((RS422_FrameType_t)c->type, c->data, c->size, c->tag, 0);
+    if (chance(opt.dup_permille)) riu_send((RS422_FrameType_t)c->type, c->data, c->size, c->tag, 0);
+    c->last_us = host_now_us();
+    c->tries++;
+}
+
+// A command, retransmitted until the ECU acknowledges it. Returns its sequence number.
+static uint8_t riu_command(RS422_FrameType_t type, const uint8_t *args, uint8_t size, bool tag)
+{
+    sim_riu_cmd_t *c = &riu.cmds[0];
+    for (unsigned i = 0; i < SIM_RIU_COMMANDS; i++) {
+        if (!riu.cmds[i].active) {
+            c = &riu.cmds[i];
+            break;
+        }
+    }
+    memset(c, 0, sizeof(*c));
+    c->active = true;
+    c->tag = tag;
+    c->seq = riu.cmd_seq++;
+    c->type = (uint8_t)type;
+    c->data[0] = c->seq;
+    memcpy(&c->data[1], args, size);
+    c->size = (uint8_t)(size + 1U);
+    riu_transmit(c);
+    return c->seq;
+}
+
+static void riu_switches(uint16_t switches, bool tag)
+{
+    uint8_t args[2] = {(uint8_t)(switches >> 8), (uint8_t)switches};
+    sim_log("RIU switches %04X\n", switches);
+    riu_command(RS422_FRAME_SWITCH_CHANGE, args, sizeof(args), tag);
+}
+
+static uint8_t riu_fire(uint8_t arg, bool tag)
+{
+    sim_log("RIU fire %02X\n", arg);
+    return riu_command(RS422_FRAME_FIRE, &arg, 1, tag);
+}
+
+static void riu_handle_frame(const uint8_t *frame, uint16_t len)
+{
+    if (len < 4U) {
+        riu.bad_frames++;
+        return;
+    }
+    uint16_t crc = (uint16_t)(frame[len - 2U] | frame[len - 1U] << 8);
+    if (crc16_compute(frame, len - 2U) != crc) {
+        riu.bad_frames++;
+        return;
+    }
+    uint8_t type = frame[1] >> 4;
+    const uint8_t *payload = &frame[2];
+    uint16_t size = (uint16_t)(len - 4U);
+
+    switch (type) {
+        case RS422_FRAME_HEARTBEAT:
+            if (size >= 1U) riu.ecu_msb = payload[0];
+            break;
+        case RS422_FRAME_CMD_ACK:
+            if (size < 3U) break;
+            for (unsigned i = 0; i < SIM_RIU_COMMANDS; i++) {
+                sim_riu_cmd_t *c = &riu.cmds[i];
+                if (c->active && c->seq == payload[0] && c->type == payload[1]) c->active = false;
+            }
+            if (payload[1] == RS422_FRAME_FIRE) {
+                if (run.fire_sent && payload[0] == run.fire_seq && run.fire_status < 0) {
+                    run.fire_status = payload[2];
+                    if (payload[2] == RS422_CMD_OK) run.burn_ms = fire_burn_ms(run.fire_arg);
+                    sim_log("fire %s (%u)\n", payload[2] == RS422_CMD_OK ? "accepted" : "refused", payload[2]);
+                } else if (run.dist == DIST_DOUBLE_FIRE && run.dist_sent && payload[0] == run.fire2_seq &&
+                           run.fire2_status < 0) {
+                    run.fire2_status = payload[2];
+                    if (payload[2] == RS422_CMD_OK) run.burn_ms = fire_burn_ms(run.fire2_arg);
+                    sim_log("second fire %s (%u)\n", payload[2] == RS422_CMD_OK ? "accepted" : "refused", payload[2]);
+                }
+            }
+            break;
+        case RS422_FRAME_ABORT:
+            // A command from the ECU: acknowledge every copy, as the RIU does
+            if (size < 1U) break;
+            if (run.phase != PHASE_BOOT && riu.abort_rx_us == 0) {
+                riu.abort_rx_us = host_now_us();
+                sim_log("RIU got the abort (%u)\n", size >= 2U ? payload[1] : 0U);
+            }
+            riu_send(RS422_FRAME_CMD_ACK, (const uint8_t[]){payload[0], RS422_FRAME_ABORT, RS422_CMD_OK}, 3, false, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// ECU frames off the line: COBS decode at each delimiter
+static void riu_rx(const uint8_t *data, uint16_t len)
+{
+    if (!riu.up) return;
+    for (uint16_t i = 0; i < len; i++) {
+        if (data[i] != RS422_COBS_DELIM) {
+            if (riu.rx_len < sizeof(riu.rx)) {
+                riu.rx[riu.rx_len++] = data[i];
+            } else {
+                riu.rx_overflow = true;
+            }
+            continue;
+        }
+        uint8_t frame[RS422_RAW_FRAME_SIZE];
+        uint16_t out = 0;
+        bool ok = !riu.rx_overflow;
+        for (uint16_t k = 0; ok && k < riu.rx_len;) {
+            uint8_t code = riu.rx[k++];
+            for (uint8_t j = 1; j < code; j++) {
+                if (k >= riu.rx_len || out >= sizeof(frame)) {
+                    ok = false;
+                    break;
+                }
+                frame[out++] = riu.rx[k++];
+            }
+            if (ok && code < 0xFFU && k < riu.rx_len) {
+                if (out >= sizeof(frame)) ok = false;
+                else frame[out++] = 0;
+            }
+        }
+        if (ok) {
+            riu_handle_frame(frame, out);
+        } else {
+            riu.bad_frames++;
+        }
+        riu.rx_len = 0;
+        riu.rx_overflow = false;
+    }
+}
+
+static void riu_tick(uint64_t now)
+{
+    if (!riu.up) return;
+    if (now >= riu.next_beat_us) {
+        static const uint8_t beat[2] = {0, 0};
+        riu_send(RS422_FRAME_HEARTBEAT, beat, sizeof(beat), false, BOARD_ID_RIU + 1U);
+        riu.next_beat_us += SIM_RIU_BEAT_MS * 1000ULL;
+    }
+    for (unsigned i = 0; i < SIM_RIU_COMMANDS; i++) {
+        sim_riu_cmd_t *c = &riu.cmds[i];
+        if (!c->active || now - c->last_us < SIM_RIU_RETRY_MS * 1000ULL) continue;
+        if (c->tries >= SIM_RIU_TRIES) {
+            c->active = false;
+            riu.gave_up++;
+            sim_log("RIU gave up on command %u type %u\n", c->seq, c->type);
+        } else {
+            riu_transmit(c);
+        }
+    }
+}
+
+// ---------------- Servo board ----------------
+
+static uint8_t servo_target(const sim_servo_t *s)
+{
+    return s->set == SERVO_POSITION_CLOSE ? 0U : 20U;
+}
+
+static void servo_start_move(sim_servo_t *s, uint64_t now)
+{
+    s->move_start_us = 0;
+    if (!s->armed || s->pos == servo_target(s)) return;
+    s->from = s->pos;
+    s->move_start_us = now;
+    s->move_us = rand_range(SIM_SERVO_MOVE_MIN_MS, SIM_SERVO_MOVE_MAX_MS) * 1000U;
+}
+
+static void servo_report(bool tag)
+{
+    CAN_ServoPosFrame f = {.what = (uint8_t)(4U << 3 | BOARD_ID_SERVO)}; // 4 servos connected
+    for (int i = 0; i < 4; i++) {
+        const sim_servo_t *s = &servo.s[i];
+        uint8_t state = !s->armed ? SERVO_DISARMED : s->move_start_us ? SERVO_MOVING : SERVO_ARMED;
+        bool at = s->pos == servo_target(s);
+        f.set_pos[i] = (uint8_t)(s->set << 6);
+        f.current_pos[i] = (uint8_t)(state << 6 | (at ? 0x20U : 0U) | s->pos);
+    }
+    put_timestamp(f.timestamp);
+    bus_send(CAN_PRIORITY_DATA, CAN_TYPE_SERVO_POS, &f, sizeof(f), tag, 0);
+}
+
+// Commands from the ECU, handled a few ms after they come off the bus
+static void servo_command(uint8_t what, uint8_t options)
+{
+    uint64_t now = host_now_us();
+    uint8_t cmd = what >> 3;
+    if (cmd == CAN_CMD_SET_SERVO_ARM) {
+        // High nibble selects the servos, low nibble arms (1) or disarms (0) them
+        for (int i = 0; i < 4; i++) {
+            if ((options & (0x10U << i)) == 0) continue;
+            sim_servo_t *s = &servo.s[i];
+            s->armed = (options & (1U << i)) != 0;
+            servo_start_move(s, now);
+        }
+    } else if (cmd == CAN_CMD_SET_SERVO_POS) {
+        sim_servo_t *s = &servo.s[(options >> 6) & 0x03U];
+        s->set = options & 0x03U;
+        servo_start_move(s, now);
+    }
+}
+
+static void servo_reset(void)
+{
+    memset(servo.s, 0, sizeof(servo.s));
+    for (int i = 0; i < 4; i++) servo.s[i].set = SERVO_POSITION_CLOSE;
+}
+
+static void servo_tick(uint64_t now)
+{
+    // Travel carries on even when the board is not talking
+    for (int i = 0; i < 4; i++) {
+        sim_servo_t *s = &servo.s[i];
+        if (s->move_start_us == 0) continue;
+        uint64_t t = now - s->move_start_us;
+        uint8_t target = servo_target(s);
+        if (t >= s->move_us) {
+            s->pos = target;
+            s->move_start_us = 0;
+        } else {
+            s->pos = (uint8_t)((int32_t)s->from + ((int32_t)target - s->from) * (int32_t)t / (int32_t)s->move_us);
+        }
+    }
+
+    if (servo.restart_end_us != 0 && now >= servo.restart_end_us) {
+        servo.restart_end_us = 0;
+        servo.up = true;
+        servo_reset();
+        CAN_ErrorWarningFrame w = {.what = (uint8_t)(CAN_ERROR_ACTION_WARNING << 6 | BOARD_ID_SERVO),
+                                   .why = SERVO_WARNING_STARTUP};
+        put_timestamp(w.timestamp);
+        sim_log("servo board back, startup warning\n");
+        bus_send(CAN_PRIORITY_CRITICAL, CAN_TYPE_ERROR, &w, sizeof(w), run.dist == DIST_SERVO_RESTART, 0);
+    }
+
+    for (uint8_t i = 0; i < servo.cmd_count;) {
+        if (servo.cmds[i].at_us > now) {
+            i++;
+            continue;
+        }
+        servo_command(servo.cmds[i].what, servo.cmds[i].options);
+        servo.cmds[i] = servo.cmds[--servo.cmd_count];
+    }
+
+    if (!servo.up) return;
+    if (now >= servo.next_beat_us) {
+        CAN_HeartbeatFrame h = {.what = BOARD_ID_SERVO};
+        put_timestamp(h.timestamp);
+        bus_send(CAN_PRIORITY_HEARTBEAT, CAN_TYPE_HEARTBEAT, &h, sizeof(h), false, BOARD_ID_SERVO + 1U);
+        servo.next_beat_us = now + SIM_BOARD_BEAT_MS * 1000ULL;
+    }
+    if (now >= servo.next_report_us) {
+        servo_report(false);
+        servo.next_report_us = now + SIM_SERVO_REPORT_MS * 1000ULL;
+    }
+}
+
+// ---------------- ADC board ----------------
+
+static void adc_tick(uint64_t now)
+{
+    if (!adc.up) return;
+    if (now >= adc.next_beat_us) {
+        CAN_HeartbeatFrame h = {.what = BOARD_ID_ADC_A};
+        put_timestamp(h.timestamp);
+        bus_send(CAN_PRIORITY_HEARTBEAT, CAN_TYPE_HEARTBEAT, &h, sizeof(h), false, BOARD_ID_ADC_A + 1U);
+        adc.next_beat_us = now + SIM_BOARD_BEAT_MS * 1000ULL;
+    }
+    if (now >= adc.next_frame_us) {
+        // Mainline pressure and temperature pairs at 10 ms, then the sequence number
+        CAN_ADCFrame f = {.what = (uint8_t)(SENSOR_PT_MAINLINE << 3 | 4U), .length = SIM_ADC_SAMPLES * 4U + 1U};
+        for (uint8_t i = 0; i < SIM_ADC_SAMPLES; i++) {
+            int16_t p = (int16_t)(mainline_raw + (int16_t)rand_below(5) - 2);
+            int16_t t = 2500;
+            f.data[4 * i] = (uint8_t)p;
+            f.data[4 * i + 1] = (uint8_t)((uint16_t)p >> 8);
+            f.data[4 * i + 2] = (uint8_t)t;
+            f.data[4 * i + 3] = (uint8_t)((uint16_t)t >> 8);
+        }
+        f.data[SIM_ADC_SAMPLES * 4U] = adc.frame_seq++;
+        put_timestamp(f.timestamp);
+        bus_send(CAN_PRIORITY_DATA, CAN_TYPE_ADC_DATA, &f, (uint8_t)(5U + f.length), false, 0);
+        adc.next_frame_us = now + SIM_ADC_FRAME_MS * 1000ULL;
+    }
+}
+
+// Frames the ECU puts on the bus: the servo board takes its commands
+static void bus_rx(uint16_t std_id, const uint8_t *data, uint8_t len)
+{
+    CAN_ID id = unpack_can_id(std_id);
+    if (id.nodeType != CAN_NODE_TYPE_SERVO || id.frameType != CAN_TYPE_COMMAND || len < 2U) return;
+    if (!servo.up || servo.cmd_count >= sizeof(servo.cmds) / sizeof(servo.cmds[0])) return;
+    servo.cmds[servo.cmd_count].at_us = host_now_us() + rand_range(SIM_SERVO_CMD_MIN_US, SIM_SERVO_CMD_MAX_US);
+    servo.cmds[servo.cmd_count].what = data[0];
+    servo.cmds[servo.cmd_count].options = data[1];
+    servo.cmd_count++;
+}
+
+// ---------------- Disturbances ----------------
+
+static void set_link(uint8_t board, bool up)
+{
+    if (board == BOARD_ID_RIU) {
+        riu.up = up;
+        if (!up) {
+            run.riu_was_down = true;
+            riu.rx_len = 0;
+        }
+    } else if (board == BOARD_ID_SERVO) {
+        servo.up = up;
+    } else if (board == BOARD_ID_ADC_A) {
+        adc.up = up;
+    }
+}
+
+static void servo_restart(uint64_t now)
+{
+    servo.up = false;
+    servo.cmd_count = 0;
+    servo.restart_end_us = now + SIM_SERVO_RESTART_MS * 1000ULL;
+}
+
+static void disturb(uint64_t now)
+{
+    static const uint8_t dropout_board[DIST_COUNT] = {
+        [DIST_RIU_DROPOUT] = BOARD_ID_RIU, [DIST_SERVO_DROPOUT] = BOARD_ID_SERVO,
+        [DIST_ADC_DROPOUT] = BOARD_ID_ADC_A,
+    };
+    run.dist_sent = true;
+    run.dist_sent_us = now;
+    sim_log("disturbance: %s\n", dist_names[run.dist]);
+
+    switch (run.dist) {
+        case DIST_ABORT: {
+            uint8_t code = 0;
+            riu_command(RS422_FRAME_ABORT, &code, 1, true);
+            break;
+        }
+        case DIST_DISARM:
+            riu_switches(SIM_SW_DISARMED, true);
+            break;
+        case DIST_OVERRIDE:
+            riu_switches(SIM_SW_OVERRIDE, true);
+            break;
+        case DIST_ESTOP:
+            host_gpio_set(INTERLOCK_GPIO_Port, INTERLOCK_Pin, GPIO_PIN_RESET);
+            run.dist_reached_us = now;
+            break;
+        case DIST_DOUBLE_FIRE:
+            run.fire2_arg = (uint8_t)(SIM_FIRE_ARG | rand_below(7));
+            run.fire2_seq = riu_fire(run.fire2_arg, true);
+            break;
+        case DIST_RIU_DROPOUT:
+        case DIST_SERVO_DROPOUT:
+        case DIST_ADC_DROPOUT:
+            run.drop_board = dropout_board[run.dist];
+            run.drop_start_us = now;
+            run.drop_end_us = now + rand_range(SIM_DROPOUT_MIN_MS, SIM_DROPOUT_MAX_MS) * 1000ULL;
+            set_link(run.drop_board, false);
+            break;
+        case DIST_SERVO_RESTART:
+            run.drop_board = BOARD_ID_SERVO;
+            run.drop_start_us = now;
+            run.drop_end_us = now + SIM_SERVO_RESTART_MS * 1000ULL;
+            servo_restart(now);
+            break;
+        case DIST_CAN_SHUTDOWN: {
+            CAN_ErrorWarningFrame e = {.what = (uint8_t)(CAN_ERROR_ACTION_SHUTDOWN << 6 | BOARD_ID_ADC_A),
+                                       .why = ADC_ERROR_FAIL_READ_PTE7300};
+            put_timestamp(e.timestamp);
+            bus_send(CAN_PRIORITY_CRITICAL, CAN_TYPE_ERROR, &e, sizeof(e), true, 0);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// ---------------- Trace ----------------
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static uint8_t parse_hex(const char *hex, uint8_t *out, uint8_t max)
+{
+    uint8_t n = 0;
+    while (n < max && hex_nibble(hex[0]) >= 0 && hex_nibble(hex[1]) >= 0) {
+        out[n++] = (uint8_t)(hex_nibble(hex[0]) << 4 | hex_nibble(hex[1]));
+        hex += 2;
+    }
+    return n;
+}
+
+static bool parse_board(const char *name, uint8_t *board)
+{
+    if (strcmp(name, "riu") == 0) *board = BOARD_ID_RIU;
+    else if (strcmp(name, "servo") == 0) *board = BOARD_ID_SERVO;
+    else if (strcmp(name, "adc") == 0) *board = BOARD_ID_ADC_A;
+    else return false;
+    return true;
+}
+
+// One event per line, at ms from the run start, '#' starts a comment:
+//   <ms> switches HHHH          RIU switch word (hex)
+//   <ms> fire N                 RIU fire command, burn N s (0 = the script's)
+//   <ms> abort [code]           RIU abort command
+//   <ms> estop on|off           ESTOP pressed or released
+//   <ms> link riu|servo|adc on|off
+//   <ms> servo_restart          Servo board reboots, startup warning 300 ms later
+//   <ms> can ID#HEX             Raw CAN frame to the ECU
+//   <ms> rs422 TYPE HEX         Raw RS422 frame from the RIU, type in decimal
+//   <ms> expect STATE           INIT, READY, SEQUENCER, POST_FIRE, MANUAL or ABORT
+//   <ms> end
+// candump -l lines, "(1712345678.123456) can0 24C#03000000", are CAN frames to the ECU at
+// their time from the first candump line, plus the time of the last event before it.
+static bool load_trace(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "fsm_sim: cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    trace = calloc(SIM_TRACE_MAX, sizeof(*trace));
+    if (trace == NULL) {
+        fclose(in);
+        return false;
+    }
+    char line[512];
+    uint32_t n = 0;
+    double first_dump = -1.0;
+    uint64_t dump_base_us = 0;
+    uint64_t last_us = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), in) != NULL) {
+        n++;
+        char *hash = strchr(line, '#');
+        if (line[0] != '(' && hash != NULL && (hash == line || hash[-1] == ' ' || hash[-1] == '\t')) *hash = '\0';
+        char word[32], arg[300], arg2[32];
+        double ts;
+        unsigned ms;
+        sim_trace_event_t e = {.line = n};
+
+        if (sscanf(line, " (%lf) %31s %299s", &ts, word, arg) == 3) {
+            char *sep = strchr(arg, '#');
+            if (sep == NULL) continue;
+            *sep = '\0';
+            if (first_dump < 0.0) {
+                first_dump = ts;
+                dump_base_us = last_us;
+            }
+            e.at_us = dump_base_us + (uint64_t)((ts - first_dump) * 1e6);
+            e.op = TR_CAN;
+            e.value = (uint16_t)strtoul(arg, NULL, 16);
+            const char *hex = sep + 1;
+            if (*hex == '#') hex += 2; // FD flags nibble
+            e.len = parse_hex(hex, e.data, sizeof(e.data));
+        } else {
+            int fields = sscanf(line, " %u %31s %299s %31s", &ms, word, arg, arg2);
+            if (fields <= 0) continue;
+            if (fields < 2) {
+                ok = false;
+                break;
+            }
+            e.at_us = (uint64_t)ms * 1000U;
+            main_states_t state;
+            if (strcmp(word, "switches") == 0 && fields >= 3) {
+                e.op = TR_SWITCHES;
+                e.value = (uint16_t)strtoul(arg, NULL, 16);
+            } else if (strcmp(word, "fire") == 0 && fields >= 3) {
+                e.op = TR_FIRE;
+                e.value = (uint16_t)(SIM_FIRE_ARG | (atoi(arg) & 0x0F));
+            } else if (strcmp(word, "abort") == 0) {
+                e.op = TR_ABORT;
+                e.value = fields >= 3 ? (uint16_t)atoi(arg) : 0U;
+            } else if (strcmp(word, "estop") == 0 && fields >= 3) {
+                e.op = TR_ESTOP;
+                e.value = strcmp(arg, "on") == 0;
+            } else if (strcmp(word, "link") == 0 && fields >= 4 && parse_board(arg, &e.board)) {
+                e.op = TR_LINK;
+                e.value = strcmp(arg2, "on") == 0;
+            } else if (strcmp(word, "servo_restart") == 0) {
+                e.op = TR_SERVO_RESTART;
+            } else if (strcmp(word, "can") == 0 && fields >= 3 && strchr(arg, '#') != NULL) {
+                e.op = TR_CAN;
+                e.value = (uint16_t)strtoul(arg, NULL, 16);
+                e.len = parse_hex(strchr(arg, '#') + 1, e.data, sizeof(e.data));
+            } else if (strcmp(word, "rs422") == 0 && fields >= 3) {
+                e.op = TR_RS422;
+                e.value = (uint16_t)atoi(arg);
+                e.len = fields >= 4 ? parse_hex(arg2, e.data, sizeof(e.data)) : 0U;
+            } else if (strcmp(word, "expect") == 0 && fields >= 3 && parse_state(arg, &state)) {
+                e.op = TR_EXPECT;
+                e.value = state;
+            } else if (strcmp(word, "end") == 0) {
+                e.op = TR_END;
+            } else {
+                ok = false;
+                break;
+            }
+        }
+        if (e.at_us < last_us || trace_len >= SIM_TRACE_MAX) {
+            ok = false;
+            break;
+        }
+        last_us = e.at_us;
+        trace[trace_len++] = e;
+    }
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "fsm_sim: %s:%u: bad or out of order event\n", path, n);
+        return false;
+    }
+    if (trace_len == 0) {
+        fprintf(stderr, "fsm_sim: no events in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void trace_step(uint64_t now)
+{
+    while (run.trace_next < trace_len && run.start_us + trace[run.trace_next].at_us <= now) {
+        const sim_trace_event_t *e = &trace[run.trace_next++];
+        switch (e->op) {
+            case TR_SWITCHES:
+                riu_switches(e->value, false);
+                break;
+            case TR_FIRE:
+                riu_fire((uint8_t)e->value, false);
+                break;
+            case TR_ABORT: {
+                uint8_t code = (uint8_t)e->value;
+                riu_command(RS422_FRAME_ABORT, &code, 1, false);
+                break;
+            }
+            case TR_ESTOP:
+                host_gpio_set(INTERLOCK_GPIO_Port, INTERLOCK_Pin, e->value ? GPIO_PIN_RESET : GPIO_PIN_SET);
+                break;
+            case TR_LINK:
+                set_link(e->board, e->value != 0);
+                break;
+            case TR_SERVO_RESTART:
+                servo_restart(now);
+                break;
+            case TR_CAN: {
+                sim_delivery_t *d = queue_add();
+                d->can_id = e->value;
+                d->len = e->len;
+                memcpy(d->data, e->data, e->len);
+                d->at_us = now;
+                link_rearm();
+                break;
+            }
+            case TR_RS422:
+                riu_send((RS422_FrameType_t)e->value, e->data, e->len, false, 0);
+                break;
+            case TR_EXPECT:
+                if (fsm_get_state() != (main_states_t)e->value) {
+                    fail("line %u: %s at %u ms, expected %s", e->line, state_name(fsm_get_state()),
+                         (unsigned)(e->at_us / 1000U), state_name((main_states_t)e->value));
+                }
+                break;
+            case TR_END:
+                run.phase = PHASE_DONE;
+                return;
+        }
+    }
+    if (run.trace_next >= trace_len && now >= run.start_us + trace[trace_len - 1].at_us + SIM_TRACE_TAIL_MS * 1000ULL) {
+        run.phase = PHASE_DONE;
+    }
+}
+
+// ---------------- Run ----------------
+
+// What the firmware is doing, every ms
+static void observe(uint64_t now)
+{
+    main_states_t state = fsm_get_state();
+    sequencer_states_t seq = sequencer_get_state();
+    if (run.phase == PHASE_BOOT) return;
+
+    for (uint8_t b = 0; b < SIM_BOARDS; b++) {
+        if (b != BOARD_ID_ECU && run.lost_us[b] == 0 && heartbeat_get_state(b) == HEARTBEAT_LOST) {
+            run.lost_us[b] = now;
+            sim_log("ECU lost board %u\n", b);
+        }
+    }
+    if (run.phase != PHASE_RUN && run.phase != PHASE_TAIL) return;
+    if (run.countdown_us == 0 && seq == SEQUENCER_COUNTDOWN) {
+        run.countdown_us = now;
+        sim_log("countdown started\n");
+    }
+    if (run.t0_us == 0 && seq == SEQUENCER_FIRE) run.t0_us = now;
+
+    if (run.phase == PHASE_RUN && state != STATE_SEQUENCER) {
+        run.end_us = now;
+        run.outcome = state;
+        run.outputs_safe = !spicy_get_arm() && !spicy_get_solenoid() && !spicy_get_ematch1();
+        run.phase = PHASE_TAIL;
+        run.tail_end_us = now + SIM_TAIL_MS * 1000ULL;
+        sim_log("left the sequencer for %s\n", state_name(state));
+    }
+    if (run.end_us != 0 && run.outcome == STATE_ABORT && run.disarmed_us == 0) {
+        bool disarmed = true;
+        for (int i = 0; i < 4; i++) disarmed = disarmed && !servo.s[i].armed;
+        if (disarmed) run.disarmed_us = now;
+    }
+}
+
+static void scenario(uint64_t now)
+{
+    if (run.drop_end_us != 0 && now >= run.drop_end_us && run.dist != DIST_SERVO_RESTART) {
+        set_link(run.drop_board, true);
+        run.drop_end_us = 0;
+        sim_log("board %u back\n", run.drop_board);
+    }
+
+    switch (run.phase) {
+        case PHASE_ARM:
+            if (riu.ecu_msb == (STATE_SEQUENCER << 4 | SEQUENCER_READY)) {
+                run.phase = PHASE_RUN;
+                run.fire_at_us = now + rand_below(SIM_FIRE_DELAY_MS + 1U) * 1000ULL;
+                run.fire_arg = (uint8_t)(SIM_FIRE_ARG | rand_below(7));
+                run.burn_ms = fire_burn_ms(run.fire_arg);
+                uint64_t span_ms = plan_total_ms(run.burn_ms) + SIM_EARLY_MS;
+                run.dist_due_us = run.fire_at_us + rand_below((uint32_t)span_ms + 1U) * 1000ULL;
+                run.dist_due_us = run.dist_due_us > SIM_EARLY_MS * 1000ULL + now
+                                      ? run.dist_due_us - SIM_EARLY_MS * 1000ULL : now;
+                if (run.dist == DIST_DOUBLE_FIRE && run.dist_due_us <= run.fire_at_us) {
+                    run.dist_due_us = run.fire_at_us + 1000U;
+                }
+            } else if (now - run.arm_us > SIM_READY_TIMEOUT_MS * 1000ULL) {
+                fail("sequencer never ready, ECU heartbeat %02X", riu.ecu_msb);
+                run.phase = PHASE_DONE;
+            }
+            break;
+        case PHASE_RUN:
+            if (!run.fire_sent && now >= run.fire_at_us) {
+                run.fire_sent = true;
+                run.fire_seq = riu_fire(run.fire_arg, false);
+            }
+            // A cut link would lose the fire command itself, so it waits for the ACK
+            if (!run.dist_sent && run.dist != DIST_NONE && now >= run.dist_due_us &&
+                (run.dist != DIST_RIU_DROPOUT || run.fire_status >= 0)) {
+                disturb(now);
+            }
+            if (run.fire_sent && now > run.fire_at_us + (plan_total_ms(SEQ_SCRIPT_MAX_BURN_MS) + SIM_RUN_TIMEOUT_MS) * 1000ULL) {
+                fail("still in SEQUENCER (sequencer %u, fire status %d)", sequencer_get_state(), run.fire_status);
+                run.phase = PHASE_DONE;
+            }
+            break;
+        case PHASE_TAIL:
+            if (now >= run.tail_end_us) run.phase = PHASE_DONE;
+            break;
+        case PHASE_TRACE:
+            trace_step(now);
+            break;
+        default:
+            break;
+    }
+}
+
+// The boards, every ms
+static uint64_t boards_irq(void)
+{
+    uint64_t now = host_now_us();
+    observe(now);
+    scenario(now);
+    riu_tick(now);
+    servo_tick(now);
+    adc_tick(now);
+    return now + 1000U;
+}
+
+// ---------------- Checks ----------------
+
+static uint64_t reaction_limit_us(void)
+{
+    return (uint64_t)(SIM_REACTION_MS + opt.stall_ms) * 1000U;
+}
+
+static uint64_t run_done_us(void)
+{
+    return run.countdown_us + (uint64_t)plan_total_ms(run.burn_ms) * 1000U;
+}
+
+// Outcomes allowed for a cause at the ECU at t: before the countdown, during it or after the
+// sequence ended, and both around each edge. Sets the cause time when the outcome is certain.
+static uint32_t expect_at(uint64_t t, uint32_t before, uint32_t during, uint64_t *cause_us)
+{
+    uint64_t react = reaction_limit_us();
+    if (run.countdown_us == 0 || t + react <= run.countdown_us) {
+        *cause_us = t;
+        return before;
+    }
+    if (t <= run.countdown_us + react) return before | during;
+    if (t + react <= run_done_us()) {
+        *cause_us = t;
+        return during;
+    }
+    if (t <= run_done_us() + react) return during | ALLOW(STATE_POST_FIRE);
+    return ALLOW(STATE_POST_FIRE);
+}
+
+// A board silence overlapping the servo moves before the pre-ignition checks
+static bool dropout_hits_servo_steps(void)
+{
+    if (run.countdown_us == 0) return false;
+    uint32_t from_ms, to_ms;
+    plan_servo_window(&from_ms, &to_ms);
+    uint64_t from = run.countdown_us + (uint64_t)from_ms * 1000U;
+    uint64_t to = run.countdown_us + (uint64_t)to_ms * 1000U;
+    uint64_t drop_end = run.drop_end_us ? run.drop_end_us : host_now_us();
+    return run.drop_start_us < to && drop_end + SIM_SERVO_REPORT_MS * 1000ULL > from;
+}
+
+static uint32_t expect_dropout(uint64_t *cause_us)
+{
+    uint8_t b = run.drop_board;
+    uint32_t undetected = dropout_hits_servo_steps() && b == BOARD_ID_SERVO
+                              ? ALLOW(STATE_POST_FIRE) | ALLOW(STATE_ABORT) : ALLOW(STATE_POST_FIRE);
+#ifdef TEST_MODE
+    // A lost board is only reported
+    return undetected;
+#else
+    uint64_t t = run.lost_us[b];
+    if (t == 0 || (run.end_us != 0 && t > run.end_us)) return undetected;
+    if (b == BOARD_ID_SERVO) return expect_at(t, ALLOW(STATE_ABORT), ALLOW(STATE_ABORT), cause_us);
+    // RIU and ADC boards lost after T-0 do not stop the burn
+    uint64_t react = reaction_limit_us();
+    if (run.t0_us == 0 || t + react <= run.t0_us) return expect_at(t, ALLOW(STATE_ABORT), ALLOW(STATE_ABORT), cause_us);
+    if (t <= run.t0_us + react) return ALLOW(STATE_ABORT) | ALLOW(STATE_POST_FIRE);
+    return ALLOW(STATE_POST_FIRE);
+#endif
+}
+
+// Loss detection against the longest silence the ECU saw from the dropped board
+static void check_detection(uint64_t now)
+{
+    uint8_t b = run.drop_board;
+    uint64_t gap = run.gap_max_us[b];
+    uint64_t gap_start = run.gap_start_us[b];
+    if (now - run.beat_last_us[b] > gap) {
+        gap = now - run.beat_last_us[b];
+        gap_start = run.beat_last_us[b];
+    }
+    uint64_t lost = (uint64_t)lost_ms[b] * 1000U;
+    uint64_t margin = (uint64_t)(SIM_HB_MARGIN_MS + opt.stall_ms) * 1000U;
+    if (gap >= lost + margin) {
+        if (run.lost_us[b] == 0) {
+            fail("board %u silent %u ms, never lost", b, (unsigned)(gap / 1000U));
+        } else if (run.lost_us[b] + 1000U < gap_start + lost || run.lost_us[b] > gap_start + lost + margin) {
+            // A ms early at most: heartbeat.c keeps arrival times in whole ms
+            fail("board %u lost %d ms into a %u ms silence", b,
+                 (int)(((int64_t)run.lost_us[b] - (int64_t)gap_start) / 1000), (unsigned)(gap / 1000U));
+        }
+    } else if (gap + margin <= lost && run.lost_us[b] != 0) {
+        fail("board %u lost after a %u ms silence", b, (unsigned)(gap / 1000U));
+    }
+}
+
+static void check_run(void)
+{
+    sim_result_t *res = run.res;
+    uint64_t now = host_now_us();
+    uint64_t cause_us = 0;
+    uint32_t allowed = ALLOW(STATE_POST_FIRE);
+    bool servo_down = run.dist == DIST_SERVO_DROPOUT || run.dist == DIST_SERVO_RESTART;
+
+    if (run.dist == DIST_TRACE) {
+        res->outcome = fsm_get_state();
+    } else {
+        res->outcome = run.end_us ? run.outcome : STATE_SEQUENCER;
+    }
+    res->dist_ms = run.dist_sent ? (int32_t)(((int64_t)run.dist_sent_us - (int64_t)run.fire_at_us) / 1000) : INT32_MIN;
+
+    if (run.dist != DIST_TRACE && run.end_us != 0) {
+        switch (run.dist) {
+            case DIST_ABORT:
+            case DIST_SERVO_RESTART:
+            case DIST_CAN_SHUTDOWN:
+                if (run.dist_reached_us) allowed = expect_at(run.dist_reached_us, ALLOW(STATE_ABORT), ALLOW(STATE_ABORT), &cause_us);
+                break;
+            case DIST_DISARM:
+            case DIST_ESTOP:
+                if (run.dist_reached_us) allowed = expect_at(run.dist_reached_us, ALLOW(STATE_READY), ALLOW(STATE_ABORT), &cause_us);
+                break;
+            case DIST_OVERRIDE:
+                // READY goes on to MANUAL on the same event or the next tick
+                if (run.dist_reached_us) {
+                    allowed = expect_at(run.dist_reached_us, ALLOW(STATE_READY) | ALLOW(STATE_MANUAL_MODE),
+                                        ALLOW(STATE_ABORT), &cause_us);
+                }
+                break;
+            case DIST_RIU_DROPOUT:
+            case DIST_SERVO_DROPOUT:
+            case DIST_ADC_DROPOUT:
+                if (run.dist_sent) {
+                    allowed = expect_dropout(&cause_us);
+                    check_detection(now);
+                }
+                break;
+            default:
+                break;
+        }
+
+        if ((allowed & ALLOW(run.outcome)) == 0) {
+            char want[64] = "";
+            for (unsigned s = 0; s < 16; s++) {
+                if (allowed & ALLOW(s)) {
+                    if (want[0]) strcat(want, " or ");
+                    strcat(want, state_name((main_states_t)s));
+                }
+            }
+            fail("ended in %s, expected %s", state_name(run.outcome), want);
+        }
+        if (run.countdown_us == 0 && (cause_us == 0 || cause_us > run.end_us)) {
+            fail("countdown never started (fire status %d)", run.fire_status);
+        }
+        if (cause_us != 0 && run.end_us >= cause_us && (allowed & ALLOW(run.outcome)) != 0) {
+            res->reaction_ms = (uint32_t)((run.end_us - cause_us) / 1000U);
+            if (run.end_us - cause_us > reaction_limit_us()) fail("%u ms to react", res->reaction_ms);
+        }
+        if (!run.outputs_safe) fail("outputs live on leaving the sequencer for %s", state_name(run.outcome));
+
+        if (run.outcome == STATE_ABORT) {
+            if (run.dist != DIST_RIU_DROPOUT) {
+                if (riu.abort_rx_us == 0) {
+                    fail("abort never reported to the RIU");
+                } else {
+                    res->report_ms = riu.abort_rx_us > run.end_us ? (uint32_t)((riu.abort_rx_us - run.end_us) / 1000U) : 0U;
+                    if (res->report_ms > SIM_ABORT_REPORT_MS + opt.stall_ms) fail("abort reported to the RIU after %u ms", res->report_ms);
+                }
+            }
+            if (!servo_down) {
+                if (run.disarmed_us == 0) {
+                    fail("servos still armed %u ms after the abort", (unsigned)((now - run.end_us) / 1000U));
+                } else {
+                    res->disarm_ms = (uint32_t)((run.disarmed_us - run.end_us) / 1000U);
+                    if (res->disarm_ms > FSM_MONITOR_ABORT_VALVES_MS) fail("servos disarmed %u ms after the abort", res->disarm_ms);
+                }
+            }
+        }
+
+        if (run.dist == DIST_DOUBLE_FIRE && run.fire_status == RS422_CMD_OK && run.fire2_status == RS422_CMD_OK) {
+            fail("both fire commands accepted");
+        }
+    }
+
+    fsm_monitor_stats_t monitor;
+    fsm_monitor_get_stats(&monitor);
+    for (unsigned i = 0; i < FSM_INV_COUNT; i++) {
+        res->violations[i] = monitor.violations[i] - run.monitor_start.violations[i];
+        if (res->violations[i] == 0) continue;
+        if (i == FSM_INV_ABORT_VALVES && servo_down) { // Nobody to disarm
+            res->excused = res->violations[i];
+            continue;
+        }
+        fail("invariant broken: %s (%u)", inv_names[i], res->violations[i]);
+    }
+    fsm_event_stats_t events;
+    fsm_get_event_stats(&events);
+    if (events.dropped != run.events_start.dropped) fail("%u FSM events dropped", events.dropped - run.events_start.dropped);
+    if (riu.gave_up != 0 && !run.riu_was_down) fail("%u RIU commands never acknowledged", riu.gave_up);
+}
+
+// ---------------- Firmware process ----------------
+
+static void task_send_heartbeat(void)
+{
+    can_send_heartbeat(CAN_NODE_TYPE_BROADCAST, CAN_NODE_ADDR_BROADCAST);
+    rs422_send_heartbeat();
+}
+
+// In place of the SD flush, which holds the main loop about this long
+static void task_stall(void)
+{
+    if (opt.stall_ms) host_advance_us(rand_below(opt.stall_ms * 1000U + 1U));
+}
+
+static Task tasks[] = {
+    {0, 20, can_handler_poll},
+    {0, 10, rs422_handler_rx_poll},
+    {0, SIM_STALL_EVERY_MS, task_stall},
+    {0, 100, fsm_tick},
+    {0, 1, fsm_dispatch},
+    {0, 1, fsm_monitor_poll},
+    {0, 3, can_service_tx_queue},
+    {0, 1, rs422_service_tx},
+    {0, 400, task_send_heartbeat},
+    {0, 200, spicy_send_status_update},
+};
+
+// The main loop, each task taking some time, until the run is over
+static void main_loop(bool (*done)(void))
+{
+    while (!done()) {
+        uint32_t now = HAL_GetTick();
+        for (unsigned i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+            if (now - tasks[i].last_run_time >= tasks[i].interval) {
+                tasks[i].last_run_time = now;
+                tasks[i].task_function();
+                if (task_us) host_advance_us(rand_below(task_us + 1U));
+            }
+        }
+        host_advance_us(1000U - host_now_us() % 1000U);
+    }
+}
+
+static bool booted(void)
+{
+    if (HAL_GetTick() > SIM_BOOT_TIMEOUT_MS) {
+        fprintf(stderr, "fsm_sim: no READY after %u ms (state %s)\n", SIM_BOOT_TIMEOUT_MS, state_name(fsm_get_state()));
+        exit(2);
+    }
+    return fsm_get_state() == STATE_READY && HAL_GetTick() >= SIM_BOOT_MS;
+}
+
+static bool run_over(void)
+{
+    return run.phase == PHASE_DONE;
+}
+
+static bool write_script(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "fsm_sim: cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    static char text[SEQ_SCRIPT_MAX_SIZE];
+    size_t len = fread(text, 1, sizeof(text), in);
+    fclose(in);
+    FIL f;
+    UINT written = 0;
+    bool ok = f_open(&f, SEQ_SCRIPT_FILE, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+    ok = ok && f_write(&f, text, (UINT)len, &written) == FR_OK && written == len;
+    if (ok) ok = f_close(&f) == FR_OK;
+    return ok;
+}
+
+// Boot once; every run forks from here
+static bool boot(void)
+{
+    static FATFS fs;
+    ramdisk_config_t disk = {.sectors = SIM_DISK_SECTORS, .sector_us = 0};
+    if (!ramdisk_create(&disk) || f_mount(&fs, "", 1) != FR_OK) {
+        fprintf(stderr, "fsm_sim: cannot create the RAM disk\n");
+        return false;
+    }
+    if (opt.script != NULL && !write_script(opt.script)) return false;
+
+    rng = opt.seed;
+    host_set_us(0);
+    host_gpio_set(INTERLOCK_GPIO_Port, INTERLOCK_Pin, GPIO_PIN_SET);       // ESTOP released
+    host_gpio_set(EMATCH1_CONT_GPIO_Port, EMATCH1_CONT_Pin, GPIO_PIN_SET); // Igniter connected
+    host_uart_tx_hook = riu_rx;
+    host_can_tx_hook = bus_rx;
+
+    calibration_init();
+    while (mainline_raw < INT16_MAX && sensors_convert(SENSOR_PT_MAINLINE, mainline_raw, 0) < SIM_MAINLINE_BAR10) {
+        mainline_raw++;
+    }
+    can_init();
+    rs422_init(&huart1);
+    sequencer_init();
+    heartbeat_init();
+    if (!seq_script_load(&plan)) {
+        fprintf(stderr, "fsm_sim: sequence script refused\n");
+        return false;
+    }
+
+    riu.up = servo.up = adc.up = true;
+    servo_reset();
+    riu.next_beat_us = rand_below(SIM_RIU_BEAT_MS * 1000U);
+    servo.next_beat_us = rand_below(SIM_BOARD_BEAT_MS * 1000U);
+    servo.next_report_us = rand_below(SIM_SERVO_REPORT_MS * 1000U);
+    adc.next_beat_us = rand_below(SIM_BOARD_BEAT_MS * 1000U);
+    adc.next_frame_us = rand_below(SIM_ADC_FRAME_MS * 1000U);
+    run.phase = PHASE_BOOT;
+    host_irq_attach(boards_irq, 1000U);
+    main_loop(booted);
+    return true;
+}
+
+static void run_child(uint32_t index)
+{
+    sim_result_t *res = &results[index];
+    memset(&run, 0, sizeof(run));
+    run.index = index;
+    run.res = res;
+    res->seed = run_seed(index);
+    res->ok = true;
+    rng = res->seed;
+    srand(res->seed);
+
+    // Run 0 of a trace is replayed exactly as written
+    if (opt.trace != NULL && index == 0) {
+        opt.jitter_ms = opt.dup_permille = opt.overtake_permille = opt.corrupt_permille = 0;
+        opt.stall_ms = 0;
+        opt.timer_jitter_us = 0;
+        task_us = 0;
+    }
+    host_timer_jitter_us = opt.timer_jitter_us;
+
+    fsm_monitor_get_stats(&run.monitor_start);
+    fsm_get_event_stats(&run.events_start);
+    for (uint8_t b = 0; b < SIM_BOARDS; b++) run.beat_last_us[b] = host_now_us();
+    run.start_us = host_now_us();
+    run.fire_status = run.fire2_status = -1;
+
+    if (opt.trace != NULL) {
+        run.dist = DIST_TRACE;
+        run.phase = PHASE_TRACE;
+    } else {
+        run.dist = (sim_dist_t)rand_below(DIST_COUNT);
+        run.phase = PHASE_ARM;
+        run.arm_us = host_now_us();
+        riu_switches(SIM_SW_ARMED, false);
+    }
+    res->dist = (uint8_t)run.dist;
+    main_loop(run_over);
+
+    check_run();
+    res->done = true;
+    fflush(stdout);
+    _exit(0);
+}
+
+// ---------------- Report ----------------
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: fsm_sim [-n runs] [-j jobs] [-S seed] [-r run] [-J ms] [-d n] [-o n] [-e n]\n"
+                    "               [-t us] [-l ms] [-s script] [-v] [trace]\n");
+    exit(2);
+}
+
+static bool report(uint32_t first, uint32_t count, double seconds)
+{
+    uint32_t runs[DIST_COUNT + 1] = {0}, failed[DIST_COUNT + 1] = {0};
+    uint32_t outcomes[DIST_COUNT + 1][4] = {{0}};   // POST_FIRE, ABORT, READY, other
+    uint32_t violations[FSM_INV_COUNT] = {0};
+    uint32_t max_reaction = 0, max_report = 0, max_disarm = 0, failures = 0, excused = 0;
+
+    for (uint32_t i = first; i < first + count; i++) {
+        const sim_result_t *r = &results[i];
+        uint8_t d = r->done ? r->dist : DIST_COUNT;
+        runs[d]++;
+        if (!r->done || !r->ok) {
+            failed[d]++;
+            if (failures++ < SIM_MAX_FAILURES) {
+                printf("run %u (%s", i, r->done ? dist_names[r->dist] : "crashed");
+                if (r->done && r->dist_ms != INT32_MIN) printf(" at %+d ms", r->dist_ms);
+                printf("): %s, reproduce with -S %u -r %u -v\n", r->done ? r->why : "no result", opt.seed, i);
+            }
+        }
+        if (!r->done) continue;
+        unsigned o = r->outcome == STATE_POST_FIRE ? 0U : r->outcome == STATE_ABORT ? 1U : r->outcome == STATE_READY ? 2U : 3U;
+        outcomes[d][o]++;
+        for (unsigned k = 0; k < FSM_INV_COUNT; k++) violations[k] += r->violations[k];
+        excused += r->excused;
+        if (r->reaction_ms > max_reaction) max_reaction = r->reaction_ms;
+        if (r->report_ms > max_report) max_report = r->report_ms;
+        if (r->disarm_ms > max_disarm) max_disarm = r->disarm_ms;
+    }
+    if (failures > SIM_MAX_FAILURES) printf("... %u more failed runs\n", failures - SIM_MAX_FAILURES);
+
+    printf("%-14s %6s %9s %6s %6s %6s %6s\n", "disturbance", "runs", "post fire", "abort", "ready", "other", "failed");
+    for (unsigned d = 0; d <= DIST_COUNT; d++) {
+        if (runs[d] == 0) continue;
+        printf("%-14s %6u %9u %6u %6u %6u %6u\n", d == DIST_COUNT && opt.trace == NULL ? "crashed" : dist_names[d],
+               runs[d], outcomes[d][0], outcomes[d][1], outcomes[d][2], outcomes[d][3], failed[d]);
+    }
+    printf("worst: reaction %u ms, abort to the RIU %u ms, abort to servos disarmed %u ms\n",
+           max_reaction, max_report, max_disarm);
+    printf("invariant violations:");
+    for (unsigned k = 0; k < FSM_INV_COUNT; k++) printf(" %s %u%s", inv_names[k], violations[k], k + 1U < FSM_INV_COUNT ? "," : "");
+    printf(excused ? " (%u with the servo board silent)\n" : "\n", excused);
+    printf("%u runs in %.1f s (%.0f runs/min)\n", count, seconds, seconds > 0.0 ? count * 60.0 / seconds : 0.0);
+    return failures == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    opt.jobs = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    while ((c = getopt(argc, argv, "n:j:S:r:J:d:o:e:t:l:s:v")) != -1) {
+        switch (c) {
+            case 'n': opt.runs = (uint32_t)atoi(optarg); break;
+            case 'j': opt.jobs = (uint32_t)atoi(optarg); break;
+            case 'S': opt.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'r': opt.only = atoi(optarg); break;
+            case 'J': opt.jitter_ms = (uint32_t)atoi(optarg); break;
+            case 'd': opt.dup_permille = (uint32_t)atoi(optarg); break;
+            case 'o': opt.overtake_permille = (uint32_t)atoi(optarg); break;
+            case 'e': opt.corrupt_permille = (uint32_t)atoi(optarg); break;
+            case 't': opt.timer_jitter_us = (uint32_t)atoi(optarg); break;
+            case 'l': opt.stall_ms = (uint32_t)atoi(optarg); break;
+            case 's': opt.script = optarg; break;
+            case 'v': host_verbose = true; break;
+            default: usage();
+        }
+    }
+    if (optind < argc) opt.trace = argv[optind];
+    if (opt.runs == 0) opt.runs = opt.trace != NULL ? 1U : 1000U;
+    if (opt.jobs == 0) opt.jobs = 1;
+    if (opt.only >= (int32_t)opt.runs) opt.runs = (uint32_t)opt.only + 1U;
+    if (opt.trace != NULL && !load_trace(opt.trace)) return 2;
+
+    results = mmap(NULL, opt.runs * sizeof(*results), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        fprintf(stderr, "fsm_sim: out of memory\n");
+        return 2;
+    }
+    bool verbose = host_verbose;
+    host_verbose = verbose && opt.only < 0 && opt.jobs == 1;
+    if (!boot()) return 2;
+    host_verbose = verbose;
+
+    uint32_t first = opt.only >= 0 ? (uint32_t)opt.only : 0U;
+    uint32_t count = opt.only >= 0 ? 1U : opt.runs;
+    printf("fsm_sim: %u run%s%s%s, %s configuration, script %s (countdown %u ms, burn %u ms), seed %u\n",
+           count, count == 1U ? "" : "s", opt.trace ? " of " : "", opt.trace ? opt.trace : "",
+#ifdef TEST_MODE
+           "test",
+#else
+           "hot-fire",
+#endif
+           plan.from_card ? opt.script : "built in", plan.countdown_ms, plan.burn_ms, opt.seed);
+    printf("  RIU delay 0-%u ms, %u/1000 twice, %u/1000 overtaking, %u/1000 corrupted; timer latency 0-%u us, "
+           "stalls 0-%u ms\n", opt.jitter_ms, opt.dup_permille, opt.overtake_permille, opt.corrupt_permille,
+           opt.timer_jitter_us, opt.stall_ms);
+    fflush(stdout);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint32_t running = 0;
+    for (uint32_t next = first; next < first + count || running > 0;) {
+        if (next < first + count && running < opt.jobs) {
+            pid_t pid = fork();
+            if (pid == 0) run_child(next);
+            if (pid < 0) {
+                fprintf(stderr, "fsm_sim: fork: %s\n", strerror(errno));
+                return 2;
+            }
+            running++;
+            next++;
+            continue;
+        }
+        if (wait(NULL) > 0) running--;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    bool ok = report(first, count, seconds);
+    printf("fsm_sim %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
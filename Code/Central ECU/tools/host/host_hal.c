@@ -0,0 +1,252 @@
+#include "host_hal.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "debug_io.h"
+#include "seq_timer.h"
+
+// The parts of the HAL and of the board the modules under test touch, on a virtual clock.
+// Everything else is stubbed in host_stubs.c.
+
+volatile uint32_t host_primask = 0;
+volatile uint32_t host_ipsr = 0;
+bool host_verbose = false;
+uint32_t host_timer_jitter_us = 0;
+
+static uint64_t now_us = 0;
+
+// Sequencer timer (seq_timer.c drives TIM3 registers, which plain memory cannot mimic: the
+// status flags are cleared by writing zeros). Same API and semantics on the virtual clock.
+static bool timer_armed = false;
+static uint64_t timer_due_us = 0;
+static seq_timer_fn timer_fn = NULL;
+
+// Simulated interrupt sources (CAN RX and the like), see host_irq_attach()
+typedef struct {
+    host_irq_fn fn;
+    uint64_t due_us;
+} irq_source_t;
+
+static irq_source_t irqs[HOST_IRQ_SOURCES];
+
+#define GPIO_PORTS  6U
+
+static GPIO_PinState pins[GPIO_PORTS][16];
+static uint32_t pin_writes[GPIO_PORTS][16];
+
+// Peripheral registers the modules touch directly (SysTick in cycle_count.h, the TIM14, UART
+// and DMA macros) as plain memory at their real addresses, so the code and the instance
+// pointer compares work unchanged. Nothing counts, cycle counts read zero.
+__attribute__((constructor)) static void map_register_pages(void)
+{
+    static const uintptr_t bases[] = {SCS_BASE, TIM14_BASE, USART1_BASE, DMA1_BASE};
+    for (unsigned i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        void *page = (void *)(bases[i] & ~(uintptr_t)0xFFFU);
+        if (mmap(page, 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+                 -1, 0) == MAP_FAILED && errno != EEXIST) {
+            perror("host_hal: cannot map the peripheral registers");
+            exit(2);
+        }
+    }
+}
+
+uint64_t host_now_us(void)
+{
+    return now_us;
+}
+
+void host_set_us(uint64_t us)
+{
+    now_us = us;
+    timer_armed = false;
+    host_primask = 0;
+}
+
+// Earliest due interrupt source, NULL if none is due by end
+static irq_source_t *next_irq(uint64_t end)
+{
+    irq_source_t *next = NULL;
+    for (unsigned i = 0; i < HOST_IRQ_SOURCES; i++) {
+        irq_source_t *src = &irqs[i];
+        if (src->fn != NULL && src->due_us <= end && (next == NULL || src->due_us < next->due_us)) {
+            next = src;
+        }
+    }
+    return next;
+}
+
+void host_advance_us(uint64_t us)
+{
+    uint64_t end = now_us + us;
+    // Masked interrupts stay pending, the sequencer timer ahead of the others at the same time
+    while (host_primask == 0) {
+        bool timer = timer_armed && timer_due_us <= end;
+        irq_source_t *irq = next_irq(end);
+        if (!timer && irq == NULL) break;
+        host_ipsr = 1;
+        if (irq != NULL && (!timer || irq->due_us < timer_due_us)) {
+            if (irq->due_us > now_us) now_us = irq->due_us;
+            irq->due_us = irq->fn();
+        } else {
+            if (timer_due_us > now_us) now_us = timer_due_us;
+            timer_armed = false;
+            if (timer_fn != NULL) {
+                timer_fn(); // May schedule the next event, possibly already due
+            }
+        }
+        host_ipsr = 0;
+    }
+    now_us = end;
+}
+
+void host_irq_attach(host_irq_fn fn, uint64_t first_us)
+{
+    irq_source_t *free_src = NULL;
+    for (unsigned i = 0; i < HOST_IRQ_SOURCES; i++) {
+        if (irqs[i].fn == fn) {
+            irqs[i].due_us = first_us;
+            return;
+        }
+        if (irqs[i].fn == NULL && free_src == NULL) free_src = &irqs[i];
+    }
+    if (free_src == NULL) {
+        fprintf(stderr, "host_hal: more than %u interrupt sources\n", HOST_IRQ_SOURCES);
+        exit(2);
+    }
+    free_src->fn = fn;
+    free_src->due_us = first_us;
+}
+
+void host_irq_detach(host_irq_fn fn)
+{
+    for (unsigned i = 0; i < HOST_IRQ_SOURCES; i++) {
+        if (irqs[i].fn == fn) irqs[i].fn = NULL;
+    }
+}
+
+void host_advance_ms(uint32_t ms)
+{
+    host_advance_us((uint64_t)ms * 1000U);
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return (uint32_t)(now_us / 1000U);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    host_advance_ms(Delay);
+}
+
+void seq_timer_init(void)
+{
+    timer_armed = false;
+}
+
+uint32_t seq_timer_now_us(void)
+{
+    return (uint32_t)now_us;
+}
+
+void seq_timer_schedule(uint32_t at_us, seq_timer_fn fn)
+{
+    // Same wrap handling as the target: a target up to half the timeline behind is due now
+    int32_t delta = (int32_t)(at_us - (uint32_t)now_us);
+    uint64_t due = delta <= 0 ? now_us : now_us + (uint64_t)delta;
+    if (host_timer_jitter_us > 0) {
+        due += (uint64_t)(rand() % (int)(host_timer_jitter_us + 1U));
+    }
+    timer_fn = fn;
+    timer_due_us = due;
+    timer_armed = true;
+}
+
+void seq_timer_cancel(void)
+{
+    timer_armed = false;
+}
+
+static int port_index(const GPIO_TypeDef *port)
+{
+    static GPIO_TypeDef *const ports[GPIO_PORTS] = {GPIOA, GPIOB, GPIOC, GPIOD, GPIOE, GPIOF};
+    for (unsigned i = 0; i < GPIO_PORTS; i++) {
+        if (ports[i] == port) return (int)i;
+    }
+    return -1;
+}
+
+GPIO_PinState host_gpio_get(GPIO_TypeDef *port, uint16_t pin)
+{
+    int p = port_index(port);
+    if (p < 0 || pin == 0) return GPIO_PIN_RESET;
+    return pins[p][__builtin_ctz(pin)];
+}
+
+void host_gpio_set(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+    int p = port_index(port);
+    if (p < 0) return;
+    for (unsigned b = 0; b < 16U; b++) {
+        if ((pin & (1U << b)) == 0) continue;
+        if (pins[p][b] != state) pin_writes[p][b]++;
+        pins[p][b] = state;
+    }
+}
+
+uint32_t host_gpio_writes(GPIO_TypeDef *port, uint16_t pin)
+{
+    int p = port_index(port);
+    if (p < 0 || pin == 0) return 0;
+    return pin_writes[p][__builtin_ctz(pin)];
+}
+
+void host_gpio_reset(void)
+{
+    memset(pins, 0, sizeof(pins));
+    memset(pin_writes, 0, sizeof(pin_writes));
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    return host_gpio_get(GPIOx, GPIO_Pin);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    host_gpio_set(GPIOx, GPIO_Pin, PinState);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    host_gpio_set(GPIOx, GPIO_Pin, host_gpio_get(GPIOx, GPIO_Pin) == GPIO_PIN_SET ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+void dbg_printf(const char *fmt, ...)
+{
+    if (!host_verbose) return;
+    va_list args;
+    va_start(args, fmt);
+    printf("[%8.3f] ", (double)now_us / 1e6);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void dbg_printf_nolog(const char *fmt, ...)
+{
+    if (!host_verbose) return;
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int dbg_recv(char *buffer, int max_length)
+{
+    (void)buffer;
+    (void)max_length;
+    return 0;
+}
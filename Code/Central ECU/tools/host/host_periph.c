@@ -0,0 +1,353 @@
+#include "host_periph.h"
+#include <string.h>
+#include "host_hal.h"
+
+// Handles as CubeMX sets them up in main.c, as far as the modules look at them
+DMA_HandleTypeDef hdma_usart1_rx = {.Instance = DMA1_Channel1};
+UART_HandleTypeDef huart1 = {.Instance = USART1, .hdmarx = &hdma_usart1_rx};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1};
+TIM_HandleTypeDef htim14 = {.Instance = TIM14};
+
+void (*host_uart_tx_hook)(const uint8_t *data, uint16_t len) = NULL;
+void (*host_can_tx_hook)(uint16_t std_id, const uint8_t *data, uint8_t len) = NULL;
+
+// Weak like the HAL's own, for targets that do not link the module with the real one
+__weak void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    (void)huart;
+    (void)Size;
+}
+
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+}
+
+__weak void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+{
+    (void)hfdcan;
+    (void)RxFifo0ITs;
+}
+
+__weak void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs)
+{
+    (void)hfdcan;
+    (void)RxFifo1ITs;
+}
+
+__weak void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+}
+
+//==============================
+// USART1: circular RX DMA, TX DMA
+//==============================
+
+static struct {
+    uint8_t *ring;          // Receive buffer given to HAL_UARTEx_ReceiveToIdle_DMA()
+    uint16_t size;
+    uint16_t pos;           // Next byte the DMA writes
+    bool tx_busy;
+    uint8_t tx_data[256];
+    uint16_t tx_len;
+    uint64_t tx_done_us;
+} uart;
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (pData == NULL || Size == 0) return HAL_ERROR;
+    uart.ring = pData;
+    uart.size = Size;
+    uart.pos = 0;
+    huart->hdmarx->Instance->CNDTR = Size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    uart.ring = NULL;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart)
+{
+    return HAL_UART_AbortReceive(huart);
+}
+
+void host_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len)
+{
+    bool reported = true;
+    for (uint16_t i = 0; i < len; i++) {
+        if (uart.ring == NULL) return; // Receiver stopped, bytes lost
+        uart.ring[uart.pos] = data[i];
+        uart.pos = (uint16_t)((uart.pos + 1U) % uart.size);
+        huart->hdmarx->Instance->CNDTR = uart.size - uart.pos;
+        reported = false;
+        if (uart.pos == uart.size / 2U || uart.pos == 0) {
+            HAL_UARTEx_RxEventCallback(huart, uart.pos == 0 ? uart.size : uart.pos); // Half or full transfer
+            reported = true;
+        }
+    }
+    if (!reported) {
+        HAL_UARTEx_RxEventCallback(huart, uart.pos); // Line idle after the last byte
+    }
+}
+
+static uint64_t uart_tx_irq(void)
+{
+    uart.tx_busy = false;
+    if (host_uart_tx_hook != NULL) host_uart_tx_hook(uart.tx_data, uart.tx_len);
+    HAL_UART_TxCpltCallback(&huart1); // May start the next transfer
+    return uart.tx_busy ? uart.tx_done_us : UINT64_MAX;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    (void)huart;
+    if (uart.tx_busy) return HAL_BUSY;
+    if (Size == 0 || Size > sizeof(uart.tx_data)) return HAL_ERROR;
+    memcpy(uart.tx_data, pData, Size);
+    uart.tx_len = Size;
+    uart.tx_busy = true;
+    uart.tx_done_us = host_now_us() + (uint64_t)Size * HOST_UART_US_PER_BYTE;
+    host_irq_attach(uart_tx_irq, uart.tx_done_us);
+    return HAL_OK;
+}
+
+//==============================
+// FDCAN1
+//==============================
+
+#define CAN_FILTERS 28U     // Standard ID filter elements on the G0
+
+typedef struct {
+    uint16_t id;
+    uint8_t len;
+    uint8_t data[64];
+} can_frame_t;
+
+static const uint8_t dlc_bytes[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+static struct {
+    FDCAN_FilterTypeDef filters[CAN_FILTERS];
+    bool filter_used[CAN_FILTERS];
+    uint32_t non_matching;          // Global filter for standard IDs
+    bool started;
+    can_frame_t rx;                 // Frame the RX callback is about to read
+    bool rx_full;
+    can_frame_t tx[HOST_CAN_TX_FIFO];
+    uint8_t tx_head;
+    uint8_t tx_count;
+    uint64_t tx_done_us;
+} can;
+
+static uint8_t bytes_to_dlc(uint8_t len)
+{
+    uint8_t dlc = 0;
+    while (dlc < 15U && dlc_bytes[dlc] < len) dlc++;
+    return dlc;
+}
+
+// Arbitration at 1 Mbit/s and the data phase at 5 Mbit/s, stuffing included roughly
+static uint64_t can_frame_us(uint8_t len)
+{
+    return 40U + (uint64_t)len * 2U;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *hfdcan, const FDCAN_FilterTypeDef *sFilterConfig)
+{
+    (void)hfdcan;
+    if (sFilterConfig->IdType != FDCAN_STANDARD_ID) return HAL_OK; // Only 11 bit IDs on this bus
+    if (sFilterConfig->FilterIndex >= CAN_FILTERS) return HAL_ERROR;
+    can.filters[sFilterConfig->FilterIndex] = *sFilterConfig;
+    can.filter_used[sFilterConfig->FilterIndex] = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan, uint32_t NonMatchingStd,
+                                               uint32_t NonMatchingExt, uint32_t RejectRemoteStd,
+                                               uint32_t RejectRemoteExt)
+{
+    (void)hfdcan;
+    (void)NonMatchingExt;
+    (void)RejectRemoteStd;
+    (void)RejectRemoteExt;
+    can.non_matching = NonMatchingStd;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan)
+{
+    (void)hfdcan;
+    can.started = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t ActiveITs,
+                                                 uint32_t BufferIndexes)
+{
+    (void)hfdcan;
+    (void)ActiveITs;
+    (void)BufferIndexes;
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetError(const FDCAN_HandleTypeDef *hfdcan)
+{
+    return hfdcan->ErrorCode;
+}
+
+// FIFO the first matching filter sends the frame to, 0 if rejected
+static uint32_t can_filter(uint16_t id)
+{
+    for (unsigned i = 0; i < CAN_FILTERS; i++) {
+        const FDCAN_FilterTypeDef *f = &can.filters[i];
+        if (!can.filter_used[i]) continue;
+        bool match;
+        switch (f->FilterType) {
+            case FDCAN_FILTER_RANGE: match = id >= f->FilterID1 && id <= f->FilterID2; break;
+            case FDCAN_FILTER_DUAL:  match = id == f->FilterID1 || id == f->FilterID2; break;
+            case FDCAN_FILTER_MASK:  match = (id & f->FilterID2) == (f->FilterID1 & f->FilterID2); break;
+            default:                 match = false; break;
+        }
+        if (!match) continue;
+        switch (f->FilterConfig) {
+            case FDCAN_FILTER_TO_RXFIFO0: return FDCAN_RX_FIFO0;
+            case FDCAN_FILTER_TO_RXFIFO1: return FDCAN_RX_FIFO1;
+            default:                      return 0; // Reject, or a priority only filter
+        }
+    }
+    switch (can.non_matching) {
+        case FDCAN_ACCEPT_IN_RX_FIFO0: return FDCAN_RX_FIFO0;
+        case FDCAN_ACCEPT_IN_RX_FIFO1: return FDCAN_RX_FIFO1;
+        default:                       return 0;
+    }
+}
+
+bool host_can_receive(uint16_t std_id, const uint8_t *data, uint8_t len)
+{
+    uint32_t fifo = can.started ? can_filter(std_id) : 0;
+    if (fifo == 0) return false;
+
+    uint8_t dlc = bytes_to_dlc(len);
+    can.rx.id = std_id;
+    can.rx.len = dlc;
+    memset(can.rx.data, 0, sizeof(can.rx.data));
+    memcpy(can.rx.data, data, len);
+    can.rx_full = true;
+    if (fifo == FDCAN_RX_FIFO0) {
+        HAL_FDCAN_RxFifo0Callback(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+    } else {
+        HAL_FDCAN_RxFifo1Callback(&hfdcan1, FDCAN_IT_RX_FIFO1_NEW_MESSAGE);
+    }
+    can.rx_full = false; // Not read in the callback, overwritten by the next frame
+    return true;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef *pRxHeader, uint8_t *pRxData)
+{
+    (void)RxLocation;
+    if (!can.rx_full) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+    memset(pRxHeader, 0, sizeof(*pRxHeader));
+    pRxHeader->Identifier = can.rx.id;
+    pRxHeader->IdType = FDCAN_STANDARD_ID;
+    pRxHeader->RxFrameType = FDCAN_DATA_FRAME;
+    pRxHeader->DataLength = can.rx.len; // DLC code, as the G0 HAL reports it
+    pRxHeader->FDFormat = FDCAN_FD_CAN;
+    pRxHeader->BitRateSwitch = FDCAN_BRS_ON;
+    memcpy(pRxData, can.rx.data, dlc_bytes[can.rx.len]);
+    can.rx_full = false;
+    return HAL_OK;
+}
+
+static uint64_t can_tx_irq(void)
+{
+    can_frame_t *f = &can.tx[can.tx_head];
+    can.tx_head = (uint8_t)((can.tx_head + 1U) % HOST_CAN_TX_FIFO);
+    can.tx_count--;
+    if (host_can_tx_hook != NULL) host_can_tx_hook(f->id, f->data, dlc_bytes[f->len]);
+    if (can.tx_count == 0) return UINT64_MAX;
+    can.tx_done_us = host_now_us() + can_frame_us(dlc_bytes[can.tx[can.tx_head].len]);
+    return can.tx_done_us;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan, const FDCAN_TxHeaderTypeDef *pTxHeader,
+                                                const uint8_t *pTxData)
+{
+    if (can.tx_count >= HOST_CAN_TX_FIFO) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_FULL;
+        return HAL_ERROR;
+    }
+    can_frame_t *f = &can.tx[(can.tx_head + can.tx_count) % HOST_CAN_TX_FIFO];
+    f->id = (uint16_t)pTxHeader->Identifier;
+    f->len = (uint8_t)(pTxHeader->DataLength & 0x0FU);
+    memcpy(f->data, pTxData, dlc_bytes[f->len]);
+    can.tx_count++;
+    if (can.tx_count == 1U) {
+        can.tx_done_us = host_now_us() + can_frame_us(dlc_bytes[f->len]);
+        host_irq_attach(can_tx_irq, can.tx_done_us);
+    }
+    return HAL_OK;
+}
+
+//==============================
+// TIM14: update interrupt, 1 kHz counter clock
+//==============================
+
+static uint64_t tim14_due_us = 0;
+
+static uint64_t tim14_irq(void)
+{
+    HAL_TIM_PeriodElapsedCallback(&htim14);
+    tim14_due_us += (uint64_t)(TIM14->ARR + 1U) * 1000U;
+    return tim14_due_us;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+    if (htim->Instance != TIM14) return HAL_ERROR;
+    tim14_due_us = host_now_us() + (uint64_t)(TIM14->ARR + 1U) * 1000U;
+    host_irq_attach(tim14_irq, tim14_due_us);
+    return HAL_OK;
+}
+
+//==============================
+// CRC unit in crc.c's configuration: CRC-32 polynomial, MSB first, no reversal. Bit at a
+// time, so it checks the table backend rather than sharing its arithmetic.
+//==============================
+
+static uint32_t crc_unit = 0xFFFFFFFFUL;
+
+static void crc_unit_feed(uint32_t data, uint8_t bits)
+{
+    crc_unit ^= data << (32U - bits);
+    while (bits-- > 0) {
+        crc_unit = (crc_unit & 0x80000000UL) ? (crc_unit << 1) ^ 0x04C11DB7UL : crc_unit << 1;
+    }
+}
+
+void crc_unit_reset(uint32_t init)
+{
+    crc_unit = init;
+}
+
+void crc_unit_write8(uint8_t data)
+{
+    crc_unit_feed(data, 8);
+}
+
+void crc_unit_write32(uint32_t data)
+{
+    crc_unit_feed(data, 32);
+}
+
+uint32_t crc_unit_read(void)
+{
+    return crc_unit;
+}
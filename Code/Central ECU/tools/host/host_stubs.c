@@ -0,0 +1,229 @@
+#include "host_hal.h"
+#include <string.h>
+#include "cal_store.h"
+#include "calibration.h"
+#include "can.h"
+#include "derived.h"
+#include "heartbeat.h"
+#include "main_FSM.h"
+#include "redline.h"
+#include "rs422.h"
+#include "rtc_helper.h"
+#include "sd_log.h"
+#include "sd_replay.h"
+#include "sensor_history.h"
+#include "sensor_seq.h"
+#include "sensor_summary.h"
+#include "servo.h"
+
+// Stand ins for the modules a host target does not compile. All weak, so a target that
+// links the real module gets the real one. They report nothing happening: no data, nothing
+// sent, nothing logged.
+
+// Blank calibration flash: the defaults, applied once
+__weak void cal_store_init(const cal_store_config_t *cfg)
+{
+    memcpy(cfg->active, cfg->defaults, cfg->size);
+    if (cfg->apply != NULL) cfg->apply();
+}
+
+__weak void cal_store_get_info(cal_info_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+__weak void cal_store_request(const cal_msg_t *req, cal_msg_t *reply)
+{
+    *reply = *req;
+    reply->status = CAL_ERR_STATE;
+}
+
+__weak bool cal_store_unpack_info(const uint8_t *data, uint8_t length, cal_info_t *out)
+{
+    (void)data;
+    (void)length;
+    (void)out;
+    return false;
+}
+
+__weak void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length)
+{
+    (void)frame;
+    (void)length;
+}
+
+__weak bool can_send_error_warning(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, CAN_ErrorAction action,
+                                   uint8_t errorCode)
+{
+    (void)nodeType;
+    (void)nodeAddr;
+    (void)action;
+    (void)errorCode;
+    return true;
+}
+
+__weak bool can_send_calibration(CAN_NodeType nodeType, CAN_NodeAddr nodeAddr, uint8_t op, uint8_t status,
+                                 uint8_t offset, const uint8_t *data, uint8_t length)
+{
+    (void)nodeType;
+    (void)nodeAddr;
+    (void)op;
+    (void)status;
+    (void)offset;
+    (void)data;
+    (void)length;
+    return true;
+}
+
+__weak main_states_t fsm_get_state(void)
+{
+    return STATE_READY;
+}
+
+__weak uint8_t fsm_get_error_code(void)
+{
+    return 0;
+}
+
+__weak void fsm_raise_error(uint8_t code)
+{
+    (void)code;
+}
+
+__weak void fsm_set_abort(uint8_t code)
+{
+    (void)code;
+}
+
+__weak void heartbeat_reload(uint8_t BOARD_ID)
+{
+    (void)BOARD_ID;
+}
+
+__weak heartbeat_state_t heartbeat_get_state(uint8_t board_id)
+{
+    (void)board_id;
+    return HEARTBEAT_OK;
+}
+
+__weak void redline_check_frame(const CAN_ADCFrame *frame)
+{
+    (void)frame;
+}
+
+__weak bool rs422_send_error_warning(uint8_t can_who_what, uint8_t error_code)
+{
+    (void)can_who_what;
+    (void)error_code;
+    return true;
+}
+
+__weak bool rs422_send_valve_position(uint8_t valve_pos)
+{
+    (void)valve_pos;
+    return true;
+}
+
+__weak bool rs422_send_data(const uint8_t *data, uint8_t size, RS422_FrameType_t frame_type)
+{
+    (void)data;
+    (void)size;
+    (void)frame_type;
+    return true;
+}
+
+// Time of day from the virtual clock, starting at midnight
+__weak void rtc_helper_get_datetime(RTC_TimeTypeDef *time, RTC_DateTypeDef *date)
+{
+    uint32_t ms = HAL_GetTick();
+    memset(time, 0, sizeof(*time));
+    memset(date, 0, sizeof(*date));
+    time->Hours = (uint8_t)((ms / 3600000U) % 24U);
+    time->Minutes = (uint8_t)((ms / 60000U) % 60U);
+    time->Seconds = (uint8_t)((ms / 1000U) % 60U);
+    time->SecondFraction = 999U;
+    time->SubSeconds = 999U - ms % 1000U;
+    date->Year = 25;
+    date->Month = RTC_MONTH_JANUARY;
+    date->Date = 1;
+}
+
+__weak bool sd_log_write(SD_LogType_t type, const char *format, ...)
+{
+    (void)type;
+    (void)format;
+    return true;
+}
+
+__weak bool sd_log_write_sensor_chunk(CAN_ADCFrame *frame, uint8_t length)
+{
+    (void)frame;
+    (void)length;
+    return true;
+}
+
+__weak uint32_t sd_log_get_session_number(void)
+{
+    return 0;
+}
+
+__weak rs422_cmd_status_t sd_replay_handle_request(const uint8_t *data, uint16_t size)
+{
+    (void)data;
+    (void)size;
+    return RS422_CMD_NAK_UNSUPPORTED;
+}
+
+__weak uint8_t derived_add_frame(const CAN_ADCFrame *frame, CAN_ADCFrame *out, uint8_t max)
+{
+    (void)frame;
+    (void)out;
+    (void)max;
+    return 0;
+}
+
+__weak bool derived_get(uint8_t id, int32_t *value)
+{
+    (void)id;
+    (void)value;
+    return false;
+}
+
+__weak void sensor_history_add_frame(const CAN_ADCFrame *frame)
+{
+    (void)frame;
+}
+
+__weak bool sensor_history_latest(uint8_t id, int32_t *value, uint32_t *time_ms)
+{
+    (void)id;
+    (void)value;
+    (void)time_ms;
+    return false;
+}
+
+__weak void sensor_seq_check(const CAN_ADCFrame *frame)
+{
+    (void)frame;
+}
+
+__weak void sensor_seq_note_rx_drop(const CAN_ADCFrame *frame)
+{
+    (void)frame;
+}
+
+__weak void sensor_summary_add(const CAN_ADCFrame *frame)
+{
+    (void)frame;
+}
+
+__weak void servo_status_update(uint8_t main_state, uint8_t substates)
+{
+    (void)main_state;
+    (void)substates;
+}
+
+__weak void servo_update(servo_feedback_t feedback[4])
+{
+    (void)feedback;
+}
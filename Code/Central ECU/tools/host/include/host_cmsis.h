@@ -0,0 +1,59 @@
+#ifndef HOST_CMSIS_H
+#define HOST_CMSIS_H
+
+// Forced include (-include host_cmsis.h) for the host builds. Stands in for cmsis_gcc.h,
+// whose intrinsics are Cortex-M instructions, so the real CMSIS and HAL headers can be used
+// for the types and register layouts. Interrupt masking becomes a flag the harness checks
+// before it runs a simulated interrupt, and IPSR one it sets while the interrupt runs.
+
+#include <stdint.h>
+
+#define __CMSIS_GCC_H
+
+#define __ASM                       __asm
+#define __INLINE                    inline
+#define __STATIC_INLINE             static inline
+#define __STATIC_FORCEINLINE        static inline
+#define __NO_RETURN                 __attribute__((__noreturn__))
+#define __USED                      __attribute__((used))
+#define __WEAK                      __attribute__((weak))
+#define __PACKED                    __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT             struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION              union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)                __attribute__((aligned(x)))
+#define __RESTRICT                  __restrict
+#define __COMPILER_BARRIER()        __ASM volatile("":::"memory")
+
+#define __NOP()                     ((void)0)
+#define __WFI()                     ((void)0)
+#define __WFE()                     ((void)0)
+#define __SEV()                     ((void)0)
+#define __BKPT(value)               ((void)0)
+
+extern volatile uint32_t host_primask;
+extern volatile uint32_t host_ipsr;      // Non zero while the harness runs a simulated interrupt
+
+static inline void __enable_irq(void) { host_primask = 0; }
+static inline void __disable_irq(void) { host_primask = 1; }
+static inline uint32_t __get_PRIMASK(void) { return host_primask; }
+static inline void __set_PRIMASK(uint32_t mask) { host_primask = mask; }
+static inline uint32_t __get_IPSR(void) { return host_ipsr; }
+
+static inline void __ISB(void) { __COMPILER_BARRIER(); }
+static inline void __DSB(void) { __COMPILER_BARRIER(); }
+static inline void __DMB(void) { __COMPILER_BARRIER(); }
+
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+static inline uint32_t __REV16(uint32_t value)
+{
+    return ((value & 0xFF00FF00UL) >> 8) | ((value & 0x00FF00FFUL) << 8);
+}
+static inline int16_t __REVSH(int16_t value) { return (int16_t)__builtin_bswap16((uint16_t)value); }
+static inline uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+    op2 %= 32U;
+    return op2 == 0U ? op1 : (op1 >> op2) | (op1 << (32U - op2));
+}
+static inline uint8_t __CLZ(uint32_t value) { return value == 0U ? 32U : (uint8_t)__builtin_clz(value); }
+
+#endif // HOST_CMSIS_H
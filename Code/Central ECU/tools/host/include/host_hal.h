@@ -0,0 +1,36 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Harness side of the host builds: a virtual clock behind HAL_GetTick() and the sequencer
+// timer, GPIO pin state, and dbg_printf() to stdout. Nothing advances time on its own, the
+// harness moves the clock and runs the firmware's tasks and simulated interrupts.
+
+extern bool host_verbose;               // Print the firmware's dbg_printf() output
+
+uint64_t host_now_us(void);
+void host_set_us(uint64_t us);          // Start of a fresh run, drops any timer event
+void host_advance_us(uint64_t us);      // Runs a due sequencer timer event on the way
+void host_advance_ms(uint32_t ms);
+
+// Simulated interrupts: a source runs when the clock reaches its due time, with interrupts
+// enabled (__get_IPSR() non zero while it runs), and returns its next due time (UINT64_MAX
+// for none). Attaching a source again moves its due time.
+#define HOST_IRQ_SOURCES 8U
+typedef uint64_t (*host_irq_fn)(void);
+void host_irq_attach(host_irq_fn fn, uint64_t first_us);
+void host_irq_detach(host_irq_fn fn);
+
+// Sequencer timer events fire up to this much late, uniformly at random (interrupt latency)
+extern uint32_t host_timer_jitter_us;
+
+// Pin state, as driven by HAL_GPIO_WritePin() or set by the harness for inputs
+GPIO_PinState host_gpio_get(GPIO_TypeDef *port, uint16_t pin);
+void host_gpio_set(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+uint32_t host_gpio_writes(GPIO_TypeDef *port, uint16_t pin);   // Writes that changed the pin
+void host_gpio_reset(void);
+
+#endif // HOST_HAL_H
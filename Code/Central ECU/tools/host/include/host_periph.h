@@ -0,0 +1,31 @@
+#ifndef HOST_PERIPH_H
+#define HOST_PERIPH_H
+
+#include "stm32g0xx_hal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// The HAL drivers behind the RS422 link (USART1 with circular RX DMA), the CAN bus (FDCAN1)
+// and the heartbeat wheel (TIM14), on the virtual clock of host_hal.c, and the CRC unit
+// behind crc16_update_hw(). The firmware's own
+// HAL callbacks run from simulated interrupts exactly as on the target; the harness plays
+// the other end of each link through the functions below.
+
+#define HOST_UART_US_PER_BYTE   5U      // 2 Mbaud, 10 bits per byte
+#define HOST_CAN_TX_FIFO        3U      // FDCAN TX FIFO depth
+
+// Bytes arriving on the UART: written into the DMA ring as the DMA would, with the half,
+// full and idle events. Call from a simulated interrupt.
+void host_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len);
+
+// A frame sent by the firmware, called once the last byte is on the line
+extern void (*host_uart_tx_hook)(const uint8_t *data, uint16_t len);
+
+// A frame arriving on the bus, through the filters the firmware configured. Returns false
+// if the filters rejected it. Call from a simulated interrupt.
+bool host_can_receive(uint16_t std_id, const uint8_t *data, uint8_t len);
+
+// A frame sent by the firmware, called when it leaves the TX FIFO onto the bus
+extern void (*host_can_tx_hook)(uint16_t std_id, const uint8_t *data, uint8_t len);
+
+#endif // HOST_PERIPH_H
@@ -0,0 +1,43 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// RAM backed disk for FatFs on the host (diskio.h disk_* functions), standing in for
+// user_diskio.c and the SD card. Every access goes through the bench fault injection
+// (sd_fault.h) the same way the SD driver does with SD_FAULT_INJECT, and costs card time
+// on the virtual clock. The image is shared memory, so it survives a forked firmware
+// process being cut off, like a card survives a power cut.
+
+typedef struct {
+    uint32_t sectors;           // 512 byte sectors
+    uint32_t sector_us;         // Card and SPI time per sector read or written
+    uint32_t cut_at_write;      // Power cut on this write call, 0 = never: part of its sectors
+                                // are stored, then ramdisk_power_cut_hook runs
+    uint32_t au_sectors;        // Allocation unit the card reports (GET_BLOCK_SIZE), 1 = none,
+                                // 0 = one cluster
+} ramdisk_config_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t failed;            // Accesses refused by sd_fault
+} ramdisk_stats_t;
+
+// Create and format (FAT) a new image. False if it cannot be allocated or formatted.
+bool ramdisk_create(const ramdisk_config_t *cfg);
+
+// The image as stored, for checking what landed where
+const uint8_t *ramdisk_image(void);
+void ramdisk_set_cut(uint32_t cut_at_write);
+
+// Runs at the power cut, after the torn write; does not return (ends the firmware process)
+extern void (*ramdisk_power_cut_hook)(void);
+
+void ramdisk_get_stats(ramdisk_stats_t *out);
+void ramdisk_reset_stats(void);
+
+#endif // RAMDISK_H
@@ -0,0 +1,171 @@
+#include "ramdisk.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "host_hal.h"
+#include "diskio.h"
+#include "ff.h"
+#include "sd_fault.h"
+#include "sd_format.h"
+#include "ff_gen_drv.h"
+#include "user_diskio.h"
+
+#define SECTOR_SIZE 512U
+
+// Image and counters live in one shared mapping, so they outlive a forked firmware process
+typedef struct {
+    ramdisk_config_t cfg;
+    ramdisk_stats_t stats;
+} ramdisk_state_t;
+
+static ramdisk_state_t *state = NULL;
+static uint8_t *image = NULL;
+
+// Volume window of user_diskio.c, moved only by sd_format
+static DWORD vol_base = 0;
+static DWORD vol_size = 0;  // 0 = up to the end of the disk
+static DWORD vol_block = 0; // 0 = au_sectors
+
+void (*ramdisk_power_cut_hook)(void) = NULL;
+
+bool ramdisk_create(const ramdisk_config_t *cfg)
+{
+    size_t bytes = (size_t)cfg->sectors * SECTOR_SIZE;
+    void *shared = mmap(NULL, sizeof(ramdisk_state_t) + bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return false;
+    state = shared;
+    image = (uint8_t *)shared + sizeof(ramdisk_state_t);
+    state->cfg = *cfg;
+    memset(&state->stats, 0, sizeof(state->stats));
+
+    // Same layout choices as sd_format, on a smaller volume
+    static uint8_t work[_MAX_SS * 4];
+    uint32_t cut = state->cfg.cut_at_write;
+    uint32_t sector_us = state->cfg.sector_us;
+    state->cfg.cut_at_write = 0;
+    state->cfg.sector_us = 0;
+    FRESULT res = f_mkfs("", FM_FAT | FM_FAT32 | FM_SFD, SD_FORMAT_CLUSTER_BYTES, work, sizeof(work));
+    state->cfg.cut_at_write = cut;
+    state->cfg.sector_us = sector_us;
+    memset(&state->stats, 0, sizeof(state->stats));
+    return res == FR_OK;
+}
+
+const uint8_t *ramdisk_image(void)
+{
+    return image;
+}
+
+void USER_set_volume_window(DWORD base, DWORD size, DWORD block)
+{
+    vol_base = base;
+    vol_size = size;
+    vol_block = block;
+}
+
+static DWORD volume_sectors(void)
+{
+    return vol_size ? vol_size : state->cfg.sectors - vol_base;
+}
+
+void ramdisk_set_cut(uint32_t cut_at_write)
+{
+    state->cfg.cut_at_write = cut_at_write;
+    state->stats.writes = 0;
+}
+
+void ramdisk_get_stats(ramdisk_stats_t *out)
+{
+    *out = state->stats;
+}
+
+void ramdisk_reset_stats(void)
+{
+    memset(&state->stats, 0, sizeof(state->stats));
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return (pdrv == 0 && image != NULL) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (pdrv == 0 && image != NULL) ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    if (pdrv != 0) return RES_PARERR;
+    if ((uint64_t)sector + count > volume_sectors()) return RES_PARERR;
+    sector += vol_base;
+    state->stats.reads++;
+    if (!sd_fault_on_read()) {
+        state->stats.failed++;
+        return RES_ERROR;
+    }
+    host_advance_us((uint64_t)state->cfg.sector_us * count);
+    memcpy(buff, image + (size_t)sector * SECTOR_SIZE, (size_t)count * SECTOR_SIZE);
+    state->stats.sectors_read += count;
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (pdrv != 0) return RES_PARERR;
+    if ((uint64_t)sector + count > volume_sectors()) return RES_PARERR;
+    sector += vol_base;
+    state->stats.writes++;
+
+    if (state->cfg.cut_at_write != 0 && state->stats.writes == state->cfg.cut_at_write) {
+        // Whole sectors reach the card in order, the cut lands somewhere in the transfer
+        UINT stored = (UINT)(rand() % (int)count);
+        memcpy(image + (size_t)sector * SECTOR_SIZE, buff, (size_t)stored * SECTOR_SIZE);
+        state->stats.sectors_written += stored;
+        if (ramdisk_power_cut_hook != NULL) ramdisk_power_cut_hook();
+        return RES_ERROR;
+    }
+
+    if (!sd_fault_on_write(sector, count)) { // Latency and busy stalls happen in here
+        state->stats.failed++;
+        return RES_ERROR;
+    }
+    host_advance_us((uint64_t)state->cfg.sector_us * count);
+    memcpy(image + (size_t)sector * SECTOR_SIZE, buff, (size_t)count * SECTOR_SIZE);
+    state->stats.sectors_written += count;
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if (pdrv != 0) return RES_PARERR;
+    switch (cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = volume_sectors();
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = SECTOR_SIZE;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            if (vol_block) {
+                *(DWORD *)buff = vol_block;
+            } else {
+                *(DWORD *)buff = state->cfg.au_sectors ? state->cfg.au_sectors : SD_FORMAT_CLUSTER_BYTES / SECTOR_SIZE;
+            }
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+// 2025-01-01 00:00:00 plus the virtual clock
+DWORD get_fattime(void)
+{
+    uint32_t s = (uint32_t)(host_now_us() / 1000000U);
+    uint32_t day = s / 86400U;
+    return ((DWORD)(2025 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)(1 + day % 28U) << 16) |
+           ((DWORD)((s / 3600U) % 24U) << 11) | ((DWORD)((s / 60U) % 60U) << 5) | ((DWORD)(s % 60U) / 2U);
+}
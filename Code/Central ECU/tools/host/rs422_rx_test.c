@@ -0,0 +1,256 @@
+// Host test of the RS422 receive path: rs422.c's NDTR head tracking and in place decoder
+// against the circular RX DMA of host_periph.c, which raises the half, full and idle events
+// as the DMA would. Random frames go in at random chunk sizes with the parser reading at
+// random times. Some frames are damaged on the line (byte flipped, byte dropped, noise
+// inserted, delimiter lost), and now and then the parser is held off for more than a buffer
+// so the DMA laps it.
+//
+// Every frame rs422_read() delivers must be a sent one, in order and exactly as sent, and
+// every undamaged frame must arrive unless an overrun took it. Frames that match nothing
+// sent can only be damage the CRC-16 let through, about one in 65536, so more than a
+// handful of them fails too.
+//
+// Usage: rs422_rx_test [-n frames] [-S seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host_hal.h"
+#include "host_periph.h"
+#include "config.h"
+#include "rs422.h"
+
+#define RX_TEST_WINDOW          1024U   // Sent frames kept for matching, a power of two
+#define RX_TEST_DAMAGE_PERMILLE 50U
+#define RX_TEST_FLOOD_EVERY     2000U   // Frames between forced overruns (on average)
+#define RX_TEST_DRAIN_AT        300U    // Unread bytes the parser lets build up normally
+
+uint8_t BOARD_ID = BOARD_ID_ECU;    // app.c
+
+typedef struct {
+    uint8_t seq;
+    uint8_t type;
+    uint8_t size;
+    uint8_t data[RS422_MAX_PAYLOAD];
+    bool damaged;
+    bool at_risk;               // May be lost without a fault: in or next to an overrun
+} sent_frame_t;
+
+static const uint8_t valid_types[] = {
+    RS422_FRAME_HEARTBEAT, RS422_FRAME_SWITCH_CHANGE, RS422_FRAME_VALVE_UPDATE, RS422_FRAME_SENSOR,
+    RS422_STRING_MESSAGE, RS422_FRAME_COUNTDOWN, RS422_FRAME_ERROR_WARNING, RS422_FRAME_ABORT,
+    RS422_FRAME_FIRE, RS422_FRAME_CMD_ACK, RS422_FRAME_REPLAY, RS422_FRAME_CALIBRATION,
+};
+
+static sent_frame_t sent[RX_TEST_WINDOW];
+static uint32_t sent_count = 0;
+static uint32_t next_match = 0;     // First sent frame not delivered or passed over
+
+static struct {
+    uint32_t delivered;
+    uint32_t damaged;
+    uint32_t lost_at_risk;
+    uint32_t undetected;        // Delivered frames matching nothing sent
+    uint32_t missing;           // Undamaged frames never delivered
+    uint32_t floods;
+} result;
+
+static uint32_t rand_below(uint32_t n)
+{
+    return n ? (uint32_t)rand() % n : 0U;
+}
+
+static bool frame_matches(const sent_frame_t *s, const RS422_RxFrame_t *f)
+{
+    // Delivered size is the DLC length, the sender zero pads up to it
+    static const uint8_t zero[RS422_MAX_PAYLOAD] = {0};
+    if (s->seq != f->seq || s->type != f->frame_type || f->size < s->size) return false;
+    return memcmp(s->data, f->data, s->size) == 0 && memcmp(&f->data[s->size], zero, f->size - s->size) == 0;
+}
+
+// A frame came out of rs422_read(): find it among the sent ones, everything skipped over on
+// the way must have been allowed to go missing
+static void check_delivered(const RS422_RxFrame_t *f)
+{
+    result.delivered++;
+    for (uint32_t i = next_match; i < sent_count && i - next_match < RX_TEST_WINDOW; i++) {
+        const sent_frame_t *s = &sent[i % RX_TEST_WINDOW];
+        if (!frame_matches(s, f)) continue;
+        for (uint32_t k = next_match; k < i; k++) {
+            const sent_frame_t *skipped = &sent[k % RX_TEST_WINDOW];
+            if (skipped->damaged) continue;
+            if (skipped->at_risk) {
+                result.lost_at_risk++;
+            } else {
+                if (result.missing++ == 0) printf("first missing frame: %u (seq %u)\n", k, skipped->seq);
+            }
+        }
+        next_match = i + 1;
+        return;
+    }
+    result.undetected++;
+}
+
+static void drain(uint32_t reads)
+{
+    RS422_RxFrame_t f;
+    for (uint32_t i = 0; i < reads; i++) {
+        if (rs422_read(&f) == 0) return;
+        check_delivered(&f);
+    }
+}
+
+static void drain_all(void)
+{
+    drain(UINT32_MAX);
+}
+
+// Encode one frame and damage it on the line if chosen. Returns the bytes to send.
+static uint16_t make_frame(sent_frame_t *s, uint8_t *out, bool *lost_delim)
+{
+    static uint8_t seq = 0;
+    s->seq = seq++;
+    s->type = valid_types[rand_below(sizeof(valid_types))];
+    s->size = (uint8_t)rand_below(RS422_MAX_PAYLOAD + 1U);
+    for (uint8_t i = 0; i < s->size; i++) {
+        // Plenty of zeros so the COBS blocks are all lengths
+        s->data[i] = rand_below(4) == 0 ? 0 : (uint8_t)rand();
+    }
+    s->damaged = false;
+    s->at_risk = false;
+    uint16_t len = rs422_encode_frame(s->seq, (RS422_FrameType_t)s->type, s->data, s->size, out);
+
+    *lost_delim = false;
+    if (rand_below(1000) >= RX_TEST_DAMAGE_PERMILLE) return len;
+    s->damaged = true;
+    result.damaged++;
+    uint16_t at = (uint16_t)rand_below(len - 1U); // Before the delimiter
+    switch (rand_below(4)) {
+        case 0: // Bit errors in one byte
+            out[at] ^= (uint8_t)(1U + rand_below(255));
+            break;
+        case 1: // Byte lost
+            memmove(&out[at], &out[at + 1], len - at - 1U);
+            len--;
+            break;
+        case 2: // Noise byte, possibly a delimiter
+            memmove(&out[at + 1], &out[at], len - at);
+            out[at] = rand_below(8) == 0 ? RS422_COBS_DELIM : (uint8_t)rand();
+            len++;
+            break;
+        default: // Delimiter lost, the next frame runs into this one
+            len--;
+            *lost_delim = true;
+            break;
+    }
+    return len;
+}
+
+// Line bytes to the UART in random chunks, the parser reading in between as the main loop
+// gets to it
+static void send_bytes(const uint8_t *data, uint16_t len, bool flood)
+{
+    while (len > 0) {
+        uint16_t chunk = (uint16_t)(1U + rand_below(flood ? 256U : 48U));
+        if (chunk > len) chunk = len;
+        host_uart_receive(&huart1, data, chunk);
+        data += chunk;
+        len -= chunk;
+        if (flood) continue;
+        if (rs422_get_rx_available() > RX_TEST_DRAIN_AT) {
+            drain_all();
+        } else if (rand_below(4) == 0) {
+            drain(1U + rand_below(3));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 200000;
+    uint32_t seed = 1;
+    int c;
+    while ((c = getopt(argc, argv, "n:S:")) != -1) {
+        switch (c) {
+            case 'n': frames = (uint32_t)atoi(optarg); break;
+            case 'S': seed = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: rs422_rx_test [-n frames] [-S seed]\n");
+                return 2;
+        }
+    }
+    srand(seed);
+    if (!rs422_init(&huart1)) {
+        fprintf(stderr, "rs422_rx_test: rs422_init failed\n");
+        return 2;
+    }
+
+    // The parser starts hunting for a delimiter like after a restart: lock on first
+    static const uint8_t delim = RS422_COBS_DELIM;
+    host_uart_receive(&huart1, &delim, 1);
+
+    uint8_t line[RS422_TX_MESSAGE_SIZE + 1];
+    uint8_t flood_buf[RS422_RX_BUFFER_SIZE * 3];
+    uint16_t flood_len = 0;
+    bool flooding = false;
+    bool next_at_risk = false;
+    for (uint32_t n = 0; n < frames; n++) {
+        if (!flooding && rand_below(RX_TEST_FLOOD_EVERY) == 0) {
+            // Main loop stalls: everything not read yet and the burst that follows may go
+            drain_all();
+            flooding = true;
+            flood_len = 0;
+            result.floods++;
+        }
+
+        sent_frame_t *s = &sent[sent_count % RX_TEST_WINDOW];
+        bool lost_delim;
+        uint16_t len = make_frame(s, line, &lost_delim);
+        s->at_risk = flooding || next_at_risk;
+        next_at_risk = lost_delim;
+        sent_count++;
+
+        if (flooding) {
+            memcpy(&flood_buf[flood_len], line, len);
+            flood_len += len;
+            if (flood_len > RS422_RX_BUFFER_SIZE + RS422_RX_BUFFER_SIZE / 2U) {
+                send_bytes(flood_buf, flood_len, true);
+                drain_all(); // Overrun, the parser hunts for the next delimiter
+                flooding = false;
+                next_at_risk = true; // Its start went with the overrun
+            }
+            continue;
+        }
+        send_bytes(line, len, false);
+    }
+    if (flooding) send_bytes(flood_buf, flood_len, true);
+    host_uart_receive(&huart1, &delim, 1); // Closes a frame left open by a lost delimiter
+    drain_all();
+
+    // Frames after the last delivered one
+    for (uint32_t k = next_match; k < sent_count; k++) {
+        const sent_frame_t *s = &sent[k % RX_TEST_WINDOW];
+        if (s->damaged) continue;
+        if (s->at_risk) {
+            result.lost_at_risk++;
+        } else {
+            result.missing++;
+        }
+    }
+
+    RS422_RxStats_t st;
+    rs422_get_rx_stats(&st);
+    printf("rs422_rx_test: %u frames, %u damaged, %u forced overruns, seed %u\n",
+           sent_count, result.damaged, result.floods, seed);
+    printf("  delivered %u, lost to overruns %u, missing %u, unmatched %u\n",
+           result.delivered, result.lost_at_risk, result.missing, result.undetected);
+    printf("  parser: %u ok, %u crc fail, %u bad, %u resyncs, %u overruns, %u lost by seq, backlog high water %u\n",
+           st.frames_ok, st.crc_failures, st.bad_frames, st.resyncs, st.overruns, st.frames_lost, st.max_backlog);
+
+    bool ok = result.missing == 0 && result.delivered == st.frames_ok;
+    ok = ok && result.undetected <= 1U + result.damaged / 4096U;
+    ok = ok && (result.floods == 0 || st.overruns >= result.floods);
+    printf("rs422_rx_test %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// Host run of the bench RIU emulator (rs422_stress.c, the RSSTRESS command) against rs422.c,
+// rs422_cmd.c and rs422_handler.c, with the task intervals of app.c on the virtual clock.
+// The emulator writes RIU frames into the RX ring as on the board; what the ECU sends goes
+// out through the USART1 emulation of host_periph.c at the line rate, so the TX lanes fill
+// and throttle as they do on the wire. At the end the emulator's own report is printed
+// (frames/s, latency, parser counters, link budget per lane) and checked:
+//   - every frame lost is explained by a corrupted frame or a noise burst
+//   - no DMA overruns unless -O allows them (an overrun takes a buffer's worth of frames)
+//   - heartbeat latency at most -L ms
+//   - the safety and control lanes never drop a frame, however full bulk is
+//
+// Usage: rs422_stress_sim [options]
+//   -f n    RIU heartbeats per second (default 200)
+//   -c n    Valve commands per second, every fourth sent twice (default 20)
+//   -e n    Per mille of frames with a flipped bit (default 0)
+//   -N n    Per mille chance of a noise burst before each frame (default 0)
+//   -b n    64 byte bulk frames per second queued for the downlink (default 0)
+//   -t s    Run time in seconds (default 10)
+//   -L ms   Worst heartbeat latency allowed (default 20)
+//   -O      Overruns allowed, for loads past what the handler drains
+//   -S seed Random seed for the main loop task timing (default 1)
+//   -v      Print the firmware's debug output throughout, not only the report
+//
+// Exits 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "host_hal.h"
+#include "host_periph.h"
+#include "app.h"
+#include "config.h"
+#include "rs422.h"
+#include "rs422_cmd.h"
+#include "rs422_handler.h"
+#include "rs422_stress.h"
+#include "spicy.h"
+
+#define STRESS_TASK_US  100U    // Each task takes 0 to this long
+
+uint8_t BOARD_ID = BOARD_ID_ECU;    // app.c
+
+static struct {
+    rs422_stress_config_t cfg;
+    uint32_t max_latency_ms;
+    bool overruns_ok;
+    uint32_t seed;
+} opt = {
+    .cfg = {.frames_per_s = 200, .commands_per_s = 20, .seconds = 10},
+    .max_latency_ms = 20,
+    .seed = 1,
+};
+
+static void task_send_heartbeat(void)
+{
+    rs422_send_heartbeat();
+}
+
+// The RS422 side of app.c's task list
+static Task tasks[] = {
+    {0, 10, rs422_handler_rx_poll},
+    {0, 1, rs422_service_tx},
+    {0, 400, task_send_heartbeat},
+    {0, 200, spicy_send_status_update},
+    {0, 1, rs422_stress_poll},
+};
+
+static uint32_t rand_below(uint32_t n)
+{
+    return n ? (uint32_t)rand() % n : 0U;
+}
+
+static void main_loop(uint32_t until_ms)
+{
+    while (HAL_GetTick() < until_ms) {
+        uint32_t now = HAL_GetTick();
+        for (unsigned i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+            if (now - tasks[i].last_run_time >= tasks[i].interval) {
+                tasks[i].last_run_time = now;
+                tasks[i].task_function();
+                host_advance_us(rand_below(STRESS_TASK_US + 1U));
+            }
+        }
+        host_advance_us(1000U - host_now_us() % 1000U);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "f:c:e:N:b:t:L:OS:v")) != -1) {
+        switch (c) {
+            case 'f': opt.cfg.frames_per_s = (uint16_t)atoi(optarg); break;
+            case 'c': opt.cfg.commands_per_s = (uint16_t)atoi(optarg); break;
+            case 'e': opt.cfg.corrupt_per_mille = (uint16_t)atoi(optarg); break;
+            case 'N': opt.cfg.noise_per_mille = (uint16_t)atoi(optarg); break;
+            case 'b': opt.cfg.tx_frames_per_s = (uint16_t)atoi(optarg); break;
+            case 't': opt.cfg.seconds = (uint16_t)atoi(optarg); break;
+            case 'L': opt.max_latency_ms = (uint32_t)atoi(optarg); break;
+            case 'O': opt.overruns_ok = true; break;
+            case 'S': opt.seed = (uint32_t)atoi(optarg); break;
+            case 'v': host_verbose = true; break;
+            default:
+                fprintf(stderr, "usage: rs422_stress_sim [-f hb/s] [-c cmd/s] [-e permille] [-N permille] [-b bulk/s]"
+                                " [-t s] [-L ms] [-O] [-S seed] [-v]\n");
+                return 2;
+        }
+    }
+    if (opt.cfg.frames_per_s == 0 || opt.cfg.seconds == 0) {
+        fprintf(stderr, "rs422_stress_sim: need a heartbeat rate and a run time\n");
+        return 2;
+    }
+    srand(opt.seed);
+    host_set_us(0);
+    if (!rs422_init(&huart1)) {
+        fprintf(stderr, "rs422_stress_sim: rs422_init failed\n");
+        return 2;
+    }
+    main_loop(100);     // Link up and idle before the run, as after boot
+
+    // The emulator stops itself at the end of the run and reports through dbg_printf(),
+    // which only prints when verbose: stop it from here instead
+    uint32_t seconds = opt.cfg.seconds;
+    opt.cfg.seconds = UINT16_MAX;
+    RS422_RxStats_t rx_before, rx;
+    rs422_get_rx_stats(&rx_before);
+    rs422_stress_start(&opt.cfg);
+    main_loop(HAL_GetTick() + seconds * 1000U);
+    while (rs422_get_rx_available() > 0) {
+        rs422_handler_rx_poll(); // Frames injected since the last poll
+    }
+    bool verbose = host_verbose;
+    host_verbose = true;
+    rs422_stress_stop();
+    host_verbose = verbose;
+
+    rs422_stress_result_t run;
+    rs422_stress_get_result(&run);
+    rs422_get_rx_stats(&rx);
+    uint32_t handled = rx.frames_ok - rx_before.frames_ok;
+    uint32_t overruns = rx.overruns - rx_before.overruns;
+    uint32_t lost = run.frames > handled ? run.frames - handled : 0U;
+    bool ok = true;
+
+    if (lost > run.corrupted + run.noise_bursts && overruns == 0) {
+        printf("FAIL: %u frames lost, only %u corrupted and %u noise bursts\n", lost, run.corrupted, run.noise_bursts);
+        ok = false;
+    }
+    if (overruns != 0 && !opt.overruns_ok) {
+        printf("FAIL: %u RX overruns\n", overruns);
+        ok = false;
+    }
+    if (run.latency_max > opt.max_latency_ms) {
+        printf("FAIL: heartbeat latency %u ms, limit %u ms\n", run.latency_max, opt.max_latency_ms);
+        ok = false;
+    }
+    static const RS422_Lane_t protected_lanes[] = {RS422_LANE_SAFETY, RS422_LANE_CONTROL};
+    for (unsigned i = 0; i < sizeof(protected_lanes) / sizeof(protected_lanes[0]); i++) {
+        RS422_LaneStats_t lane;
+        rs422_get_lane_stats(protected_lanes[i], &lane);
+        if (lane.dropped != 0) {
+            printf("FAIL: lane %u dropped %u frames\n", protected_lanes[i], lane.dropped);
+            ok = false;
+        }
+    }
+
+    printf("rs422_stress_sim %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,690 @@
+// Host simulation of the sensor logging path: CAN RX queue -> can_handlers -> sensor_seq ->
+// sd_log -> FatFs -> a RAM disk, all the firmware's own code, on a virtual clock with the
+// task intervals of app.c. The card is slowed down and broken with the bench fault injection
+// (sd_fault.h), cut off mid-write, and the result is read back off the disk image and
+// checked frame for frame against what was sent.
+//
+// Usage: sd_sim [options] [trace]
+//   trace       candump -l log, or a sensors.raw / sensors.lzb off a card, replayed in
+//               their own timing. Without one, a synthetic load of -n sensors at -r frames/s.
+//   -t s        Seconds of traffic (default 30, a trace plays out in full)
+//   -r fps      Synthetic frames per second over all sensors (default 100)
+//   -n n        Synthetic sensors (default 6, at most 11)
+//   -z          Synthetic samples of zero with an A1 byte among them, as unpressurised PTs
+//               can give: sample data that looks like the sd_log record markers
+//   -s us       Card time per 512 byte sector (default 400, SPI at ~12 MHz)
+//   -l ms       Write latency per sector
+//   -b n:ms     Busy stall of ms every n writes
+//   -f n        Fail every n-th write
+//   -d n:ms     Card drops out at write n and comes back ms later
+//   -p n        Power cut during write n: the firmware stops dead, then boots again
+//               (writes counted from the end of sd_log_init)
+//   -S seed     Random seed (default 1)
+//   -v          Print the firmware's debug output
+//
+// Exits 1 when an invariant fails: a frame the log neither holds nor accounts for as a gap
+// while the card was healthy, a damaged block other than from a failed or cut write, a bad
+// block index entry, no recovery within SD_SIM_RECOVERY_MS of the card coming back, or a
+// failed boot.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "host_hal.h"
+#include "ramdisk.h"
+#include "app.h"
+#include "can_handlers.h"
+#include "sd_fault.h"
+#include "sd_log.h"
+#include "sd_lz.h"
+#include "sensor_seq.h"
+
+#define SD_SIM_SECTORS          (256UL * 2048UL)    // 256 MB, FAT16 at the firmware's cluster size
+#define SD_SIM_LOG_MB           2U                  // TEST_MODE preallocation
+#define SD_SIM_SENS_MB          10U
+#define SD_SIM_BOOTS            2U
+#define SD_SIM_DRAIN_MS         3000U               // Quiet time before shutdown, rings empty
+#define SD_SIM_REBOOT_MS        500U                // Power cut to the next boot
+#define SD_SIM_RECOVERY_MS      2500U               // Two reopen tries (1 s apart, sd_log.c) and a service
+#define SD_SIM_MAX_ID           32U
+
+typedef struct {
+    uint64_t at_us;
+    CAN_Frame_t frame;
+} sim_frame_t;
+
+// Per boot results, in shared memory so they survive the firmware process
+typedef struct {
+    bool init_ok;
+    bool cut;                   // Ended by the power cut
+    bool finished;              // Shut down normally
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t offered[SD_SIM_MAX_ID];
+    uint32_t skipped[SD_SIM_MAX_ID];    // Sequence numbers missing from the traffic itself
+    uint32_t next_frame;        // First trace frame not offered
+    sd_log_stats_t log;
+    sensor_seq_stats_t seq[SD_SIM_MAX_ID];
+    bool seq_valid[SD_SIM_MAX_ID];
+    // Dropout: outage seen, card back, first good write after it
+    uint64_t outage_us;
+    uint64_t restored_us;
+    uint64_t recovered_us;
+} sim_boot_t;
+
+typedef struct {
+    sim_boot_t boot[SD_SIM_BOOTS];
+    uint8_t boots;
+} sim_shared_t;
+
+typedef struct {
+    uint32_t seconds;
+    uint32_t rate;
+    uint8_t sensors;
+    uint32_t sector_us;
+    sd_fault_config_t fault;
+    uint32_t dropout_at;
+    uint32_t dropout_ms;
+    uint32_t cut_at;
+    uint32_t seed;
+    bool zeros;
+    const char *trace;
+} sim_options_t;
+
+// What the card holds for one session
+typedef struct {
+    bool found;
+    uint32_t blocks;
+    uint32_t bad_blocks;        // LZ header found but the frame does not check out
+    uint32_t cut_blocks;        // Good blocks that do not hold whole records
+    uint32_t raw_bytes;
+    uint32_t records[SD_SIM_MAX_ID];
+    uint32_t gap_lost[SD_SIM_MAX_ID][3];    // By sensor_seq_stage_t
+    uint32_t index_entries;
+    uint32_t index_bad;
+} sim_session_t;
+
+static sim_options_t opt = {
+    .seconds = 30,
+    .rate = 100,
+    .sensors = 6,
+    .sector_us = 400,
+    .seed = 1,
+};
+
+static sim_shared_t *shared;
+static sim_frame_t *trace;
+static uint32_t trace_len;
+static uint32_t trace_cap;
+
+// Firmware process state
+static sim_boot_t *boot;
+static uint32_t feed_next;
+static uint32_t recoveries_at_restore;
+static int16_t last_seq[SD_SIM_MAX_ID];
+
+// ---------------- Traffic ----------------
+
+static sim_frame_t *trace_add(uint64_t at_us)
+{
+    if (trace_len == trace_cap) {
+        trace_cap = trace_cap ? trace_cap * 2U : 4096U;
+        trace = realloc(trace, trace_cap * sizeof(*trace));
+        if (trace == NULL) {
+            fprintf(stderr, "sd_sim: out of memory\n");
+            exit(2);
+        }
+    }
+    sim_frame_t *f = &trace[trace_len++];
+    memset(f, 0, sizeof(*f));
+    f->at_us = at_us;
+    f->frame.id = (CAN_ID){.priority = CAN_PRIORITY_DATA, .nodeType = CAN_NODE_TYPE_ADC,
+                           .nodeAddr = CAN_NODE_ADDR_ADC_1, .frameType = CAN_TYPE_ADC_DATA};
+    return f;
+}
+
+// FDCAN DataLength code for a payload, as can.c stores it
+static uint8_t bytes_to_dlc(uint8_t bytes)
+{
+    static const uint8_t fd_sizes[] = {12, 16, 20, 24, 32, 48, 64};
+    if (bytes <= 8U) return bytes;
+    for (uint8_t i = 0; i < sizeof(fd_sizes); i++) {
+        if (bytes <= fd_sizes[i]) return (uint8_t)(9U + i);
+    }
+    return 15;
+}
+
+// Frames of an ADC board: 29 samples of a slow signal with some noise, then the sequence number.
+// With -z the signal is zero with the odd 0xA1 byte, [00 00 00 00 A1] all through the frame.
+static void make_synthetic(void)
+{
+    static const uint8_t ids[] = {0, 1, 8, 9, 10, 16, 17, 18, 24, 25, 26};
+    uint8_t seq[sizeof(ids)] = {0};
+    if (opt.sensors == 0 || opt.sensors > sizeof(ids)) opt.sensors = sizeof(ids);
+    uint64_t period_us = 1000000ULL * opt.sensors / (opt.rate ? opt.rate : 1U);
+    uint64_t end_us = (uint64_t)opt.seconds * 1000000ULL;
+
+    for (uint64_t t = 0; t < end_us; t += period_us) {
+        for (uint8_t s = 0; s < opt.sensors; s++) {
+            uint64_t at = t + period_us * s / opt.sensors; // Sensors spread over the period
+            sim_frame_t *f = trace_add(at);
+            CAN_ADCFrame *adc = (CAN_ADCFrame *)f->frame.data;
+            uint32_t ms = (uint32_t)(at / 1000U);
+            adc->what = (uint8_t)(ids[s] << 3 | 7U); // 1 kHz
+            adc->length = 59;
+            adc->timestamp[0] = (uint8_t)(ms >> 16);
+            adc->timestamp[1] = (uint8_t)(ms >> 8);
+            adc->timestamp[2] = (uint8_t)ms;
+            for (uint8_t i = 0; i < 29U; i++) {
+                int16_t v = (int16_t)(2000 + s * 300 + (int32_t)((ms / 50U + i) % 200U) + rand() % 8);
+                if (opt.zeros) v = (i % 3U == 2U) ? (int16_t)(0xA1 | (rand() % 32) << 11) : 0;
+                adc->data[2 * i] = (uint8_t)v;
+                adc->data[2 * i + 1] = (uint8_t)((uint16_t)v >> 8);
+            }
+            adc->data[58] = seq[s]++;
+            f->frame.length = bytes_to_dlc(64);
+        }
+    }
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// candump -l: "(1712345678.123456) can0 1FF#0011..." or "... 1FF##<flags>0011..." for CAN FD.
+// ADC data frames only.
+static bool load_candump(FILE *in)
+{
+    char line[512];
+    double first = -1.0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        double ts;
+        char iface[32];
+        char body[300];
+        if (sscanf(line, " (%lf) %31s %299s", &ts, iface, body) != 3) continue;
+        char *hash = strchr(body, '#');
+        if (hash == NULL) continue;
+        *hash = '\0';
+        uint16_t std_id = (uint16_t)strtoul(body, NULL, 16);
+        char *hex = hash + 1;
+        if (*hex == '#') hex += 2; // FD flags nibble
+        CAN_ID id = unpack_can_id(std_id);
+        if (id.frameType != CAN_TYPE_ADC_DATA) continue;
+
+        if (first < 0.0) first = ts;
+        sim_frame_t *f = trace_add((uint64_t)((ts - first) * 1e6));
+        f->frame.id = id;
+        uint8_t n = 0;
+        while (n < sizeof(f->frame.data) && hex_nibble(hex[0]) >= 0 && hex_nibble(hex[1]) >= 0) {
+            f->frame.data[n++] = (uint8_t)(hex_nibble(hex[0]) << 4 | hex_nibble(hex[1]));
+            hex += 2;
+        }
+        f->frame.length = bytes_to_dlc(n);
+    }
+    return trace_len > 0;
+}
+
+// Sensor records as sd_log writes them, in file order. Each sensor keeps its own ADC clock,
+// placed on the replay timeline where that sensor first appears.
+static void load_records(const uint8_t *raw, uint32_t len)
+{
+    uint64_t base[SD_SIM_MAX_ID];
+    uint32_t first_ts[SD_SIM_MAX_ID];
+    bool seen[SD_SIM_MAX_ID] = {false};
+    uint64_t now = 0;
+
+    for (uint32_t i = 0; i + 10U <= len;) {
+        bool marker = raw[i] == 0 && raw[i + 1] == 0 && raw[i + 2] == 0 && raw[i + 3] == 0;
+        if (!marker || raw[i + 4] != SD_LOG_SENS_RECORD) {
+            i += (marker && raw[i + 4] == SD_LOG_SENS_GAP) ? 13U : 1U;
+            continue;
+        }
+        const CAN_ADCFrame *adc = (const CAN_ADCFrame *)&raw[i + 5];
+        uint32_t rec = 5U + 5U + adc->length;
+        if (adc->length > sizeof(adc->data) || i + rec > len) break;
+
+        uint8_t id = adc->what >> 3;
+        uint32_t ts = ((uint32_t)adc->timestamp[0] << 16) | ((uint32_t)adc->timestamp[1] << 8) | adc->timestamp[2];
+        if (!seen[id]) {
+            seen[id] = true;
+            base[id] = now;
+            first_ts[id] = ts;
+        }
+        uint64_t at = base[id] + (uint64_t)((ts - first_ts[id]) & 0xFFFFFFU) * 1000U;
+        if (at > now) now = at;
+        sim_frame_t *f = trace_add(now);
+        memcpy(f->frame.data, adc, 5U + adc->length);
+        f->frame.length = bytes_to_dlc((uint8_t)(5U + adc->length));
+        i += rec;
+    }
+}
+
+static bool load_trace(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "sd_sim: cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    uint8_t head[5] = {0};
+    size_t got = fread(head, 1, sizeof(head), in);
+    rewind(in);
+
+    if (got >= 2 && (head[0] | head[1] << 8) == SD_LZ_MAGIC) {
+        // Compressed sensor file: decode every good block, as sd_unpack does
+        fseek(in, 0, SEEK_END);
+        long size = ftell(in);
+        rewind(in);
+        uint8_t *file = malloc((size_t)size);
+        uint8_t *raw = malloc((size_t)size * 8U + SD_LZ_BLOCK_SIZE);
+        uint32_t raw_len = 0;
+        if (file == NULL || raw == NULL || fread(file, 1, (size_t)size, in) != (size_t)size) {
+            fclose(in);
+            return false;
+        }
+        for (long pos = 0; pos + (long)sizeof(sd_lz_header_t) <= size;) {
+            const sd_lz_header_t *h = (const sd_lz_header_t *)&file[pos];
+            uint32_t frame_len = sizeof(*h) + (h->data_len & ~SD_LZ_STORED);
+            uint16_t n = 0;
+            if (h->magic == SD_LZ_MAGIC && pos + (long)frame_len <= size) {
+                n = sd_lz_unframe(&file[pos], (uint16_t)frame_len, &raw[raw_len]);
+            }
+            if (n == 0) {
+                pos++;
+                continue;
+            }
+            raw_len += n;
+            pos += frame_len;
+        }
+        load_records(raw, raw_len);
+        free(file);
+        free(raw);
+    } else if (got == 5 && head[0] == 0 && head[1] == 0 && head[2] == 0 && head[3] == 0) {
+        fseek(in, 0, SEEK_END);
+        long size = ftell(in);
+        rewind(in);
+        uint8_t *raw = malloc((size_t)size);
+        if (raw == NULL || fread(raw, 1, (size_t)size, in) != (size_t)size) {
+            fclose(in);
+            return false;
+        }
+        load_records(raw, (uint32_t)size);
+        free(raw);
+    } else {
+        (void)load_candump(in);
+    }
+    fclose(in);
+    if (trace_len == 0) {
+        fprintf(stderr, "sd_sim: no ADC frames in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// ---------------- Firmware process ----------------
+
+// CAN RX interrupt, one frame per call at its trace time
+static uint64_t feed_frame(void)
+{
+    CAN_Frame_t frame = trace[feed_next].frame;
+    const CAN_ADCFrame *adc = (const CAN_ADCFrame *)trace[feed_next].frame.data;
+    uint8_t id = adc->what >> 3;
+    frame.timestamp = HAL_GetTick();
+    boot->offered[id]++;
+    if ((adc->length & 1U) != 0 && adc->length <= sizeof(adc->data)) {
+        uint8_t seq = adc->data[adc->length - 1U];
+        if (last_seq[id] >= 0) boot->skipped[id] += (uint8_t)(seq - last_seq[id] - 1);
+        last_seq[id] = seq;
+    }
+    enqueue_can_frame(&frame);
+    feed_next++;
+    boot->next_frame = feed_next;
+    return feed_next < trace_len ? trace[feed_next].at_us : UINT64_MAX;
+}
+
+static void save_results(void)
+{
+    sd_log_get_stats(&boot->log);
+    for (uint8_t id = 0; id < SD_SIM_MAX_ID; id++) {
+        boot->seq_valid[id] = sensor_seq_get_stats(id, &boot->seq[id]);
+    }
+    boot->end_us = host_now_us();
+    fflush(stdout); // _exit does not
+}
+
+static void power_cut(void)
+{
+    save_results();
+    boot->cut = true;
+    _exit(0);
+}
+
+static void task_flush_sd_card(void)
+{
+    sd_log_service(50);
+}
+
+// The card drops out at the configured write and is given back dropout_ms later
+static void task_dropout(void)
+{
+    if (opt.dropout_at == 0 || boot->recovered_us != 0) return;
+    sd_log_stats_t stats;
+    sd_log_get_stats(&stats);
+    if (boot->outage_us == 0) {
+        if (sd_fault_power_lost()) boot->outage_us = host_now_us();
+    } else if (boot->restored_us == 0) {
+        if (host_now_us() - boot->outage_us >= (uint64_t)opt.dropout_ms * 1000U) {
+            sd_fault_clear();
+            boot->restored_us = host_now_us();
+            recoveries_at_restore = stats.recoveries;
+        }
+    } else if (stats.recoveries != recoveries_at_restore) {
+        boot->recovered_us = host_now_us();
+    }
+}
+
+static void run_firmware(uint8_t n, uint64_t start_us, uint32_t first_frame)
+{
+    boot = &shared->boot[n];
+    boot->start_us = start_us;
+    host_set_us(start_us);
+    srand(opt.seed + n);
+
+    ramdisk_power_cut_hook = power_cut;
+    boot->init_ok = sd_log_init(SD_SIM_LOG_MB, SD_SIM_SENS_MB);
+    if (!boot->init_ok) {
+        save_results();
+        _exit(1);
+    }
+    sd_log_write(SD_LOG_INFO, "ECU initialized");
+
+    // Faults count writes from here, a card that fails init only tests setup_panic()
+    sd_fault_config_t fault = opt.fault;
+    if (n == 0) {
+        fault.power_loss_after = opt.dropout_at;
+        ramdisk_set_cut(opt.cut_at);
+    }
+    sd_fault_configure(&fault);
+
+    // Frames sent while the board was off are gone, the rest arrive in their own time
+    memset(last_seq, 0xFF, sizeof(last_seq));
+    feed_next = first_frame;
+    while (feed_next < trace_len && trace[feed_next].at_us < host_now_us()) feed_next++;
+    boot->next_frame = feed_next;
+    uint64_t traffic_end = trace_len ? trace[trace_len - 1].at_us + 1U : 0;
+    if (feed_next < trace_len) host_irq_attach(feed_frame, trace[feed_next].at_us);
+
+    Task tasks[] = {
+        {0, 20, can_handler_poll},
+        {0, 500, task_flush_sd_card},
+        {0, 100, sensor_seq_poll},
+        {0, 1, task_dropout},
+    };
+    uint64_t end_us = (traffic_end > host_now_us() ? traffic_end : host_now_us()) + SD_SIM_DRAIN_MS * 1000ULL;
+    while (host_now_us() < end_us) {
+        uint32_t now = HAL_GetTick();
+        for (unsigned i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+            if (now - tasks[i].last_run_time >= tasks[i].interval) {
+                tasks[i].last_run_time = now;
+                tasks[i].task_function();
+            }
+        }
+        host_advance_ms(1);
+    }
+    host_irq_detach(feed_frame);
+
+    sd_log_shutdown();
+    save_results();
+    boot->finished = true;
+    _exit(0);
+}
+
+// ---------------- Card check ----------------
+
+// Records of one block, which holds whole records only. False if it does not parse exactly.
+static bool scan_block(sim_session_t *s, const uint8_t *raw, uint32_t len)
+{
+    uint32_t i = 0;
+    while (i + 7U <= len) {
+        if (raw[i] != 0 || raw[i + 1] != 0 || raw[i + 2] != 0 || raw[i + 3] != 0) return false;
+        if (raw[i + 4] == SD_LOG_SENS_RECORD) {
+            uint32_t rec = 10U + raw[i + 6];
+            if (raw[i + 6] > 59U || i + rec > len) return false;
+            s->records[raw[i + 5] >> 3]++;
+            i += rec;
+        } else if (raw[i + 4] == SD_LOG_SENS_GAP && i + 13U <= len) {
+            uint8_t stage = raw[i + 12];
+            if (stage <= SENSOR_SEQ_STAGE_SD) {
+                s->gap_lost[raw[i + 5] >> 3][stage] += raw[i + 10] | (uint32_t)raw[i + 11] << 8;
+            }
+            i += 13U;
+        } else {
+            return false;
+        }
+    }
+    return i == len;
+}
+
+static uint8_t *read_file(const char *path, uint32_t *len)
+{
+    FIL f;
+    *len = 0;
+    if (f_open(&f, path, FA_READ) != FR_OK) return NULL;
+    uint32_t size = (uint32_t)f_size(&f);
+    uint8_t *data = malloc(size ? size : 1U);
+    UINT got = 0;
+    if (data != NULL && f_read(&f, data, size, &got) == FR_OK) *len = got;
+    f_close(&f);
+    return data;
+}
+
+static void check_session(uint32_t number, sim_session_t *s)
+{
+    char path[64];
+    uint32_t len;
+    memset(s, 0, sizeof(*s));
+
+    snprintf(path, sizeof(path), "LOG_%04u/%s", (unsigned)number, SD_LOG_SENS_FILE);
+    uint8_t *file = read_file(path, &len);
+    if (file == NULL) return;
+    s->found = true;
+
+    // Every block that checks out, in file order; a damaged one is skipped like sd_unpack does
+    static uint8_t raw[SD_LZ_BLOCK_SIZE];
+    for (uint32_t pos = 0; pos + sizeof(sd_lz_header_t) <= len;) {
+        const sd_lz_header_t *h = (const sd_lz_header_t *)&file[pos];
+        uint32_t frame_len = sizeof(*h) + (h->data_len & ~SD_LZ_STORED);
+        if (h->magic != SD_LZ_MAGIC) {
+            pos++;
+            continue;
+        }
+        uint16_t n = pos + frame_len <= len ? sd_lz_unframe(&file[pos], (uint16_t)frame_len, raw) : 0;
+        if (n == 0) {
+            s->bad_blocks++;
+            pos++;
+            continue;
+        }
+        s->blocks++;
+        s->raw_bytes += n;
+        if (!scan_block(s, raw, n)) s->cut_blocks++;
+        pos += frame_len;
+    }
+
+    // Each index entry points at a block that decodes to its raw length
+    uint32_t idx_len;
+    snprintf(path, sizeof(path), "LOG_%04u/%s", (unsigned)number, SD_LOG_SENS_INDEX_FILE);
+    sd_log_block_index_t *idx = (sd_log_block_index_t *)read_file(path, &idx_len);
+    static uint8_t block[SD_LZ_BLOCK_SIZE];
+    for (uint32_t i = 0; idx != NULL && i < idx_len / sizeof(*idx); i++) {
+        if (idx[i].length == 0) break; // Cut before the entry reached the card
+        s->index_entries++;
+        bool ok = (uint64_t)idx[i].offset + idx[i].length <= len &&
+                  sd_lz_unframe(&file[idx[i].offset], idx[i].length, block) == idx[i].raw_len;
+        if (!ok) s->index_bad++;
+    }
+    free(idx);
+    free(file);
+}
+
+// ---------------- Report ----------------
+
+static bool report_boot(uint8_t n, const sim_session_t *s)
+{
+    const sim_boot_t *b = &shared->boot[n];
+    bool ok = true;
+    uint32_t offered = 0, on_card = 0, lost_rx = 0, lost_sd = 0, lost_link = 0, unaccounted = 0;
+    bool card_healthy = b->log.write_errors == 0 && !b->cut;
+
+    printf("boot %u: %s, %.3f s to %.3f s\n", n + 1U,
+           !b->init_ok ? "INIT FAILED" : b->cut ? "power cut" : b->finished ? "shut down" : "DIED",
+           (double)b->start_us / 1e6, (double)b->end_us / 1e6);
+    if (!b->init_ok || (!b->cut && !b->finished)) return false;
+
+    for (uint8_t id = 0; id < SD_SIM_MAX_ID; id++) {
+        if (b->offered[id] == 0 && s->records[id] == 0) continue;
+        // A gap record dropped from the ring is logged again as an SD gap, so only the total
+        // over the stages has to match, with the frames missing from the traffic as link losses
+        uint32_t gaps = s->gap_lost[id][SENSOR_SEQ_STAGE_LINK] + s->gap_lost[id][SENSOR_SEQ_STAGE_RX_QUEUE] +
+                        s->gap_lost[id][SENSOR_SEQ_STAGE_SD];
+        int32_t missing = (int32_t)(b->offered[id] + b->skipped[id] - s->records[id] - gaps);
+        printf("  sensor %2u: sent %6u (%u skipped) card %6u gaps link %u rx %u sd %u (seq stats rx %u sd %u)%s\n",
+               id, b->offered[id], b->skipped[id], s->records[id], s->gap_lost[id][SENSOR_SEQ_STAGE_LINK],
+               s->gap_lost[id][SENSOR_SEQ_STAGE_RX_QUEUE], s->gap_lost[id][SENSOR_SEQ_STAGE_SD],
+               b->seq_valid[id] ? b->seq[id].lost_rx_queue : 0U, b->seq_valid[id] ? b->seq[id].lost_sd : 0U,
+               missing != 0 ? " MISMATCH" : "");
+        offered += b->offered[id];
+        on_card += s->records[id];
+        lost_link += s->gap_lost[id][SENSOR_SEQ_STAGE_LINK];
+        lost_rx += s->gap_lost[id][SENSOR_SEQ_STAGE_RX_QUEUE];
+        lost_sd += s->gap_lost[id][SENSOR_SEQ_STAGE_SD];
+        if (missing > 0) unaccounted += (uint32_t)missing;
+        if (missing < 0 || (missing > 0 && card_healthy)) ok = false;
+    }
+    const char *where = "";
+    if (unaccounted && !card_healthy) {
+        where = b->cut ? " (in RAM at the cut or in failed writes)" : " (in failed writes)";
+    }
+    printf("  frames: %u sent, %u on card, gaps %u link %u rx queue %u sd ring, %u unaccounted%s\n",
+           offered, on_card, lost_link, lost_rx, lost_sd, unaccounted, where);
+
+    const sd_log_stats_t *l = &b->log;
+    printf("  rings: sensor drop %u bytes (%u records) high water %u/%u, debug drop %u high water %u/%u\n",
+           l->sens_dropped, l->sens_records_dropped, l->sens_high_water, SD_LOG_SENS_BUF_SIZE,
+           l->dbg_dropped, l->dbg_high_water, SD_LOG_DEBUG_BUF_SIZE);
+    printf("  card: %u write errors, %u recoveries (last %u ms, max %u ms), max service %u ms\n",
+           l->write_errors, l->recoveries, l->last_recovery_ms, l->max_recovery_ms, l->max_service_ms);
+    printf("  file: %u blocks, %u damaged, %u not whole records, %u raw bytes, %u index entries (%u bad), "
+           "compressed to %u%%\n", s->blocks, s->bad_blocks, s->cut_blocks, s->raw_bytes, s->index_entries,
+           s->index_bad, l->raw_bytes ? (unsigned)((uint64_t)l->card_bytes * 100U / l->raw_bytes) : 0U);
+
+    // A failed write can leave its block half on the card, a cut write too
+    uint32_t allowed_bad = l->write_errors + (b->cut ? 1U : 0U);
+    if (!s->found || s->bad_blocks > allowed_bad || s->cut_blocks != 0) ok = false;
+    if (s->index_bad > (b->cut ? 1U : 0U)) ok = false;
+
+    if (n == 0 && opt.dropout_at != 0) {
+        if (b->outage_us == 0) {
+            printf("  dropout: card never dropped out\n");
+        } else if (b->recovered_us == 0) {
+            printf("  dropout: out at %.3f s, back at %.3f s, NOT RECOVERED\n",
+                   (double)b->outage_us / 1e6, (double)b->restored_us / 1e6);
+            ok = false;
+        } else {
+            uint32_t ms = (uint32_t)((b->recovered_us - b->restored_us) / 1000U);
+            printf("  dropout: out at %.3f s, back at %.3f s, logging again %u ms later\n",
+                   (double)b->outage_us / 1e6, (double)b->restored_us / 1e6, ms);
+            if (ms > SD_SIM_RECOVERY_MS) ok = false;
+        }
+    }
+    return ok;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sd_sim [-t s] [-r fps] [-n sensors] [-z] [-s sector_us] [-l ms] [-b n:ms]\n"
+                    "              [-f n] [-d n:ms] [-p n] [-S seed] [-v] [trace]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "t:r:n:zs:l:b:f:d:p:S:v")) != -1) {
+        switch (c) {
+            case 't': opt.seconds = (uint32_t)atoi(optarg); break;
+            case 'r': opt.rate = (uint32_t)atoi(optarg); break;
+            case 'n': opt.sensors = (uint8_t)atoi(optarg); break;
+            case 'z': opt.zeros = true; break;
+            case 's': opt.sector_us = (uint32_t)atoi(optarg); break;
+            case 'l': opt.fault.write_latency_ms = (uint16_t)atoi(optarg); break;
+            case 'b':
+                if (sscanf(optarg, "%u:%hu", &opt.fault.busy_every, &opt.fault.busy_ms) != 2) usage();
+                break;
+            case 'f': opt.fault.fail_every = (uint32_t)atoi(optarg); break;
+            case 'd':
+                if (sscanf(optarg, "%u:%u", &opt.dropout_at, &opt.dropout_ms) != 2) usage();
+                break;
+            case 'p': opt.cut_at = (uint32_t)atoi(optarg); break;
+            case 'S': opt.seed = (uint32_t)atoi(optarg); break;
+            case 'v': host_verbose = true; break;
+            default: usage();
+        }
+    }
+    if (optind < argc) opt.trace = argv[optind];
+
+    srand(opt.seed);
+    if (opt.trace != NULL) {
+        if (!load_trace(opt.trace)) return 2;
+    } else {
+        make_synthetic();
+    }
+
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ramdisk_config_t disk = {.sectors = SD_SIM_SECTORS, .sector_us = opt.sector_us};
+    if (shared == MAP_FAILED || !ramdisk_create(&disk)) {
+        fprintf(stderr, "sd_sim: cannot create the RAM disk\n");
+        return 2;
+    }
+    printf("sd_sim: %u frames over %.1f s%s%s, %u us/sector\n", trace_len,
+           trace_len ? (double)trace[trace_len - 1].at_us / 1e6 : 0.0,
+           opt.trace ? " from " : " synthetic", opt.trace ? opt.trace : "", opt.sector_us);
+    fflush(stdout);
+
+    // Each boot is a process of its own, so a power cut can stop it dead anywhere
+    uint64_t start_us = 0;
+    uint32_t first_frame = 0;
+    for (uint8_t n = 0; n < SD_SIM_BOOTS; n++) {
+        pid_t pid = fork();
+        if (pid == 0) run_firmware(n, start_us, first_frame);
+        int status;
+        waitpid(pid, &status, 0);
+        shared->boots = (uint8_t)(n + 1U);
+        if (!shared->boot[n].cut) break;
+        start_us = shared->boot[n].end_us + SD_SIM_REBOOT_MS * 1000ULL;
+        first_frame = shared->boot[n].next_frame;
+    }
+
+    // Read the card back as a PC would
+    static FATFS fs;
+    bool ok = f_mount(&fs, "", 1) == FR_OK;
+    if (!ok) printf("card does not mount\n");
+    ramdisk_stats_t disk_stats;
+    ramdisk_get_stats(&disk_stats);
+    for (uint8_t n = 0; ok && n < shared->boots; n++) {
+        sim_session_t s;
+        check_session(n + 1U, &s);
+        if (!report_boot(n, &s)) ok = false;
+    }
+    printf("disk: %u writes (%u sectors), %u reads, %u refused\n", disk_stats.writes,
+           disk_stats.sectors_written, disk_stats.reads, disk_stats.failed);
+    printf("sd_sim %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
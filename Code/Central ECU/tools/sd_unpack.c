@@ -0,0 +1,143 @@
+// Host decoder for the compressed SD log files written by sd_log (see src/modules/sd_log/sd_lz.h)
+//
+// Build: gcc -O2 -o sd_unpack sd_unpack.c
+// Usage: sd_unpack LOG.LZB log.txt
+//        sd_unpack SENSORS.LZB sensors.raw
+//
+// Damaged or truncated blocks are skipped and decoding resumes at the next valid header.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE  2048U
+#define HEADER_SIZE 8U
+#define MAGIC       0x5A4CU
+#define STORED      0x8000U
+
+// The ECU uses the STM32 CRC unit with its reset configuration (CRC-32/MPEG-2, bytes fed
+// MSB first, no reflection) and keeps the low 16 bits
+static uint16_t ecu_crc16(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint32_t)data[i] << 24;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80000000UL) ? (crc << 1) ^ 0x04C11DB7UL : (crc << 1);
+        }
+    }
+    return (uint16_t)crc;
+}
+
+// Decode one LZ4 block. Returns the decoded size or -1 if the block is malformed.
+static long lz4_decode(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_cap)
+{
+    const uint8_t *ip = src, *iend = src + src_len;
+    uint8_t *op = dst, *oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) break; // Last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t mlen = token & 0x0F;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += 4;
+        if ((size_t)(oend - op) < mlen) return -1;
+        const uint8_t *ref = op - offset;
+        while (mlen--) *op++ = *ref++; // Overlapping copy is intended
+    }
+    return (long)(op - dst);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <in.lzb> <out>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) { perror(argv[1]); return 1; }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *buf = malloc(size > 0 ? (size_t)size : 1);
+    if (!buf || fread(buf, 1, (size_t)size, in) != (size_t)size) { perror("read"); return 1; }
+    fclose(in);
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) { perror(argv[2]); return 1; }
+
+    uint8_t block[BLOCK_SIZE];
+    size_t pos = 0, good = 0, bad = 0, skipped = 0, raw_total = 0;
+
+    while (pos + HEADER_SIZE <= (size_t)size) {
+        const uint8_t *h = buf + pos;
+        uint16_t magic = h[0] | (h[1] << 8);
+        uint16_t raw_len = h[2] | (h[3] << 8);
+        uint16_t data_len = h[4] | (h[5] << 8);
+        uint16_t crc = h[6] | (h[7] << 8);
+        uint16_t n = data_len & ~STORED;
+
+        if (magic != MAGIC || raw_len == 0 || raw_len > BLOCK_SIZE || n > BLOCK_SIZE
+            || pos + HEADER_SIZE + n > (size_t)size) {
+            // Unused preallocated space at the end of a file reads as zeros or junk
+            pos++;
+            skipped++;
+            continue;
+        }
+
+        const uint8_t *data = h + HEADER_SIZE;
+        long len = -1;
+        if (ecu_crc16(data, n) == crc) {
+            if (data_len & STORED) {
+                if (n == raw_len) { memcpy(block, data, n); len = n; }
+            } else {
+                len = lz4_decode(data, n, block, sizeof(block));
+            }
+        }
+        if (len != raw_len) {
+            bad++;
+            pos++;
+            skipped++;
+            continue;
+        }
+
+        fwrite(block, 1, (size_t)len, out);
+        raw_total += (size_t)len;
+        good++;
+        pos += HEADER_SIZE + n;
+    }
+    fclose(out);
+    free(buf);
+
+    fprintf(stderr, "%zu blocks, %zu bytes out (%.1f%% of input), %zu bad blocks, %zu bytes skipped\n",
+            good, raw_total, raw_total ? 100.0 * (double)size / (double)raw_total : 0.0, bad, skipped);
+    return bad ? 1 : 0;
+}
@@ -8,6 +8,7 @@
 #include "can_handlers.h"
 #include "can_buffer.h"
 #include "error_def.h"
+#include "calibration.h"
 
 uint8_t BOARD_ID = 0;
 PTE7300_HandleTypeDef hpte7300_A;
@@ -67,6 +68,9 @@ void app_init(void) {
     can_init();
     can_send_error_warning(CAN_NODE_TYPE_CENTRAL, CAN_NODE_ADDR_CENTRAL, CAN_ERROR_ACTION_WARNING, ADC_WARNING_STARTUP);
 
+    // Load the sensor calibration before anything converts a sample
+    calibration_init();
+
     // Initialise the ADC functionality
     HAL_ADCEx_Calibration_Start(&hadc1);
 
@@ -2,6 +2,7 @@
 #include "debug_io.h"
 #include "can.h"
 #include "ads124_handler.h"
+#include "calibration.h"
 
 static uint16_t adc_buffer[ADC_DOUBLE_BUFFER_SIZE][ADC_NUMBER_CHANNELS];
 static bool buffer_write_first_half = true;
@@ -43,36 +44,41 @@ uint16_t adc_get_batt_voltage()
     }
 }
 
+// NTC line 100*C = 5604.29 - 1.8764*mV, folded with the mV per count into Q16 so it
+// is one multiply per update instead of soft float. Coefficients are in calibration.c.
 int16_t adc_get_NTC_temp()
 {
-    float miliVolts;
+    const calibration_t *cal = calibration_get();
+    int32_t counts;
     if (buffer_write_first_half) {
-        miliVolts = adc_buffer[ADC_DOUBLE_BUFFER_SIZE / 2][ADC_CHANNEL_CJT] * ADC_mV_FACTOR;
+        counts = adc_buffer[ADC_DOUBLE_BUFFER_SIZE / 2][ADC_CHANNEL_CJT];
     } else {
-        miliVolts = adc_buffer[0][ADC_CHANNEL_CJT] * ADC_mV_FACTOR;
+        counts = adc_buffer[0][ADC_CHANNEL_CJT];
     }
-    // Convert mV to temperature in 100*Celsius
-    int16_t temp = (int16_t)(5604.29 - 1.8764 * miliVolts);
+    // Convert to temperature in 100*Celsius
+    int16_t temp = (int16_t)((cal->ntc_offset_q16 - counts * cal->ntc_slope_q16) / 65536);
     adc_update_cj_correction(temp); // Update the CJT correction for thermocouples
     return temp;
 }
 
-#define A5 -1.53240117e-19
-#define A4  1.52238305e-14
-#define A3 -5.09008467e-10
-#define A2  6.43706573e-06
-#define A1  6.61009312e-01
-#define A0 -9.21373426e+00
+// Cold junction 100*C to thermocouple counts, 5th-degree fit. In fixed point: T is taken
+// as Q14 (T / 2^14) so each coefficient is scaled by 2^(14*k), then held in Q16. Within 1
+// count of the float fit over the whole int16 range. Coefficients are in calibration.c.
+#define CJ_POLY_SHIFT 14
 
-static inline float poly5_eval(int16_t T) {
-    // Use Horners method to evaluate polynomial
-    return (((((A5 * T + A4) * T + A3) * T + A2) * T + A1) * T + A0);
+static inline int16_t poly5_eval(int16_t T) {
+    // Use Horners method to evaluate polynomial, 64 bit products
+    const int32_t *poly = calibration_get()->cj_poly_q16;
+    int64_t acc = poly[0];
+    for (uint8_t i = 1; i < CALIBRATION_CJ_TERMS; i++) {
+        acc = ((acc * T) >> CJ_POLY_SHIFT) + poly[i];
+    }
+    return (int16_t)((acc + 32768) >> 16);
 }
 
 void adc_update_cj_correction(int16_t cj_temp)
 {    
-    float cj_adc_count = poly5_eval(cj_temp);
-    ads124_set_cjt_correction((int16_t)cj_adc_count);
+    ads124_set_cjt_correction(poly5_eval(cj_temp));
 }
 
 void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc)
@@ -107,6 +113,9 @@ static void process_adc_data(uint16_t (*data)[ADC_NUMBER_CHANNELS], uint32_t tim
     MIPA_A_Frame[ADC_DOUBLE_BUFFER_SIZE / 2] = data[0][ADC_CHANNEL_REF5V]; // Add REF5V to end of MIPA_A_Frame
     MIPA_B_Frame[ADC_DOUBLE_BUFFER_SIZE / 2] = data[0][ADC_CHANNEL_REF5V]; // And MIPA_B_Frame
 
-    can_send_data(SID_SENSOR_MIPA_A, (uint8_t*)MIPA_A_Frame, ADC_DOUBLE_BUFFER_SIZE + 2, timestamp); // ADC_DOUBLE_BUFFER_SIZE * 2 (uint16_t) / 2 (half buffer) + 2 (for REF5V)
-    can_send_data(SID_SENSOR_MIPA_B, (uint8_t*)MIPA_B_Frame, ADC_DOUBLE_BUFFER_SIZE + 2, timestamp);
+    // Frame sequence numbers, as in can_buffer_tx
+    static uint8_t mipa_a_seq = 0;
+    static uint8_t mipa_b_seq = 0;
+    can_send_data(SID_SENSOR_MIPA_A, (uint8_t*)MIPA_A_Frame, ADC_DOUBLE_BUFFER_SIZE + 2, timestamp, mipa_a_seq++); // ADC_DOUBLE_BUFFER_SIZE * 2 (uint16_t) / 2 (half buffer) + 2 (for REF5V)
+    can_send_data(SID_SENSOR_MIPA_B, (uint8_t*)MIPA_B_Frame, ADC_DOUBLE_BUFFER_SIZE + 2, timestamp, mipa_b_seq++);
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "calibration.h"
+#include <string.h>
+#include "can.h"
+#include "debug_io.h"
+
+_Static_assert(sizeof(calibration_t) == 32, "calibration_t layout changed, bump CALIBRATION_VERSION");
+_Static_assert(sizeof(calibration_t) <= CAL_STORE_MAX_SIZE, "calibration_t too big for the store");
+
+static const calibration_t defaults = {
+    // -1.53240117e-19, 1.52238305e-14, -5.09008467e-10, 6.43706573e-06, 6.61009312e-01, -9.21373426e+00
+    .cj_poly_q16 = {-11856380, 71892507, -146711702, 113242058, 709753344, -603831},
+    // 100*C = 5604.29 - 1.8764*mV
+    .ntc_offset_q16 = 367282749L,   // 5604.29 * 65536
+    .ntc_slope_q16 = 6194L,         // 1.8764 * 3300 / 65520 * 65536
+};
+
+static calibration_t active;
+
+static bool validate(const void *cal)
+{
+    const calibration_t *c = cal;
+    // Keeps counts * slope inside int32 for 16 bit oversampled counts
+    return c->ntc_slope_q16 > 0 && c->ntc_slope_q16 < 0x8000L;
+}
+
+static const cal_store_config_t store_config = {
+    .active = &active,
+    .defaults = &defaults,
+    .size = sizeof(calibration_t),
+    .version = CALIBRATION_VERSION,
+    .validate = validate,
+    .apply = NULL,
+};
+
+void calibration_init(void)
+{
+    cal_store_init(&store_config);
+}
+
+const calibration_t *calibration_get(void)
+{
+    return &active;
+}
+
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length)
+{
+    if (length < 4) return;
+    cal_msg_t req = {0};
+    req.op = frame->what >> 3;
+    req.offset = frame->offset;
+    req.length = frame->length;
+    if (req.length > CAL_STORE_CHUNK || req.length > length - 4U) return;
+    memcpy(req.data, frame->data, req.length);
+
+    cal_msg_t reply;
+    cal_store_request(&req, &reply);
+    dbg_printf("CAL: op %u status %u\r\n", reply.op, reply.status);
+    can_send_calibration(CAN_NODE_TYPE_CENTRAL, CAN_NODE_ADDR_CENTRAL, reply.op, reply.status,
+                         reply.offset, reply.data, reply.length);
+}
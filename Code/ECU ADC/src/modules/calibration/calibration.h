@@ -0,0 +1,31 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "stm32g0xx_hal.h"
+#include "cal_store.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Calibration of this board, kept in the flash store (cal_store.h). The ECU forwards the
+// RIU's requests as CAN_TYPE_CALIBRATION frames and relays the reply.
+
+#define CALIBRATION_VERSION     1U
+#define CALIBRATION_CJ_TERMS    6U
+
+// Field offsets are part of the protocol, only ever append and bump CALIBRATION_VERSION
+typedef struct {
+    int32_t cj_poly_q16[CALIBRATION_CJ_TERMS];  // Cold junction 100*C to thermocouple counts, see adc.c
+    int32_t ntc_offset_q16;                     // NTC 100*C at 0 counts, Q16
+    int32_t ntc_slope_q16;                      // NTC 100*C lost per count, Q16
+} calibration_t;
+
+// Load this board's calibration, before anything that reads it
+void calibration_init(void);
+
+const calibration_t *calibration_get(void);
+
+// CAN_TYPE_CALIBRATION request from the ECU, answered with the same frame type
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length);
+
+#endif // CALIBRATION_H
@@ -8,6 +8,7 @@ void can_buffer_init(can_buffer_t *buffer, uint8_t SID, uint8_t length, bool ena
     buffer->head = 0;
     memset(buffer->data, 0, sizeof(buffer->data));
     buffer->SID = SID; // Set the Sensor ID for CAN transmission
+    buffer->seq = 0;
     buffer->length = length;
     buffer->enableTX = enableTX; // Set the TX enable flag
 }
@@ -33,5 +34,6 @@ bool can_buffer_push(can_buffer_t *buffer, int16_t value)
 
 static inline void can_buffer_tx(can_buffer_t *buffer, uint8_t SID)
 {
-    can_send_data(buffer->SID, (uint8_t *)buffer->data, buffer->length*2, buffer->first_sample_timestamp);
+    // Counted even if the TX queue drops it, so the loss shows up as a gap
+    can_send_data(buffer->SID, (uint8_t *)buffer->data, buffer->length*2, buffer->first_sample_timestamp, buffer->seq++);
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ typedef struct {
     uint8_t head;
     uint8_t length;
     uint8_t SID;
+    uint8_t seq; // Frames sent, goes out with each frame for gap detection on the ECU
     uint32_t first_sample_timestamp; // Timestamp of the first sample
     bool enableTX; // Flag to enable/disable CAN transmission
 } can_buffer_t;
@@ -1,6 +1,7 @@
 #include "can_handlers.h"
 #include "debug_io.h"
 #include "error_def.h"
+#include "calibration.h"
 
 static void handle_cmd_set_servo_arm(CAN_CommandFrame* frame, CAN_ID id);
 static void handle_cmd_set_servo_pos(CAN_CommandFrame* frame, CAN_ID id);
@@ -75,6 +76,9 @@ void can_handler_poll(void) {
         case CAN_TYPE_STATUS:
             handle_status((CAN_StatusFrame*)frame->data, frame->id);
             break;
+        case CAN_TYPE_CALIBRATION:
+            handle_calibration((CAN_CalibrationFrame*)frame->data, frame->id, frame->length);
+            break;
         default:
             dbg_printf("Unknown CAN frame type: %d\n", frame->id.frameType);
             break;
@@ -172,6 +176,25 @@ void handle_status(CAN_StatusFrame* frame, CAN_ID id) {
     uint8_t initiator = frame->what & 0x07; // Bits 0-2 for who
 }
 
+static uint8_t can_dlc_to_bytes(uint8_t dlc_code) {
+    // Convert CAN-FD DLC code (0..15) to number of bytes
+    if (dlc_code <= 8) return dlc_code;
+    switch (dlc_code) {
+        case 9:  return 12;
+        case 10: return 16;
+        case 11: return 20;
+        case 12: return 24;
+        case 13: return 32;
+        case 14: return 48;
+        case 15: return 64;
+        default: return 0;
+    }
+}
+
+void handle_calibration(CAN_CalibrationFrame* frame, CAN_ID id, uint8_t dataLength) {
+    calibration_handle_can(frame, can_dlc_to_bytes(dataLength));
+}
+
 void handle_heartbeat(CAN_HeartbeatFrame* frame, CAN_ID id, uint32_t timestamp) {
     // Handle heartbeat messages
     // RxTimestamp not used at this stage as far more accurate than SysTick and rolls over often
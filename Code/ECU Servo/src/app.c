@@ -4,6 +4,7 @@
 #include "servo.h"
 #include "fsm.h"
 #include "adc.h"
+#include "calibration.h"
 #include "servo.h"
 
 static uint16_t adcValues[4];
@@ -44,6 +45,7 @@ void app_init(void)
         setup_panic(1); // Enter panic mode
     }
 
+    calibration_init(); // Load the feedback calibration before the first position update
     adc_init(); // Initialize ADC for servo position reading
     can_init(); // Initialize CAN peripheral
     servo_init(); // Initialize servos
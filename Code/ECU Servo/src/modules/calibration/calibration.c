@@ -0,0 +1,65 @@
+#include "calibration.h"
+#include <string.h>
+#include "can.h"
+#include "debug_io.h"
+
+_Static_assert(sizeof(calibration_t) == 28, "calibration_t layout changed, bump CALIBRATION_VERSION");
+_Static_assert(sizeof(calibration_t) <= CAL_STORE_MAX_SIZE, "calibration_t too big for the store");
+
+static const calibration_t defaults = {
+    // -0.305944*x + 1128, -0.299401*x + 1120, 0.286369*x - 138, 0.291206*x - 136
+    .feedback_slope_q16 = {-20050, -19622, 18767, 19084},
+    .feedback_offset = {1128, 1120, -138, -136},
+    .position_tolerance = 50,
+    .report_tolerance = 150,
+};
+
+static calibration_t active;
+
+static bool validate(const void *cal)
+{
+    const calibration_t *c = cal;
+    for (uint8_t i = 0; i < CALIBRATION_SERVOS; i++) {
+        // Keeps counts * slope inside int32 for 12 bit counts
+        if (c->feedback_slope_q16[i] == 0 || c->feedback_slope_q16[i] > 0x40000L ||
+            c->feedback_slope_q16[i] < -0x40000L) return false;
+    }
+    return c->position_tolerance > 0 && c->position_tolerance <= c->report_tolerance &&
+           c->report_tolerance <= 1000;
+}
+
+static const cal_store_config_t store_config = {
+    .active = &active,
+    .defaults = &defaults,
+    .size = sizeof(calibration_t),
+    .version = CALIBRATION_VERSION,
+    .validate = validate,
+    .apply = NULL,
+};
+
+void calibration_init(void)
+{
+    cal_store_init(&store_config);
+}
+
+const calibration_t *calibration_get(void)
+{
+    return &active;
+}
+
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length)
+{
+    if (length < 4) return;
+    cal_msg_t req = {0};
+    req.op = frame->what >> 3;
+    req.offset = frame->offset;
+    req.length = frame->length;
+    if (req.length > CAL_STORE_CHUNK || req.length > length - 4U) return;
+    memcpy(req.data, frame->data, req.length);
+
+    cal_msg_t reply;
+    cal_store_request(&req, &reply);
+    dbg_printf("CAL: op %u status %u\r\n", reply.op, reply.status);
+    can_send_calibration(CAN_NODE_TYPE_CENTRAL, CAN_NODE_ADDR_CENTRAL, reply.op, reply.status,
+                         reply.offset, reply.data, reply.length);
+}
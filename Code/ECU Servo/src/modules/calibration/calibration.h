@@ -0,0 +1,32 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "stm32g0xx_hal.h"
+#include "cal_store.h"
+#include "frames.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Calibration of this board, kept in the flash store (cal_store.h). The ECU forwards the
+// RIU's requests as CAN_TYPE_CALIBRATION frames and relays the reply.
+
+#define CALIBRATION_VERSION     1U
+#define CALIBRATION_SERVOS      4U
+
+// Field offsets are part of the protocol, only ever append and bump CALIBRATION_VERSION
+typedef struct {
+    int32_t feedback_slope_q16[CALIBRATION_SERVOS];  // Position per feedback count, Q16. Vent, N2, N2O A, N2O B
+    int16_t feedback_offset[CALIBRATION_SERVOS];     // Position at 0 counts
+    uint16_t position_tolerance;                     // 0-1000 units, a move is complete within this
+    uint16_t report_tolerance;                       // 0-1000 units, reported at position within this
+} calibration_t;
+
+// Load this board's calibration, before anything that reads it
+void calibration_init(void);
+
+const calibration_t *calibration_get(void);
+
+// CAN_TYPE_CALIBRATION request from the ECU, answered with the same frame type
+void calibration_handle_can(const CAN_CalibrationFrame *frame, uint8_t length);
+
+#endif // CALIBRATION_H
@@ -4,6 +4,7 @@
 #include "can.h"
 #include "fsm.h"
 #include "error_def.h"
+#include "calibration.h"
 
 static ServoQueue servoQueue = {
     .items = {0},
@@ -128,7 +129,7 @@ void servo_send_can_positions(void)
         bool atPosition = false;
         int16_t delta = (int16_t)servoByIndex[i]->targetPosition - servoByIndex[i]->currentPosition;
         if (delta < 0) delta = -delta;
-        if (delta <= SERVO_POSITION_TOLERANCE*3) {
+        if (delta <= calibration_get()->report_tolerance) {
             atPosition = true;
         }
         currentPos[i] = (servoByIndex[i]->state << 6) | (atPosition << 5) | (servoByIndex[i]->currentPosition / 50);
@@ -203,7 +204,7 @@ bool servo_queue_check_complete()
         ServoQueueItem *item = &servoQueue.items[servoQueue.head];
         int16_t delta = (int16_t)item->position - item->servo->currentPosition;
         if (delta < 0) delta = -delta;
-        if (delta <= SERVO_POSITION_TOLERANCE) {
+        if (delta <= calibration_get()->position_tolerance) {
             return true; // Item is complete
         }
     }
@@ -246,18 +247,24 @@ void servo_queue_clear_for_servo(Servo *servo) {
     servo_queue_remove_for_servo(servo);
 }
 
+// 12 bit feedback ADC to 0-1000 position, slope in Q16 so there is no soft float per update
+static inline int16_t servo_feedback_to_position(uint16_t adc, int32_t slope_q16, int32_t offset) {
+    return (int16_t)((offset * 65536 + (int32_t)adc * slope_q16) / 65536);
+}
+
 void servo_update_positions() {
     // Get the latest servo positions from the ADC as uint16_t array
     adc_get_servo_positions(servoPositions);
 
     // Convert from 12 bit ADC values to 0-1000 servo positions and set current positions
-    servoVent.currentPosition = (int16_t)(-0.305944*servoPositions[0] + 1128);
+    const calibration_t *cal = calibration_get();
+    servoVent.currentPosition = servo_feedback_to_position(servoPositions[0], cal->feedback_slope_q16[0], cal->feedback_offset[0]);
     servoPositions[0] = servoVent.currentPosition; // Update servoPositions array
-    servoNitrogen.currentPosition = (int16_t)(-0.299401*servoPositions[1] + 1120);
+    servoNitrogen.currentPosition = servo_feedback_to_position(servoPositions[1], cal->feedback_slope_q16[1], cal->feedback_offset[1]);
     servoPositions[1] = servoNitrogen.currentPosition; // Update servoPositions array
-    servoNitrousA.currentPosition = (int16_t)(0.286369*servoPositions[2] - 138);
+    servoNitrousA.currentPosition = servo_feedback_to_position(servoPositions[2], cal->feedback_slope_q16[2], cal->feedback_offset[2]);
     servoPositions[2] = servoNitrousA.currentPosition; // Update servoPositions array
-    servoNitrousB.currentPosition = (int16_t)(0.291206*servoPositions[3] - 136);
+    servoNitrousB.currentPosition = servo_feedback_to_position(servoPositions[3], cal->feedback_slope_q16[3], cal->feedback_offset[3]);
     servoPositions[3] = servoNitrousB.currentPosition; // Update servoPositions array
 }
 